@@ -3,6 +3,8 @@
 #include "algorithms/subgraph.hpp"
 #include <vg/io/stream.hpp>
 #include "../path.hpp"
+#include "../alignment_field_scanner.hpp"
+#include "../io/arena_for_each.hpp"
 
 namespace vg {
 namespace algorithms {
@@ -267,8 +269,36 @@ pair<double, double> sample_mapping_depth(const HandleGraph& graph, const string
         }
     };
     if (format == "GAM") {
+        // We only need the node and length of each mapping, so we don't need
+        // to decode the reads.
+        function<void(const string&)> serialized_callback = [&](const string& serialized) {
+            unordered_map<nid_t, size_t>& node_coverage = node_coverages[omp_get_thread_num()];
+            int32_t mapping_quality;
+            // The mapping quality comes after the path, so hold on to the lengths.
+            thread_local vector<pair<nid_t, int64_t>> mapped_lengths;
+            mapped_lengths.clear();
+            bool parsed = AlignmentFieldScanner::for_each_mapping(serialized, mapping_quality,
+                [&](id_t node_id, bool is_reverse, int64_t offset, int64_t from_length, int64_t to_length) {
+                    mapped_lengths.emplace_back(node_id, from_length);
+                });
+            if (!parsed) {
+                // we're in a parallel task, where an exception can't be caught
+#pragma omp critical (cerr)
+                cerr << "error:[vg::algorithms::coverage_depth] could not parse GAM record" << endl;
+                exit(1);
+            }
+            if (mapping_quality >= min_mapq) {
+                for (auto& mapped_length : mapped_lengths) {
+                    auto found = node_coverage.find(mapped_length.first);
+                    if (found != node_coverage.end()) {
+                        // we add the number of bases covered
+                        found->second += mapped_length.second;
+                    }
+                }
+            }
+        };
         get_input_file(input_filename, [&] (istream& gam_stream) {
-                vg::io::for_each_parallel(gam_stream, aln_callback);
+                vg::io::for_each_parallel_serialized<Alignment>(gam_stream, serialized_callback);
             });
     } else if (format == "GAF") {
         vg::io::gaf_unpaired_for_each_parallel(graph, input_filename, aln_callback);
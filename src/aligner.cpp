@@ -1568,6 +1568,21 @@ void Aligner::align_xdrop(Alignment& alignment, const HandleGraph& g, const vect
     }
 }
 
+void Aligner::align_xdrop(Alignment& alignment, const DozeuInterface::OrderedGraph& g,
+                          const vector<MaximalExactMatch>& mems, bool reverse_complemented, uint16_t max_gap_length) const
+{
+    // XdropAligner manages its own stack, so it can never be threadsafe without be recreated
+    // for every alignment, which meshes poorly with its stack implementation. We achieve
+    // thread-safety by having one per thread, which makes this method const-ish.
+    XdropAligner& xdrop = const_cast<XdropAligner&>(xdrops[omp_get_thread_num()]);
+    xdrop.align(alignment, g, mems, reverse_complemented, full_length_bonus, max_gap_length);
+    if (!alignment.has_path() && mems.empty()) {
+        // dozeu couldn't find an alignment, probably because it's seeding heuristic failed
+        // we'll just fall back on GSSW
+        align(alignment, g.graph, g.order);
+    }
+}
+
 
 // Scoring an exact match is very simple in an ordinary Aligner
 
@@ -2244,6 +2259,26 @@ void QualAdjAligner::align_xdrop(Alignment& alignment, const HandleGraph& g, con
     }
 }
 
+void QualAdjAligner::align_xdrop(Alignment& alignment, const DozeuInterface::OrderedGraph& g,
+                                 const vector<MaximalExactMatch>& mems, bool reverse_complemented,
+                                 uint16_t max_gap_length) const
+{
+    // QualAdjXdropAligner manages its own stack, so it can never be threadsafe without being recreated
+    // for every alignment, which meshes poorly with its stack implementation. We achieve
+    // thread-safety by having one per thread, which makes this method const-ish.
+    QualAdjXdropAligner& xdrop = const_cast<QualAdjXdropAligner&>(xdrops[omp_get_thread_num()]);
+    
+    // get the quality adjusted bonus
+    int8_t bonus = qual_adj_full_length_bonuses[reverse_complemented ? alignment.quality().front() : alignment.quality().back()];
+    
+    xdrop.align(alignment, g, mems, reverse_complemented, bonus, max_gap_length);
+    if (!alignment.has_path() && mems.empty()) {
+        // dozeu couldn't find an alignment, probably because it's seeding heuristic failed
+        // we'll just fall back on GSSW
+        align(alignment, g.graph, true);
+    }
+}
+
 int32_t QualAdjAligner::score_exact_match(const Alignment& aln, size_t read_offset, size_t length) const {
     auto& sequence = aln.sequence();
     auto& base_quality = aln.quality();
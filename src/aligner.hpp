@@ -171,6 +171,12 @@ namespace vg {
         virtual void align_xdrop(Alignment& alignment, const HandleGraph& g, const vector<handle_t>& order,
                                  const vector<MaximalExactMatch>& mems, bool reverse_complemented,
                                  uint16_t max_gap_length = default_xdrop_max_gap_length) const = 0;
+        
+        /// xdrop aligner, but with a graph and topological order that have already been packed for
+        /// dozeu, so that the packing can be reused across alignments
+        virtual void align_xdrop(Alignment& alignment, const DozeuInterface::OrderedGraph& g,
+                                 const vector<MaximalExactMatch>& mems, bool reverse_complemented,
+                                 uint16_t max_gap_length = default_xdrop_max_gap_length) const = 0;
 
         /// Compute the score of an exact match in the given alignment, from the
         /// given offset, of the given length.
@@ -376,6 +382,12 @@ namespace vg {
         void align_xdrop(Alignment& alignment, const HandleGraph& g, const vector<handle_t>& order,
                          const vector<MaximalExactMatch>& mems, bool reverse_complemented,
                          uint16_t max_gap_length = default_xdrop_max_gap_length) const;
+        
+        /// xdrop aligner, but with a graph and topological order that have already been packed for
+        /// dozeu, so that the packing can be reused across alignments
+        void align_xdrop(Alignment& alignment, const DozeuInterface::OrderedGraph& g,
+                         const vector<MaximalExactMatch>& mems, bool reverse_complemented,
+                         uint16_t max_gap_length = default_xdrop_max_gap_length) const;
 
         int32_t score_exact_match(const Alignment& aln, size_t read_offset, size_t length) const;
         int32_t score_exact_match(const string& sequence, const string& base_quality) const;
@@ -441,6 +453,9 @@ namespace vg {
         void align_xdrop(Alignment& alignment, const HandleGraph& g, const vector<handle_t>& order,
                          const vector<MaximalExactMatch>& mems, bool reverse_complemented,
                          uint16_t max_gap_length = default_xdrop_max_gap_length) const;
+        void align_xdrop(Alignment& alignment, const DozeuInterface::OrderedGraph& g,
+                         const vector<MaximalExactMatch>& mems, bool reverse_complemented,
+                         uint16_t max_gap_length = default_xdrop_max_gap_length) const;
         
         int32_t score_exact_match(const Alignment& aln, size_t read_offset, size_t length) const;
         int32_t score_exact_match(const string& sequence, const string& base_quality) const;
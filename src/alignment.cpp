@@ -38,42 +38,58 @@ int hts_for_each_parallel(string& filename, function<void(Alignment&)> lambda,
 
     samFile *in = hts_open(filename.c_str(), "r");
     if (in == NULL) return 0;
+    int thread_count = get_thread_count();
+    if (thread_count > 1) {
+        // Let htslib decompress blocks ahead of us in its own threads. Those
+        // run alongside our workers, so only give it part of the thread budget.
+        hts_set_threads(in, max(1, thread_count / 2));
+    }
     bam_hdr_t *hdr = sam_hdr_read(in);
     map<string, string> rg_sample;
     parse_rg_sample_map(hdr->text, rg_sample);
     map<int, path_handle_t> tid_path_handle;
     parse_tid_path_handle_map(hdr, graph, tid_path_handle);
 
-    int thread_count = get_thread_count();
-    vector<bam1_t*> bs; bs.resize(thread_count);
-    for (auto& b : bs) {
-        b = bam_init1();
+    // Each thread reads a whole batch of records at a time, so it takes the
+    // input lock once per batch instead of once per record.
+    const size_t batch_size = 256;
+    vector<vector<bam1_t*>> batches(thread_count, vector<bam1_t*>(batch_size));
+    for (auto& batch : batches) {
+        for (auto& b : batch) {
+            b = bam_init1();
+        }
     }
 
     bool more_data = true;
-#pragma omp parallel shared(in, hdr, more_data, rg_sample)
+#pragma omp parallel shared(in, hdr, more_data, rg_sample, batches)
     {
         int tid = omp_get_thread_num();
+        vector<bam1_t*>& batch = batches[tid];
         while (more_data) {
-            bam1_t* b = bs[tid];
             // We need to track our own read operation's success separate from
             // the global flag, or someone else encountering EOF will cause us
-            // to drop our read on the floor.
-            bool got_read = false;
+            // to drop our reads on the floor.
+            size_t got_reads = 0;
 #pragma omp critical (hts_input)
             if (more_data) {
-                got_read = sam_read1(in, hdr, b) >= 0;
-                more_data &= got_read;
+                while (got_reads < batch.size() && sam_read1(in, hdr, batch[got_reads]) >= 0) {
+                    got_reads++;
+                }
+                more_data &= (got_reads == batch.size());
             }
             // Now we're outside the critical section so we can only rely on our own variables.
-            if (got_read) {
-                Alignment a = bam_to_alignment(b, rg_sample, tid_path_handle, hdr, graph);
+            for (size_t i = 0; i < got_reads; i++) {
+                Alignment a = bam_to_alignment(batch[i], rg_sample, tid_path_handle, hdr, graph);
                 lambda(a);
             }
         }
     }
 
-    for (auto& b : bs) bam_destroy1(b);
+    for (auto& batch : batches) {
+        for (auto& b : batch) {
+            bam_destroy1(b);
+        }
+    }
     bam_hdr_destroy(hdr);
     hts_close(in);
     return 1;
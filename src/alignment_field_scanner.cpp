@@ -0,0 +1,241 @@
+/**
+ * \file alignment_field_scanner.cpp
+ * Implementations for decoding parts of serialized Alignments.
+ */
+
+#include "alignment_field_scanner.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <stdexcept>
+
+namespace vg {
+
+using namespace std;
+
+using google::protobuf::internal::WireFormatLite;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+/// Look up the number of a field by name, or throw
+static int field_number(const google::protobuf::Descriptor* descriptor, const string& name) {
+    auto field = descriptor->FindFieldByName(name);
+    if (field == nullptr) {
+        throw runtime_error("error:[AlignmentFieldScanner] " + descriptor->name() + " has no field " + name);
+    }
+    return field->number();
+}
+
+/// Field numbers used when walking paths without the descriptors
+struct path_fields_t {
+    int alignment_path = field_number(Alignment::descriptor(), "path");
+    int alignment_mapping_quality = field_number(Alignment::descriptor(), "mapping_quality");
+    int path_mapping = field_number(Path::descriptor(), "mapping");
+    int mapping_position = field_number(Mapping::descriptor(), "position");
+    int mapping_edit = field_number(Mapping::descriptor(), "edit");
+    int position_node_id = field_number(Position::descriptor(), "node_id");
+    int position_offset = field_number(Position::descriptor(), "offset");
+    int position_is_reverse = field_number(Position::descriptor(), "is_reverse");
+    int edit_from_length = field_number(Edit::descriptor(), "from_length");
+    int edit_to_length = field_number(Edit::descriptor(), "to_length");
+};
+
+static const path_fields_t& path_fields() {
+    static const path_fields_t fields;
+    return fields;
+}
+
+/// Read the length of a length-delimited field and limit the stream to it.
+/// Returns false if the field isn't length-delimited or can't be read.
+static bool enter_submessage(CodedInputStream& in, uint32_t tag, CodedInputStream::Limit& limit) {
+    if (WireFormatLite::GetTagWireType(tag) != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+        return false;
+    }
+    uint32_t length;
+    if (!in.ReadVarint32(&length)) {
+        return false;
+    }
+    limit = in.PushLimit(length);
+    return true;
+}
+
+/// Read a varint field's value. Returns false if the field isn't a varint or
+/// can't be read.
+static bool read_varint(CodedInputStream& in, uint32_t tag, uint64_t& value) {
+    return WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_VARINT && in.ReadVarint64(&value);
+}
+
+AlignmentFieldScanner::AlignmentFieldScanner(const vector<string>& field_names) {
+    for (auto& name : field_names) {
+        int number = field_number(Alignment::descriptor(), name);
+        if (number >= kept.size()) {
+            kept.resize(number + 1, false);
+        }
+        kept[number] = true;
+    }
+}
+
+void AlignmentFieldScanner::keep_only_path_presence() {
+    path_presence_field = path_fields().alignment_path;
+}
+
+bool AlignmentFieldScanner::extract(const string& serialized, string& output) const {
+    output.clear();
+    google::protobuf::io::ArrayInputStream raw_in(serialized.data(), serialized.size());
+    CodedInputStream in(&raw_in);
+    google::protobuf::io::StringOutputStream raw_out(&output);
+    CodedOutputStream out(&raw_out);
+
+    int mapping_field = path_fields().path_mapping;
+    bool has_mapping = false;
+    uint32_t tag;
+    while ((tag = in.ReadTag()) != 0) {
+        int field = WireFormatLite::GetTagFieldNumber(tag);
+        if (path_presence_field != 0 && field == path_presence_field) {
+            // Look into the Path just far enough to see if it has a Mapping
+            CodedInputStream::Limit limit;
+            if (!enter_submessage(in, tag, limit)) {
+                return false;
+            }
+            uint32_t path_tag;
+            while (!has_mapping && (path_tag = in.ReadTag()) != 0) {
+                if (WireFormatLite::GetTagFieldNumber(path_tag) == mapping_field) {
+                    has_mapping = true;
+                } else if (!WireFormatLite::SkipField(&in, path_tag)) {
+                    return false;
+                }
+            }
+            if (!in.Skip(in.BytesUntilLimit())) {
+                return false;
+            }
+            in.PopLimit(limit);
+        } else if (field < kept.size() && kept[field]) {
+            if (!WireFormatLite::SkipField(&in, tag, &out)) {
+                return false;
+            }
+        } else if (!WireFormatLite::SkipField(&in, tag)) {
+            return false;
+        }
+    }
+    if (!in.ConsumedEntireMessage()) {
+        return false;
+    }
+
+    if (has_mapping) {
+        // Write a Path holding one empty Mapping
+        uint32_t mapping_tag = WireFormatLite::MakeTag(mapping_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+        out.WriteTag(WireFormatLite::MakeTag(path_presence_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED));
+        out.WriteVarint32(CodedOutputStream::VarintSize32(mapping_tag) + 1);
+        out.WriteTag(mapping_tag);
+        out.WriteVarint32(0);
+    }
+
+    out.Trim();
+    return !out.HadError();
+}
+
+bool AlignmentFieldScanner::parse(const string& serialized, Alignment& aln, string& scratch) const {
+    return extract(serialized, scratch) && aln.ParseFromString(scratch);
+}
+
+bool AlignmentFieldScanner::for_each_mapping(const string& serialized, int32_t& mapping_quality,
+                                             const function<void(id_t, bool, int64_t, int64_t, int64_t)>& iteratee) {
+    const path_fields_t& fields = path_fields();
+
+    mapping_quality = 0;
+    google::protobuf::io::ArrayInputStream raw_in(serialized.data(), serialized.size());
+    CodedInputStream in(&raw_in);
+
+    uint32_t tag;
+    while ((tag = in.ReadTag()) != 0) {
+        int field = WireFormatLite::GetTagFieldNumber(tag);
+        if (field == fields.alignment_mapping_quality) {
+            uint64_t value;
+            if (!read_varint(in, tag, value)) {
+                return false;
+            }
+            mapping_quality = (int32_t) value;
+        } else if (field == fields.alignment_path) {
+            CodedInputStream::Limit path_limit;
+            if (!enter_submessage(in, tag, path_limit)) {
+                return false;
+            }
+            uint32_t path_tag;
+            while ((path_tag = in.ReadTag()) != 0) {
+                if (WireFormatLite::GetTagFieldNumber(path_tag) != fields.path_mapping) {
+                    if (!WireFormatLite::SkipField(&in, path_tag)) {
+                        return false;
+                    }
+                    continue;
+                }
+                // Walk the Mapping, adding up its edits
+                CodedInputStream::Limit mapping_limit;
+                if (!enter_submessage(in, path_tag, mapping_limit)) {
+                    return false;
+                }
+                uint64_t node_id = 0;
+                uint64_t offset = 0;
+                uint64_t is_reverse = 0;
+                int64_t from_length = 0;
+                int64_t to_length = 0;
+                uint32_t mapping_tag;
+                while ((mapping_tag = in.ReadTag()) != 0) {
+                    int mapping_field = WireFormatLite::GetTagFieldNumber(mapping_tag);
+                    if (mapping_field == fields.mapping_position || mapping_field == fields.mapping_edit) {
+                        bool is_position = (mapping_field == fields.mapping_position);
+                        CodedInputStream::Limit inner_limit;
+                        if (!enter_submessage(in, mapping_tag, inner_limit)) {
+                            return false;
+                        }
+                        uint32_t inner_tag;
+                        while ((inner_tag = in.ReadTag()) != 0) {
+                            int inner_field = WireFormatLite::GetTagFieldNumber(inner_tag);
+                            uint64_t value;
+                            bool ok = true;
+                            if (is_position && inner_field == fields.position_node_id) {
+                                ok = read_varint(in, inner_tag, node_id);
+                            } else if (is_position && inner_field == fields.position_offset) {
+                                ok = read_varint(in, inner_tag, offset);
+                            } else if (is_position && inner_field == fields.position_is_reverse) {
+                                ok = read_varint(in, inner_tag, is_reverse);
+                            } else if (!is_position && inner_field == fields.edit_from_length) {
+                                ok = read_varint(in, inner_tag, value);
+                                from_length += (int32_t) value;
+                            } else if (!is_position && inner_field == fields.edit_to_length) {
+                                ok = read_varint(in, inner_tag, value);
+                                to_length += (int32_t) value;
+                            } else {
+                                ok = WireFormatLite::SkipField(&in, inner_tag);
+                            }
+                            if (!ok) {
+                                return false;
+                            }
+                        }
+                        if (!in.ConsumedEntireMessage()) {
+                            return false;
+                        }
+                        in.PopLimit(inner_limit);
+                    } else if (!WireFormatLite::SkipField(&in, mapping_tag)) {
+                        return false;
+                    }
+                }
+                if (!in.ConsumedEntireMessage()) {
+                    return false;
+                }
+                in.PopLimit(mapping_limit);
+                iteratee((id_t) node_id, is_reverse != 0, (int64_t) offset, from_length, to_length);
+            }
+            if (!in.ConsumedEntireMessage()) {
+                return false;
+            }
+            in.PopLimit(path_limit);
+        } else if (!WireFormatLite::SkipField(&in, tag)) {
+            return false;
+        }
+    }
+    return in.ConsumedEntireMessage();
+}
+
+}
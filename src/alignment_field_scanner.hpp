@@ -0,0 +1,67 @@
+#ifndef VG_ALIGNMENT_FIELD_SCANNER_HPP_INCLUDED
+#define VG_ALIGNMENT_FIELD_SCANNER_HPP_INCLUDED
+
+/**
+ * \file alignment_field_scanner.hpp
+ * Decode just the parts of serialized Alignments that a consumer needs,
+ * straight from the Protobuf wire format.
+ */
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <vg/vg.pb.h>
+
+#include "types.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Walks serialized Alignments in the Protobuf wire format, keeping only some
+ * of their top-level fields and skipping over the rest without parsing or
+ * copying them. Consumers that look at only the path and a few scalars, like
+ * coverage and read filtering, can then avoid building the names, sequences,
+ * and annotations of every read.
+ */
+class AlignmentFieldScanner {
+public:
+    /// Make a scanner that keeps the Alignment fields with the given names.
+    /// Throws if a name isn't an Alignment field.
+    AlignmentFieldScanner(const vector<string>& field_names);
+
+    /// Instead of keeping the whole path, keep only whether it has any
+    /// mappings. The path of the kept Alignment will be either empty or a
+    /// single empty Mapping.
+    void keep_only_path_presence();
+
+    /// Copy the kept fields of the given serialized Alignment into output, as
+    /// another serialized Alignment. Returns false if the input can't be
+    /// parsed.
+    bool extract(const string& serialized, string& output) const;
+
+    /// Decode the kept fields of the given serialized Alignment into the
+    /// given Alignment, using the given scratch string. Returns false if the
+    /// input can't be parsed.
+    bool parse(const string& serialized, Alignment& aln, string& scratch) const;
+
+    /// Call the iteratee with the node ID, orientation, and offset of each
+    /// Mapping on the path of the given serialized Alignment, along with the
+    /// total from and to lengths of its edits, without constructing any
+    /// Protobuf objects. Fills in the mapping quality. Returns false if the
+    /// input can't be parsed.
+    static bool for_each_mapping(const string& serialized, int32_t& mapping_quality,
+                                 const function<void(id_t, bool, int64_t, int64_t, int64_t)>& iteratee);
+
+private:
+    /// Whether each field number is kept
+    vector<bool> kept;
+    /// The field number of the path, if we only keep whether it has mappings
+    int path_presence_field = 0;
+};
+
+}
+
+#endif
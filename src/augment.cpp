@@ -6,6 +6,7 @@
 #include "alignment.hpp"
 #include "packer.hpp"
 #include "annotation.hpp"
+#include "io/arena_for_each.hpp"
 //#define debug
 
 using namespace vg::io;
@@ -45,7 +46,7 @@ void augment(MutablePathMutableHandleGraph* graph,
         if (aln_format == "GAM") {
             get_input_file(gam_path, [&](istream& gam_stream) {
                     if (parallel) {
-                        vg::io::for_each_parallel(gam_stream, aln_callback, Packer::estimate_batch_size(get_thread_count()));
+                        vg::io::for_each_parallel_arena(gam_stream, aln_callback, Packer::estimate_batch_size(get_thread_count()));
                     } else {
                         vg::io::for_each(gam_stream, aln_callback);
                     }
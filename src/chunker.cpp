@@ -432,5 +432,20 @@ set<pair<pair<id_t, bool>, pair<id_t, bool>>> PathChunker::get_path_edge_index(s
     return path_edges;
 }
 
+template<>
+void ChunkReadRouter<Alignment>::write_reads(ostream& out, vector<Alignment>& reads) {
+    // Each write makes a complete GAM segment, and the segments concatenate.
+    vg::io::ProtobufEmitter<Alignment> emitter(out);
+    for (auto& read : reads) {
+        emitter.write(std::move(read));
+    }
+}
+
+template<>
+void ChunkReadRouter<GAFRecord>::write_reads(ostream& out, vector<GAFRecord>& reads) {
+    for (auto& read : reads) {
+        out << read.line() << "\n";
+    }
+}
 
 }
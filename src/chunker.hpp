@@ -2,13 +2,19 @@
 #define VG_CHUNKER_HPP_INCLUDED
 
 #include <iostream>
+#include <fstream>
 #include <map>
 #include <chrono>
 #include <ctime>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "vg/io/json2pb.h"
 #include "region.hpp"
 #include "handle.hpp"
 #include "snarls.hpp"
+#include "gaf_stream.hpp"
 
 namespace vg {
 
@@ -72,6 +78,192 @@ public:
 
 };
 
+/**
+ * Sends reads to the files for the chunks they belong in, writing the files
+ * on background threads. Each chunk buffers a bounded number of reads before
+ * they are handed off to the writer thread responsible for that chunk, and
+ * the writers each have a bounded queue, so memory use doesn't depend on the
+ * size of the input. Reads come out in each chunk's file in the order they
+ * were routed.
+ *
+ * Chunk files are opened only while being written, so there can be more
+ * chunks than open file descriptors. GAM chunks are written as concatenated
+ * GAM segments, and GAF chunks as plain text.
+ */
+template<typename Message>
+class ChunkReadRouter {
+public:
+    
+    /// Make a router writing to the files with the given names, on the given
+    /// number of threads. Each chunk holds up to buffer_size reads before
+    /// they are sent to be written.
+    ChunkReadRouter(const vector<string>& filenames, size_t writer_threads, size_t buffer_size = 256);
+    
+    /// Finish writing, if that hasn't happened yet.
+    ~ChunkReadRouter();
+    
+    ChunkReadRouter(const ChunkReadRouter& other) = delete;
+    ChunkReadRouter& operator=(const ChunkReadRouter& other) = delete;
+    
+    /// Add a copy of a read to the given chunk. May block if the writers are
+    /// behind. Must only be called from one thread at a time.
+    void route(size_t chunk, const Message& read);
+    
+    /// Write out all the buffered reads and wait for the writers to finish.
+    /// Chunks with no reads get empty files.
+    void finish();
+    
+private:
+    
+    /// Write the given reads to the end of the given stream.
+    static void write_reads(ostream& out, vector<Message>& reads);
+    
+    /// Hand a chunk's buffered reads off to its writer.
+    void send(size_t chunk);
+    
+    /// Write the reads for the given writer's chunks until told to stop.
+    void run_writer(size_t writer);
+    
+    struct writer_t {
+        thread worker;
+        mutex queue_mutex;
+        condition_variable queue_changed;
+        deque<pair<size_t, vector<Message>>> queue;
+        bool done = false;
+    };
+    
+    /// How many buffers can wait for each writer?
+    const static size_t MAX_QUEUED = 8;
+    
+    vector<string> filenames;
+    size_t buffer_size;
+    /// The reads waiting to go to each chunk
+    vector<vector<Message>> buffers;
+    /// Whether each chunk's file has been started. Each entry is only used by
+    /// the chunk's writer, or after the writers finish.
+    vector<uint8_t> started;
+    vector<unique_ptr<writer_t>> writers;
+    bool finished = false;
+};
+
+template<>
+void ChunkReadRouter<Alignment>::write_reads(ostream& out, vector<Alignment>& reads);
+
+template<>
+void ChunkReadRouter<GAFRecord>::write_reads(ostream& out, vector<GAFRecord>& reads);
+
+////////////
+// Template Implementations
+////////////
+
+template<typename Message>
+ChunkReadRouter<Message>::ChunkReadRouter(const vector<string>& filenames, size_t writer_threads, size_t buffer_size) :
+    filenames(filenames), buffer_size(max<size_t>(buffer_size, 1)), buffers(filenames.size()),
+    started(filenames.size(), false) {
+    
+    writer_threads = max<size_t>(1, min(writer_threads, filenames.size()));
+    for (size_t i = 0; i < writer_threads; i++) {
+        writers.emplace_back(new writer_t());
+    }
+    for (size_t i = 0; i < writer_threads; i++) {
+        writers[i]->worker = thread(&ChunkReadRouter<Message>::run_writer, this, i);
+    }
+}
+
+template<typename Message>
+ChunkReadRouter<Message>::~ChunkReadRouter() {
+    finish();
+}
+
+template<typename Message>
+void ChunkReadRouter<Message>::route(size_t chunk, const Message& read) {
+    buffers[chunk].push_back(read);
+    if (buffers[chunk].size() >= buffer_size) {
+        send(chunk);
+    }
+}
+
+template<typename Message>
+void ChunkReadRouter<Message>::send(size_t chunk) {
+    // Chunks always go to the same writer, so they stay in order.
+    writer_t& writer = *writers[chunk % writers.size()];
+    unique_lock<mutex> lock(writer.queue_mutex);
+    writer.queue_changed.wait(lock, [&]() {
+        return writer.queue.size() < MAX_QUEUED;
+    });
+    writer.queue.emplace_back(chunk, std::move(buffers[chunk]));
+    buffers[chunk].clear();
+    writer.queue_changed.notify_all();
+}
+
+template<typename Message>
+void ChunkReadRouter<Message>::run_writer(size_t writer_number) {
+    writer_t& writer = *writers[writer_number];
+    while (true) {
+        pair<size_t, vector<Message>> job;
+        {
+            unique_lock<mutex> lock(writer.queue_mutex);
+            writer.queue_changed.wait(lock, [&]() {
+                return !writer.queue.empty() || writer.done;
+            });
+            if (writer.queue.empty()) {
+                // We are done and there's nothing left to write.
+                return;
+            }
+            job = std::move(writer.queue.front());
+            writer.queue.pop_front();
+            writer.queue_changed.notify_all();
+        }
+        
+        // Start the file the first time, and add to it after that.
+        const string& filename = filenames[job.first];
+        ofstream out(filename, started[job.first] ? ios::app : ios::trunc);
+        if (!out) {
+            cerr << "error[vg chunk]: can't open output chunk file " << filename << endl;
+            exit(1);
+        }
+        started[job.first] = true;
+        write_reads(out, job.second);
+    }
+}
+
+template<typename Message>
+void ChunkReadRouter<Message>::finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+    
+    for (size_t i = 0; i < buffers.size(); i++) {
+        if (!buffers[i].empty()) {
+            send(i);
+        }
+    }
+    for (auto& writer : writers) {
+        {
+            lock_guard<mutex> lock(writer->queue_mutex);
+            writer->done = true;
+        }
+        writer->queue_changed.notify_all();
+    }
+    for (auto& writer : writers) {
+        writer->worker.join();
+    }
+    
+    for (size_t i = 0; i < filenames.size(); i++) {
+        if (!started[i]) {
+            // Make an empty file for the chunk.
+            ofstream out(filenames[i]);
+            if (!out) {
+                cerr << "error[vg chunk]: can't open output chunk file " << filenames[i] << endl;
+                exit(1);
+            }
+            vector<Message> no_reads;
+            write_reads(out, no_reads);
+        }
+    }
+}
+
 
 }
 
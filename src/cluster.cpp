@@ -1666,6 +1666,56 @@ vector<pair<size_t, size_t>> PathOrientedDistanceMeasurer::exclude_merges(vector
     return excludes;
 }
     
+vector<pair<pair<path_handle_t, bool>, int64_t>> PathOrientedDistanceMeasurer::path_coordinates(const pos_t& pos) {
+    
+    vector<pair<pair<path_handle_t, bool>, int64_t>> coordinates;
+    
+    // add the coordinates of the start of an oriented node on each of its path strands,
+    // shifted by some distance
+    auto add_coordinates = [&](const handle_t& handle, int64_t shift) {
+        for (const step_handle_t& step : graph->steps_of_handle(handle)) {
+            bool rev_strand = graph->get_handle_of_step(step) != handle;
+            int64_t path_offset = graph->get_position_of_step(step);
+            int64_t coordinate = rev_strand ? -(path_offset + (int64_t) graph->get_length(handle)) : path_offset;
+            coordinates.emplace_back(make_pair(graph->get_path_handle_of_step(step), rev_strand),
+                                     coordinate + shift);
+        }
+    };
+    
+    handle_t handle = graph->get_handle(id(pos), is_rev(pos));
+    add_coordinates(handle, offset(pos));
+    
+    if (coordinates.empty() && max_walk > 0) {
+        // walk outward to the nearest node on a path, with the same distance semantics as the
+        // traversals in oriented_distance
+        RankPairingHeap<pair<handle_t, bool>, int64_t, greater<int64_t>> queue;
+        queue.push_or_reprioritize(make_pair(handle, true), offset(pos) - graph->get_length(handle));
+        queue.push_or_reprioritize(make_pair(handle, false), -offset(pos));
+        
+        while (!queue.empty() && coordinates.empty()) {
+            auto trav = queue.top();
+            queue.pop();
+            
+            if (trav.second > (int64_t) max_walk) {
+                break;
+            }
+            
+            int64_t dist = trav.second + graph->get_length(trav.first.first);
+            if (trav.first.first != handle) {
+                // walking left, the position is to the right of the node's start, and walking right,
+                // it is to the left
+                add_coordinates(trav.first.first, trav.first.second ? dist : -trav.second);
+            }
+            
+            graph->follow_edges(trav.first.first, trav.first.second, [&](const handle_t& next) {
+                queue.push_or_reprioritize(make_pair(next, trav.first.second), dist);
+            });
+        }
+    }
+    
+    return coordinates;
+}
+    
 SnarlOrientedDistanceMeasurer::SnarlOrientedDistanceMeasurer(SnarlDistanceIndex* distance_index) : distance_index(distance_index) {
     
     // nothing to do
@@ -1861,6 +1911,144 @@ OrientedDistanceClusterer::OrientedDistanceClusterer(OrientedDistanceMeasurer& d
         
 }
 
+WindowedPathClusterer::WindowedPathClusterer(PathOrientedDistanceMeasurer& path_distance_measurer,
+                                             size_t max_expected_dist_approx_error,
+                                             size_t max_edges_per_hit)
+    : OrientedDistanceClusterer(path_distance_measurer, max_expected_dist_approx_error),
+      path_distance_measurer(path_distance_measurer), max_edges_per_hit(max_edges_per_hit) {
+    
+}
+    
+MEMClusterer::HitGraph WindowedPathClusterer::make_hit_graph(const Alignment& alignment, const vector<MaximalExactMatch>& mems,
+                                                             const GSSWAligner* aligner, size_t min_mem_length,
+                                                             const match_fanouts_t* fanouts) {
+    
+    HitGraph hit_graph(mems, alignment, aligner, min_mem_length, false, fanouts);
+    
+    // place each hit on the path strands it is on as records of (path strand, coordinate, hit)
+    unordered_map<pair<path_handle_t, bool>, size_t> path_strand_idx;
+    vector<tuple<size_t, int64_t, size_t>> path_positions;
+    for (size_t i = 0; i < hit_graph.nodes.size(); ++i) {
+        for (const auto& coordinate : path_distance_measurer.path_coordinates(hit_graph.nodes[i].start_pos)) {
+            auto it = path_strand_idx.find(coordinate.first);
+            if (it == path_strand_idx.end()) {
+                it = path_strand_idx.emplace(coordinate.first, path_strand_idx.size()).first;
+            }
+            path_positions.emplace_back(it->second, coordinate.second, i);
+        }
+    }
+    std::sort(path_positions.begin(), path_positions.end());
+    
+    // the range of the records on each path strand, and the records of each hit
+    vector<pair<size_t, size_t>> strand_ranges(path_strand_idx.size(), make_pair(0, 0));
+    vector<vector<size_t>> hit_records(hit_graph.nodes.size());
+    for (size_t i = 0; i < path_positions.size(); ++i) {
+        auto& strand_range = strand_ranges[get<0>(path_positions[i])];
+        if (strand_range.first == strand_range.second) {
+            strand_range.first = i;
+        }
+        strand_range.second = i + 1;
+        hit_records[get<2>(path_positions[i])].push_back(i);
+    }
+    
+    int64_t forward_gap_length = min<int64_t>(aligner->longest_detectable_gap(alignment), max_gap) + max_expected_dist_approx_error;
+    
+    // the edges out of one hit on all of its path strands, as (discrepancy between graph and read distance,
+    // (to, graph distance, weight))
+    vector<pair<int64_t, tuple<size_t, int64_t, int32_t>>> hit_edges;
+    
+    for (size_t pivot_idx = 0; pivot_idx < hit_graph.nodes.size(); ++pivot_idx) {
+        
+        HitNode& pivot = hit_graph.nodes[pivot_idx];
+        int64_t pivot_length = pivot.mem->end - pivot.mem->begin;
+        int64_t suffix_length = alignment.sequence().end() - pivot.mem->begin;
+        
+        hit_edges.clear();
+        for (size_t i : hit_records[pivot_idx]) {
+            
+            int64_t strand_pos = get<1>(path_positions[i]);
+            const auto& strand_range = strand_ranges[get<0>(path_positions[i])];
+            
+            // the same window of possible edges that the OrientedDistanceClusterer uses
+            int64_t target_low_pos = strand_pos - max_expected_dist_approx_error;
+            int64_t target_hi_pos = strand_pos + suffix_length + forward_gap_length;
+            
+            auto low = lower_bound(path_positions.begin() + strand_range.first, path_positions.begin() + strand_range.second,
+                                   target_low_pos, [](const tuple<size_t, int64_t, size_t>& record, int64_t value) {
+                return get<1>(record) < value;
+            });
+            auto hi = upper_bound(low, path_positions.begin() + strand_range.second,
+                                  target_hi_pos, [](int64_t value, const tuple<size_t, int64_t, size_t>& record) {
+                return value < get<1>(record);
+            });
+            
+#ifdef debug_mem_clusterer
+            cerr << "checking for possible edges from " << pivot_idx << " to " << (hi - low) << " MEMs inside the interval (" << target_low_pos << ", " << target_hi_pos << ") on path strand " << get<0>(path_positions[i]) << endl;
+#endif
+            
+            for (auto it = low; it != hi; ++it) {
+                
+                size_t next_idx = get<2>(*it);
+                if (next_idx == pivot_idx) {
+                    // don't make self edges
+                    continue;
+                }
+                HitNode& next = hit_graph.nodes[next_idx];
+                
+                // the estimated distance between the end of the pivot and the start of the next MEM in the graph
+                int64_t graph_dist = get<1>(*it) - strand_pos - pivot_length;
+                int64_t discrepancy = abs(graph_dist - (next.mem->begin - pivot.mem->end));
+                
+                if (next.mem->begin >= pivot.mem->begin && next.mem->end <= pivot.mem->end
+                    && abs((get<1>(*it) - strand_pos) - (next.mem->begin - pivot.mem->begin)) <= 1) {
+                    // this looks like a redundant sub-MEM, so we only add a dummy edge to join the clusters.
+                    // its graph and read distances agree, so it will rank with the best edges
+                    hit_edges.emplace_back(discrepancy, make_tuple(next_idx, graph_dist, numeric_limits<int32_t>::lowest() / 2));
+                }
+                else if (next.mem->begin <= pivot.mem->begin || next.mem->end <= pivot.mem->end) {
+                    // these MEMs cannot be colinear along the read
+                    continue;
+                }
+                else {
+                    hit_edges.emplace_back(discrepancy, make_tuple(next_idx, graph_dist,
+                                                                   estimate_edge_score(pivot.mem, next.mem, graph_dist, aligner)));
+                }
+            }
+        }
+        
+        // a pair of hits can be found together on several path strands, in which case we keep the shortest
+        // distance like the OrientedDistanceMeasurer would
+        std::sort(hit_edges.begin(), hit_edges.end(), [](const pair<int64_t, tuple<size_t, int64_t, int32_t>>& a,
+                                                         const pair<int64_t, tuple<size_t, int64_t, int32_t>>& b) {
+            return make_pair(get<0>(a.second), abs(get<1>(a.second))) < make_pair(get<0>(b.second), abs(get<1>(b.second)));
+        });
+        hit_edges.resize(unique(hit_edges.begin(), hit_edges.end(), [](const pair<int64_t, tuple<size_t, int64_t, int32_t>>& a,
+                                                                       const pair<int64_t, tuple<size_t, int64_t, int32_t>>& b) {
+            return get<0>(a.second) == get<0>(b.second);
+        }) - hit_edges.begin());
+        
+        if (max_edges_per_hit != 0 && hit_edges.size() > max_edges_per_hit) {
+            // keep only the edges that look most consistent with the read, then put them back in order
+            nth_element(hit_edges.begin(), hit_edges.begin() + max_edges_per_hit, hit_edges.end());
+            hit_edges.resize(max_edges_per_hit);
+            std::sort(hit_edges.begin(), hit_edges.end(), [](const pair<int64_t, tuple<size_t, int64_t, int32_t>>& a,
+                                                             const pair<int64_t, tuple<size_t, int64_t, int32_t>>& b) {
+                return get<0>(a.second) < get<0>(b.second);
+            });
+        }
+        
+        for (const auto& hit_edge : hit_edges) {
+            hit_graph.add_edge(pivot_idx, get<0>(hit_edge.second), get<2>(hit_edge.second), get<1>(hit_edge.second));
+            
+#ifdef debug_mem_clusterer
+            cerr << "adding edge from MEM " << pivot_idx << " to " << get<0>(hit_edge.second) << " with weight " << get<2>(hit_edge.second) << endl;
+#endif
+        }
+    }
+    
+    return hit_graph;
+}
+
 unordered_map<pair<size_t, size_t>, int64_t> OrientedDistanceClusterer::get_on_strand_distance_tree(size_t num_items,
                                                                                                     const function<pos_t(size_t)>& get_position,
                                                                                                     const function<int64_t(size_t)>& get_offset) {
@@ -417,6 +417,12 @@ public:
     vector<pair<size_t, size_t>> exclude_merges(vector<vector<size_t>>& current_groups,
                                                 const function<pos_t(size_t)>& get_position);
     
+    /// Project a position onto the strands of the paths that it lies on, or the nearest paths
+    /// within the maximum walk if it is not on any. Coordinates on the reverse strand of a path
+    /// are negative, so that the difference between two coordinates on the same path strand is
+    /// their oriented distance.
+    vector<pair<pair<path_handle_t, bool>, int64_t>> path_coordinates(const pos_t& pos);
+    
     /// The maximum distance we will walk trying to find a shared path
     size_t max_walk = 50;
     
@@ -568,6 +574,34 @@ protected:
     bool unstranded;
     
 };
+
+/*
+ * A version of the OrientedDistanceClusterer that places hits directly on the coordinates of
+ * embedded paths rather than building a distance tree between them, and only looks for edges
+ * within a window along each path strand. It finds the same edges as the OrientedDistanceClusterer
+ * when they lie within the window, but its memory is linear in the number of hits.
+ */
+class WindowedPathClusterer : public OrientedDistanceClusterer {
+public:
+    
+    /// Constructor
+    WindowedPathClusterer(PathOrientedDistanceMeasurer& path_distance_measurer,
+                          size_t max_expected_dist_approx_error = 8,
+                          size_t max_edges_per_hit = 64);
+    
+protected:
+    
+    /// Concrete implementation of virtual method from MEMClusterer, overrides the inherited one from
+    /// OrientedDistanceClusterer
+    HitGraph make_hit_graph(const Alignment& alignment, const vector<MaximalExactMatch>& mems, const GSSWAligner* aligner,
+                            size_t min_mem_length, const match_fanouts_t* fanouts);
+    
+    PathOrientedDistanceMeasurer& path_distance_measurer;
+    
+    /// The most edges we will add out of a hit, across all path strands and including the dummy edges
+    /// to its sub-MEMs, keeping the ones whose graph and read distances agree best (0 for no maximum)
+    size_t max_edges_per_hit;
+};
     
 /*
  * An abtract class that provides a heuristic distance between two positions. The semantics are
@@ -43,23 +43,52 @@ DozeuInterface::OrderedGraph::OrderedGraph(const HandleGraph& graph, const vecto
     for (size_t i = 0; i < order.size(); ++i) {
         index_of[order[i]] = i;
     }
+    
+    // pack the sequences and the edges within the order, so that we never have to query
+    // the graph again during alignment
+    sequence_offsets.reserve(order.size() + 1);
+    neighbor_offsets.reserve(2 * order.size() + 1);
+    for (size_t i = 0; i < order.size(); ++i) {
+        sequence_offsets.push_back(sequences.size());
+        sequences.append(graph.get_sequence(order[i]));
+        for (bool go_left : {true, false}) {
+            neighbor_offsets.push_back(neighbors.size());
+            graph.follow_edges(order[i], go_left, [&](const handle_t& next) {
+                auto it = index_of.find(next);
+                if (it != index_of.end()) {
+                    neighbors.push_back(it->second);
+                }
+            });
+        }
+    }
+    sequence_offsets.push_back(sequences.size());
+    neighbor_offsets.push_back(neighbors.size());
 }
 
 void DozeuInterface::OrderedGraph::for_each_neighbor(const size_t i, bool go_left,
                                                      const function<void(size_t)>& lambda) const {
-    graph.follow_edges(order[i], go_left, [&](const handle_t& pred) {
-        auto it = index_of.find(pred);
-        if (it != index_of.end()) {
-            lambda(it->second);
-        }
-        return true;
-    });
+    size_t slot = 2 * i + (go_left ? 0 : 1);
+    for (size_t j = neighbor_offsets[slot]; j < neighbor_offsets[slot + 1]; ++j) {
+        lambda(neighbors[j]);
+    }
 }
 
 size_t DozeuInterface::OrderedGraph::size() const {
     return order.size();
 }
 
+const char* DozeuInterface::OrderedGraph::sequence(size_t i) const {
+    return sequences.c_str() + sequence_offsets[i];
+}
+
+size_t DozeuInterface::OrderedGraph::length(size_t i) const {
+    return sequence_offsets[i + 1] - sequence_offsets[i];
+}
+
+size_t DozeuInterface::OrderedGraph::total_length() const {
+    return sequences.size();
+}
+
 static inline char comp(char x)
 {
 	switch(x) {
@@ -97,7 +126,7 @@ DozeuInterface::graph_pos_s DozeuInterface::calculate_seed_position(const Ordere
 	pos.node_index = graph.index_of.at(graph.graph.get_handle(gcsa::Node::id(seed_pos), gcsa::Node::rc(seed_pos)));
     
 	// calc ref_offset
-	pos.ref_offset = direction ? (graph.graph.get_length(graph.order[pos.node_index]) - gcsa::Node::offset(seed_pos))
+	pos.ref_offset = direction ? (graph.length(pos.node_index) - gcsa::Node::offset(seed_pos))
                                : gcsa::Node::offset(seed_pos);
 
     // calc query_offset (FIXME: is there O(1) solution?)
@@ -120,9 +149,6 @@ DozeuInterface::graph_pos_s DozeuInterface::calculate_max_position(const Ordered
 	graph_pos_s pos;
 	pos.node_index = max_node_index;
     
-    // Find the node
-    handle_t n = graph.order[pos.node_index];
-
     assert(forefronts.at(max_node_index)->mcap != nullptr);
 
 	// calc max position on the node
@@ -131,7 +157,7 @@ DozeuInterface::graph_pos_s DozeuInterface::calculate_max_position(const Ordered
 	// ref-side offset fixup
 	int32_t rpos = (int32_t)(max_pos>>32);
 
-	pos.ref_offset = direction ? -rpos : (graph.graph.get_length(n) - rpos);
+	pos.ref_offset = direction ? -rpos : (graph.length(pos.node_index) - rpos);
 
 	// query-side offset fixup
 	int32_t qpos = max_pos & 0xffffffff;
@@ -173,16 +199,17 @@ pair<DozeuInterface::graph_pos_s, bool> DozeuInterface::scan_seed_position(const
             incoming_forefronts.push_back(inc_ff);
         });
         
-        auto seq = graph.graph.get_sequence(graph.order[i]);
+        const char* seq = graph.sequence(i);
+        int64_t seq_len = graph.length(i);
         if (incoming_forefronts.empty()) {
             forefronts[i] = scan(packed_query, &aln_init.root, 1,
-                                 &seq.c_str()[direction ? seq.size() : 0],
-                                 direction ? -seq.size() : seq.size(), i, aln_init.xt);
+                                 &seq[direction ? seq_len : 0],
+                                 direction ? -seq_len : seq_len, i, aln_init.xt);
         }
         else {
             forefronts[i] = scan(packed_query, incoming_forefronts.data(), incoming_forefronts.size(),
-                                 &seq.c_str()[direction ? seq.size() : 0],
-                                 direction ? -seq.size() : seq.size(), i, aln_init.xt);
+                                 &seq[direction ? seq_len : 0],
+                                 direction ? -seq_len : seq_len, i, aln_init.xt);
         }
         
         if(forefronts[i]->max + (direction & dz_geq(forefronts[i])) > forefronts[max_idx]->max) {
@@ -231,16 +258,17 @@ size_t DozeuInterface::do_poa(const OrderedGraph& graph, const dz_query_s* packe
     for (const graph_pos_s& seed_pos : seed_positions) {
         
         // get root node
-        auto root_seq = graph.graph.get_sequence(graph.order[seed_pos.node_index]);
+        const char* root_seq = graph.sequence(seed_pos.node_index);
          
         // load position and length
-        int64_t rlen = (right_to_left ? 0 : root_seq.size()) - seed_pos.ref_offset;
+        int64_t rlen = (right_to_left ? 0 : (int64_t) graph.length(seed_pos.node_index)) - seed_pos.ref_offset;
         
         
         debug("seed rpos(%lu), rlen(%ld), nid(%ld), rseq(%s)", seed_pos.ref_offset, rlen,
-              graph.graph.get_id(graph.order[seed_pos.node_index]), root_seq.c_str());
+              graph.graph.get_id(graph.order[seed_pos.node_index]),
+              string(root_seq, graph.length(seed_pos.node_index)).c_str());
         forefronts[seed_pos.node_index] = extend(packed_query, &aln_init.root, 1,
-                                                 root_seq.c_str() + seed_pos.ref_offset,
+                                                 root_seq + seed_pos.ref_offset,
                                                  rlen, seed_pos.node_index, aln_init.xt);
         
         // push the start index out as far as we can
@@ -271,14 +299,15 @@ size_t DozeuInterface::do_poa(const OrderedGraph& graph, const dz_query_s* packe
             // TODO: if there were multiple seed positions and we didn't choose head nodes, we
             // can end up clobbering them here, seems like it might be fragile if anyone develops this again...
             
-            auto ref_seq = graph.graph.get_sequence(graph.order[i]);
+            const char* ref_seq = graph.sequence(i);
+            int64_t ref_len = graph.length(i);
             
-            debug("extend rlen(%ld), nid(%ld), rseq(%s)", ref_seq.size(),
-                  graph.graph.get_id(graph.order[i]), ref_seq.c_str());
+            debug("extend rlen(%ld), nid(%ld), rseq(%s)", ref_len,
+                  graph.graph.get_id(graph.order[i]), string(ref_seq, ref_len).c_str());
             
             forefronts[i] = extend(packed_query, incoming_forefronts.data(), incoming_forefronts.size(),
-                                   &ref_seq.c_str()[right_to_left ? ref_seq.length() : 0],
-                                   right_to_left ? -ref_seq.length() : ref_seq.length(), i, aln_init.xt);
+                                   &ref_seq[right_to_left ? ref_len : 0],
+                                   right_to_left ? -ref_len : ref_len, i, aln_init.xt);
         }
         
         if (forefronts[i] != nullptr) {
@@ -612,9 +641,13 @@ void DozeuInterface::align(Alignment& alignment, const HandleGraph& graph, const
                            const vector<MaximalExactMatch>& mems, bool reverse_complemented,
                            int8_t full_length_bonus, uint16_t max_gap_length)
 {
-
     const OrderedGraph ordered_graph(graph, order);
-    
+    align(alignment, ordered_graph, mems, reverse_complemented, full_length_bonus, max_gap_length);
+}
+
+void DozeuInterface::align(Alignment& alignment, const OrderedGraph& ordered_graph, const vector<MaximalExactMatch>& mems,
+                           bool reverse_complemented, int8_t full_length_bonus, uint16_t max_gap_length)
+{
 	// debug_print(alignment, graph, mems[0], reverse_complemented);
 
 	// compute direction (currently just copied), FIXME: direction (and position) may contradict the MEMs when the function is called via the unfold -> dagify path
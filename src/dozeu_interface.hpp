@@ -102,6 +102,55 @@ public:
                const vector<MaximalExactMatch>& mems, bool reverse_complemented,
                int8_t full_length_bonus, uint16_t max_gap_length = default_xdrop_max_gap_length);
     
+    /**
+     * Represents a HandleGraph with a defined (topological) order calculated
+     * for it, packed for dozeu. The node sequences are concatenated into one
+     * buffer and the edges between handles in the order are stored as
+     * indexes into the order, so an OrderedGraph can be built once and then
+     * aligned against repeatedly without going back to the HandleGraph.
+     *
+     * The backing graph must outlive the OrderedGraph.
+     */
+    struct OrderedGraph {
+        OrderedGraph(const HandleGraph& graph, const vector<handle_t>& order);
+        /// Call the lambda with the index of each predecessor (go_left = true)
+        /// or successor (go_left = false) of the handle at index i that is
+        /// also in the order.
+        void for_each_neighbor(const size_t i, bool go_left, const function<void(size_t)>& lambda) const;
+        /// Get the number of handles in the order.
+        size_t size() const;
+        /// Get a pointer to the sequence of the handle at index i.
+        const char* sequence(size_t i) const;
+        /// Get the length of the handle at index i.
+        size_t length(size_t i) const;
+        /// Get the total sequence length of all handles in the order.
+        size_t total_length() const;
+        
+        const HandleGraph& graph;
+        vector<handle_t> order;
+        unordered_map<handle_t, size_t> index_of;
+        
+    private:
+        /// Sequences of all handles in the order, concatenated.
+        string sequences;
+        /// Offset of each handle's sequence in sequences, plus a past-the-end sentinel.
+        vector<size_t> sequence_offsets;
+        /// Offsets into neighbors: predecessors of handle i start at 2 * i,
+        /// successors at 2 * i + 1, and both end where the next range starts.
+        vector<size_t> neighbor_offsets;
+        /// Indexes in the order of the neighbors of each handle.
+        vector<size_t> neighbors;
+    };
+    
+    /**
+     * Same as above except using a graph that has already been packed with
+     * its topological order. This allows the packing to be reused across
+     * alignments to the same graph.
+     */
+    void align(Alignment& alignment, const OrderedGraph& graph, const vector<MaximalExactMatch>& mems,
+               bool reverse_complemented, int8_t full_length_bonus,
+               uint16_t max_gap_length = default_xdrop_max_gap_length);
+    
     /**
      * Compute a pinned alignment, where the start (pin_left=true) or end
      * (pin_left=false) end of the Alignment sequence is pinned to the
@@ -128,19 +177,6 @@ protected:
         uint32_t query_offset;
     };
     
-    /**
-     * Represents a HandleGraph with a defined (topological) order calculated for it.
-     */
-    struct OrderedGraph {
-        OrderedGraph(const HandleGraph& graph, const vector<handle_t>& order);
-        void for_each_neighbor(const size_t i, bool go_left, const function<void(size_t)>& lambda) const;
-        size_t size() const;
-        
-        const HandleGraph& graph;
-        const vector<handle_t>& order;
-        unordered_map<handle_t, size_t> index_of;
-    };
-    
     // wrappers for dozeu functions that can be used to toggle between between quality
     // adjusted and standard alignments
     virtual dz_query_s* pack_query_forward(const char* seq, const uint8_t* qual,
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstring>
+#include <unordered_set>
 
 /**
  * \file funnel.hpp: implementation of the Funnel class
@@ -85,8 +86,22 @@ bool Funnel::PaintableSpace::is_any_painted(size_t start, size_t length) const {
     return false;
 }
 
+Funnel::Funnel(Tracking tracking) : tracking(tracking) {
+    // Nothing to do!
+}
+
+double Funnel::total_seconds() const {
+    return chrono::duration_cast<chrono::duration<double>>(stop_time - start_time).count();
+}
+
 void Funnel::start(const string& name) {
     assert(!name.empty());
+    
+    if (tracking == Tracking::NONE) {
+        // All we need is the time.
+        start_time = clock::now();
+        return;
+    }
 
     // (Re)start the funnel.
     funnel_name = name;
@@ -106,6 +121,9 @@ void Funnel::stop() {
 }
 
 void Funnel::stage(const string& name) {
+    if (tracking == Tracking::NONE) {
+        return;
+    }
     assert(!funnel_name.empty());
     assert(!name.empty());
     
@@ -143,6 +161,9 @@ void Funnel::stage_stop() {
 }
 
 void Funnel::substage(const string& name) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     assert(!funnel_name.empty());
     assert(!stage_name.empty());
     assert(!name.empty());
@@ -168,6 +189,9 @@ void Funnel::substage_stop() {
 }
 
 void Funnel::processing_input(size_t prev_stage_item) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     // We can only take input from previous stages, in a stage
     assert(!stage_name.empty());
     assert(stages.size() > 1);
@@ -191,6 +215,9 @@ void Funnel::processed_input() {
 }
 
 void Funnel::producing_output(size_t item) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     // We can only produce output in a stage
     assert(!stage_name.empty());
     assert(!stages.empty());
@@ -213,6 +240,12 @@ void Funnel::produced_output() {
 }
 
 void Funnel::introduce(size_t count) {
+    if (tracking != Tracking::FULL) {
+        if (tracking == Tracking::COUNTS) {
+            stages.back().projected_count += count;
+        }
+        return;
+    }
     // Create that many new items
     for (size_t i = 0; i < count; i++) {
         create_item();
@@ -220,6 +253,12 @@ void Funnel::introduce(size_t count) {
 }
 
 void Funnel::expand(size_t prev_stage_item, size_t count) {
+    if (tracking != Tracking::FULL) {
+        if (tracking == Tracking::COUNTS) {
+            stages.back().projected_count += count;
+        }
+        return;
+    }
     for (size_t i = 0; i < count; i++) {
         // Create the requested number of items
         project(prev_stage_item);
@@ -227,6 +266,12 @@ void Funnel::expand(size_t prev_stage_item, size_t count) {
 }
 
 void Funnel::project(size_t prev_stage_item) {
+    if (tracking != Tracking::FULL) {
+        if (tracking == Tracking::COUNTS) {
+            stages.back().projected_count++;
+        }
+        return;
+    }
     // There must be a prev stage to project from
     assert(stages.size() > 1);
     auto& prev_stage = stages[stages.size() - 2];
@@ -246,6 +291,11 @@ void Funnel::project(size_t prev_stage_item) {
 }
 
 void Funnel::project_group(size_t prev_stage_item, size_t group_size) {
+    if (tracking != Tracking::FULL) {
+        // Only the new item counts
+        project(prev_stage_item);
+        return;
+    }
     // Project the item
     project(prev_stage_item);
     // Save the group size
@@ -253,6 +303,9 @@ void Funnel::project_group(size_t prev_stage_item, size_t group_size) {
 }
 
 void Funnel::also_relevant(size_t earlier_stage_lookback, size_t earlier_stage_item) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     assert(earlier_stage_lookback > 0);
     assert(stages.size() > earlier_stage_lookback);
     auto& earlier_stage = stages[stages.size() - 1 - earlier_stage_lookback];
@@ -268,6 +321,9 @@ void Funnel::also_relevant(size_t earlier_stage_lookback, size_t earlier_stage_i
 }
 
 void Funnel::fail(const char* filter, size_t prev_stage_item, double statistic) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     // There must be a prev stage to project from
     assert(stages.size() > 1);
     auto& prev_stage = stages[stages.size() - 2];
@@ -278,6 +334,9 @@ void Funnel::fail(const char* filter, size_t prev_stage_item, double statistic)
 }
 
 void Funnel::pass(const char* filter, size_t prev_stage_item, double statistic) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     // There must be a prev stage to project from
     assert(stages.size() > 1);
     auto& prev_stage = stages[stages.size() - 2];
@@ -288,10 +347,16 @@ void Funnel::pass(const char* filter, size_t prev_stage_item, double statistic)
 }
 
 void Funnel::score(size_t item, double score) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     get_item(item).score = score;
 }
 
 void Funnel::tag(size_t item, State state, size_t tag_start, size_t tag_length) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
 
 #ifdef debug
     std::cerr << "Tag item " << item << " stage " << stages.back().name << " as " << state << " on " << tag_start << "-" << tag_start + tag_length << std::endl;
@@ -329,16 +394,26 @@ void Funnel::tag_correct(size_t item, size_t tag_start, size_t tag_length) {
 }
 
 bool Funnel::is_correct(size_t item) const {
+    if (tracking != Tracking::FULL) {
+        // Nothing is known to be correct.
+        return false;
+    }
     return stages.back().items[item].tag >= State::CORRECT;
 }
 
 bool Funnel::was_correct(size_t prev_stage_item) const {
+    if (tracking != Tracking::FULL) {
+        return false;
+    }
     assert(stages.size() > 1);
     auto& prev_stage = stages[stages.size() - 2];
     return prev_stage.items[prev_stage_item].tag >= State::CORRECT;
 }
 
 bool Funnel::was_correct(size_t prev_stage_index, const string& prev_stage_name, size_t prev_stage_item) const {
+    if (tracking != Tracking::FULL) {
+        return false;
+    }
     assert(stages.size() > prev_stage_index);
     auto& prev_stage = stages[prev_stage_index];
     assert(prev_stage.name == prev_stage_name);
@@ -362,7 +437,16 @@ string Funnel::last_correct_stage(size_t tag_start, size_t tag_length) const {
 }
 
 size_t Funnel::latest() const {
+    if (tracking == Tracking::NONE) {
+        // Nothing is numbered, and nothing will look at the number.
+        return 0;
+    }
     assert(!stages.empty());
+    if (tracking == Tracking::COUNTS) {
+        // There are no items, but we still know how many there are.
+        assert(stages.back().projected_count > 0);
+        return stages.back().projected_count - 1;
+    }
     assert(!stages.back().items.empty());
     return stages.back().items.size() - 1;
 }
@@ -380,6 +464,14 @@ void Funnel::for_each_stage(const function<void(const string&, const vector<size
     }
 }
 
+void Funnel::for_each_stage_count(const function<void(const string&, size_t, double)>& callback) const {
+    for (auto& stage : stages) {
+        // Items only exist with full tracking, but they can also run ahead of
+        // the projected count there.
+        callback(stage.name, tracking == Tracking::FULL ? stage.items.size() : stage.projected_count, stage.duration);
+    }
+}
+
 void Funnel::for_each_filter(const function<void(const string&, const string&,
     const FilterPerformance&, const FilterPerformance&, const vector<double>&, const vector<double>&)>& callback) const {
     
@@ -588,15 +680,24 @@ void Funnel::to_dot(ostream& out) const {
 }
 void Funnel::annotate_mapped_alignment(Alignment& aln, bool annotate_correctness) const {
     // Save the total duration in the field set asside for it
-    aln.set_time_used(chrono::duration_cast<chrono::duration<double>>(stop_time - start_time).count());
+    aln.set_time_used(total_seconds());
+    
+    if (tracking == Tracking::NONE) {
+        return;
+    }
     
-    for_each_stage([&](const string& stage, const vector<size_t>& result_sizes, const double& duration) {
+    for_each_stage_count([&](const string& stage, size_t result_count, double duration) {
         // Save the number of items
-        set_annotation(aln, "stage_" + stage + "_results", (double)result_sizes.size());
+        set_annotation(aln, "stage_" + stage + "_results", (double)result_count);
         // And the per-stage duration
         set_annotation(aln, "stage_" + stage + "_time", duration);
     });
     
+    if (tracking != Tracking::FULL) {
+        // Nothing was tagged or filtered.
+        return;
+    }
+    
     set_annotation(aln, "last_placed_stage", last_tagged_stage(State::PLACED));
     for (size_t i = 0; i < aln.sequence().size(); i += 500) {
         // For each 500 bp window, annotate with the last stage that had something placed in or spanning the window.
@@ -685,21 +786,149 @@ size_t Funnel::create_item() {
     // Return the index used
     return next_index;
 }
-    
-
-
 
+FunnelStageCounter::FunnelStageCounter(size_t thread_count) : tables(thread_count) {
+    // Nothing to do!
 }
 
+FunnelStageCounter::StageTotals* FunnelStageCounter::ThreadTable::find_stage(const string& stage) {
+    // There are only ever a handful of stages, so a linear scan is fine.
+    size_t slot = 0;
+    while (slot < stage_count && names[slot] != stage) {
+        slot++;
+    }
+    if (slot == stage_count) {
+        if (stage_count == MAX_STAGES) {
+            // No room to count this one
+            return nullptr;
+        }
+        names[slot] = stage;
+        stage_count++;
+    }
+    return &totals[slot];
+}
 
+void FunnelStageCounter::record(const Funnel& funnel, size_t thread_num) {
+    auto& table = tables.at(thread_num);
+    lock_guard<mutex> guard(table.table_mutex);
+    
+    table.inputs++;
+    table.input_latency.record(funnel.total_seconds());
+    
+    funnel.for_each_stage_count([&](const string& stage, size_t result_count, double duration) {
+        auto totals = table.find_stage(stage);
+        if (totals) {
+            totals->inputs++;
+            totals->items += result_count;
+            totals->seconds += duration;
+            totals->latency.record(duration);
+        }
+    });
+}
 
+void FunnelStageCounter::record_time(const string& stage, double seconds, size_t thread_num) {
+    auto& table = tables.at(thread_num);
+    lock_guard<mutex> guard(table.table_mutex);
+    
+    auto totals = table.find_stage(stage);
+    if (totals) {
+        totals->inputs++;
+        totals->seconds += seconds;
+        totals->latency.record(seconds);
+    }
+}
 
+void FunnelStageCounter::for_each_stage(const function<void(const string&, const StageTotals&)>& callback) const {
+    // Take a consistent snapshot of the names first
+    vector<string> names;
+    unordered_set<string> seen;
+    for (auto& table : tables) {
+        lock_guard<mutex> guard(table.table_mutex);
+        for (size_t slot = 0; slot < table.stage_count; slot++) {
+            if (!seen.count(table.names[slot])) {
+                seen.insert(table.names[slot]);
+                names.push_back(table.names[slot]);
+            }
+        }
+    }
+    
+    for (auto& name : names) {
+        // Sum each stage over all the threads
+        StageTotals sum;
+        for (auto& table : tables) {
+            lock_guard<mutex> guard(table.table_mutex);
+            for (size_t slot = 0; slot < table.stage_count; slot++) {
+                if (table.names[slot] == name) {
+                    auto& totals = table.totals[slot];
+                    sum.inputs += totals.inputs;
+                    sum.items += totals.items;
+                    sum.seconds += totals.seconds;
+                    sum.latency.merge(totals.latency);
+                    break;
+                }
+            }
+        }
+        callback(name, sum);
+    }
+}
 
+size_t FunnelStageCounter::input_count() const {
+    size_t total = 0;
+    for (auto& table : tables) {
+        lock_guard<mutex> guard(table.table_mutex);
+        total += table.inputs;
+    }
+    return total;
+}
 
+LatencyHistogram FunnelStageCounter::input_latency() const {
+    LatencyHistogram total;
+    for (auto& table : tables) {
+        lock_guard<mutex> guard(table.table_mutex);
+        total.merge(table.input_latency);
+    }
+    return total;
+}
+
+void FunnelStageCounter::write_table(ostream& out) const {
+    size_t total_inputs = input_count();
+    out << "stage\treached\titems\titems_per_input\tseconds\tseconds_per_input\tp50_seconds\tp99_seconds" << endl;
+    for_each_stage([&](const string& stage, const StageTotals& totals) {
+        out << stage << "\t" << totals.inputs << "\t" << totals.items
+            << "\t" << (total_inputs == 0 ? 0.0 : (double) totals.items / total_inputs)
+            << "\t" << totals.seconds
+            << "\t" << (total_inputs == 0 ? 0.0 : totals.seconds / total_inputs)
+            << "\t" << totals.latency.quantile(0.5)
+            << "\t" << totals.latency.quantile(0.99) << endl;
+    });
+}
 
+void FunnelStageCounter::write_json(ostream& out, double elapsed_seconds) const {
+    size_t total_inputs = input_count();
+    out << "{\"inputs\": " << total_inputs;
+    if (elapsed_seconds > 0) {
+        out << ", \"elapsed_seconds\": " << elapsed_seconds
+            << ", \"inputs_per_second\": " << total_inputs / elapsed_seconds;
+    }
+    out << ", \"latency\": ";
+    input_latency().write_json(out);
+    out << ", \"stages\": [";
+    bool first = true;
+    for_each_stage([&](const string& stage, const StageTotals& totals) {
+        if (!first) {
+            out << ", ";
+        }
+        first = false;
+        // Stage names are plain identifiers, so they need no escaping.
+        out << "{\"name\": \"" << stage << "\""
+            << ", \"reached\": " << totals.inputs
+            << ", \"items\": " << totals.items
+            << ", \"seconds\": " << totals.seconds
+            << ", \"latency\": ";
+        totals.latency.write_json(out);
+        out << "}";
+    });
+    out << "]}" << endl;
+}
 
-
-
-
-
-
+}
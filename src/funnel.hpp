@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <array>
 #include <unordered_map>
 #include <cassert>
 #include <chrono>
@@ -10,8 +11,10 @@
 #include <functional>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <vg/vg.pb.h>
 #include "annotation.hpp"
+#include "latency_histogram.hpp"
 
 
 /** 
@@ -38,10 +41,37 @@ using namespace std;
  *
  * We also can assign "scores" or correctness/placed-ness "tags" to items at a
  * stage. Tags can cover a region of a linear read space.
+ *
+ * How much of this is actually recorded is fixed when the Funnel is
+ * constructed. Below full tracking, the calls for things that aren't recorded
+ * return immediately, so a client can leave them in place and pay almost
+ * nothing for them.
  */
 class Funnel {
 
 public:
+
+    /// How much of the history of an input a Funnel records.
+    enum class Tracking {
+        /// Record only the overall start and stop times.
+        NONE = 0,
+        /// Also record the name, duration, and number of items of each stage,
+        /// but not the items themselves, so there is no provenance, filter, or
+        /// tag information.
+        COUNTS = 1,
+        /// Record everything.
+        FULL = 2
+    };
+    
+    /// Make a Funnel that records at the given level.
+    Funnel(Tracking tracking = Tracking::FULL);
+    
+    /// Get the level this Funnel records at.
+    inline Tracking get_tracking() const;
+    
+    /// Get the time in seconds between start() and stop().
+    double total_seconds() const;
+
     /// Start processing the given named input.
     /// Name must not be empty.
     /// No stage or substage will be active.
@@ -207,8 +237,14 @@ public:
     
     /// Call the given callback with stage name, and vector of result item
     /// sizes at that stage, and a duration in seconds, for each stage.
+    /// Requires full tracking to report anything but durations.
     void for_each_stage(const function<void(const string&, const vector<size_t>&, const double&)>& callback) const;
     
+    /// Call the given callback with stage name, number of result items at
+    /// that stage, and a duration in seconds, for each stage. Works with
+    /// counts-only tracking.
+    void for_each_stage_count(const function<void(const string&, size_t, double)>& callback) const;
+    
     /// Represents the performance of a filter, for either item counts or total item sizes.
     /// Note that passing_correct and failing_correct will always be 0 if nothing is tagged correct.
     struct FilterPerformance {
@@ -235,11 +271,15 @@ public:
     /// Set an alignments annotations with the number of results at each stage
     /// if annotate_correctness is true, also annotate the alignment with the
     /// number of correct results at each stage. This assumes that we've been
-    /// tracking correctness all along
+    /// tracking correctness all along. Without full tracking, only what was
+    /// recorded is annotated; without any tracking that is just the time used.
     void annotate_mapped_alignment(Alignment& aln, bool annotate_correctness) const;
     
 protected:
     
+    /// How much are we recording?
+    Tracking tracking;
+    
     /// Pick a clock to use for measuring stage duration
     using clock = std::chrono::high_resolution_clock;
     /// And a type to represent stage transition times
@@ -340,6 +380,83 @@ protected:
     vector<Stage> stages;
 };
 
+/**
+ * Accumulates the per-stage item counts, durations, and latency distributions
+ * of many Funnels, for reporting where a mapper spends its time across a whole
+ * run. Each thread records into its own fixed-size table, so recording never
+ * allocates once a thread has seen all the stage names. Each table has its own
+ * lock, which is only ever contended by a report taken while mapping is
+ * still going on.
+ */
+class FunnelStageCounter {
+public:
+    
+    /// The most distinct stage names that will be counted. Stages past this
+    /// are dropped.
+    static constexpr size_t MAX_STAGES = 32;
+    
+    /// Totals for one stage
+    struct StageTotals {
+        /// Number of inputs that reached the stage
+        size_t inputs = 0;
+        /// Number of items at the stage, over all inputs
+        size_t items = 0;
+        /// Time spent in the stage, over all inputs
+        double seconds = 0;
+        /// Distribution of time spent in the stage per input
+        LatencyHistogram latency;
+    };
+    
+    /// Make a counter with tables for the given number of threads.
+    FunnelStageCounter(size_t thread_count);
+    
+    /// Add the stages of a stopped Funnel, with at least counts-only tracking,
+    /// and its total duration, to the table for the given thread.
+    void record(const Funnel& funnel, size_t thread_num);
+    
+    /// Add time spent by one input in a stage that happens outside of any
+    /// Funnel, such as output, to the table for the given thread.
+    void record_time(const string& stage, double seconds, size_t thread_num);
+    
+    /// Call the given callback with stage name and totals for the stage,
+    /// summed over all threads. Stages are visited in the order they were
+    /// first seen by the lowest-numbered thread that saw them.
+    void for_each_stage(const function<void(const string&, const StageTotals&)>& callback) const;
+    
+    /// Get the number of Funnels recorded, over all threads.
+    size_t input_count() const;
+    
+    /// Get the distribution of total Funnel durations, over all threads.
+    LatencyHistogram input_latency() const;
+    
+    /// Write a tab-separated table of the totals for each stage, with a header.
+    void write_table(ostream& out) const;
+    
+    /// Write the totals and latency distributions as a single-line JSON
+    /// object. If elapsed_seconds is positive, throughput over that much wall
+    /// clock time is included.
+    void write_json(ostream& out, double elapsed_seconds = 0) const;
+    
+protected:
+    
+    /// Everything one thread records. The histograms keep the totals of
+    /// different threads far enough apart not to share cache lines.
+    struct ThreadTable {
+        mutable mutex table_mutex;
+        size_t inputs = 0;
+        LatencyHistogram input_latency;
+        size_t stage_count = 0;
+        array<string, MAX_STAGES> names;
+        array<StageTotals, MAX_STAGES> totals;
+        
+        /// Find the totals for the given stage, adding it if it is new.
+        /// Returns nullptr if there is no room. Caller must hold the lock.
+        StageTotals* find_stage(const string& stage);
+    };
+    
+    vector<ThreadTable> tables;
+};
+
 inline std::ostream& operator<<(std::ostream& out, const Funnel::State& state) {
     switch (state) {
         case Funnel::State::NONE:
@@ -353,8 +470,18 @@ inline std::ostream& operator<<(std::ostream& out, const Funnel::State& state) {
     }
 }
 
+inline Funnel::Tracking Funnel::get_tracking() const {
+    return tracking;
+}
+
 template<typename Iterator>
 void Funnel::merge_group(Iterator prev_stage_items_begin, Iterator prev_stage_items_end) {
+    if (tracking != Tracking::FULL) {
+        // Only the new item counts
+        merge(prev_stage_items_begin, prev_stage_items_end);
+        return;
+    }
+    
     // Do a non-group merge
     merge(prev_stage_items_begin, prev_stage_items_end);
     
@@ -367,6 +494,12 @@ void Funnel::merge_group(Iterator prev_stage_items_begin, Iterator prev_stage_it
 
 template<typename Iterator>
 void Funnel::merge_groups(Iterator prev_stage_items_begin, Iterator prev_stage_items_end) {
+    if (tracking != Tracking::FULL) {
+        // Only the new item counts
+        merge(prev_stage_items_begin, prev_stage_items_end);
+        return;
+    }
+    
     // Do a non-group merge
     merge(prev_stage_items_begin, prev_stage_items_end);
     
@@ -391,6 +524,14 @@ void Funnel::merge_groups(Iterator prev_stage_items_begin, Iterator prev_stage_i
 
 template<typename Iterator>
 void Funnel::merge(Iterator prev_stage_items_begin, Iterator prev_stage_items_end) {
+    if (tracking != Tracking::FULL) {
+        if (tracking == Tracking::COUNTS) {
+            // Just count the new item
+            stages.back().projected_count++;
+        }
+        return;
+    }
+    
     // There must be a prev stage to merge from
     assert(stages.size() > 1);
     auto& prev_stage = stages[stages.size() - 2];
@@ -424,6 +565,9 @@ void Funnel::also_merge_group(Iterator prev_stage_items_begin, Iterator prev_sta
 
 template<typename Iterator>
 void Funnel::also_merge_group(size_t earlier_stage_lookback, Iterator earlier_stage_items_begin, Iterator earlier_stage_items_end) {
+    if (tracking != Tracking::FULL) {
+        return;
+    }
     assert(earlier_stage_lookback > 0);
     assert(stages.size() > earlier_stage_lookback);
     auto& earlier_stage = stages[stages.size() - 1 - earlier_stage_lookback];
@@ -0,0 +1,280 @@
+/**
+ * \file gaf_stream.cpp
+ * Implementations for line-at-a-time GAF reading, writing, and scanning.
+ */
+
+#include "gaf_stream.hpp"
+
+#include <vg/io/hfile_cppstream.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace vg {
+
+using namespace std;
+
+GAFRecord::GAFRecord(string line) : text(std::move(line)) {
+    // Nothing to do!
+}
+
+const string& GAFRecord::line() const {
+    return text;
+}
+
+string GAFRecord::name() const {
+    return text.substr(0, text.find('\t'));
+}
+
+bool GAFRecord::for_each_step(const function<bool(id_t, bool, size_t)>& iteratee) const {
+    // Find the path (column 6) and the path start (column 8)
+    size_t path_start = string::npos;
+    size_t path_end = string::npos;
+    size_t offset_start = string::npos;
+    size_t column = 1;
+    for (size_t i = 0; i < text.size() && offset_start == string::npos; i++) {
+        if (text[i] == '\t') {
+            column++;
+            if (column == 6) {
+                path_start = i + 1;
+            } else if (column == 7) {
+                path_end = i;
+            } else if (column == 8) {
+                offset_start = i + 1;
+            }
+        }
+    }
+    if (offset_start == string::npos) {
+        throw runtime_error("error:[GAFRecord] GAF line for " + name() + " has too few columns");
+    }
+
+    if (path_end == path_start + 1 && text[path_start] == '*') {
+        // The read is unmapped
+        return true;
+    }
+    if (text[path_start] != '>' && text[path_start] != '<') {
+        throw runtime_error("error:[GAFRecord] GAF path for " + name() + " uses segment names instead of node IDs");
+    }
+
+    size_t offset = strtoull(text.c_str() + offset_start, nullptr, 10);
+    for (size_t i = path_start; i < path_end;) {
+        bool is_reverse = (text[i] == '<');
+        char* id_end;
+        id_t node_id = strtoll(text.c_str() + i + 1, &id_end, 10);
+        size_t next = id_end - text.c_str();
+        if (next == i + 1 || next > path_end) {
+            throw runtime_error("error:[GAFRecord] GAF path for " + name() + " is malformed");
+        }
+        if (!iteratee(node_id, is_reverse, offset)) {
+            return false;
+        }
+        offset = 0;
+        i = next;
+    }
+    return true;
+}
+
+int GAFRecord::ByteSize() const {
+    return text.size();
+}
+
+void GAFRecord::AppendToString(string* output) const {
+    output->append(text);
+}
+
+bool GAFRecord::ParseFromArray(const void* data, int size) {
+    text.assign((const char*) data, size);
+    return true;
+}
+
+GAFCursor::GAFCursor(istream& in) {
+    bgzf = bgzf_hopen(vg::io::hfile_wrap(in), "r");
+    if (bgzf == nullptr) {
+        throw runtime_error("error:[GAFCursor] could not open GAF input");
+    }
+    advance();
+}
+
+GAFCursor::GAFCursor(GAFCursor&& other) : bgzf(other.bgzf), line_buffer(other.line_buffer),
+    current(std::move(other.current)), have_current(other.have_current), group_vo(other.group_vo) {
+
+    other.bgzf = nullptr;
+    other.line_buffer = {0, 0, nullptr};
+    other.have_current = false;
+}
+
+GAFCursor::~GAFCursor() {
+    if (bgzf != nullptr) {
+        bgzf_close(bgzf);
+    }
+    free(line_buffer.s);
+}
+
+bool GAFCursor::has_current() const {
+    return have_current;
+}
+
+const GAFRecord& GAFCursor::operator*() const {
+    return current;
+}
+
+const GAFRecord* GAFCursor::operator->() const {
+    return &current;
+}
+
+void GAFCursor::advance() {
+    while (true) {
+        int64_t line_vo = bgzf_tell(bgzf);
+        int result = bgzf_getline(bgzf, '\n', &line_buffer);
+        if (result < -1) {
+            throw runtime_error("error:[GAFCursor] could not read GAF input");
+        }
+        if (!bgzf->is_compressed) {
+            group_vo = -1;
+        } else if (result == -1 || !have_current || (line_vo & 0xFFFF) == 0) {
+            // Groups start at block boundaries, and the end of the file
+            // counts as its own group.
+            group_vo = line_vo;
+        }
+        if (result == -1) {
+            have_current = false;
+            return;
+        }
+        if (line_buffer.l != 0) {
+            current = GAFRecord(string(line_buffer.s, line_buffer.l));
+            have_current = true;
+            return;
+        }
+        // Otherwise skip the blank line
+    }
+}
+
+GAFRecord GAFCursor::take() {
+    GAFRecord taken = std::move(current);
+    advance();
+    return taken;
+}
+
+int64_t GAFCursor::tell_group() const {
+    return group_vo;
+}
+
+bool GAFCursor::seek_group(int64_t virtual_offset) {
+    if (!bgzf->is_compressed || bgzf_seek(bgzf, virtual_offset, SEEK_SET) != 0) {
+        return false;
+    }
+    // The record we read next starts a new group
+    have_current = false;
+    advance();
+    return true;
+}
+
+GAFEmitter::GAFEmitter(ostream& out) {
+    bgzf = bgzf_hopen(vg::io::hfile_wrap(out), "w");
+    if (bgzf == nullptr) {
+        throw runtime_error("error:[GAFEmitter] could not open GAF output");
+    }
+}
+
+GAFEmitter::~GAFEmitter() {
+    emit_group();
+    if (bgzf_close(bgzf) != 0) {
+        cerr << "error:[GAFEmitter] could not finish writing GAF output" << endl;
+        exit(1);
+    }
+}
+
+void GAFEmitter::write(GAFRecord&& record) {
+    // Count the record with its newline
+    size_t record_bytes = record.line().size() + 1;
+    if (group_bytes + record_bytes > BGZF_BLOCK_SIZE) {
+        // Keep the group to one block
+        emit_group();
+    }
+    group.emplace_back(std::move(record));
+    group_bytes += record_bytes;
+    if (group_bytes >= BGZF_BLOCK_SIZE) {
+        // This record alone fills a block or more
+        emit_group();
+    }
+}
+
+void GAFEmitter::write(const GAFRecord& record) {
+    write(GAFRecord(record));
+}
+
+void GAFEmitter::on_message(const function<void(const GAFRecord&)>& handler) {
+    message_handlers.push_back(handler);
+}
+
+void GAFEmitter::on_group(const function<void(int64_t, int64_t)>& handler) {
+    group_handlers.push_back(handler);
+}
+
+void GAFEmitter::emit_group() {
+    if (group.empty()) {
+        return;
+    }
+
+    // The last group was flushed, so this one starts a block
+    int64_t start_vo = bgzf_tell(bgzf);
+    for (auto& record : group) {
+        if (bgzf_write(bgzf, record.line().c_str(), record.line().size()) < 0 ||
+            bgzf_write(bgzf, "\n", 1) < 0) {
+            cerr << "error:[GAFEmitter] could not write GAF output" << endl;
+            exit(1);
+        }
+    }
+    if (bgzf_flush(bgzf) != 0) {
+        cerr << "error:[GAFEmitter] could not write GAF output" << endl;
+        exit(1);
+    }
+    int64_t past_end_vo = bgzf_tell(bgzf);
+
+    for (auto& handler : message_handlers) {
+        for (auto& record : group) {
+            handler(record);
+        }
+    }
+    for (auto& handler : group_handlers) {
+        handler(start_vo, past_end_vo);
+    }
+
+    group.clear();
+    group_bytes = 0;
+}
+
+bool is_gaf_file_name(const string& filename) {
+    for (const string extension : {".gaf", ".gaf.gz", ".gaf.bgz"}) {
+        if (filename.size() >= extension.size() &&
+            filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<>
+bool PositionIDScanner<GAFRecord>::scan(const GAFRecord& msg, const function<bool(const Position&)>& pos_iteratee,
+    const function<bool(const id_t&)>& id_iteratee) {
+
+    // Like a Path, an unmapped record visits the sentinel zero node ID.
+    bool path_is_empty = true;
+
+    bool keep_going = msg.for_each_step([&](id_t node_id, bool is_reverse, size_t offset) {
+        path_is_empty = false;
+        Position pos;
+        pos.set_node_id(node_id);
+        pos.set_is_reverse(is_reverse);
+        pos.set_offset(offset);
+        return pos_iteratee(pos);
+    });
+
+    if (keep_going && path_is_empty) {
+        keep_going &= id_iteratee(0);
+    }
+
+    return keep_going;
+}
+
+}
@@ -0,0 +1,171 @@
+#ifndef VG_GAF_STREAM_HPP_INCLUDED
+#define VG_GAF_STREAM_HPP_INCLUDED
+
+/**
+ * \file gaf_stream.hpp
+ * Reading, writing, sorting, and indexing GAF files one line at a time,
+ * without converting the lines to Alignments.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <htslib/bgzf.h>
+
+#include "types.hpp"
+#include "scanner.hpp"
+#include "stream_index.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * One line of a GAF file. The only column that gets parsed is the path, and
+ * only on demand. Provides just enough of the Protobuf message interface to go
+ * through the StreamSorter's temporary files.
+ */
+class GAFRecord {
+public:
+    GAFRecord() = default;
+    explicit GAFRecord(string line);
+
+    /// Get the GAF line, without its terminating newline.
+    const string& line() const;
+
+    /// Get the read name from the first column.
+    string name() const;
+
+    /// Call the iteratee with the ID and orientation of each node on the
+    /// record's path, in path order, along with the offset on that node at
+    /// which the alignment starts (which is only nonzero for the first node).
+    /// Unmapped records visit nothing. Throws if the path is written with
+    /// segment names instead of node IDs. Returns false if the iteratee asked
+    /// to stop.
+    bool for_each_step(const function<bool(id_t, bool, size_t)>& iteratee) const;
+
+    /// Get the size of the record in its serialized form.
+    int ByteSize() const;
+
+    /// Append the serialized record to the given string.
+    void AppendToString(string* output) const;
+
+    /// Replace the record with one deserialized from the given bytes. Returns
+    /// true on success.
+    bool ParseFromArray(const void* data, int size);
+
+private:
+    string text;
+};
+
+/**
+ * Reads GAFRecords from a plain, gzipped, or BGZF-compressed GAF stream. For
+ * BGZF input written by a GAFEmitter, supports seeking to groups, where each
+ * group is a BGZF block of whole lines.
+ */
+class GAFCursor {
+public:
+    /// Make a cursor reading from the given stream. The stream must outlive
+    /// the cursor.
+    GAFCursor(istream& in);
+    ~GAFCursor();
+
+    GAFCursor(const GAFCursor& other) = delete;
+    GAFCursor& operator=(const GAFCursor& other) = delete;
+    GAFCursor(GAFCursor&& other);
+    GAFCursor& operator=(GAFCursor&& other) = delete;
+
+    /// Return true if there is a record to look at.
+    bool has_current() const;
+
+    /// Get the current record.
+    const GAFRecord& operator*() const;
+    const GAFRecord* operator->() const;
+
+    /// Move on to the next record.
+    void advance();
+
+    /// Take the current record and move on to the next one.
+    GAFRecord take();
+
+    /// Get the virtual offset of the group that the current record is in, or
+    /// of the end of the file if there is no current record. Returns -1 if
+    /// the input is not BGZF-compressed.
+    int64_t tell_group() const;
+
+    /// Seek to the group at the given virtual offset and read its first
+    /// record. Returns false if the input can't seek.
+    bool seek_group(int64_t virtual_offset);
+
+private:
+    BGZF* bgzf = nullptr;
+    kstring_t line_buffer = {0, 0, nullptr};
+    GAFRecord current;
+    bool have_current = false;
+    int64_t group_vo = -1;
+};
+
+/**
+ * Writes GAFRecords to a stream as BGZF-compressed GAF. Records are grouped so
+ * that each group fills no more than one BGZF block, which makes every group
+ * start at a block boundary where a GAFCursor can find it again. Has the same
+ * hooks as a ProtobufEmitter, so a StreamIndex can be built while writing.
+ */
+class GAFEmitter {
+public:
+    /// Make an emitter writing to the given stream. The stream must outlive
+    /// the emitter.
+    GAFEmitter(ostream& out);
+
+    /// Write out any buffered records and the BGZF end of file marker.
+    ~GAFEmitter();
+
+    GAFEmitter(const GAFEmitter& other) = delete;
+    GAFEmitter& operator=(const GAFEmitter& other) = delete;
+
+    /// Emit a record.
+    void write(GAFRecord&& record);
+    void write(const GAFRecord& record);
+
+    /// Call the given handler with each record as its group is written.
+    void on_message(const function<void(const GAFRecord&)>& handler);
+
+    /// Call the given handler with the start and past-the-end virtual
+    /// offsets of each group as it is written.
+    void on_group(const function<void(int64_t, int64_t)>& handler);
+
+private:
+    /// Write out the buffered group, if any.
+    void emit_group();
+
+    BGZF* bgzf = nullptr;
+    vector<GAFRecord> group;
+    size_t group_bytes = 0;
+    vector<function<void(const GAFRecord&)>> message_handlers;
+    vector<function<void(int64_t, int64_t)>> group_handlers;
+};
+
+/// Return true if the given file name looks like a GAF file, plain or
+/// compressed, rather than a GAM.
+bool is_gaf_file_name(const string& filename);
+
+/// GAF lines are read and written with GAFCursors and GAFEmitters
+template<>
+struct StreamFormat<GAFRecord> {
+    using cursor_t = GAFCursor;
+    using emitter_t = GAFEmitter;
+};
+
+/// GAF lines are scanned through their paths
+template<>
+bool PositionIDScanner<GAFRecord>::scan(const GAFRecord& msg, const function<bool(const Position&)>& pos_iteratee,
+    const function<bool(const id_t&)>& id_iteratee);
+
+/// Define a GAF index as a stream index over the lines of a GAF file
+using GAFIndex = StreamIndex<GAFRecord>;
+
+}
+
+#endif
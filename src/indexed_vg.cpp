@@ -24,7 +24,7 @@ IndexedVG::IndexedVG(string graph_filename) : vg_filename(graph_filename), index
     ifstream index_in_stream(index_filename);
     if (index_in_stream.good()) {
         // We found the index, load it
-        index.load(index_in_stream);
+        index.load(index_filename);
     } else {
         // We need to build the index
         
@@ -0,0 +1,263 @@
+#ifndef VG_IO_ARENA_FOR_EACH_HPP_INCLUDED
+#define VG_IO_ARENA_FOR_EACH_HPP_INCLUDED
+
+#include <functional>
+#include <vector>
+#include <memory>
+#include <iostream>
+
+#include <omp.h>
+#include <google/protobuf/arena.h>
+
+#include <vg/io/message_iterator.hpp>
+#include <vg/io/registry.hpp>
+
+namespace vg {
+
+namespace io {
+
+// A drop-in replacement for vg::io::for_each_parallel() for streams of
+// Protobuf messages, like GAM, where each message is only needed for the
+// duration of the callback. The serialized messages are read in batches, and
+// each batch is parsed into a single Protobuf Arena that is thrown away all at
+// once when the batch is done, instead of allocating and freeing every string
+// and submessage of every message separately. Each thread keeps the memory
+// block its last arena needed, so in the steady state a batch costs no
+// allocations at all.
+//
+// The callback may modify the message, and may move or copy it somewhere
+// else, but must not keep any pointers or references into it.
+//
+// If a preparse function is given, each serialized message is passed through
+// it, and what it produces is parsed instead. This lets consumers decode only
+// some of the fields of each message.
+template <class T>
+void for_each_parallel_arena(std::istream& in, const std::function<void(T&)>& lambda, size_t batch_size = 256,
+                             const std::function<bool(const std::string&, std::string&)>& preparse = nullptr);
+
+// Call the given function in parallel on the serialized form of each message
+// of type T in the given stream, for consumers that walk the wire format
+// themselves and never need the parsed message at all.
+template <class T>
+void for_each_parallel_serialized(std::istream& in, const std::function<void(const std::string&)>& lambda,
+                                  size_t batch_size = 256);
+
+// Parse the messages of type T in the given stream in parallel, in the same
+// batches and arenas as for_each_parallel_arena(), and have the given
+// function append a text representation of each one to its batch's buffer.
+// The buffers are written to the given output stream in input order, while
+// the batches after them are being formatted.
+template <class T>
+void format_parallel_ordered(std::istream& in, std::ostream& out, const std::function<void(T&, std::string&)>& format,
+                             size_t batch_size = 1000);
+
+// Call the given function in parallel tasks on batches of the serialized
+// messages of type T in the given stream. The function may consume the
+// strings in the batch. Used to implement the above.
+template <class T>
+void for_each_parallel_serialized_batch(std::istream& in,
+                                        const std::function<void(std::vector<std::unique_ptr<std::string>>&)>& batch_lambda,
+                                        size_t batch_size);
+
+
+// Implementation of above:
+
+// Fill the given batch with up to batch_size serialized messages of type T
+// from the given iterator.
+template <class T>
+inline void read_serialized_batch(MessageIterator& message_iterator, std::vector<std::unique_ptr<std::string>>& batch,
+                                  size_t batch_size) {
+    batch.reserve(batch_size);
+    while (batch.size() < batch_size && message_iterator.has_current()) {
+        auto tagged = message_iterator.take();
+        if (!tagged.second) {
+            // This is just a tag alone; there's nothing to parse.
+            continue;
+        }
+        if (!tagged.first.empty() && !Registry::check_protobuf_tag<T>(tagged.first)) {
+            // This isn't the kind of message we are looking for.
+            continue;
+        }
+        batch.emplace_back(std::move(tagged.second));
+    }
+}
+
+// Parse a batch of serialized messages of type T into one arena, starting in
+// the given block, and call the lambda on each of them. Grows the block to fit
+// the whole batch next time.
+template <class T>
+inline void parse_batch_in_arena(std::vector<std::unique_ptr<std::string>>& batch, std::vector<char>& block,
+                                 const std::function<bool(const std::string&, std::string&)>& preparse,
+                                 const std::function<void(T&)>& lambda) {
+
+    // Don't let one huge batch pin down a huge block forever.
+    const size_t max_kept_block_size = 16 * 1024 * 1024;
+
+    size_t space_used;
+    {
+        google::protobuf::ArenaOptions options;
+        if (!block.empty()) {
+            // Start out in the memory the last batch needed.
+            options.initial_block = block.data();
+            options.initial_block_size = block.size();
+        }
+        google::protobuf::Arena arena(options);
+
+        std::string preparsed;
+        for (auto& serialized : batch) {
+            T* message = google::protobuf::Arena::CreateMessage<T>(&arena);
+            bool parsed;
+            if (preparse) {
+                parsed = preparse(*serialized, preparsed) && message->ParseFromString(preparsed);
+            } else {
+                parsed = message->ParseFromString(*serialized);
+            }
+            if (!parsed) {
+#pragma omp critical (cerr)
+                std::cerr << "error:[vg::io::for_each_parallel_arena] could not parse message" << std::endl;
+                exit(1);
+            }
+            // We don't need the serialized copy anymore.
+            serialized.reset();
+            lambda(*message);
+        }
+
+        space_used = arena.SpaceAllocated();
+        // Everything in the batch is freed at once here.
+    }
+
+    if (space_used > block.size() && space_used <= max_kept_block_size) {
+        // Next time, start with enough room for all of it.
+        block.resize(space_used);
+    }
+}
+
+template <class T>
+inline void for_each_parallel_serialized_batch(std::istream& in,
+                                               const std::function<void(std::vector<std::unique_ptr<std::string>>&)>& batch_lambda,
+                                               size_t batch_size) {
+
+    // We parse the messages ourselves, so we just want the tagged bytes.
+    MessageIterator message_iterator(in);
+
+    // Let the tasks catch up with the reading every so often, so the whole
+    // input doesn't end up in memory.
+    size_t batches_between_waits = 4 * omp_get_max_threads();
+
+#pragma omp parallel shared(message_iterator)
+    {
+#pragma omp single
+        {
+            size_t batches_launched = 0;
+            while (message_iterator.has_current()) {
+                auto* batch = new std::vector<std::unique_ptr<std::string>>();
+                read_serialized_batch<T>(message_iterator, *batch, batch_size);
+
+#pragma omp task firstprivate(batch)
+                {
+                    batch_lambda(*batch);
+                    delete batch;
+                }
+
+                if (++batches_launched % batches_between_waits == 0) {
+#pragma omp taskwait
+                }
+            }
+
+            // Wait for the final tasks.
+#pragma omp taskwait
+        }
+    }
+}
+
+template <class T>
+inline void for_each_parallel_serialized(std::istream& in, const std::function<void(const std::string&)>& lambda,
+                                         size_t batch_size) {
+    for_each_parallel_serialized_batch<T>(in, [&](std::vector<std::unique_ptr<std::string>>& batch) {
+        for (auto& serialized : batch) {
+            lambda(*serialized);
+        }
+    }, batch_size);
+}
+
+template <class T>
+inline void for_each_parallel_arena(std::istream& in, const std::function<void(T&)>& lambda, size_t batch_size,
+                                    const std::function<bool(const std::string&, std::string&)>& preparse) {
+
+    std::vector<std::vector<char>> thread_blocks(omp_get_max_threads());
+
+    for_each_parallel_serialized_batch<T>(in, [&](std::vector<std::unique_ptr<std::string>>& batch) {
+        parse_batch_in_arena<T>(batch, thread_blocks[omp_get_thread_num()], preparse, lambda);
+    }, batch_size);
+}
+
+template <class T>
+inline void format_parallel_ordered(std::istream& in, std::ostream& out, const std::function<void(T&, std::string&)>& format,
+                                    size_t batch_size) {
+
+    MessageIterator message_iterator(in);
+
+    size_t thread_count = omp_get_max_threads();
+    std::vector<std::vector<char>> thread_blocks(thread_count);
+
+    // We format a round of batches at a time, and write out each round while
+    // the next one is formatted.
+    struct round_t {
+        std::vector<std::vector<std::unique_ptr<std::string>>> batches;
+        std::vector<std::string> texts;
+    };
+    size_t batches_per_round = 2 * thread_count;
+
+#pragma omp parallel shared(message_iterator, thread_blocks)
+    {
+#pragma omp single
+        {
+            // The round that tasks may still be formatting
+            std::unique_ptr<round_t> formatting;
+            while (true) {
+                std::unique_ptr<round_t> next(new round_t());
+                while (next->batches.size() < batches_per_round && message_iterator.has_current()) {
+                    next->batches.emplace_back();
+                    read_serialized_batch<T>(message_iterator, next->batches.back(), batch_size);
+                }
+                next->texts.resize(next->batches.size());
+
+                // Wait for the last round to be formatted.
+#pragma omp taskwait
+                std::unique_ptr<round_t> finished = std::move(formatting);
+
+                if (!next->batches.empty()) {
+                    formatting = std::move(next);
+                    for (size_t i = 0; i < formatting->batches.size(); i++) {
+                        auto* batch = &formatting->batches[i];
+                        std::string* text = &formatting->texts[i];
+#pragma omp task firstprivate(batch, text)
+                        {
+                            parse_batch_in_arena<T>(*batch, thread_blocks[omp_get_thread_num()], nullptr, [&](T& message) {
+                                format(message, *text);
+                            });
+                        }
+                    }
+                }
+
+                if (finished) {
+                    // Write out the last round in order.
+                    for (auto& text : finished->texts) {
+                        out.write(text.data(), text.size());
+                    }
+                }
+
+                if (!formatting) {
+                    // Everything has been written.
+                    break;
+                }
+            }
+        }
+    }
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+/**
+ * \file latency_histogram.cpp: implementation of the LatencyHistogram class
+ */
+
+namespace vg {
+using namespace std;
+
+void LatencyHistogram::record(double seconds) {
+    seconds = std::max(seconds, 0.0);
+    buckets[bucket_of((uint64_t) llround(seconds * 1E6))]++;
+    total_count++;
+    total_seconds += seconds;
+    max_seconds = std::max(max_seconds, seconds);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] += other.buckets[i];
+    }
+    total_count += other.total_count;
+    total_seconds += other.total_seconds;
+    max_seconds = std::max(max_seconds, other.max_seconds);
+}
+
+size_t LatencyHistogram::count() const {
+    return total_count;
+}
+
+double LatencyHistogram::mean() const {
+    return total_count == 0 ? 0.0 : total_seconds / total_count;
+}
+
+double LatencyHistogram::max() const {
+    return max_seconds;
+}
+
+double LatencyHistogram::quantile(double fraction) const {
+    if (total_count == 0) {
+        return 0.0;
+    }
+    // Find the rank of the value we want, counting from 1
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t) ceil(fraction * total_count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // Report the top of the bucket, but nothing longer than we actually saw.
+            return std::min(bucket_upper_bound(i) / 1E6, max_seconds);
+        }
+    }
+    return max_seconds;
+}
+
+void LatencyHistogram::write_json(ostream& out) const {
+    out << "{\"count\": " << count()
+        << ", \"mean\": " << mean()
+        << ", \"p50\": " << quantile(0.5)
+        << ", \"p90\": " << quantile(0.9)
+        << ", \"p99\": " << quantile(0.99)
+        << ", \"p999\": " << quantile(0.999)
+        << ", \"max\": " << max() << "}";
+}
+
+size_t LatencyHistogram::bucket_of(uint64_t microseconds) {
+    if (microseconds < 2 * SUB_BUCKETS) {
+        // Small values are exact
+        return microseconds;
+    }
+    // Otherwise keep just the top SUB_BUCKET_BITS + 1 bits
+    size_t shift = (63 - __builtin_clzll(microseconds)) - SUB_BUCKET_BITS;
+    if (shift > MAX_SHIFT) {
+        return BUCKET_COUNT - 1;
+    }
+    return shift * SUB_BUCKETS + (microseconds >> shift);
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(size_t bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return bucket;
+    }
+    size_t shift = bucket / SUB_BUCKETS - 1;
+    uint64_t leading = bucket - shift * SUB_BUCKETS;
+    return ((leading + 1) << shift) - 1;
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef VG_LATENCY_HISTOGRAM_HPP_INCLUDED
+#define VG_LATENCY_HISTOGRAM_HPP_INCLUDED
+
+/**
+ * \file latency_histogram.hpp
+ * Contains the LatencyHistogram class, for summarizing the distribution of
+ * many timings in fixed space.
+ */
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * A histogram of latencies in the style of HdrHistogram. Latencies are kept in
+ * whole microseconds, and each power of two is split into 8 linear
+ * sub-buckets, so any recorded value is known to within 12.5%. The histogram
+ * has a fixed size, so recording never allocates, and histograms kept by
+ * different threads can be merged by adding them up.
+ */
+class LatencyHistogram {
+public:
+    
+    /// Record a latency, in seconds.
+    void record(double seconds);
+    
+    /// Add all the latencies recorded in another histogram to this one.
+    void merge(const LatencyHistogram& other);
+    
+    /// Get the number of latencies recorded.
+    size_t count() const;
+    
+    /// Get the mean latency in seconds, or 0 if nothing is recorded.
+    double mean() const;
+    
+    /// Get the largest latency recorded, in seconds.
+    double max() const;
+    
+    /// Get the latency in seconds that the given fraction (between 0 and 1)
+    /// of recorded latencies are at or below, to the resolution of the
+    /// buckets. Returns 0 if nothing is recorded.
+    double quantile(double fraction) const;
+    
+    /// Write a JSON object with the count, mean, max, and the 50th, 90th,
+    /// 99th, and 99.9th percentiles, all in seconds.
+    void write_json(ostream& out) const;
+    
+    /// Number of low bits of each power of two that get their own buckets
+    static constexpr size_t SUB_BUCKET_BITS = 3;
+    /// Number of buckets each power of two is split into
+    static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    /// Largest power of two scaling of the sub-buckets. Longer latencies (over
+    /// about 9 hours) are counted in the last bucket.
+    static constexpr size_t MAX_SHIFT = 32;
+    /// Total number of buckets
+    static constexpr size_t BUCKET_COUNT = (MAX_SHIFT + 2) * SUB_BUCKETS;
+    
+protected:
+    
+    /// Get the bucket that a latency in microseconds falls into.
+    static size_t bucket_of(uint64_t microseconds);
+    
+    /// Get the largest latency in microseconds that falls into a bucket.
+    static uint64_t bucket_upper_bound(size_t bucket);
+    
+    array<uint64_t, BUCKET_COUNT> buckets {};
+    uint64_t total_count = 0;
+    double total_seconds = 0;
+    double max_seconds = 0;
+};
+
+}
+
+#endif
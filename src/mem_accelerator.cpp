@@ -7,67 +7,193 @@
 #include "mem_accelerator.hpp"
 #include <sdsl/util.hpp>
 #include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <omp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace vg {
 
-MEMAccelerator::MEMAccelerator(const gcsa::GCSA& gcsa_index, size_t k) : k(k)
+const uint64_t MEMAccelerator::file_magic = 0x4d454d41434345ull; // "MEMACCE"
+const uint64_t MEMAccelerator::file_version = 2;
+
+MEMAccelerator::MEMAccelerator(const gcsa::GCSA& gcsa_index, size_t k, int num_threads) : k(k), gcsa_size(gcsa_index.size())
 {
     // compute the minimum width required to express the integers.
-    range_table.width(max<uint8_t>(sdsl::bits::length(gcsa_index.size()), 1));
-    // range table is initialized to size 2^(2k + 1) = 2 * 4^k
-    range_table.resize(1 << (2 * k + 1));
+    table_width = max<uint8_t>(sdsl::bits::length(gcsa_index.size()), 1);
+    // range table is initialized to size 2^(2k + 1) = 2 * 4^k, and it must start
+    // zeroed so that the threads can fill it in with bitwise ORs
+    range_table = sdsl::int_vector<>(size_t(1) << (2 * k + 1), 0, table_width);
+    table_words = range_table.data();
     
     const char alphabet[5] = "ACGT";
     
-    // records of (next char to query, k-mer integer encoding, range)
-    vector<tuple<int64_t, int64_t, gcsa::range_type>> stack;
-    stack.emplace_back(0, 0, gcsa::range_type(0, gcsa_index.size() - 1));
+    // entries are packed together, so entries written by different threads
+    // can share a word
+    uint64_t* words = range_table.data();
+    auto write_entry = [&](size_t i, uint64_t value) {
+        size_t bit = i * table_width;
+        size_t offset = bit & 63;
+        __atomic_fetch_or(words + (bit >> 6), value << offset, __ATOMIC_RELAXED);
+        if (offset + table_width > 64) {
+            __atomic_fetch_or(words + (bit >> 6) + 1, value >> (64 - offset), __ATOMIC_RELAXED);
+        }
+    };
     
-    // TODO: multithread this? probably would do it single threaded
-    // to init 128 stacks or something similar
-    while (!stack.empty()) {
-        if (stack.size() == k + 1) {
-            // we've walked the full k-mers
-            range_table[2 * get<1>(stack.back())] = get<2>(stack.back()).first;
-            range_table[2 * get<1>(stack.back()) + 1] = get<2>(stack.back()).second;
-            stack.pop_back();
+    // extend a range by a character, normalizing empty ranges
+    auto extend = [&](const gcsa::range_type& range, int64_t next) {
+        if (gcsa::Range::empty(range)) {
+            return range;
         }
-        else if (get<0>(stack.back()) == 4) {
-            // we've walked all the k-mers that start with this prefix
-            stack.pop_back();
+        gcsa::range_type extended = gcsa_index.LF(range, gcsa_index.alpha.char2comp[alphabet[next]]);
+        if (gcsa::Range::empty(extended)) {
+            // we normalize empty ranges to an empty range that will
+            // fit within any bit width
+            extended.first = 1;
+            extended.second = 0;
+        }
+        return extended;
+    };
+    
+    // walk the first few characters breadth-first to get a set of independent
+    // subtrees that we can divide among threads
+    size_t prefix_length = min<size_t>(k, 4);
+    vector<pair<int64_t, gcsa::range_type>> prefixes(1, make_pair(0, gcsa::range_type(0, gcsa_index.size() - 1)));
+    for (size_t i = 0; i < prefix_length; ++i) {
+        vector<pair<int64_t, gcsa::range_type>> next_prefixes;
+        next_prefixes.reserve(prefixes.size() * 4);
+        for (const auto& prefix : prefixes) {
+            for (int64_t next = 0; next < 4; ++next) {
+                next_prefixes.emplace_back((next << (2 * i)) | prefix.first,
+                                           extend(prefix.second, next));
+            }
         }
-        else {
-            // extend the current range by the next character
-            auto next = get<0>(stack.back())++;
-            auto enc = (next << (2 * (stack.size() - 1))) | get<1>(stack.back());
-            
-            gcsa::range_type range;
-            if (!gcsa::Range::empty(get<2>(stack.back()))) {
-                range = gcsa_index.LF(get<2>(stack.back()),
-                                      gcsa_index.alpha.char2comp[alphabet[next]]);
-                if (gcsa::Range::empty(range)) {
-                    // we normalize empty ranges to an empty range that will
-                    // fit within any bit width
-                    range.first = 1;
-                    range.second = 0;
-                }
+        prefixes = move(next_prefixes);
+    }
+    
+#pragma omp parallel for schedule(dynamic, 1) num_threads(max(num_threads, 1))
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+        
+        // records of (next char to query, k-mer integer encoding, range)
+        vector<tuple<int64_t, int64_t, gcsa::range_type>> stack;
+        stack.emplace_back(0, prefixes[i].first, prefixes[i].second);
+        
+        while (!stack.empty()) {
+            if (stack.size() + prefix_length == k + 1) {
+                // we've walked the full k-mers
+                write_entry(2 * get<1>(stack.back()), get<2>(stack.back()).first);
+                write_entry(2 * get<1>(stack.back()) + 1, get<2>(stack.back()).second);
+                stack.pop_back();
+            }
+            else if (get<0>(stack.back()) == 4) {
+                // we've walked all the k-mers that start with this prefix
+                stack.pop_back();
             }
             else {
-                range = get<2>(stack.back());
+                // extend the current range by the next character
+                auto next = get<0>(stack.back())++;
+                auto enc = (next << (2 * (stack.size() + prefix_length - 1))) | get<1>(stack.back());
+                stack.emplace_back(0, enc, extend(get<2>(stack.back()), next));
             }
-            
-            stack.emplace_back(0, enc, range);
         }
     }
 }
 
+MEMAccelerator::MEMAccelerator(const string& filename, const gcsa::GCSA& gcsa_index) {
+    
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("error:[MEMAccelerator] could not open " + filename);
+    }
+    struct stat file_stats;
+    if (fstat(fd, &file_stats) != 0 || file_stats.st_size < (off_t) (6 * sizeof(uint64_t))) {
+        close(fd);
+        throw runtime_error("error:[MEMAccelerator] " + filename + " is not a MEM accelerator table");
+    }
+    mapped_size = file_stats.st_size;
+    mapped = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        mapped = nullptr;
+        throw runtime_error("error:[MEMAccelerator] could not memory-map " + filename);
+    }
+    // lookups hop all over the table
+    madvise(mapped, mapped_size, MADV_RANDOM);
+    
+    // header is magic, version, k, width, GCSA2 size, number of words
+    const uint64_t* header = (const uint64_t*) mapped;
+    if (header[0] != file_magic || header[1] != file_version
+        || header[2] == 0 || header[2] > 30 || header[3] == 0 || header[3] > 64
+        || mapped_size != (6 + header[5]) * sizeof(uint64_t)
+        || header[5] != (((size_t(1) << (2 * header[2] + 1)) * header[3] + 63) >> 6)) {
+        munmap(mapped, mapped_size);
+        mapped = nullptr;
+        throw runtime_error("error:[MEMAccelerator] " + filename + " is not a valid MEM accelerator table");
+    }
+    k = header[2];
+    table_width = header[3];
+    gcsa_size = header[4];
+    table_words = header + 6;
+    
+    // make sure the table was built from this index. a matching size catches
+    // most stale tables, and spot checking some of the entries against the
+    // index catches the rest without having to walk the whole table
+    bool matches = (gcsa_size == gcsa_index.size());
+    size_t num_kmers = size_t(1) << (2 * k);
+    size_t num_checks = min<size_t>(num_kmers, 64);
+    for (size_t i = 0; i < num_checks && matches; ++i) {
+        int64_t enc = (i * num_kmers) / num_checks;
+        gcsa::range_type range = direct_LF(gcsa_index, enc, k);
+        matches = (table_entry(enc << 1) == range.first && table_entry((enc << 1) | 1) == range.second);
+    }
+    if (!matches) {
+        munmap(mapped, mapped_size);
+        mapped = nullptr;
+        throw runtime_error("error:[MEMAccelerator] " + filename + " was not built from this GCSA2 index");
+    }
+}
+
+MEMAccelerator::~MEMAccelerator() {
+    if (mapped) {
+        munmap(mapped, mapped_size);
+    }
+}
+
+void MEMAccelerator::save(const string& filename) const {
+    
+    size_t num_words = (((size_t(1) << (2 * k + 1)) * table_width + 63) >> 6);
+    uint64_t header[6] = {file_magic, file_version, (uint64_t) k, table_width, gcsa_size, num_words};
+    
+    ofstream out(filename, ios::binary);
+    if (!out) {
+        throw runtime_error("error:[MEMAccelerator] could not open " + filename + " for writing");
+    }
+    out.write((const char*) header, sizeof(header));
+    out.write((const char*) table_words, num_words * sizeof(uint64_t));
+    if (!out) {
+        throw runtime_error("error:[MEMAccelerator] could not write to " + filename);
+    }
+}
+
 gcsa::range_type MEMAccelerator::memoized_LF(string::const_iterator last) const {
-    int64_t enc = 0;
+    int64_t enc = encode_kmer(last);
+    return gcsa::range_type(table_entry(enc << 1), table_entry((enc << 1) | 1));
+}
+
+gcsa::range_type MEMAccelerator::direct_LF(const gcsa::GCSA& gcsa_index, int64_t enc, size_t k) {
+    // the first character in the encoding is the last one in the k-mer, which
+    // is where backward search starts
+    gcsa::range_type range(0, gcsa_index.size() - 1);
     for (size_t i = 0; i < k; ++i) {
-        enc |= (encode(*last) << (i << 1));
-        --last;
+        range = gcsa_index.LF(range, gcsa_index.alpha.char2comp["ACGT"[(enc >> (i << 1)) & 3]]);
+        if (gcsa::Range::empty(range)) {
+            return gcsa::range_type(1, 0);
+        }
     }
-    return gcsa::range_type(range_table[enc << 1], range_table[(enc << 1) | 1]);
+    return range;
 }
 
 }
@@ -9,8 +9,10 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
 #include <gcsa/gcsa.h>
 #include <sdsl/int_vector.hpp>
+#include <sdsl/bits.hpp>
 
 namespace vg {
 
@@ -18,13 +20,28 @@ using namespace std;
 
 /*
  * An auxilliary index that accelerates the initial steps of
- * MEM-finding in
+ * MEM-finding in GCSA2. The table can either be built in memory or
+ * saved to disk once and memory-mapped when it is loaded.
  */
 class MEMAccelerator {
 public:
     
     MEMAccelerator() = default;
-    MEMAccelerator(const gcsa::GCSA& gcsa_index, size_t k);
+    // build the table for k-mers with this many threads
+    MEMAccelerator(const gcsa::GCSA& gcsa_index, size_t k, int num_threads = 1);
+    
+    // memory-map a table that was previously written with save() for this
+    // GCSA2 index. throws if the file is not a table or was not made from an
+    // index like this one.
+    MEMAccelerator(const string& filename, const gcsa::GCSA& gcsa_index);
+    
+    ~MEMAccelerator();
+    
+    MEMAccelerator(const MEMAccelerator& other) = delete;
+    MEMAccelerator& operator=(const MEMAccelerator& other) = delete;
+    
+    // write the table to a file that can be memory-mapped later
+    void save(const string& filename) const;
     
     // return the length of k-mers that are memoized
     inline int64_t length() const;
@@ -40,11 +57,33 @@ private:
     
     inline int64_t encode(char c) const;
     
+    // the index of the k-mer ending at this position in the table
+    inline int64_t encode_kmer(string::const_iterator last) const;
+    
+    // read an entry from the table
+    inline uint64_t table_entry(size_t i) const;
+    
+    // the range of the k-mer with this encoding, queried directly from the
+    // GCSA2 index, with empty ranges normalized as in the table
+    static gcsa::range_type direct_LF(const gcsa::GCSA& gcsa_index, int64_t enc, size_t k);
+    
+    // magic number and version at the head of a saved table
+    static const uint64_t file_magic;
+    static const uint64_t file_version;
+    
     // the size k-mer we'll index
-    const int64_t k = 1;
-    // the actual table
+    int64_t k = 1;
+    // the size of the GCSA2 index the table was built from
+    uint64_t gcsa_size = 0;
+    // the actual table, if we built it ourselves
     sdsl::int_vector<> range_table;
-    
+    // the bit-packed words of the table, either from range_table or from
+    // a memory-mapped file
+    const uint64_t* table_words = nullptr;
+    uint8_t table_width = 1;
+    // the memory-mapped file, if we loaded one
+    void* mapped = nullptr;
+    size_t mapped_size = 0;
 };
 
 inline int64_t MEMAccelerator::length() const {
@@ -66,6 +105,20 @@ inline int64_t MEMAccelerator::encode(char c) const {
     }
 }
 
+inline int64_t MEMAccelerator::encode_kmer(string::const_iterator last) const {
+    int64_t enc = 0;
+    for (size_t i = 0; i < k; ++i) {
+        enc |= (encode(*last) << (i << 1));
+        --last;
+    }
+    return enc;
+}
+
+inline uint64_t MEMAccelerator::table_entry(size_t i) const {
+    size_t bit = i * table_width;
+    return sdsl::bits::read_int(table_words + (bit >> 6), bit & 63, table_width);
+}
+
 }
 
 #endif
@@ -12,6 +12,7 @@
 #include "split_strand_graph.hpp"
 #include "subgraph.hpp"
 #include "statistics.hpp"
+#include "wang_hash.hpp"
 #include "algorithms/count_covered.hpp"
 #include "algorithms/intersect_path_offsets.hpp"
 #include "algorithms/extract_containing_graph.hpp"
@@ -57,6 +58,9 @@ MinimizerMapper::MinimizerMapper(const gbwtgraph::GBWTGraph& graph,
     
     // The GBWTGraph needs a GBWT
     crash_unless(graph.index != nullptr);
+    
+    // Each thread makes its own rescue cache when it first needs it
+    rescue_caches.resize(get_thread_count());
 }
 
 void MinimizerMapper::set_alignment_scores(const int8_t* score_matrix, int8_t gap_open, int8_t gap_extend, int8_t full_length_bonus) {
@@ -561,8 +565,17 @@ void MinimizerMapper::dump_debug_query(const Alignment& aln1, const Alignment& a
 //-----------------------------------------------------------------------------
 
 void MinimizerMapper::map(Alignment& aln, AlignmentEmitter& alignment_emitter) {
-    // Ship out all the aligned alignments
-    alignment_emitter.emit_mapped_single(map(aln));
+    if (stage_counter == nullptr) {
+        // Ship out all the aligned alignments
+        alignment_emitter.emit_mapped_single(map(aln));
+    } else {
+        auto mappings = map(aln);
+        // Ship them out, and count the time that takes as a stage
+        auto emit_start = std::chrono::steady_clock::now();
+        alignment_emitter.emit_mapped_single(std::move(mappings));
+        std::chrono::duration<double> emit_time = std::chrono::steady_clock::now() - emit_start;
+        stage_counter->record_time("emit", emit_time.count(), omp_get_thread_num());
+    }
 }
 
 vector<Alignment> MinimizerMapper::map(Alignment& aln) {
@@ -581,7 +594,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
     }
     
     // Make a new funnel instrumenter to watch us map this read.
-    Funnel funnel;
+    Funnel funnel(funnel_tracking());
     funnel.start(aln.name());
     
     // Prepare the RNG for shuffling ties, if needed
@@ -597,7 +610,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
     vector<Seed> seeds = this->find_seeds(minimizers, aln, funnel);
 
     // Cluster the seeds. Get sets of input seed indexes that go together.
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("cluster");
     }
 
@@ -614,7 +627,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
 
     // Determine the scores and read coverages for each cluster.
     // Also find the best and second-best cluster scores.
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         funnel.substage("score");
     }
     double best_cluster_score = 0.0, second_best_cluster_score = 0.0;
@@ -646,7 +659,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         cluster_score_cutoff = std::min(cluster_score_cutoff, second_best_cluster_score);
     }
 
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now we go from clusters to gapless extensions
         funnel.stage("extend");
     }
@@ -673,7 +686,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
             // Handle sufficiently good clusters in descending coverage order
             
             Cluster& cluster = clusters[cluster_num];
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-coverage", cluster_num, cluster.coverage);
                 funnel.pass("max-extensions", cluster_num);
             }
@@ -683,7 +696,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                 && kept_cluster_count >= min_extensions) {
                 //If the score isn't good enough and we already kept at least min_extensions clusters,
                 //ignore this cluster
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnel.fail("cluster-score", cluster_num, cluster.score);
                 }
                 if (show_work) {
@@ -697,7 +710,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                 return false;
             }
             
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-score", cluster_num, cluster.score);
             }
             
@@ -728,7 +741,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         }, [&](size_t cluster_num) -> void {
             // There are too many sufficiently good clusters
             Cluster& cluster = clusters[cluster_num];
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-coverage", cluster_num, cluster.coverage);
                 funnel.fail("max-extensions", cluster_num);
             }
@@ -745,7 +758,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
             
         }, [&](size_t cluster_num) -> void {
             // This cluster is not sufficiently good.
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.fail("cluster-coverage", cluster_num, clusters[cluster_num].coverage);
             }
             if (show_work) {
@@ -759,7 +772,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         });
         
     std::vector<int> cluster_extension_scores = this->score_extensions(cluster_extensions, aln, funnel);
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("align");
     }
 
@@ -798,7 +811,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
     // We have more components to the score filter than process_until_threshold_b supports.
     auto discard_processed_cluster_by_score = [&](size_t extension_num) -> void {
         // This extension is not good enough.
-        if (track_provenance) {
+        if (track_funnel()) {
             funnel.fail("extension-set", extension_num, cluster_extension_scores[extension_num]);
         }
         
@@ -836,7 +849,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                     }
                 }
             }
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("extension-set", extension_num, cluster_extension_scores[extension_num]);
                 funnel.pass("max-alignments", extension_num);
                 funnel.processing_input(extension_num);
@@ -850,7 +863,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
             if (GaplessExtender::full_length_extensions(extensions)) {
                 // We got full-length extensions, so directly convert to an Alignment.
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnel.substage("direct");
                 }
                 
@@ -879,14 +892,14 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                     
                 }
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     // Stop the current substage
                     funnel.substage_stop();
                 }
             } else if (do_dp) {
                 // We need to do base-level alignment.
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnel.substage("align");
                 }
             
@@ -900,7 +913,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                     }
                 }
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     // We're done base-level alignment. Next alignment may not go through this substage.
                     funnel.substage_stop();
                 }
@@ -914,7 +927,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
                 alignments.emplace_back(std::move(aln));
                 alignments_to_source.push_back(extension_num);
 
-                if (track_provenance) {
+                if (track_funnel()) {
     
                     funnel.project(extension_num);
                     funnel.score(alignments.size() - 1, alignments.back().score());
@@ -934,7 +947,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
             }
 
            
-            if (track_provenance) {
+            if (track_funnel()) {
                 // We're done with this input item
                 funnel.processed_input();
             }
@@ -951,7 +964,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
             return true;
         }, [&](size_t extension_num) -> void {
             // There are too many sufficiently good extensions
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("extension-set", extension_num, cluster_extension_scores[extension_num]);
                 funnel.fail("max-alignments", extension_num);
             }
@@ -973,13 +986,13 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         alignments.emplace_back(aln);
         alignments_to_source.push_back(numeric_limits<size_t>::max());
         
-        if (track_provenance) {
+        if (track_funnel()) {
             // Say it came from nowhere
             funnel.introduce();
         }
     }
     
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now say we are finding the winner(s)
         funnel.stage("winner");
     }
@@ -1004,7 +1017,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         // Remember the output alignment
         mappings.emplace_back(std::move(alignments[alignment_num]));
         
-        if (track_provenance) {
+        if (track_funnel()) {
             // Tell the funnel
             funnel.pass("max-multimaps", alignment_num);
             funnel.project(alignment_num);
@@ -1018,7 +1031,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         // Remember the score at its rank anyway
         scores.emplace_back(alignments[alignment_num].score());
         
-        if (track_provenance) {
+        if (track_funnel()) {
             funnel.fail("max-multimaps", alignment_num);
         }
     }, [&](size_t alignment_num) {
@@ -1027,7 +1040,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
         crash_unless(false);
     });
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage("mapq");
     }
 
@@ -1088,7 +1101,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
     mappings.front().set_mapping_quality(max(min(mapq, 60.0), 0.0));
    
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage_stop();
     }
     
@@ -1105,6 +1118,7 @@ vector<Alignment> MinimizerMapper::map_from_extensions(Alignment& aln) {
     
     // Annotate with whatever's in the funnel
     funnel.annotate_mapped_alignment(mappings[0], track_correctness);
+    count_stages(funnel);
     
     if (track_provenance) {
         if (track_correctness) {
@@ -1382,7 +1396,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     std::array<Alignment*, 2> alns{&aln1, &aln2};
 
     // Make two new funnel instrumenters to watch us map this read pair.
-    std::array<Funnel, 2> funnels;
+    std::array<Funnel, 2> funnels {Funnel(funnel_tracking()), Funnel(funnel_tracking())};
     // Start this alignment 
     for (auto r : {0, 1}) {
         funnels[r].start(alns[r]->name());
@@ -1425,7 +1439,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     }
 
     // Cluster the seeds. Get sets of input seed indexes that go together.
-    if (track_provenance) {
+    if (track_funnel()) {
         for (auto r : {0, 1}) {
             funnels[r].stage("cluster");
         }
@@ -1475,7 +1489,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         }
     }
 
-    if (track_provenance) {
+    if (track_funnel()) {
         for (auto r : {0, 1}) {
             funnels[r].substage("score");
         }
@@ -1628,7 +1642,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
             cluster_score_cutoff = std::min(cluster_score_cutoff, second_best_cluster_score);
         }
 
-        if (track_provenance) {
+        if (track_funnel()) {
             // Now we go from clusters to gapless extensions
             funnels[read_num].stage("extend");
         }
@@ -1680,7 +1694,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     if (cluster_coverage_threshold != 0 && cluster.coverage < cluster_coverage_cutoff 
                             && kept_cluster_count >= min_extensions) {
                         //If the coverage isn't good enough, ignore this cluster
-                        if (track_provenance) {
+                        if (track_funnel()) {
                             funnels[read_num].fail("cluster-coverage", cluster_num, cluster.coverage);
                         }
                         return false;
@@ -1688,14 +1702,14 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     if (cluster_score_threshold != 0 && cluster.score < cluster_score_cutoff 
                             && kept_cluster_count >= min_extensions) {
                         //If the score isn't good enough, ignore this cluster
-                        if (track_provenance) {
+                        if (track_funnel()) {
                             funnels[read_num].pass("cluster-coverage", cluster_num, cluster.coverage);
                             funnels[read_num].pass("max-extensions", cluster_num);
                             funnels[read_num].fail("cluster-score", cluster_num, cluster.score);
                         }
                         return false;
                     }
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[read_num].pass("cluster-coverage", cluster_num, cluster.coverage);
                         funnels[read_num].pass("max-extensions", cluster_num);
                         funnels[read_num].pass("cluster-score", cluster_num, cluster.score);
@@ -1724,7 +1738,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     return true;
                 } else {
                     //We were looking for clusters in a paired fragment cluster but this one doesn't have any on the other end
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[read_num].pass("cluster-coverage", cluster_num, cluster.coverage);
                         funnels[read_num].pass("max-extensions", cluster_num);
                         funnels[read_num].pass("cluster-score", cluster_num, cluster.score);
@@ -1735,7 +1749,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 
             }, [&](size_t cluster_num) -> void {
                 // There are too many sufficiently good clusters
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnels[read_num].pass("cluster-coverage", cluster_num, clusters[cluster_num].coverage);
                     funnels[read_num].fail("max-extensions", cluster_num);
                 }
@@ -1747,7 +1761,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         // We now estimate the best possible alignment score for each cluster.
         std::vector<int> cluster_alignment_score_estimates = this->score_extensions(cluster_extensions, aln, funnels[read_num]);
         
-        if (track_provenance) {
+        if (track_funnel()) {
             funnels[read_num].stage("align");
         }
         
@@ -1769,7 +1783,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 // This processed cluster is good enough.
                 // Called in descending score order.
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnels[read_num].pass("extension-set", processed_num, cluster_alignment_score_estimates[processed_num]);
                     funnels[read_num].pass("max-alignments", processed_num);
                     funnels[read_num].processing_input(processed_num);
@@ -1783,7 +1797,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 if (GaplessExtender::full_length_extensions(extensions)) {
                     // We got full-length extensions, so directly convert to an Alignment.
                     
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[read_num].substage("direct");
                     }
 
@@ -1813,14 +1827,14 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                         
                     }
 
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         // Stop the current substage
                         funnels[read_num].substage_stop();
                     }
                 } else if (do_dp) {
                     // We need to do base-level alignment.
                     
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[read_num].substage("align");
                     }
                     
@@ -1829,7 +1843,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     find_optimal_tail_alignments(aln, extensions, rng, best_alignments[0], best_alignments[1]);
 
                     
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         // We're done base-level alignment. Next alignment may not go through this substage.
                         funnels[read_num].substage_stop();
                     }
@@ -1853,7 +1867,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     indices_list.emplace_back(curr_funnel_index);
                     curr_funnel_index++;
 
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[read_num].project(processed_num);
                         funnels[read_num].score(funnels[read_num].latest(), alignment_list.back().score());
                     }
@@ -1872,7 +1886,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                     observe_alignment(*aln_it);
                 }
 
-                if (track_provenance) {
+                if (track_funnel()) {
                     // We're done with this input item
                     funnels[read_num].processed_input();
                 }
@@ -1890,13 +1904,13 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 return true;
             }, [&](size_t processed_num) {
                 // There are too many sufficiently good processed clusters
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnels[read_num].pass("extension-set", processed_num, cluster_alignment_score_estimates[processed_num]);
                     funnels[read_num].fail("max-alignments", processed_num);
                 }
             }, [&](size_t processed_num) {
                 // This processed cluster is not good enough.
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnels[read_num].fail("extension-set", processed_num, cluster_alignment_score_estimates[processed_num]);
                 }
             });
@@ -1906,7 +1920,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
 
     //Now that we have alignments, figure out how to pair them up
     
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now say we are finding the pairs
         for (auto r : {0, 1}) {
             funnels[r].stage("pairing");
@@ -2007,7 +2021,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                         }
                     }
 
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         for (auto r : {0, 1}) {
                             funnels[r].processing_input(funnel_index[r]);
                             funnels[r].substage("pair-clusters");
@@ -2114,6 +2128,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 
                     // Annotate with whatever's in the funnel
                     funnels[r].annotate_mapped_alignment(paired_mappings[r].back(), track_correctness);
+                    count_stages(funnels[r]);
                 }
                 
                 return {std::move(paired_mappings[0]), std::move(paired_mappings[1])};
@@ -2121,7 +2136,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 //We are attempting rescue, but we still want to keep the best alignments as a potential (unpaired) pair
                 
                 std::array<size_t, 2> funnel_index;
-                if (track_provenance) {
+                if (track_funnel()) {
                     // Work out what the paired-up alignments are numbered in the funnel.
                     // TODO: can we flatten these lookup paths or change tuples
                     // to structs to be more understandable?
@@ -2152,7 +2167,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                 better_cluster_count_by_pairs.emplace_back(0);
                 pair_types.emplace_back(unpaired);
                 
-                if (track_provenance) {
+                if (track_funnel()) {
                     for (auto r : {0, 1}) {
                         funnels[r].substage("pair-clusters");
                         funnels[r].project(funnel_index[0]);
@@ -2167,26 +2182,86 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         if (max_rescue_attempts != 0) {
             //Attempt rescue on unpaired alignments if either we didn't find any pairs or if the unpaired alignments are very good
 
+            // First decide what to rescue. The rescues themselves can be very
+            // expensive, so we run them as tasks that idle threads can take,
+            // and then we apply the results in the order we decided on them,
+            // so nothing downstream depends on how the tasks were scheduled.
+            enum RescueDecision { rescue_attempted, rescue_skipped, rescue_too_many };
+            vector<pair<size_t, RescueDecision>> rescue_decisions;
+
             process_until_threshold_a(unpaired_alignments.size(), (std::function<double(size_t)>) [&](size_t i) -> double{
                 return (double) unpaired_alignments.at(i).lookup_in(alignments).score();
             }, 0, 1, max_rescue_attempts, rng, [&](size_t i) {
                 auto& index = unpaired_alignments.at(i);
-                size_t j = index.lookup_in(alignment_indices);
-                if (track_provenance) {
-                    funnels[index.read].processing_input(j);
-                    funnels[index.read].substage("rescue");
-                }
                 Alignment& mapped_aln = index.lookup_in(alignments);
-                Alignment rescued_aln = *alns[1 - index.read];
-                rescued_aln.clear_path();
-                
                 if (found_pair && (double) mapped_aln.score() < (double) best_alignment_scores[index.read] * paired_rescue_score_limit) {
                     //If we have already found paired clusters and this unpaired alignment is not good enough, do nothing
-                    return true;
+                    rescue_decisions.emplace_back(i, rescue_skipped);
+                } else {
+                    rescue_decisions.emplace_back(i, rescue_attempted);
                 }
+                return true;
+            }, [&](size_t i) {
+                //This alignment is good enough but we already rescued enough
+                rescue_decisions.emplace_back(i, rescue_too_many);
+                return;
+            }, [&] (size_t i) {
+                //This alignment is insufficiently good
+                //TODO: Fail something here
+                return;
+            });
 
-                //Rescue the alignment
-                attempt_rescue(mapped_aln, rescued_aln, minimizers_by_read[1 - index.read], index.read == 0);
+            // Now do all the rescues
+            vector<size_t> to_rescue;
+            for (auto& decision : rescue_decisions) {
+                if (decision.second == rescue_attempted) {
+                    to_rescue.push_back(decision.first);
+                }
+            }
+            vector<Alignment> rescued_alns(to_rescue.size());
+            // Exceptions can't leave a task, so we carry them out ourselves.
+            vector<std::exception_ptr> rescue_exceptions(to_rescue.size());
+            for (size_t k = 0; k < to_rescue.size(); k++) {
+                // The last rescue runs on this thread while it would otherwise be waiting.
+                #pragma omp task firstprivate(k) shared(to_rescue, rescued_alns, rescue_exceptions, unpaired_alignments, alignments, alns, minimizers_by_read) if(k + 1 < to_rescue.size())
+                {
+                    try {
+                        auto& index = unpaired_alignments.at(to_rescue[k]);
+                        rescued_alns[k] = *alns[1 - index.read];
+                        rescued_alns[k].clear_path();
+                        attempt_rescue(index.lookup_in(alignments), rescued_alns[k], minimizers_by_read[1 - index.read], index.read == 0);
+                    } catch (...) {
+                        rescue_exceptions[k] = std::current_exception();
+                    }
+                }
+            }
+            #pragma omp taskwait
+            for (auto& exception : rescue_exceptions) {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+
+            // And apply them
+            size_t rescue_number = 0;
+            for (auto& decision : rescue_decisions) {
+                auto& index = unpaired_alignments.at(decision.first);
+                size_t j = index.lookup_in(alignment_indices);
+                if (decision.second == rescue_too_many) {
+                    if (track_funnel()) {
+                        funnels[index.read].fail("max-rescue-attempts", j);
+                    }
+                    continue;
+                }
+                if (track_funnel()) {
+                    funnels[index.read].processing_input(j);
+                    funnels[index.read].substage("rescue");
+                }
+                if (decision.second == rescue_skipped) {
+                    continue;
+                }
+                Alignment& mapped_aln = index.lookup_in(alignments);
+                Alignment& rescued_aln = rescued_alns[rescue_number++];
 
                 if (rescued_aln.path().mapping_size() != 0) {
                     //If we actually found an alignment
@@ -2235,7 +2310,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
 #ifdef print_minimizer_table
                     alignment_was_rescued.emplace_back(index.read == 1, index.read == 0);
 #endif
-                    if (track_provenance) {
+                    if (track_funnel()) {
                         funnels[index.read].pass("max-rescue-attempts", j);
                         funnels[index.read].project(j);
                         funnels[1 - index.read].introduce();
@@ -2244,34 +2319,17 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
                         }
                     }
                 }
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnels[index.read].processed_input();
                     funnels[index.read].substage_stop();
                 }
-                return true;
-            }, [&](size_t i) {
-                //This alignment is good enough but we already rescued enough
-                if (track_provenance) {
-                    auto& index = unpaired_alignments.at(i);
-                    size_t j = index.lookup_in(alignment_indices);
-                    funnels[index.read].fail("max-rescue-attempts", j);
-                }
-                return;
-            }, [&] (size_t i) {
-                //This alignment is insufficiently good
-                if (track_provenance) {
-                    //TODO: Fail something here
-                    auto& index = unpaired_alignments.at(i);
-                    size_t j = index.lookup_in(alignment_indices);
-                }
-                return;
-            });
+            }
         }
     }
 
     
     
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now say we are finding the winner(s)
         for (auto r : {0, 1}) {
             funnels[r].stage("winner");
@@ -2360,7 +2418,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         pair_indices.push_back(index_pair);
 #endif
         
-        if (track_provenance) {
+        if (track_funnel()) {
             // Tell the funnel
             for (auto r : {0, 1}) {
                 funnels[r].pass("max-multimaps", alignment_num);
@@ -2384,7 +2442,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         std::array<read_alignment_index_t, 2> index_pair = paired_alignments[alignment_num];
         pair_indices.push_back(index_pair);
 #endif       
-        if (track_provenance) {
+        if (track_funnel()) {
             for (auto r : {0, 1}) {
                 funnels[r].fail("max-multimaps", alignment_num);
             }
@@ -2395,7 +2453,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
         crash_unless(false);
     });
 
-    if (track_provenance) {
+    if (track_funnel()) {
         for (auto r : {0, 1}) {
             funnels[r].substage("mapq");
         }
@@ -2584,7 +2642,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     
     
     for (auto r : {0, 1}) {
-        if (track_provenance) {
+        if (track_funnel()) {
             funnels[r].substage_stop();
         }
         // Stop this alignment
@@ -2594,6 +2652,7 @@ pair<vector<Alignment>, vector<Alignment>> MinimizerMapper::map_paired(Alignment
     for (auto r : {0, 1}) {
         // Annotate with whatever's in the funnel.
         funnels[r].annotate_mapped_alignment(mappings[r].front(), track_correctness);
+        count_stages(funnels[r]);
     
         if (track_provenance) {
             if (track_correctness) {
@@ -2740,6 +2799,17 @@ double MinimizerMapper::faster_cap(const VectorView<Minimizer>& minimizers, vect
     vector<double> c(minimizers_explored.size() + 1, -numeric_limits<double>::infinity());
     c[0] = 0.0;
     
+    // Precompute what we need to know about each explored minimizer, in
+    // explored order, so intervals can be evaluated without going back to the
+    // minimizers or the probability tables for each column.
+    vector<DisruptionInfo> disruption;
+    disruption.reserve(minimizers_explored.size());
+    for (size_t i : minimizers_explored) {
+        disruption.emplace_back(minimizers[i]);
+    }
+    // And reuse a buffer of column probabilities
+    vector<double> scratch;
+    
     for_each_agglomeration_interval(minimizers, sequence, quality_bytes, minimizers_explored, [&](size_t left, size_t right, size_t bottom, size_t top) {
         // For each overlap range in the agglomerations
         
@@ -2749,8 +2819,7 @@ double MinimizerMapper::faster_cap(const VectorView<Minimizer>& minimizers, vect
 #endif
         
         // Calculate the probability of a disruption here
-        double p_here = get_log10_prob_of_disruption_in_interval(minimizers, sequence, quality_bytes,
-            minimizers_explored.begin() + bottom, minimizers_explored.begin() + top, left, right);
+        double p_here = get_log10_prob_of_disruption_in_interval(disruption, quality_bytes, bottom, top, left, right, scratch);
 
 #ifdef debug
         cerr << "log10prob for here: " << p_here << endl;
@@ -2902,44 +2971,65 @@ void MinimizerMapper::for_each_agglomeration_interval(const VectorView<Minimizer
     emit_preceding_intervals(sequence.size());
 }
 
-double MinimizerMapper::get_log10_prob_of_disruption_in_interval(const VectorView<Minimizer>& minimizers,
-    const string& sequence, const string& quality_bytes,
-    const vector<size_t>::iterator& disrupt_begin, const vector<size_t>::iterator& disrupt_end,
-    size_t left, size_t right) {
+MinimizerMapper::DisruptionInfo::DisruptionInfo(const Minimizer& minimizer) :
+    core_start(minimizer.forward_offset()),
+    core_end(minimizer.forward_offset() + minimizer.length),
+    agglomeration_start(minimizer.agglomeration_start),
+    agglomeration_end(minimizer.agglomeration_start + minimizer.agglomeration_length),
+    length(minimizer.length) {
     
-#ifdef debug
-    cerr << "Compute log10 probability in interval " << left << "-" << right << endl;
-#endif
+    // We can only ever ask about up to length competitors.
+    beat_prob.fill(0.0);
+    for (size_t n = 1; n <= length; n++) {
+        beat_prob[n] = prob_for_at_least_one(minimizer.value.hash, n);
+    }
+}
+
+double MinimizerMapper::get_log10_prob_of_disruption_in_interval(const std::vector<DisruptionInfo>& disruption,
+    const string& quality_bytes, size_t disrupt_begin, size_t disrupt_end,
+    size_t left, size_t right, std::vector<double>& scratch) {
     
     if (left == right) {
         // 0-length intervals need no disruption.
         return 0;
     }
-   
-    // We want an OR over all the columns, but some of the probabilities are tiny.
-    // So instead of NOT(AND(NOT())), which also would assume independence the
-    // way we calculate AND by multiplication, we just assume independence and
-    // compute OR as (p1 + p2 - (p1 * p2)).
-    // Start with the first column.
-    double p = get_prob_of_disruption_in_column(minimizers, sequence, quality_bytes, disrupt_begin, disrupt_end, left);
-#ifdef debug
-    cerr << "\tProbability disrupted at column " << left << ": " << p << endl;
-#endif
-    for(size_t i = left + 1 ; i < right; i++) {
-        // OR up probability of all the other columns
-        double col_p = get_prob_of_disruption_in_column(minimizers, sequence, quality_bytes, disrupt_begin, disrupt_end, i);
-#ifdef debug
-        cerr << "\tProbability disrupted at column " << i << ": " << col_p << endl;
-#endif
-        p = (p + col_p - (p * col_p));
-#ifdef debug
-        cerr << "\tRunning OR of disrupted anywhere: " << p << endl;
-#endif
+    
+    // Base cost for each column is its quality.
+    size_t width = right - left;
+    scratch.resize(width);
+    for (size_t i = 0; i < width; i++) {
+        scratch[i] = phred_to_prob((uint8_t)quality_bytes[left + i]);
+    }
+    
+    for (size_t k = disrupt_begin; k < disrupt_end; k++) {
+        // For each minimizer to disrupt, in the same order as get_prob_of_disruption_in_column
+        const DisruptionInfo& m = disruption[k];
+        
+        // Columns in the flank need an error-created minimizer to beat this
+        // one; columns in the core disrupt it outright. Do the flank on each
+        // side of the core as a contiguous run.
+        size_t runs[2][2] = {{left, std::min(right, std::max(left, m.core_start))},
+                             {std::max(left, std::min(right, m.core_end)), right}};
+        for (auto& run : runs) {
+            for (size_t i = run[0]; i < run[1]; i++) {
+                // Same competitor count as get_prob_of_disruption_in_column
+                size_t possible_minimizers = std::min(m.length,
+                                                      std::min(i - m.agglomeration_start + 1,
+                                                               m.agglomeration_end - i));
+                scratch[i - left] *= m.beat_prob[possible_minimizers];
+            }
+        }
+    }
+    
+    // OR the columns together, assuming independence, as in the
+    // column-at-a-time version.
+    double p = scratch[0];
+    for (size_t i = 1; i < width; i++) {
+        p = (p + scratch[i] - (p * scratch[i]));
     }
     
     // Convert to log10prob.
     return log10(p);
- 
 }
 
 double MinimizerMapper::get_prob_of_disruption_in_column(const VectorView<Minimizer>& minimizers,
@@ -3081,82 +3171,61 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
         dozeu_seed.back().nodes.push_back(node);
     }
 
-    // GSSW and dozeu assume that the graph is a DAG.
-    std::vector<handle_t> topological_order = gbwtgraph::topological_order(cached_graph, rescue_nodes);
-    if (!topological_order.empty()) {
-        
-        size_t rescue_subgraph_bases = 0;
-        for (auto& h : topological_order) {
-            rescue_subgraph_bases += cached_graph.get_length(h);
-        }
-        if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_dozeu_cells) {
-            if (!warned_about_rescue_size.test_and_set()) {
-                cerr << "warning[vg::giraffe]: Refusing to perform too-large rescue alignment of "
-                    << rescued_alignment.sequence().size() << " bp against "
-                    << rescue_subgraph_bases << " bp ordered subgraph for read " << rescued_alignment.name()
-                    << " which would use more than " << max_dozeu_cells
-                    << " cells and might exhaust Dozeu's allocator; suppressing further warnings." << endl;
-            }
-            return; 
-        }
-    
-        if (rescue_algorithm == rescue_dozeu) {
-            size_t gap_limit = this->get_regular_aligner()->longest_detectable_gap(rescued_alignment);
-            get_regular_aligner()->align_xdrop(rescued_alignment, cached_graph, topological_order,
-                                               dozeu_seed, false, gap_limit);
-            this->fix_dozeu_score(rescued_alignment, cached_graph, topological_order);
-            this->fix_dozeu_end_deletions(rescued_alignment);
-        } else {
-            get_regular_aligner()->align(rescued_alignment, cached_graph, topological_order);
-        }
+    // GSSW and dozeu assume that the graph is a DAG. Get the rescue nodes in
+    // topological order, or a dagified copy of them if they aren't a DAG.
+    // Reads rescued into the same locus share this work through the cache.
+    std::shared_ptr<RescueSubgraph> subgraph = this->get_rescue_subgraph(cached_graph, rescue_nodes,
+                                                                         rescued_alignment.sequence().size());
+    const DozeuInterface::OrderedGraph& ordered = *subgraph->ordered;
+    if (ordered.size() == 0) {
+        // Nothing to align to
         return;
     }
-
-    // Build a subgraph overlay.
-    SubHandleGraph sub_graph(&cached_graph);
-    for (id_t id : rescue_nodes) {
-        sub_graph.add_handle(cached_graph.get_handle(id));
-    }
-
-    // Create an overlay where each strand is a separate node.
-    StrandSplitGraph split_graph(&sub_graph);
-
-    // Dagify the subgraph.
-    bdsg::HashGraph dagified;
-    std::unordered_map<id_t, id_t> dagify_trans =
-        handlealgs::dagify(&split_graph, &dagified, rescued_alignment.sequence().size());
-
-    size_t rescue_subgraph_bases = dagified.get_total_length();
+    
+    size_t rescue_subgraph_bases = ordered.total_length();
     if (rescue_subgraph_bases * rescued_alignment.sequence().size() > max_dozeu_cells) {
         if (!warned_about_rescue_size.test_and_set()) {
             cerr << "warning[vg::giraffe]: Refusing to perform too-large rescue alignment of "
                 << rescued_alignment.sequence().size() << " bp against "
-                << rescue_subgraph_bases << " bp dagified subgraph for read " << rescued_alignment.name()
+                << rescue_subgraph_bases << " bp " << (subgraph->is_dagified ? "dagified" : "ordered")
+                << " subgraph for read " << rescued_alignment.name()
                 << " which would use more than " << max_dozeu_cells
                 << " cells and might exhaust Dozeu's allocator; suppressing further warnings." << endl;
         }
         return; 
     }
     
-    // Align to the subgraph.
+    if (!subgraph->is_dagified) {
+        // The ordered graph is over the GBWTGraph, which shares handles with the cached graph.
+        if (rescue_algorithm == rescue_dozeu) {
+            size_t gap_limit = this->get_regular_aligner()->longest_detectable_gap(rescued_alignment);
+            get_regular_aligner()->align_xdrop(rescued_alignment, ordered, dozeu_seed, false, gap_limit);
+            this->fix_dozeu_score(rescued_alignment, ordered.graph, ordered.order);
+            this->fix_dozeu_end_deletions(rescued_alignment);
+        } else {
+            get_regular_aligner()->align(rescued_alignment, ordered.graph, ordered.order);
+        }
+        return;
+    }
+    
+    // Align to the dagified subgraph.
     // TODO: Map the seed to the dagified subgraph.
     if (this->rescue_algorithm == rescue_dozeu) {
         size_t gap_limit = this->get_regular_aligner()->longest_detectable_gap(rescued_alignment);
-        get_regular_aligner()->align_xdrop(rescued_alignment, dagified, std::vector<MaximalExactMatch>(), false, gap_limit);
-        this->fix_dozeu_score(rescued_alignment, dagified, std::vector<handle_t>());
+        get_regular_aligner()->align_xdrop(rescued_alignment, ordered, std::vector<MaximalExactMatch>(), false, gap_limit);
+        this->fix_dozeu_score(rescued_alignment, subgraph->dagified, std::vector<handle_t>());
         this->fix_dozeu_end_deletions(rescued_alignment);
     } else if (this->rescue_algorithm == rescue_gssw) {
-        get_regular_aligner()->align(rescued_alignment, dagified, true);
+        get_regular_aligner()->align(rescued_alignment, subgraph->dagified, true);
     }
 
     // Map the alignment back to the original graph.
     Path& path = *(rescued_alignment.mutable_path());
     for (size_t i = 0; i < path.mapping_size(); i++) {
         Position& pos = *(path.mutable_mapping(i)->mutable_position());
-        id_t id = dagify_trans[pos.node_id()];
-        handle_t handle = split_graph.get_underlying_handle(split_graph.get_handle(id));
-        pos.set_node_id(sub_graph.get_id(handle));
-        pos.set_is_reverse(sub_graph.get_is_reverse(handle));
+        handle_t handle = subgraph->dagify_trans.at(pos.node_id());
+        pos.set_node_id(cached_graph.get_id(handle));
+        pos.set_is_reverse(cached_graph.get_is_reverse(handle));
     }
     
     if (show_work) {
@@ -3167,6 +3236,75 @@ void MinimizerMapper::attempt_rescue(const Alignment& aligned_read, Alignment& r
     }
 }
 
+std::shared_ptr<MinimizerMapper::RescueSubgraph> MinimizerMapper::get_rescue_subgraph(const HandleGraph& graph,
+                                                                                       const std::unordered_set<nid_t>& rescue_nodes,
+                                                                                       size_t read_length) {
+    
+    // Find this thread's cache, if we are caching.
+    LRUCache<size_t, std::shared_ptr<RescueSubgraph>>* cache = nullptr;
+    size_t thread_num = omp_get_thread_num();
+    if (this->rescue_cache_size != 0 && thread_num < this->rescue_caches.size()) {
+        auto& thread_cache = this->rescue_caches[thread_num];
+        if (!thread_cache) {
+            thread_cache.reset(new LRUCache<size_t, std::shared_ptr<RescueSubgraph>>(this->rescue_cache_size));
+        }
+        cache = thread_cache.get();
+    }
+    
+    // Entries are keyed on the hash of the node set, so we keep the sorted
+    // IDs to check for collisions.
+    std::vector<nid_t> sorted_ids;
+    size_t key = wang_hash_64(read_length);
+    if (cache != nullptr) {
+        sorted_ids.assign(rescue_nodes.begin(), rescue_nodes.end());
+        std::sort(sorted_ids.begin(), sorted_ids.end());
+        for (nid_t id : sorted_ids) {
+            key = wang_hash_64(key ^ (size_t) id);
+        }
+        auto cached = cache->retrieve(key);
+        if (cached.second && cached.first->read_length == read_length && cached.first->nodes == sorted_ids) {
+            return cached.first;
+        }
+    }
+    
+    std::shared_ptr<RescueSubgraph> subgraph = std::make_shared<RescueSubgraph>();
+    subgraph->read_length = read_length;
+    
+    std::vector<handle_t> topological_order = gbwtgraph::topological_order(graph, rescue_nodes);
+    if (!topological_order.empty() || rescue_nodes.empty()) {
+        // The GBWTGraph outlives the cache, unlike the graph we were given.
+        subgraph->ordered.reset(new DozeuInterface::OrderedGraph(this->gbwt_graph, topological_order));
+    } else {
+        // Build a subgraph overlay.
+        SubHandleGraph sub_graph(&graph);
+        for (nid_t id : rescue_nodes) {
+            sub_graph.add_handle(graph.get_handle(id));
+        }
+        
+        // Create an overlay where each strand is a separate node.
+        StrandSplitGraph split_graph(&sub_graph);
+        
+        // Dagify the subgraph.
+        std::unordered_map<nid_t, nid_t> dagify_trans =
+            handlealgs::dagify(&split_graph, &subgraph->dagified, read_length);
+        
+        // Translate straight through to the base graph.
+        for (auto& translation : dagify_trans) {
+            subgraph->dagify_trans[translation.first] =
+                split_graph.get_underlying_handle(split_graph.get_handle(translation.second));
+        }
+        subgraph->is_dagified = true;
+        subgraph->ordered.reset(new DozeuInterface::OrderedGraph(subgraph->dagified,
+                                                                 handlealgs::lazier_topological_order(&subgraph->dagified)));
+    }
+    
+    if (cache != nullptr) {
+        subgraph->nodes = std::move(sorted_ids);
+        cache->put(key, subgraph);
+    }
+    return subgraph;
+}
+
 GaplessExtender::cluster_type MinimizerMapper::seeds_in_subgraph(const VectorView<Minimizer>& minimizers,
                                                                  const std::unordered_set<id_t>& subgraph) const {
     std::vector<id_t> sorted_ids(subgraph.begin(), subgraph.end());
@@ -3293,7 +3431,7 @@ void MinimizerMapper::extension_to_alignment(const GaplessExtension& extension,
 
 std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const std::string& sequence, Funnel& funnel) const {
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Start the minimizer finding stage
         funnel.stage("minimizer");
     }
@@ -3335,7 +3473,7 @@ std::vector<MinimizerMapper::Minimizer> MinimizerMapper::find_minimizers(const s
                             match_length, candidate_count, score });
     }
     
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Record how many we found, as new lines.
         funnel.introduce(result.size());
     }
@@ -3350,7 +3488,7 @@ std::vector<size_t> MinimizerMapper::sort_minimizers_by_score(const std::vector<
 
 std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<Minimizer>& minimizers, const Alignment& aln, Funnel& funnel) const {
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Start the minimizer locating stage
         funnel.stage("seed");
     }
@@ -3474,7 +3612,7 @@ std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<
     // locating more of the minimizers that are present and letting them pass
     // to the enxt stage should raise the cap.
     for (size_t i = 0; i < minimizers.size(); i++) {
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             // Say we're working on it
             funnel.processing_input(i);
         }
@@ -3508,13 +3646,13 @@ std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<
             passing = filter_function(minimizer);
             if (passing) {
                 // Pass this filter
-                if (this->track_provenance) {
+                if (this->track_funnel()) {
                     funnel.pass(filter_name, i, filter_stat_function(minimizer));
                 }
                 filter_pass_function(minimizer);
             } else {
                 // Fail this filter.
-                if (this->track_provenance) {
+                if (this->track_funnel()) {
                     funnel.fail(filter_name, i, filter_stat_function(minimizer));
                 }
                 filter_fail_function(minimizer);
@@ -3553,7 +3691,7 @@ std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<
                 seeds.push_back(chain_info_to_seed(hit, i, chain_info));
             }
             
-            if (this->track_provenance) {
+            if (this->track_funnel()) {
                 // Record in the funnel that this minimizer gave rise to these seeds.
                 funnel.expand(i, minimizer.hits);
             }
@@ -3564,7 +3702,7 @@ std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<
             rejected_count++;
         }
         
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             // Say we're done with this input item
             funnel.processed_input();
         }
@@ -3593,6 +3731,22 @@ std::vector<MinimizerMapper::Seed> MinimizerMapper::find_seeds(const VectorView<
     return seeds;
 }
 
+Funnel::Tracking MinimizerMapper::funnel_tracking() const {
+    if (track_provenance) {
+        return Funnel::Tracking::FULL;
+    } else if (stage_counter != nullptr) {
+        return Funnel::Tracking::COUNTS;
+    } else {
+        return Funnel::Tracking::NONE;
+    }
+}
+
+void MinimizerMapper::count_stages(const Funnel& funnel) const {
+    if (stage_counter != nullptr) {
+        stage_counter->record(funnel, omp_get_thread_num());
+    }
+}
+
 void MinimizerMapper::tag_seeds(const Alignment& aln, const std::vector<Seed>::const_iterator& begin, const std::vector<Seed>::const_iterator& end, const VectorView<Minimizer>& minimizers, size_t funnel_offset, Funnel& funnel) const { 
     if (this->track_correctness && this->path_graph == nullptr) {
         cerr << "error[vg::MinimizerMapper] Cannot use track_correctness with no XG index" << endl;
@@ -3683,7 +3837,7 @@ void MinimizerMapper::annotate_with_minimizer_statistics(Alignment& target, cons
 
 void MinimizerMapper::score_cluster(Cluster& cluster, size_t i, const VectorView<Minimizer>& minimizers, const std::vector<Seed>& seeds, size_t seq_length, Funnel& funnel) const {
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Say we're making it
         funnel.producing_output(i);
     }
@@ -3720,7 +3874,7 @@ void MinimizerMapper::score_cluster(Cluster& cluster, size_t i, const VectorView
     // Count up the covered positions and turn it into a fraction.
     cluster.coverage = sdsl::util::cnt_one_bits(covered) / static_cast<double>(seq_length);
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Record the cluster in the funnel as a group of the size of the number of items.
         funnel.merge_group(cluster.seeds.begin(), cluster.seeds.end());
         funnel.score(funnel.latest(), cluster.score);
@@ -3740,7 +3894,7 @@ vector<GaplessExtension> MinimizerMapper::extend_cluster(const Cluster& cluster,
     vector<vector<size_t>>& minimizer_kept_cluster_count,
     Funnel& funnel) const {
 
-    if (track_provenance) {
+    if (track_funnel()) {
         // Say we're working on this cluster
         funnel.processing_input(cluster_num);
     }
@@ -3781,7 +3935,7 @@ vector<GaplessExtension> MinimizerMapper::extend_cluster(const Cluster& cluster,
         }
     }
             
-    if (track_provenance) {
+    if (track_funnel()) {
         // Record with the funnel that the previous group became a group of this size.
         // Don't bother recording the seed to extension matching...
         funnel.project_group(cluster_num, cluster_extension.size());
@@ -3982,7 +4136,7 @@ int MinimizerMapper::score_extension_group(const Alignment& aln, const vector<Ga
 std::vector<int> MinimizerMapper::score_extensions(const std::vector<std::vector<GaplessExtension>>& extensions, const Alignment& aln, Funnel& funnel) const {
 
     // Extension scoring substage.
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         funnel.substage("score");
     }
 
@@ -3990,14 +4144,14 @@ std::vector<int> MinimizerMapper::score_extensions(const std::vector<std::vector
     std::vector<int> result(extensions.size(), 0);
     for (size_t i = 0; i < extensions.size(); i++) {
         
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             funnel.producing_output(i);
         }
         
         result[i] = score_extension_group(aln, extensions[i], get_regular_aligner()->gap_open, get_regular_aligner()->gap_extension);
         
         // Record the score with the funnel.
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             funnel.score(i, result[i]);
             funnel.produced_output();
         }
@@ -4009,7 +4163,7 @@ std::vector<int> MinimizerMapper::score_extensions(const std::vector<std::vector
 std::vector<int> MinimizerMapper::score_extensions(const std::vector<std::pair<std::vector<GaplessExtension>, size_t>>& extensions, const Alignment& aln, Funnel& funnel) const {
 
     // Extension scoring substage.
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         funnel.substage("score");
     }
 
@@ -4017,14 +4171,14 @@ std::vector<int> MinimizerMapper::score_extensions(const std::vector<std::pair<s
     std::vector<int> result(extensions.size(), 0);
     for (size_t i = 0; i < extensions.size(); i++) {
         
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             funnel.producing_output(i);
         }
         
         result[i] = score_extension_group(aln, extensions[i].first, get_regular_aligner()->gap_open, get_regular_aligner()->gap_extension);
         
         // Record the score with the funnel.
-        if (this->track_provenance) {
+        if (this->track_funnel()) {
             funnel.score(i, result[i]);
             funnel.produced_output();
         }
@@ -16,11 +16,16 @@
 #include "snarls.hpp"
 #include "tree_subgraph.hpp"
 #include "funnel.hpp"
+#include "statistics.hpp"
 
 #include <gbwtgraph/minimizer.h>
 #include <structures/immutable_list.hpp>
+#include <bdsg/hash_graph.hpp>
+#include "lru_cache.h"
 
+#include <array>
 #include <atomic>
+#include <memory>
 
 namespace vg {
 
@@ -91,6 +96,10 @@ public:
      * If the fragment length distribution is not yet fixed, reads will be
      * mapped independently. Otherwise, they will be mapped according to the
      * fragment length distribution.
+     *
+     * Rescue attempts are spawned as OpenMP tasks, so when this is called
+     * inside a parallel region, idle threads can take them over while this
+     * one waits. Results do not depend on which threads ran them.
      */
     pair<vector<Alignment>, vector<Alignment>> map_paired(Alignment& aln1, Alignment& aln2);
 
@@ -314,6 +323,11 @@ public:
     /// If set, log what the mapper is thinking in its mapping of each read.
     static constexpr bool default_show_work = false;
     bool show_work = default_show_work;
+    
+    /// If set, count the items and time in each stage of mapping every read
+    /// into this, even without track_provenance. The counter must have a
+    /// table for every mapping thread.
+    FunnelStageCounter* stage_counter = nullptr;
 
     ////How many stdevs from fragment length distr mean do we cluster together?
     static constexpr double default_paired_distance_stdevs = 2.0;
@@ -347,6 +361,12 @@ public:
     static constexpr size_t default_max_fragment_length = 2000;
     size_t max_fragment_length = default_max_fragment_length;
     
+    /// How many recently used rescue subgraphs should each thread keep, so
+    /// that rescues into the same locus can skip building and packing the
+    /// subgraph? 0 disables the cache.
+    static constexpr size_t default_rescue_cache_size = 64;
+    size_t rescue_cache_size = default_rescue_cache_size;
+    
     /// Implemented rescue algorithms: no rescue, dozeu, GSSW.
     enum RescueAlgorithm { rescue_none, rescue_dozeu, rescue_gssw };
 
@@ -482,6 +502,32 @@ protected:
     /// We have a clusterer
     SnarlDistanceIndexClusterer clusterer;
 
+    /**
+     * A rescue subgraph that is ready to align against. If the rescue nodes
+     * form a DAG in the GBWTGraph, we keep a packed topological order of
+     * them. Otherwise we keep a dagified copy, packed, with a translation
+     * back to the GBWTGraph.
+     */
+    struct RescueSubgraph {
+        /// Sorted IDs of the rescue nodes this subgraph was made from.
+        std::vector<nid_t> nodes;
+        /// Length of the read the subgraph was dagified for.
+        size_t read_length;
+        /// Whether we had to dagify the rescue nodes.
+        bool is_dagified = false;
+        /// The dagified graph, if any.
+        bdsg::HashGraph dagified;
+        /// Map from node ID in the dagified graph to handle in the GBWTGraph.
+        std::unordered_map<nid_t, handle_t> dagify_trans;
+        /// The GBWTGraph or the dagified graph, packed in topological order.
+        std::unique_ptr<DozeuInterface::OrderedGraph> ordered;
+    };
+    
+    /// Per-thread LRU caches of rescue subgraphs, keyed by a hash of the
+    /// rescue nodes and read length. Each cache is created by its own thread
+    /// on first use.
+    std::vector<std::unique_ptr<LRUCache<size_t, std::shared_ptr<RescueSubgraph>>>> rescue_caches;
+
     /// We have a distribution for read fragment lengths that takes care of
     /// knowing when we've observed enough good ones to learn a good
     /// distribution.
@@ -509,6 +555,24 @@ protected:
      */
     std::vector<Seed> find_seeds(const VectorView<Minimizer>& minimizers, const Alignment& aln, Funnel& funnel) const;
     
+    /**
+     * Decide how much the Funnel for each read should record, according to
+     * track_provenance and stage_counter.
+     */
+    Funnel::Tracking funnel_tracking() const;
+    
+    /**
+     * Return true if Funnel calls record anything, and so are worth making.
+     */
+    inline bool track_funnel() const {
+        return track_provenance || stage_counter != nullptr;
+    }
+    
+    /**
+     * Add a stopped read's Funnel to the stage counter, if we have one.
+     */
+    void count_stages(const Funnel& funnel) const;
+
     /**
      * If tracking correctness, mark seeds that are correctly mapped as correct
      * in the funnel, based on proximity along paths to the input read's
@@ -629,6 +693,15 @@ protected:
      */
     void attempt_rescue(const Alignment& aligned_read, Alignment& rescued_alignment, const VectorView<Minimizer>& minimizers, bool rescue_forward);
 
+    /**
+     * Get the rescue subgraph over the given rescue nodes for a read of the
+     * given length, from the calling thread's rescue cache if possible. The
+     * subgraph is built from the given graph, which must share handles with
+     * the GBWTGraph.
+     */
+    std::shared_ptr<RescueSubgraph> get_rescue_subgraph(const HandleGraph& graph, const std::unordered_set<nid_t>& rescue_nodes,
+                                                        size_t read_length);
+
     /**
      * Return the all non-redundant seeds in the subgraph, including those from
      * minimizers not used for mapping.
@@ -815,22 +888,39 @@ protected:
         const vector<size_t>& minimizer_indices,
         const function<void(size_t, size_t, size_t, size_t)>& iteratee);      
     
+    /**
+     * Precomputed information about one minimizer, for computing disruption
+     * probabilities over whole intervals of read columns at once: the
+     * extents of the minimizer and its agglomeration, and the probability of
+     * an error-created minimizer beating it for each possible number of
+     * competitors.
+     */
+    struct DisruptionInfo {
+        size_t core_start;
+        size_t core_end;
+        size_t agglomeration_start;
+        size_t agglomeration_end;
+        size_t length;
+        /// Entry n is prob_for_at_least_one(hash, n).
+        std::array<double, MAX_AT_LEAST_ONE_EVENTS + 1> beat_prob;
+        
+        DisruptionInfo(const Minimizer& minimizer);
+    };
+    
     /**
      * Gives the log10 prob of a base error in the given interval of the read,
-     * accounting for the disruption of specified minimizers.
-     * 
-     * minimizers is the collection of all minimizers
-     *
-     * disrupt_begin and disrupt_end are iterators defining a sequence of
-     * **indices** of minimizers in minimizers that are disrupted.
+     * accounting for the disruption of the minimizers in the range
+     * [disrupt_begin, disrupt_end) of disruption.
      *
-     * left and right are the inclusive and exclusive bounds of the interval
-     * of the read where the disruption occurs.
+     * Computes each column's probability into the scratch buffer, one
+     * minimizer at a time over contiguous runs of flank columns, and then
+     * ORs the columns together. Multiplications happen in the same order as
+     * when ORing up get_prob_of_disruption_in_column() one column at a time,
+     * so the result is identical to that, not just within a tolerance.
      */
-    static double get_log10_prob_of_disruption_in_interval(const VectorView<Minimizer>& minimizers,
-        const string& sequence, const string& quality_bytes,
-        const vector<size_t>::iterator& disrupt_begin, const vector<size_t>::iterator& disrupt_end,
-        size_t left, size_t right);
+    static double get_log10_prob_of_disruption_in_interval(const std::vector<DisruptionInfo>& disruption,
+        const string& quality_bytes, size_t disrupt_begin, size_t disrupt_end,
+        size_t left, size_t right, std::vector<double>& scratch);
     
     /**
      * Gives the raw probability of a base error in the given column of the
@@ -54,7 +54,7 @@ void MinimizerMapper::score_merged_cluster(Cluster& cluster,
                                            Funnel& funnel) const {
     
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Say we're making it
         funnel.producing_output(i);
     }
@@ -118,7 +118,7 @@ void MinimizerMapper::score_merged_cluster(Cluster& cluster,
     // Count up the covered positions and turn it into a fraction.
     cluster.coverage = sdsl::util::cnt_one_bits(covered) / static_cast<double>(seq_length);
 
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         // Record the cluster in the funnel as a group combining the previous groups.
         funnel.merge_groups(to_combine.begin(), to_combine.end());
         funnel.score(funnel.latest(), cluster.score);
@@ -270,7 +270,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     }
     
     // Make a new funnel instrumenter to watch us map this read.
-    Funnel funnel;
+    Funnel funnel(funnel_tracking());
     funnel.start(aln.name());
     
     // Prepare the RNG for shuffling ties, if needed
@@ -293,7 +293,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     vector<Seed> seeds = this->find_seeds(minimizers, aln, funnel);
     
     // Pre-cluster just the seeds we have. Get sets of input seed indexes that go together.
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("precluster");
         funnel.substage("compute-preclusters");
     }
@@ -301,7 +301,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     // Find the clusters up to a flat distance limit
     std::vector<Cluster> preclusters = clusterer.cluster_seeds(seeds, chaining_cluster_distance);
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage("score-preclusters");
     }
     for (size_t i = 0; i < preclusters.size(); i++) {
@@ -310,7 +310,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     }
     
     // Find pairs of "adjacent" preclusters
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage("pair-preclusters");
     }
     
@@ -407,11 +407,11 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         precluster_connections.emplace_back(std::numeric_limits<size_t>::max(), unconnected);
     }
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("reseed");
     }
     
-    if (track_provenance) {
+    if (track_funnel()) {
         // We project all preclusters into the funnel
         for (size_t i = 0; i < preclusters.size(); i++) {
             funnel.project_group(i, preclusters[i].seeds.size());
@@ -538,7 +538,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 seeds.emplace_back(std::move(seed));
                 seen_seeds.emplace_hint(found, std::move(key));
                 
-                if (this->track_provenance) {
+                if (this->track_funnel()) {
                     funnel.introduce();
                     // Tell the funnel we came from these preclusters together
                     if (connected.first != std::numeric_limits<size_t>::max()) {
@@ -588,7 +588,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     }
     
     // Make the main clusters that include the recovered seeds
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("cluster");
     }
     
@@ -596,7 +596,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     
     // Determine the scores and read coverages for each cluster.
     // Also find the best and second-best cluster scores.
-    if (this->track_provenance) {
+    if (this->track_funnel()) {
         funnel.substage("score");
     }
     double best_cluster_score = 0.0, second_best_cluster_score = 0.0;
@@ -640,7 +640,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         cluster_score_cutoff = std::min(cluster_score_cutoff, second_best_cluster_score);
     }
 
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now we go from clusters to chains
         funnel.stage("chain");
     }
@@ -673,7 +673,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             // Handle sufficiently good clusters in descending coverage order
             
             Cluster& cluster = clusters[cluster_num];
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-coverage", cluster_num, cluster.coverage);
                 funnel.pass("max-clusters-to-chain", cluster_num);
             }
@@ -701,7 +701,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 && kept_cluster_count >= min_clusters_to_chain) {
                 //If the score isn't good enough and we already kept at least min_clusters_to_chain clusters,
                 //ignore this cluster
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnel.fail("cluster-score", cluster_num, cluster.score);
                 }
                 if (show_work) {
@@ -716,7 +716,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 return false;
             }
             
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-score", cluster_num, cluster.score);
             }
             
@@ -731,7 +731,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 }
             }
             
-            if (track_provenance) {
+            if (track_funnel()) {
                 // Say we're working on this cluster
                 funnel.processing_input(cluster_num);
             }
@@ -755,7 +755,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             // Sort seeds by read start of seeded region, and remove indexes for seeds that are redundant
             algorithms::sort_and_shadow(seed_anchors, cluster_seeds_sorted);
             
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.substage("find_chain");
             }
             
@@ -808,7 +808,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 cluster_chain_seeds.back() = cluster_seeds_sorted;
             }
             
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.substage_stop();
             }
             
@@ -843,6 +843,9 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 
                 // Say we finished with this cluster, for now.
                 funnel.processed_input();
+            } else if (this->track_funnel()) {
+                // Just count the chain
+                funnel.introduce();
             }
             
             return true;
@@ -850,7 +853,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         }, [&](size_t cluster_num) -> void {
             // There are too many sufficiently good clusters
             Cluster& cluster = clusters[cluster_num];
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("cluster-coverage", cluster_num, cluster.coverage);
                 funnel.fail("max-clusters-to-chain", cluster_num);
             }
@@ -867,7 +870,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             
         }, [&](size_t cluster_num) -> void {
             // This cluster is not sufficiently good.
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.fail("cluster-coverage", cluster_num, clusters[cluster_num].coverage);
             }
             if (show_work) {
@@ -888,7 +891,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         cluster_alignment_score_estimates[i] = cluster_chains[i].first;
     }
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.stage("align");
     }
 
@@ -927,7 +930,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     // We have more components to the score filter than process_until_threshold_b supports.
     auto discard_processed_cluster_by_score = [&](size_t processed_num) -> void {
         // This chain is not good enough.
-        if (track_provenance) {
+        if (track_funnel()) {
             funnel.fail("chain-score", processed_num, cluster_alignment_score_estimates[processed_num]);
         }
         
@@ -963,7 +966,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                     }
                 }
             }
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("chain-score", processed_num, cluster_alignment_score_estimates[processed_num]);
                 funnel.pass("max-alignments", processed_num);
                 funnel.processing_input(processed_num);
@@ -976,7 +979,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             if (do_dp) {
                 // We need to do base-level alignment.
             
-                if (track_provenance) {
+                if (track_funnel()) {
                     funnel.substage("align");
                 }
                 
@@ -999,7 +1002,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
                 alignments.emplace_back(std::move(aln));
                 alignments_to_source.push_back(processed_num);
 
-                if (track_provenance) {
+                if (track_funnel()) {
     
                     funnel.project(processed_num);
                     funnel.score(alignments.size() - 1, alignments.back().score());
@@ -1019,7 +1022,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             }
 
            
-            if (track_provenance) {
+            if (track_funnel()) {
                 // We're done with this input item
                 funnel.processed_input();
             }
@@ -1036,7 +1039,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
             return true;
         }, [&](size_t processed_num) -> void {
             // There are too many sufficiently good processed clusters
-            if (track_provenance) {
+            if (track_funnel()) {
                 funnel.pass("chain-score", processed_num, cluster_alignment_score_estimates[processed_num]);
                 funnel.fail("max-alignments", processed_num);
             }
@@ -1057,13 +1060,13 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         alignments.emplace_back(aln);
         alignments_to_source.push_back(numeric_limits<size_t>::max());
         
-        if (track_provenance) {
+        if (track_funnel()) {
             // Say it came from nowhere
             funnel.introduce();
         }
     }
     
-    if (track_provenance) {
+    if (track_funnel()) {
         // Now say we are finding the winner(s)
         funnel.stage("winner");
     }
@@ -1088,7 +1091,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         // Remember the output alignment
         mappings.emplace_back(std::move(alignments[alignment_num]));
         
-        if (track_provenance) {
+        if (track_funnel()) {
             // Tell the funnel
             funnel.pass("max-multimaps", alignment_num);
             funnel.project(alignment_num);
@@ -1102,7 +1105,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         // Remember the score at its rank anyway
         scores.emplace_back(alignments[alignment_num].score());
         
-        if (track_provenance) {
+        if (track_funnel()) {
             funnel.fail("max-multimaps", alignment_num);
         }
     }, [&](size_t alignment_num) {
@@ -1111,7 +1114,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
         assert(false);
     });
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage("mapq");
     }
 
@@ -1172,7 +1175,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     mappings.front().set_mapping_quality(max(min(mapq, 60.0), 0.0));
    
     
-    if (track_provenance) {
+    if (track_funnel()) {
         funnel.substage_stop();
     }
     
@@ -1189,6 +1192,7 @@ vector<Alignment> MinimizerMapper::map_from_chains(Alignment& aln) {
     
     // Annotate with whatever's in the funnel
     funnel.annotate_mapped_alignment(mappings[0], track_correctness);
+    count_stages(funnel);
     
     if (track_provenance) {
         if (track_correctness) {
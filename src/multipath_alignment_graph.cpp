@@ -5,6 +5,8 @@
 #include "multipath_alignment_graph.hpp"
 #include "sequence_complexity.hpp"
 
+#include <exception>
+
 #include "structures/rank_pairing_heap.hpp"
 
 #include "algorithms/extract_connecting_graph.hpp"
@@ -3983,97 +3985,190 @@ namespace vg {
         }
     }
     
+    const size_t MultipathAlignmentGraph::parallel_block_size = 64;
+    
+    vector<uint64_t> MultipathAlignmentGraph::transitive_closure(const vector<size_t>& topological_order) const {
+        
+        size_t num_words = (path_nodes.size() + 63) / 64;
+        vector<uint64_t> reachable(path_nodes.size() * num_words, 0);
+        
+        // group the nodes by their height above the sinks, so that each group depends only on the
+        // groups before it
+        vector<size_t> height(path_nodes.size(), 0);
+        size_t max_height = 0;
+        for (auto iter = topological_order.rbegin(); iter != topological_order.rend(); ++iter) {
+            for (const pair<size_t, size_t>& edge : path_nodes[*iter].edges) {
+                height[*iter] = max(height[*iter], height[edge.first] + 1);
+            }
+            max_height = max(max_height, height[*iter]);
+        }
+        vector<vector<size_t>> levels(max_height + 1);
+        for (size_t i = 0; i < path_nodes.size(); ++i) {
+            levels[height[i]].push_back(i);
+        }
+        
+        bool parallel = min_nodes_for_parallel_passes != 0 && path_nodes.size() >= min_nodes_for_parallel_passes;
+        for (size_t h = 0; h < levels.size(); ++h) {
+            for (size_t block_begin = 0; block_begin < levels[h].size(); block_begin += parallel_block_size) {
+                #pragma omp task firstprivate(h, block_begin) shared(levels, reachable) if(parallel && levels[h].size() > parallel_block_size)
+                {
+                    size_t block_end = min(block_begin + parallel_block_size, levels[h].size());
+                    for (size_t k = block_begin; k < block_end; ++k) {
+                        size_t i = levels[h][k];
+                        uint64_t* reachable_from_here = reachable.data() + i * num_words;
+                        for (const pair<size_t, size_t>& edge : path_nodes[i].edges) {
+                            reachable_from_here[edge.first / 64] |= uint64_t(1) << (edge.first % 64);
+                            const uint64_t* reachable_from_next = reachable.data() + edge.first * num_words;
+                            for (size_t w = 0; w < num_words; ++w) {
+                                reachable_from_here[w] |= reachable_from_next[w];
+                            }
+                        }
+                    }
+                }
+            }
+            #pragma omp taskwait
+        }
+        
+        return reachable;
+    }
+    
     void MultipathAlignmentGraph::remove_transitive_edges(const vector<size_t>& topological_order) {
         // We can only remove edges when the edges are present
         assert(has_reachability_edges);
         
+        // if there is only one edge out of a node, that edge can never be transitive
+        // (this optimization covers most cases)
+        bool any_ambiguous = false;
+        for (const auto& path_node : path_nodes) {
+            if (path_node.edges.size() > 1) {
+                any_ambiguous = true;
+                break;
+            }
+        }
+        if (!any_ambiguous) {
+            return;
+        }
+        
+        // algorithm assumes edges are also sorted in topological order, which guarantees that we will
+        // traverse a path that reveals an edge as transitive before actually traversing the transitive edge
+        reorder_adjacency_lists(topological_order);
+        
         // records of (incoming index, length of edge) indicating the index of the nearest node
         // that an edge of exactly the expected length to this node, which is a strong sign
         // that the edge is a correct connection that we want to keep
-        vector<pair<size_t, size_t>> shortest_exact_src;
+        vector<pair<size_t, size_t>> shortest_exact_src(path_nodes.size(), make_pair(numeric_limits<size_t>::max(),
+                                                                                     numeric_limits<size_t>::max()));
+        for (size_t i = 0; i < path_nodes.size(); ++i) {
+            auto& path_node = path_nodes[i];
+            for (auto& edge : path_node.edges) {
+                if (edge.second == (path_nodes[edge.first].begin - path_node.end)) {
+                    auto& rec = shortest_exact_src[edge.first];
+                    if (edge.second < rec.second) {
+                        // this is the shortest exact edge we've seen to this node
+                        rec = make_pair(i, edge.second);
+                    }
+                }
+            }
+        }
         
-        for (size_t i : topological_order) {
-            vector<pair<size_t, size_t>>& edges = path_nodes[i].edges;
-            
-            // if there is only one edge out of a node, that edge can never be transitive
-            // (this optimization covers most cases)
-            if (edges.size() <= 1) {
-                continue;
+        // is an edge that reaches a node we could already reach from an earlier edge safe from removal?
+        auto is_removable = [&](size_t i, const pair<size_t, size_t>& edge) {
+            // it is if the path nodes abut on either the read or graph, or if it's the shortest edge with exact
+            // distance, since it is probably correct even if it is transitive (which sometimes happens across
+            // incorrect splice junctions or deletions)
+            return (edge.second != 0 && path_nodes[i].end != path_nodes[edge.first].begin
+                    && i != shortest_exact_src[edge.first].first);
+        };
+        
+        // remove the edges we flagged, keeping the others in order
+        auto remove_edges = [&](vector<pair<size_t, size_t>>& edges, const vector<bool>& keep) {
+            size_t next_idx = 0;
+            for (size_t j = 0; j < edges.size(); j++) {
+                if (keep[j]) {
+                    edges[next_idx++] = edges[j];
+                }
             }
-            
-            // we don't do these linear pre-compute steps unless there is actual ambiguity in the MEMs
-            // in order to save compute in the typical case that there is none
-            // TODO: not very readable
-            if (shortest_exact_src.empty()) {
-                
-                // algorithm assumes edges are also sorted in topological order, which guarantees that we will
-                // traverse a path that reveals an edge as transitive before actually traversing the transitive edge
-                reorder_adjacency_lists(topological_order);
-                
-                // compute the shortest incoming edge that achieves exactly the expected distance for each node
-                shortest_exact_src.resize(path_nodes.size(), make_pair(numeric_limits<size_t>::max(),
-                                                                       numeric_limits<size_t>::max()));
-                
-                for (size_t i = 0; i < path_nodes.size(); ++i) {
-                    auto& path_node = path_nodes[i];
-                    for (auto& edge : path_node.edges) {
-                        if (edge.second == (path_nodes[edge.first].begin - path_node.end)) {
-                            auto& rec = shortest_exact_src[edge.first];
-                            if (edge.second < rec.second) {
-                                // this is the shortest exact edge we've seen to this node
-                                rec = make_pair(i, edge.second);
+            edges.resize(next_idx);
+        };
+        
+        size_t num_words = (path_nodes.size() + 63) / 64;
+        if (path_nodes.size() * num_words <= max_transitive_closure_words) {
+            // the transitive closure fits in our budget, so we pack it into bitsets instead of searching
+            // from every edge
+            vector<uint64_t> reachable = transitive_closure(topological_order);
+            
+            // since removing transitive edges doesn't change reachability, every node can be done independently
+            bool parallel = min_nodes_for_parallel_passes != 0 && path_nodes.size() >= min_nodes_for_parallel_passes;
+            for (size_t block_begin = 0; block_begin < path_nodes.size(); block_begin += parallel_block_size) {
+                #pragma omp task firstprivate(block_begin) shared(reachable, remove_edges, is_removable) if(parallel)
+                {
+                    vector<uint64_t> traversed(num_words);
+                    vector<bool> keep;
+                    for (size_t i = block_begin; i < min(block_begin + parallel_block_size, path_nodes.size()); ++i) {
+                        auto& edges = path_nodes[i].edges;
+                        if (edges.size() <= 1) {
+                            continue;
+                        }
+                        
+                        std::fill(traversed.begin(), traversed.end(), 0);
+                        keep.assign(edges.size(), true);
+                        for (size_t j = 0; j < edges.size(); ++j) {
+                            size_t target = edges[j].first;
+                            if (traversed[target / 64] & (uint64_t(1) << (target % 64))) {
+                                // we can reach the target of this edge by another path, so it is transitive
+                                keep[j] = !is_removable(i, edges[j]);
+                                continue;
+                            }
+                            // mark everything reachable through this edge
+                            traversed[target / 64] |= uint64_t(1) << (target % 64);
+                            const uint64_t* reachable_from_target = reachable.data() + target * num_words;
+                            for (size_t w = 0; w < num_words; ++w) {
+                                traversed[w] |= reachable_from_target[w];
                             }
                         }
+                        remove_edges(edges, keep);
                     }
                 }
             }
-            
-            vector<bool> keep(edges.size(), true);
-            unordered_set<size_t> traversed;
-            
-            for (size_t j = 0; j < edges.size(); j++) {
-                const pair<size_t, size_t>& edge = edges[j];
-                if (traversed.count(edge.first) && edge.second != 0 &&
-                    path_nodes[i].end != path_nodes[edge.first].begin) {
-                    // we can reach the target of this edge by another path, so it is transitive
-                    // and the path nodes don't abut on either the read or graph
-                    
-                    // we also spare the shortest edge with exact distance from being removed, since
-                    // it is probably correct even if it is transitive (which sometimes happens across
-                    // incorrect splice junctions or deletions)
-                    if (i != shortest_exact_src[edge.first].first) {
-                        keep[j] = false;
-                    }
+            #pragma omp taskwait
+        }
+        else {
+            // the closure would be too large, search forward from each edge instead
+            for (size_t i : topological_order) {
+                vector<pair<size_t, size_t>>& edges = path_nodes[i].edges;
+                
+                if (edges.size() <= 1) {
                     continue;
                 }
                 
-                // DFS to mark all reachable nodes from this edge
-                vector<size_t> stack{edge.first};
-                traversed.insert(edge.first);
-                while (!stack.empty()) {
-                    size_t idx = stack.back();
-                    stack.pop_back();
-                    for (const pair<size_t, size_t>& edge_from : path_nodes.at(idx).edges) {
-                        if (!traversed.count(edge_from.first)) {
-                            stack.push_back(edge_from.first);
-                            traversed.insert(edge_from.first);
+                vector<bool> keep(edges.size(), true);
+                unordered_set<size_t> traversed;
+                
+                for (size_t j = 0; j < edges.size(); j++) {
+                    const pair<size_t, size_t>& edge = edges[j];
+                    if (traversed.count(edge.first)) {
+                        // we can reach the target of this edge by another path, so it is transitive
+                        keep[j] = !is_removable(i, edge);
+                        continue;
+                    }
+                    
+                    // DFS to mark all reachable nodes from this edge
+                    vector<size_t> stack{edge.first};
+                    traversed.insert(edge.first);
+                    while (!stack.empty()) {
+                        size_t idx = stack.back();
+                        stack.pop_back();
+                        for (const pair<size_t, size_t>& edge_from : path_nodes.at(idx).edges) {
+                            if (!traversed.count(edge_from.first)) {
+                                stack.push_back(edge_from.first);
+                                traversed.insert(edge_from.first);
+                            }
                         }
                     }
                 }
+                
+                remove_edges(edges, keep);
             }
-            
-            // remove the transitive edges we found
-            size_t next_idx = 0;
-            for (size_t j = 0; j < edges.size(); j++) {
-                if (keep[j] && j != next_idx) {
-                    edges[next_idx] = edges[j];
-                    next_idx++;
-                }
-                else if (keep[j]) {
-                    next_idx++;
-                }
-            }
-            edges.resize(next_idx);
         }
         
         
@@ -4107,44 +4202,54 @@ namespace vg {
             return;
         }
         
-        unordered_map<pair<size_t, size_t>, int32_t> edge_weights;
+        // the weights of each node's edges, in the same order as its edges
+        vector<vector<int32_t>> edge_weights(path_nodes.size());
         
         vector<int32_t> node_weights(path_nodes.size());
-                
+        
         // compute the weight of edges and node matches
-        for (size_t i = 0; i < path_nodes.size(); i++) {
-            PathNode& from_node = path_nodes.at(i);
-            node_weights[i] = (aligner->score_exact_match(from_node.begin, from_node.end,
-                                                          alignment.quality().begin() + (from_node.begin - alignment.sequence().begin()))
-                               + (from_node.begin == alignment.sequence().begin() ? aligner->score_full_length_bonus(true, alignment) : 0)
-                               + (from_node.end == alignment.sequence().end() ? aligner->score_full_length_bonus(false, alignment) : 0));
+        bool parallel = min_nodes_for_parallel_passes != 0 && path_nodes.size() >= min_nodes_for_parallel_passes;
+        for (size_t block_begin = 0; block_begin < path_nodes.size(); block_begin += parallel_block_size) {
+            #pragma omp task firstprivate(block_begin) shared(alignment, aligner, edge_weights, node_weights) if(parallel)
+            {
+                for (size_t i = block_begin; i < min(block_begin + parallel_block_size, path_nodes.size()); i++) {
+                    PathNode& from_node = path_nodes.at(i);
+                    node_weights[i] = (aligner->score_exact_match(from_node.begin, from_node.end,
+                                                                  alignment.quality().begin() + (from_node.begin - alignment.sequence().begin()))
+                                       + (from_node.begin == alignment.sequence().begin() ? aligner->score_full_length_bonus(true, alignment) : 0)
+                                       + (from_node.end == alignment.sequence().end() ? aligner->score_full_length_bonus(false, alignment) : 0));
+                    
+                    auto& weights = edge_weights[i];
+                    weights.reserve(from_node.edges.size());
+                    for (const pair<size_t, size_t>& edge : from_node.edges) {
+                        PathNode& to_node = path_nodes.at(edge.first);
                         
-            for (const pair<size_t, size_t>& edge : from_node.edges) {
-                PathNode& to_node = path_nodes.at(edge.first);
-                
-                int64_t graph_dist = edge.second;
-                int64_t read_dist = to_node.begin - from_node.end;
-                
-                if (read_dist > graph_dist) {
-                    // the read length in between the MEMs is longer than the distance, suggesting a read insert
-                    // and potentially another mismatch on the other end
-                    int64_t gap_length = read_dist - graph_dist;
-                    edge_weights[make_pair(i, edge.first)] = (-(gap_length - 1) * aligner->gap_extension - aligner->gap_open
-                                                              - (graph_dist > 0) * aligner->mismatch);
-                }
-                else if (read_dist < graph_dist) {
-                    // the read length in between the MEMs is shorter than the distance, suggesting a read deletion
-                    // and potentially another mismatch on the other end
-                    int64_t gap_length = graph_dist - read_dist;
-                    edge_weights[make_pair(i, edge.first)] = (-(gap_length - 1) * aligner->gap_extension - aligner->gap_open
-                                                              - (read_dist > 0) * aligner->mismatch);
-                }
-                else {
-                    // the read length in between the MEMs is the same as the distance, suggesting a pure mismatch
-                    edge_weights[make_pair(i, edge.first)] = -((graph_dist > 0) + (graph_dist > 1)) * aligner->mismatch;
+                        int64_t graph_dist = edge.second;
+                        int64_t read_dist = to_node.begin - from_node.end;
+                        
+                        if (read_dist > graph_dist) {
+                            // the read length in between the MEMs is longer than the distance, suggesting a read insert
+                            // and potentially another mismatch on the other end
+                            int64_t gap_length = read_dist - graph_dist;
+                            weights.push_back(-(gap_length - 1) * aligner->gap_extension - aligner->gap_open
+                                              - (graph_dist > 0) * aligner->mismatch);
+                        }
+                        else if (read_dist < graph_dist) {
+                            // the read length in between the MEMs is shorter than the distance, suggesting a read deletion
+                            // and potentially another mismatch on the other end
+                            int64_t gap_length = graph_dist - read_dist;
+                            weights.push_back(-(gap_length - 1) * aligner->gap_extension - aligner->gap_open
+                                              - (read_dist > 0) * aligner->mismatch);
+                        }
+                        else {
+                            // the read length in between the MEMs is the same as the distance, suggesting a pure mismatch
+                            weights.push_back(-((graph_dist > 0) + (graph_dist > 1)) * aligner->mismatch);
+                        }
+                    }
                 }
             }
         }
+        #pragma omp taskwait
         
         vector<int32_t> forward_scores = node_weights;
         vector<int32_t> backward_scores = node_weights;
@@ -4153,9 +4258,10 @@ namespace vg {
         for (int64_t i = 0; i < topological_order.size(); i++) {
             size_t idx = topological_order[i];
             int32_t from_score = forward_scores[idx];
-            for (const pair<size_t, size_t>& edge : path_nodes.at(idx).edges) {
-                forward_scores[edge.first] = std::max(forward_scores[edge.first],
-                                                      node_weights[edge.first] + from_score + edge_weights[make_pair(idx, edge.first)]);
+            const auto& edges = path_nodes.at(idx).edges;
+            for (size_t j = 0; j < edges.size(); ++j) {
+                forward_scores[edges[j].first] = std::max(forward_scores[edges[j].first],
+                                                          node_weights[edges[j].first] + from_score + edge_weights[idx][j]);
             }
         }
         
@@ -4163,9 +4269,10 @@ namespace vg {
         for (int64_t i = topological_order.size() - 1; i >= 0; i--) {
             size_t idx = topological_order[i];
             int32_t score_here = node_weights[idx];
-            for (const pair<size_t, size_t>& edge : path_nodes.at(idx).edges) {
+            const auto& edges = path_nodes.at(idx).edges;
+            for (size_t j = 0; j < edges.size(); ++j) {
                 backward_scores[idx] = std::max(backward_scores[idx],
-                                                score_here + backward_scores[edge.first] + edge_weights[make_pair(idx, edge.first)]);
+                                                score_here + backward_scores[edges[j].first] + edge_weights[idx][j]);
             }
         }
         
@@ -4189,7 +4296,7 @@ namespace vg {
                 size_t edges_removed = 0;
                 for (size_t j = 0; j < path_node.edges.size(); ++j) {
                     auto& edge = path_node.edges[j];
-                    if (forward_scores[i] + backward_scores[edge.first] + edge_weights[make_pair(i, edge.first)] < min_path_score) {
+                    if (forward_scores[i] + backward_scores[edge.first] + edge_weights[i][j] < min_path_score) {
                         ++edges_removed;
                     }
                     else {
@@ -5243,132 +5350,164 @@ void MultipathAlignmentGraph::align(const Alignment& alignment, const HandleGrap
         };
         
         
-#ifdef debug_multipath_alignment
-        cerr << "doing DP between MEMs" << endl;
-#endif
-        
         // perform alignment in the intervening sections
-        for (int64_t j = 0; j < path_nodes.size(); j++) {
-#ifdef debug_multipath_alignment
-            cerr << "checking for intervening alignments from match node " << j << " with path " << debug_string(path_nodes.at(j).path) << " and sequence ";
-            for (auto iter = path_nodes.at(j).begin; iter != path_nodes.at(j).end; iter++) {
-                cerr << *iter;
+        
+        // the results of aligning across one edge
+        struct EdgeAlignment {
+            // could we not get an alignment across the edge?
+            bool remove = false;
+            // translation from the connecting graph to the align graph
+            unordered_map<id_t, id_t> connect_trans;
+            // the deduplicated alignments across the edge
+            vector<pair<path_t, int32_t>> deduplicated;
+        };
+        
+        // the alignments for each edge, in the same order as the edges
+        vector<vector<EdgeAlignment>> edge_alignments(path_nodes.size());
+        vector<pair<size_t, size_t>> edge_jobs;
+        for (size_t j = 0; j < path_nodes.size(); j++) {
+            edge_alignments[j].resize(path_nodes[j].edges.size());
+            for (size_t k = 0; k < path_nodes[j].edges.size(); ++k) {
+                edge_jobs.emplace_back(j, k);
             }
-            cerr << endl;
-#endif
-            
-            PathNode& src_path_node = path_nodes.at(j);
-            subpath_t* src_subpath = multipath_aln_out.mutable_subpath(j);
-            
-            const path_t& path = src_subpath->path();
+        }
+        
+        // find the position immediately after the end of a path node
+        auto final_position = [&](size_t j) {
+            const path_t& path = path_nodes[j].path;
             const path_mapping_t& final_mapping = path.mapping(path.mapping_size() - 1);
             const position_t& final_mapping_position = final_mapping.position();
-            // make a pos_t that points to the final base in the match
-            pos_t src_pos = make_pos_t(final_mapping_position.node_id(),
-                                       final_mapping_position.is_reverse(),
-                                       final_mapping_position.offset() + mapping_from_length(final_mapping));
-            
-            // the longest gap that could be detected at this position in the read
-            size_t src_max_gap = aligner->longest_detectable_gap(alignment, src_path_node.end);
+            return make_pos_t(final_mapping_position.node_id(),
+                              final_mapping_position.is_reverse(),
+                              final_mapping_position.offset() + mapping_from_length(final_mapping));
+        };
+        
+        // align across one edge, which only reads from the graph, so the edges can be done in any order
+        auto align_edge = [&](size_t j, size_t k) {
             
-            // This holds edges that we remove, because we couldn't actually get an alignment across them with a positive score.
-            unordered_set<pair<size_t, size_t>> edges_for_removal;
+            PathNode& src_path_node = path_nodes[j];
+            const pair<size_t, size_t>& edge = src_path_node.edges[k];
+            PathNode& dest_path_node = path_nodes[edge.first];
+            EdgeAlignment& result = edge_alignments[j][k];
             
-            for (const pair<size_t, size_t>& edge : src_path_node.edges) {
-                PathNode& dest_path_node = path_nodes.at(edge.first);
-                pos_t dest_pos = make_pos_t(multipath_aln_out.subpath(edge.first).path().mapping(0).position());
-                
 #ifdef debug_multipath_alignment
-                cerr << "forming intervening alignment for edge to node " << edge.first << endl;
+            #pragma omp critical (cerr)
+            cerr << "forming intervening alignment for edge from node " << j << " to node " << edge.first << endl;
 #endif
-                
-                size_t intervening_length = dest_path_node.begin - src_path_node.end;
-
-                // if negative score is allowed set maximum distance to the length between path nodes
-                // otherwise set it to the maximum gap length possible while retaining a positive score 
-                size_t max_dist = allow_negative_scores ?
-                    edge.second :
-                    intervening_length + min(min(src_max_gap, aligner->longest_detectable_gap(alignment, dest_path_node.begin)), max_gap);
-                
-#ifdef debug_multipath_alignment
-                cerr << "read dist: " << intervening_length << ", graph dist " << edge.second << " source max gap: " << src_max_gap << ", dest max gap " << aligner->longest_detectable_gap(alignment, dest_path_node.begin) << ", max allowed gap " << max_gap << endl;
-#endif
-                
-                // extract the graph between the matches
-                bdsg::HashGraph connecting_graph;
-                auto connect_trans = algorithms::extract_connecting_graph(&align_graph,      // DAG with split strands
-                                                                          &connecting_graph, // graph to extract into
-                                                                          max_dist,          // longest distance necessary
-                                                                          src_pos,           // end of earlier match
-                                                                          dest_pos,          // beginning of later match
-                                                                          false);            // do not enforce max distance strictly
-                                
-                if (connecting_graph.get_node_count() == 0) {
-                    // the MEMs weren't connectable with a positive score after all, mark the edge for removal
+            
+            // make a pos_t that points to the final base in the match
+            pos_t src_pos = final_position(j);
+            pos_t dest_pos = make_pos_t(dest_path_node.path.mapping(0).position());
+            
+            size_t intervening_length = dest_path_node.begin - src_path_node.end;
+            
+            // if negative score is allowed set maximum distance to the length between path nodes
+            // otherwise set it to the maximum gap length possible while retaining a positive score
+            size_t max_dist = allow_negative_scores ?
+                edge.second :
+                intervening_length + min(min(aligner->longest_detectable_gap(alignment, src_path_node.end),
+                                             aligner->longest_detectable_gap(alignment, dest_path_node.begin)), max_gap);
+            
+            // extract the graph between the matches
+            bdsg::HashGraph connecting_graph;
+            result.connect_trans = algorithms::extract_connecting_graph(&align_graph,      // DAG with split strands
+                                                                        &connecting_graph, // graph to extract into
+                                                                        max_dist,          // longest distance necessary
+                                                                        src_pos,           // end of earlier match
+                                                                        dest_pos,          // beginning of later match
+                                                                        false);            // do not enforce max distance strictly
+            
+            if (connecting_graph.get_node_count() == 0) {
+                // the MEMs weren't connectable with a positive score after all, mark the edge for removal
 #ifdef debug_multipath_alignment
-                    cerr << "Remove edge " << j << " -> " << edge.first << " because we got no nodes in the connecting graph "
-                        << src_pos << " to " << dest_pos << endl;
+                #pragma omp critical (cerr)
+                cerr << "Remove edge " << j << " -> " << edge.first << " because we got no nodes in the connecting graph "
+                    << src_pos << " to " << dest_pos << endl;
 #endif
-                    edges_for_removal.insert(edge);
-                    continue;
-                }
-                
-                size_t num_alt_alns = dynamic_alt_alns ? min(max_alt_alns, handlealgs::count_walks(&connecting_graph)) :
-                                                         max_alt_alns;
-                
-                
-                // transfer the substring between the matches to a new alignment
-                Alignment intervening_sequence;
-                intervening_sequence.set_sequence(alignment.sequence().substr(src_path_node.end - alignment.sequence().begin(),
-                                                                              dest_path_node.begin - src_path_node.end));
-                if (!alignment.quality().empty()) {
-                    intervening_sequence.set_quality(alignment.quality().substr(src_path_node.end - alignment.sequence().begin(),
-                                                                                dest_path_node.begin - src_path_node.end));
-                }
+                result.remove = true;
+                return;
+            }
+            
+            size_t num_alt_alns = dynamic_alt_alns ? min(max_alt_alns, handlealgs::count_walks(&connecting_graph)) :
+                                                     max_alt_alns;
+            
+            // transfer the substring between the matches to a new alignment
+            Alignment intervening_sequence;
+            intervening_sequence.set_sequence(alignment.sequence().substr(src_path_node.end - alignment.sequence().begin(),
+                                                                          dest_path_node.begin - src_path_node.end));
+            if (!alignment.quality().empty()) {
+                intervening_sequence.set_quality(alignment.quality().substr(src_path_node.end - alignment.sequence().begin(),
+                                                                            dest_path_node.begin - src_path_node.end));
+            }
+            
+            // if we're doing dynamic alt alignments, possibly expand the number of tracebacks until we get an
+            // alignment to every path or hit the hard max
+            if (num_alt_alns > 0) {
                 
-                // if we're doing dynamic alt alignments, possibly expand the number of tracebacks until we get an
-                // alignment to every path or hit the hard max
-                vector<pair<path_t, int32_t>> deduplicated;
-                if (num_alt_alns > 0) {
+                size_t num_alns_iter = num_alt_alns;
+                while (result.deduplicated.size() < num_alt_alns) {
                     
-                    size_t num_alns_iter = num_alt_alns;
-                    while (deduplicated.size() < num_alt_alns) {
-                        
-                        intervening_sequence.clear_path();
-                        
+                    intervening_sequence.clear_path();
+                    
+                    vector<Alignment> alt_alignments;
+                    aligner->align_global_banded_multi(intervening_sequence, alt_alignments, connecting_graph, num_alns_iter,
+                                                       band_padding_function(intervening_sequence, connecting_graph), true);
+                    
+                    // remove alignments with the same path
+                    result.deduplicated = convert_and_deduplicate(alt_alignments, false, false);
+                    
+                    if (num_alns_iter >= max_alt_alns || !dynamic_alt_alns) {
+                        // we don't want to try again even if we didn't find every path yet
+                        break;
+                    }
+                    else {
+                        // if we didn't find every path, we'll try again with this many tracebacks
+                        num_alns_iter = min(max_alt_alns, num_alns_iter * 2);
+                    }
+                }
+            }
+        };
+        
 #ifdef debug_multipath_alignment
-                        cerr << "making " << num_alns_iter << " alignments of sequence " << intervening_sequence.sequence() << " to connecting graph" << endl;
-                        connecting_graph.for_each_handle([&](const handle_t& handle) {
-                            cerr << connecting_graph.get_id(handle) << " " << connecting_graph.get_sequence(handle) << endl;
-                            connecting_graph.follow_edges(handle, true, [&](const handle_t& prev) {
-                                cerr << "\t" << connecting_graph.get_id(prev) << " <-" << endl;
-                            });
-                            connecting_graph.follow_edges(handle, false, [&](const handle_t& next) {
-                                cerr << "\t-> " << connecting_graph.get_id(next) << endl;
-                            });
-                        });
+        cerr << "doing DP between MEMs across " << edge_jobs.size() << " edges" << endl;
 #endif
-                        
-                        vector<Alignment> alt_alignments;
-                        aligner->align_global_banded_multi(intervening_sequence, alt_alignments, connecting_graph, num_alns_iter,
-                                                           band_padding_function(intervening_sequence, connecting_graph), true);
-                        
-                        // remove alignments with the same path
-                        deduplicated = convert_and_deduplicate(alt_alignments, false, false);
-                        
-                        if (num_alns_iter >= max_alt_alns || !dynamic_alt_alns) {
-                            // we don't want to try again even if we didn't find every path yet
-                            break;
-                        }
-                        else {
-                            // if we didn't find every path, we'll try again with this many tracebacks
-                            num_alns_iter = min(max_alt_alns, num_alns_iter * 2);
-                        }
+        
+        // do the alignments, possibly letting other threads pick up blocks of them
+        bool parallel = min_nodes_for_parallel_passes != 0 && path_nodes.size() >= min_nodes_for_parallel_passes;
+        // exceptions can't leave a task, so we carry them out ourselves
+        vector<std::exception_ptr> edge_exceptions((edge_jobs.size() + parallel_block_size - 1) / parallel_block_size);
+        for (size_t block_begin = 0; block_begin < edge_jobs.size(); block_begin += parallel_block_size) {
+            #pragma omp task firstprivate(block_begin) shared(edge_jobs, edge_exceptions, align_edge) if(parallel)
+            {
+                try {
+                    for (size_t b = block_begin; b < min(block_begin + parallel_block_size, edge_jobs.size()); ++b) {
+                        align_edge(edge_jobs[b].first, edge_jobs[b].second);
                     }
+                } catch (...) {
+                    edge_exceptions[block_begin / parallel_block_size] = std::current_exception();
                 }
+            }
+        }
+        #pragma omp taskwait
+        for (auto& exception : edge_exceptions) {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+        
+        // add the alignments to the multipath alignment in the same order as we would have made them
+        for (int64_t j = 0; j < path_nodes.size(); j++) {
+            
+            PathNode& src_path_node = path_nodes.at(j);
+            subpath_t* src_subpath = multipath_aln_out.mutable_subpath(j);
+            pos_t src_pos = final_position(j);
+            
+            for (size_t k = 0; k < src_path_node.edges.size(); ++k) {
+                const pair<size_t, size_t>& edge = src_path_node.edges[k];
+                EdgeAlignment& edge_alignment = edge_alignments[j][k];
                 
                 bool added_direct_connection = false;
-                for (auto& connecting_alignment : deduplicated) {
+                for (auto& connecting_alignment : edge_alignment.deduplicated) {
 #ifdef debug_multipath_alignment
                     cerr << "translating connecting alignment: " << debug_string(connecting_alignment.first) << ", score " << connecting_alignment.second << endl;
 #endif
@@ -5414,9 +5553,9 @@ void MultipathAlignmentGraph::align(const Alignment& alignment, const HandleGrap
                     
                     // translate the path into the space of the main graph unless the path is null
                     if (connecting_subpath->path().mapping_size() != 0) {
-                        translate_node_ids(*connecting_subpath->mutable_path(), connect_trans);
+                        translate_node_ids(*connecting_subpath->mutable_path(), edge_alignment.connect_trans);
                         path_mapping_t* first_subpath_mapping = connecting_subpath->mutable_path()->mutable_mapping(0);
-                        if (first_subpath_mapping->position().node_id() == final_mapping.position().node_id()) {
+                        if (first_subpath_mapping->position().node_id() == id(src_pos)) {
                             first_subpath_mapping->mutable_position()->set_offset(offset(src_pos));
                         }
                     }
@@ -5428,13 +5567,14 @@ void MultipathAlignmentGraph::align(const Alignment& alignment, const HandleGrap
                 }
             }
             
-            if (!edges_for_removal.empty()) {
-                auto new_end = std::remove_if(src_path_node.edges.begin(), src_path_node.edges.end(),
-                                              [&](const pair<size_t, size_t>& edge) {
-                                                  return edges_for_removal.count(edge);
-                                              });
-                src_path_node.edges.resize(new_end - src_path_node.edges.begin());
+            // remove the edges we couldn't get an alignment across
+            size_t next_idx = 0;
+            for (size_t k = 0; k < src_path_node.edges.size(); ++k) {
+                if (!edge_alignments[j][k].remove) {
+                    src_path_node.edges[next_idx++] = src_path_node.edges[k];
+                }
             }
+            src_path_node.edges.resize(next_idx);
         }
         
         
@@ -235,6 +235,12 @@ namespace vg {
         
         void prune_high_shift_edges(size_t prune_diff, bool prohibit_new_sources, bool prohibit_new_sinks);
         
+        /// If the graph has at least this many path nodes, transitive edge
+        /// removal, pruning, and the alignments across edges in align() are
+        /// split into OpenMP tasks that idle threads can pick up. 0 disables
+        /// this.
+        size_t min_nodes_for_parallel_passes = 0;
+        
     protected:
         
         /// Nodes representing walked MEMs in the graph
@@ -361,6 +367,18 @@ namespace vg {
         
         /// The largest size we will memoize up to
         static const size_t tail_gap_memo_max_size;
+        
+        /// Compute the nodes reachable from each node (not including itself) as
+        /// bitsets, packed one after another in node order. Nodes at the same
+        /// height above the sinks are done together, in parallel if enabled.
+        vector<uint64_t> transitive_closure(const vector<size_t>& topological_order) const;
+        
+        /// The largest transitive closure, in 64-bit words, we will build rather
+        /// than searching the graph
+        size_t max_transitive_closure_words = 1 << 22;
+        
+        /// The number of path nodes or edges handled by each task in the parallel passes
+        static const size_t parallel_block_size;
     };
 }
 
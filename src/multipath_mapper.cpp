@@ -328,8 +328,16 @@ namespace vg {
             clusterer = unique_ptr<MEMClusterer>(new ComponentMinDistanceClusterer(distance_index));
         }
         else if (!no_clustering && !use_min_dist_clusterer && !use_tvs_clusterer) {
-            clusterer = unique_ptr<MEMClusterer>(new OrientedDistanceClusterer(*distance_measurer,
-                                                                               max_expected_dist_approx_error));
+            auto path_distance_measurer = dynamic_cast<PathOrientedDistanceMeasurer*>(distance_measurer);
+            if (use_windowed_clusterer && path_distance_measurer) {
+                clusterer = unique_ptr<MEMClusterer>(new WindowedPathClusterer(*path_distance_measurer,
+                                                                               max_expected_dist_approx_error,
+                                                                               max_cluster_edges_per_hit));
+            }
+            else {
+                clusterer = unique_ptr<MEMClusterer>(new OrientedDistanceClusterer(*distance_measurer,
+                                                                                   max_expected_dist_approx_error));
+            }
         }
         else if (no_clustering) {
             clusterer = unique_ptr<MEMClusterer>(new NullClusterer());
@@ -2644,7 +2652,8 @@ namespace vg {
                                       *get_aligner(!opt.quality().empty()));
         
         splice_regions.emplace_back(new SpliceRegion(get<0>(anchor_pos), searching_left, 2 * max_splice_overhang,
-                                                     *xindex, dinuc_machine, splice_stats));
+                                                     *xindex, dinuc_machine, splice_stats,
+                                                     splice_junction_index));
         
         anchor_prejoin_sides.emplace_back();
         anchor_prejoin_sides.front().candidate_idx = -1;
@@ -2692,7 +2701,8 @@ namespace vg {
                                              *get_aligner(!opt.quality().empty()));
             
             splice_regions.emplace_back(new SpliceRegion(get<0>(candidate_pos), !searching_left, 2 * max_splice_overhang,
-                                                         *xindex, dinuc_machine, splice_stats));
+                                                         *xindex, dinuc_machine, splice_stats,
+                                                         splice_junction_index));
             
             candidate_prejoin_sides.emplace_back();
             auto& candidate_side = candidate_prejoin_sides.back();
@@ -2865,8 +2875,16 @@ namespace vg {
                             continue;
                         }
                         
-                        // measure the intron length
-                        int64_t dist = get_reference_dist(l_pos, r_pos);
+                        // measure the intron length, which we already know for annotated junctions
+                        int64_t dist = -1;
+                        if (splice_junction_index && offset(r_pos) == 0 &&
+                            offset(l_pos) == xindex->get_length(l_under)) {
+                            dist = splice_junction_index->intron_length(id(l_pos), is_rev(l_pos),
+                                                                        id(r_pos), is_rev(r_pos));
+                        }
+                        if (dist < 0) {
+                            dist = get_reference_dist(l_pos, r_pos);
+                        }
                         if (dist <= 0 || dist > max_intron_length || dist == numeric_limits<int64_t>::max()) {
 #ifdef debug_multipath_mapper
                             cerr << "\tinconsistent intron length " << dist << ", skipping putative join" << endl;
@@ -6164,6 +6182,7 @@ namespace vg {
             vector<size_t> hit_provenance;
             MultipathAlignmentGraph multi_aln_graph(*align_dag, graph_mems, translator, hit_provenance,
                                                     max_branch_trim_length, gcsa, fanouts);
+            multi_aln_graph.min_nodes_for_parallel_passes = min_nodes_for_parallel_alignment;
             
             {
                 // Compute a topological order over the graph
@@ -125,6 +125,7 @@ namespace vg {
         double mem_coverage_min_ratio = 0.5;
         double truncation_multiplicity_mq_limit = 7.0;
         double max_suboptimal_path_score_ratio = 2.0;
+        size_t min_nodes_for_parallel_alignment = 0;
         size_t num_mapping_attempts = 48;
         double log_likelihood_approx_factor = 1.0;
         size_t min_clustering_mem_length = 0;
@@ -184,6 +185,9 @@ namespace vg {
         double prune_subpaths_multiplier = 2.0;
         bool use_tvs_clusterer = false;
         bool use_min_dist_clusterer = false;
+        // place hits on path coordinates and only connect them within a window (requires path distances)
+        bool use_windowed_clusterer = false;
+        size_t max_cluster_edges_per_hit = 64;
         bool greedy_min_dist = false;
         bool component_min_dist = false;
         bool no_clustering = false;
@@ -203,6 +207,8 @@ namespace vg {
         // the maximum number of pairs of each motif that we will consider during spliced alignment
         size_t max_motif_pairs = 1024;
         unordered_set<path_handle_t> ref_path_handles;
+        // annotated splice junctions to consult before searching for splice motifs
+        const SpliceJunctionIndex* splice_junction_index = nullptr;
         
         //static size_t PRUNE_COUNTER;
         //static size_t SUBGRAPH_TOTAL;
@@ -1,5 +1,10 @@
 #include "readfilter.hpp"
 
+#include <vg/io/stream.hpp>
+#include <vg/io/stream_multiplexer.hpp>
+
+#include "alignment_field_scanner.hpp"
+
 namespace vg {
 
 using namespace std;
@@ -45,4 +50,379 @@ bool ReadFilter<MultipathAlignment>::is_mapped(const MultipathAlignment& mp_alig
     return false;
 }
 
+template<>
+bool ReadFilter<Alignment>::can_filter_partially() const {
+    // Pairs have to be read together, defraying and rescoring need the whole
+    // read and change it, and the rest of these need the whole Path.
+    return !interleaved && defray_length == 0 && !rescore && !sub_score &&
+        (max_overhang <= 0 || max_overhang >= numeric_limits<int>::max() / 2) &&
+        min_end_matches <= 0 && !drop_split && repeat_size == 0;
+}
+
+template<>
+void ReadFilter<Alignment>::filter_partial(istream* in) {
+    
+    // Work out which fields the filters will look at
+    vector<string> wanted {"score", "is_secondary", "mapping_quality"};
+    bool downsampling = downsample_probability != 1.0;
+    if (!name_prefixes.empty() || downsampling) {
+        wanted.push_back("name");
+    }
+    if (downsampling) {
+        wanted.push_back("fragment_prev");
+        wanted.push_back("fragment_next");
+    }
+    if (!subsequences.empty() || frac_score) {
+        wanted.push_back("sequence");
+    }
+    if (min_base_quality > 0 && min_base_quality_fraction > 0.0) {
+        wanted.push_back("quality");
+    }
+    if (only_proper_pairs || !excluded_features.empty()) {
+        wanted.push_back("annotation");
+    }
+    if (!excluded_refpos_contigs.empty()) {
+        wanted.push_back("refpos");
+    }
+    AlignmentFieldScanner scanner(wanted);
+    if (only_mapped) {
+        scanner.keep_only_path_presence();
+    }
+    
+    // We pass the reads through as opaque tagged messages.
+    vg::io::MessageIterator message_iterator(*in);
+    
+    size_t thread_count = get_thread_count();
+    vector<Counts> counts_vec(thread_count);
+    
+    // Merge the compressed output of the threads
+    unique_ptr<vg::io::StreamMultiplexer> multiplexer;
+    if (write_output) {
+        multiplexer.reset(new vg::io::StreamMultiplexer(cout, thread_count));
+    }
+    vector<unique_ptr<vg::io::MessageEmitter>> emitters(thread_count);
+    
+    // Batches should be big enough to not spin on the task machinery, and we
+    // stop to let the tasks catch up every so many batches so the whole input
+    // doesn't end up in memory.
+    size_t batch_size = 1000;
+    size_t batches_between_waits = 4 * thread_count;
+    
+    #pragma omp parallel shared(multiplexer, emitters, counts_vec, scanner)
+    {
+        #pragma omp single
+        {
+            size_t batches_launched = 0;
+            while (message_iterator.has_current()) {
+                auto* batch = new vector<vg::io::MessageIterator::TaggedMessage>();
+                batch->reserve(batch_size);
+                while (batch->size() < batch_size && message_iterator.has_current()) {
+                    batch->emplace_back(message_iterator.take());
+                    if (batch->back().first.empty()) {
+                        // This is untagged data; assume it's GAM.
+                        batch->back().first = "GAM";
+                    }
+                    if (!batch->back().second) {
+                        // This is just a tag alone; throw this away.
+                        batch->pop_back();
+                    }
+                }
+                
+                #pragma omp task firstprivate(batch)
+                {
+                    size_t thread = omp_get_thread_num();
+                    Counts& counts = counts_vec[thread];
+                    
+                    auto& emitter_ptr = emitters[thread];
+                    if (write_output && !emitter_ptr) {
+                        emitter_ptr.reset(new vg::io::MessageEmitter(multiplexer->get_thread_stream(thread), true, buffer_size));
+                    }
+                    
+                    string scratch;
+                    Alignment partial;
+                    for (auto& message : *batch) {
+                        bool keep = true;
+                        if (message.first == "GAM") {
+                            if (!scanner.parse(*message.second, partial, scratch)) {
+                                #pragma omp critical (cerr)
+                                cerr << "error[vg filter]: could not parse GAM record" << endl;
+                                exit(1);
+                            }
+                            Counts read_counts = filter_alignment(partial);
+                            counts += read_counts;
+                            keep = (read_counts.keep() != complement_filter);
+                        }
+                        // Anything that isn't a read just passes through.
+                        if (keep && write_output) {
+                            emitter_ptr->write(message.first, std::move(*message.second));
+                        }
+                    }
+                    delete batch;
+                    
+                    if (write_output && multiplexer->want_breakpoint(thread)) {
+                        // The multiplexer wants our data.
+                        emitter_ptr->flush();
+                        multiplexer->register_breakpoint(thread);
+                    }
+                }
+                
+                if (++batches_launched % batches_between_waits == 0) {
+                    // Let the filtering catch up with the reading
+                    #pragma omp taskwait
+                }
+            }
+            
+            // Wait for the final tasks.
+            #pragma omp taskwait
+        }
+    }
+    
+    if (write_output) {
+        for (size_t i = 0; i < thread_count; i++) {
+            // Flush everything tasks have written into the multiplexer
+            if (emitters[i]) {
+                emitters[i]->flush();
+                emitters[i].reset();
+                multiplexer->register_breakpoint(i);
+            }
+        }
+        multiplexer.reset();
+    }
+    
+    if (verbose) {
+        Counts& counts = counts_vec[0];
+        for (int i = 1; i < counts_vec.size(); ++i) {
+            counts += counts_vec[i];
+        }
+        cerr << counts;
+    }
+}
+
+template<>
+Counts ReadFilter<Alignment>::filter_gaf_record(const GAFRecord& record) const {
+    Counts counts;
+    ++counts.counts[Counts::FilterName::read];
+    
+    // Find the columns we need: the name, the read length, the path, the
+    // mapping quality, and the tags after those.
+    const string& line = record.line();
+    vector<size_t> column_starts {0};
+    for (size_t i = line.find('\t'); i != string::npos; i = line.find('\t', i + 1)) {
+        column_starts.push_back(i + 1);
+    }
+    // This runs in a task, so we can't throw our way out of a bad line.
+    auto fail = [&](const string& problem) {
+        #pragma omp critical (cerr)
+        cerr << "error[vg filter]: GAF line for " << record.name() << " " << problem << endl;
+        exit(1);
+    };
+    auto parse_number = [&](const string& text, const string& field) {
+        char* end = nullptr;
+        double value = strtod(text.c_str(), &end);
+        if (text.empty() || end != text.c_str() + text.size()) {
+            fail("has an invalid " + field + ": " + text);
+        }
+        return value;
+    };
+    if (column_starts.size() < 12) {
+        fail("has too few columns");
+    }
+    auto column = [&](size_t i) {
+        size_t end = i + 1 < column_starts.size() ? column_starts[i + 1] - 1 : line.size();
+        return line.substr(column_starts[i], end - column_starts[i]);
+    };
+    string name = column(0);
+    
+    double score = 0;
+    bool proper_pair = false;
+    bool is_paired = false;
+    for (size_t i = 12; i < column_starts.size(); i++) {
+        string tag = column(i);
+        if (tag.compare(0, 5, "AS:i:") == 0) {
+            score = parse_number(tag.substr(5), "alignment score");
+        } else if (tag.compare(0, 5, "pd:b:") == 0) {
+            proper_pair = (tag.substr(5) == "1" || tag.substr(5) == "true");
+        } else if (tag.compare(0, 5, "fp:Z:") == 0 || tag.compare(0, 5, "fn:Z:") == 0) {
+            is_paired = true;
+        }
+    }
+    if (frac_score) {
+        double denom = parse_number(column(1), "read length");
+        if (denom > 0.) {
+            score /= denom;
+        }
+    }
+    
+    bool keep = true;
+    if (!name_prefixes.empty()) {
+        if (!matches_name(name)) {
+            ++counts.counts[Counts::FilterName::wrong_name];
+            keep = false;
+        }
+    }
+    if ((keep || verbose) && only_proper_pairs) {
+        if (!proper_pair) {
+            ++counts.counts[Counts::FilterName::proper_pair];
+            keep = false;
+        }
+    }
+    // GAF doesn't mark secondary alignments, so everything is primary.
+    if ((keep || verbose) && score < min_primary) {
+        ++counts.counts[Counts::FilterName::min_score];
+        keep = false;
+    }
+    if ((keep || verbose) && min_mapq > 0) {
+        // GAF uses 255 for a missing MAPQ, which GAM leaves unset and we treat as 0
+        double mapq = parse_number(column(11), "mapping quality");
+        if (mapq == 255) {
+            mapq = 0;
+        }
+        if (mapq < min_mapq) {
+            ++counts.counts[Counts::FilterName::min_mapq];
+            keep = false;
+        }
+    }
+    if ((keep || verbose) && only_mapped) {
+        if (column(5) == "*") {
+            ++counts.counts[Counts::FilterName::unmapped];
+            keep = false;
+        }
+    }
+    if ((keep || verbose) && downsample_probability != 1.0) {
+        if (!sample_name(name, is_paired)) {
+            ++counts.counts[Counts::FilterName::random];
+            keep = false;
+        }
+    }
+    
+    if (!keep) {
+        ++counts.counts[Counts::FilterName::filtered];
+    }
+    
+    return counts;
+}
+
+template<>
+int ReadFilter<Alignment>::filter_gaf(istream* gaf_stream) {
+    
+    // Make sure we can do everything that was asked for from the GAF columns
+    vector<string> unsupported;
+    if (interleaved) {
+        unsupported.push_back("interleaved pairs");
+    }
+    if (!subsequences.empty()) {
+        unsupported.push_back("subsequences");
+    }
+    if (!excluded_refpos_contigs.empty()) {
+        unsupported.push_back("refpos contigs");
+    }
+    if (!excluded_features.empty()) {
+        unsupported.push_back("features");
+    }
+    if (min_secondary != numeric_limits<double>::lowest()) {
+        unsupported.push_back("secondary scores");
+    }
+    if (rescore || sub_score) {
+        unsupported.push_back("rescoring");
+    }
+    if (max_overhang > 0 && max_overhang < numeric_limits<int>::max() / 2) {
+        unsupported.push_back("overhangs");
+    }
+    if (min_end_matches > 0) {
+        unsupported.push_back("end matches");
+    }
+    if (min_base_quality > 0 && min_base_quality_fraction > 0.0) {
+        unsupported.push_back("base qualities");
+    }
+    if (drop_split) {
+        unsupported.push_back("split reads");
+    }
+    if (repeat_size > 0) {
+        unsupported.push_back("repeat ends");
+    }
+    if (defray_length > 0) {
+        unsupported.push_back("defraying");
+    }
+    if (!unsupported.empty()) {
+        cerr << "error[vg filter]: cannot filter GAF input on";
+        for (size_t i = 0; i < unsupported.size(); i++) {
+            cerr << (i == 0 ? " " : ", ") << unsupported[i];
+        }
+        cerr << endl;
+        return 1;
+    }
+    
+    GAFCursor cursor(*gaf_stream);
+    
+    size_t thread_count = get_thread_count();
+    vector<Counts> counts_vec(thread_count);
+    
+    // Merge the lines written by the threads
+    unique_ptr<vg::io::StreamMultiplexer> multiplexer;
+    if (write_output) {
+        multiplexer.reset(new vg::io::StreamMultiplexer(cout, thread_count));
+    }
+    
+    size_t batch_size = 1000;
+    size_t batches_between_waits = 4 * thread_count;
+    
+    #pragma omp parallel shared(multiplexer, counts_vec)
+    {
+        #pragma omp single
+        {
+            size_t batches_launched = 0;
+            while (cursor.has_current()) {
+                auto* batch = new vector<GAFRecord>();
+                batch->reserve(batch_size);
+                while (batch->size() < batch_size && cursor.has_current()) {
+                    batch->emplace_back(cursor.take());
+                }
+                
+                #pragma omp task firstprivate(batch)
+                {
+                    size_t thread = omp_get_thread_num();
+                    for (auto& record : *batch) {
+                        Counts read_counts = filter_gaf_record(record);
+                        counts_vec[thread] += read_counts;
+                        if ((read_counts.keep() != complement_filter) && write_output) {
+                            multiplexer->get_thread_stream(thread) << record.line() << '\n';
+                        }
+                    }
+                    delete batch;
+                    
+                    if (write_output && multiplexer->want_breakpoint(thread)) {
+                        // We only stop between whole lines.
+                        multiplexer->register_breakpoint(thread);
+                    }
+                }
+                
+                if (++batches_launched % batches_between_waits == 0) {
+                    // Let the filtering catch up with the reading
+                    #pragma omp taskwait
+                }
+            }
+            
+            // Wait for the final tasks.
+            #pragma omp taskwait
+        }
+    }
+    
+    if (write_output) {
+        for (size_t i = 0; i < thread_count; i++) {
+            multiplexer->register_breakpoint(i);
+        }
+        multiplexer.reset();
+    }
+    
+    if (verbose) {
+        Counts& counts = counts_vec[0];
+        for (int i = 1; i < counts_vec.size(); ++i) {
+            counts += counts_vec[i];
+        }
+        cerr << counts;
+    }
+    
+    return 0;
+}
+
 }
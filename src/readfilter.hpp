@@ -14,6 +14,8 @@
 #include "IntervalTree.h"
 #include "annotation.hpp"
 #include "multipath_alignment_emitter.hpp"
+#include "gaf_stream.hpp"
+#include "io/arena_for_each.hpp"
 #include <vg/io/alignment_emitter.hpp>
 #include <vg/vg.pb.h>
 #include <vg/io/stream.hpp>
@@ -116,6 +118,14 @@ public:
      */
     int filter(istream* alignment_stream);
     
+    /**
+     * Filter the GAF records available from the given stream, placing the
+     * lines that pass on standard output, without converting them to
+     * alignments. Only filters that can be evaluated on the GAF columns and
+     * tags are supported. Returns 0 on success, exit code to use on error.
+     */
+    int filter_gaf(istream* gaf_stream);
+    
     /**
      * Look at either end of the given alignment, up to k bases in from the end.
      * See if that tail of the alignment is mapped such that another embedding
@@ -146,6 +156,26 @@ private:
      */
     bool is_mapped(const Read& read) const;
     
+    /**
+     * Return true if all the active filters look only at fields of a read
+     * that can be decoded without the rest of it, and none of them modify the
+     * read. Then reads can be filtered after decoding just those fields, and
+     * passed along in their original serialized form.
+     */
+    bool can_filter_partially() const;
+    
+    /**
+     * Helper function for filter, which decodes only the fields the active
+     * filters look at and writes out the passing reads without re-encoding
+     * them.
+     */
+    void filter_partial(istream* in);
+    
+    /**
+     * Run all the active filters on a GAF record.
+     */
+    Counts filter_gaf_record(const GAFRecord& record) const;
+    
     /**
      * Trim only the end of the given alignment, leaving the start alone. Two
      * calls of this implement trim_ambiguous_ends above.
@@ -169,6 +199,12 @@ private:
      */
     bool sample_read(const Read& read) const;
     
+    /**
+     * Decide if a read with the given name should be kept when downsampling,
+     * the way samtools would decide.
+     */
+    bool sample_name(const string& name, bool is_paired) const;
+    
     /**
      * Convert a multipath alignment to a single path
      */
@@ -184,6 +220,12 @@ private:
      */
     bool matches_name(const Read& read) const;
     
+    /**
+     * Return false if the given read name doesn't have any of the name
+     * prefixes, and true otherwise.
+     */
+    bool matches_name(const string& name) const;
+    
     /**
      * Does the read match one of the excluded refpos contigs?
      */
@@ -308,6 +350,25 @@ struct Counts {
 };
 ostream& operator<<(ostream& os, const Counts& counts);
 
+// Partial decoding and GAF input are only available for Alignments.
+
+template<>
+bool ReadFilter<Alignment>::can_filter_partially() const;
+
+template<>
+void ReadFilter<Alignment>::filter_partial(istream* in);
+
+template<>
+int ReadFilter<Alignment>::filter_gaf(istream* gaf_stream);
+
+template<>
+Counts ReadFilter<Alignment>::filter_gaf_record(const GAFRecord& record) const;
+
+template<>
+inline bool ReadFilter<MultipathAlignment>::can_filter_partially() const {
+    return false;
+}
+
 
 /**
  * Template implementations
@@ -351,7 +412,7 @@ void ReadFilter<Read>::filter_internal(istream* in) {
     if (interleaved) {
         vg::io::for_each_interleaved_pair_parallel(*in, pair_lambda);
     } else {
-        vg::io::for_each_parallel(*in, lambda);
+        vg::io::for_each_parallel_arena(*in, lambda);
     }
     
     if (verbose) {
@@ -371,6 +432,12 @@ inline int ReadFilter<Alignment>::filter(istream* alignment_stream) {
         return 1;
     }
     
+    if (can_filter_partially()) {
+        // No filter needs whole reads, so don't decode or re-encode them.
+        filter_partial(alignment_stream);
+        return 0;
+    }
+    
     if (write_output) {
         // Keep an AlignmentEmitter to multiplex output from multiple threads.
         aln_emitter = get_non_hts_alignment_emitter("-", "GAM", map<string, int64_t>(), get_thread_count());
@@ -611,6 +678,11 @@ inline double ReadFilter<MultipathAlignment>::get_score(const MultipathAlignment
 
 template<typename Read>
 bool ReadFilter<Read>::matches_name(const Read& aln) const {
+    return matches_name(aln.name());
+}
+
+template<typename Read>
+bool ReadFilter<Read>::matches_name(const string& name) const {
     bool keep = true;
     // filter (current) alignment
     if (!name_prefixes.empty()) {
@@ -623,8 +695,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
         size_t left_bound = 0;
         size_t left_match = 0;
         while (left_match < name_prefixes[left_bound].size() &&
-               left_match < aln.name().size() &&
-               name_prefixes[left_bound][left_match] == aln.name()[left_match]) {
+               left_match < name.size() &&
+               name_prefixes[left_bound][left_match] == name[left_match]) {
             // Scan all the matches at the start
             left_match++;
         }
@@ -632,8 +704,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
         size_t right_bound = name_prefixes.size() - 1;
         size_t right_match = 0;
         while (right_match < name_prefixes[right_bound].size() &&
-               right_match < aln.name().size() &&
-               name_prefixes[right_bound][right_match] == aln.name()[right_match]) {
+               right_match < name.size() &&
+               name_prefixes[right_bound][right_match] == name[right_match]) {
             // Scan all the matches at the end
             right_match++;
         }
@@ -649,8 +721,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
                 size_t center_match = min(left_match, right_match);
                 
                 while (center_match < name_prefixes[center].size() &&
-                       center_match < aln.name().size() &&
-                       name_prefixes[center][center_match] == aln.name()[center_match]) {
+                       center_match < name.size() &&
+                       name_prefixes[center][center_match] == name[center_match]) {
                     // Scan all the matches here
                     center_match++;
                 }
@@ -661,8 +733,8 @@ bool ReadFilter<Read>::matches_name(const Read& aln) const {
                     break;
                 }
                 
-                if (center_match == aln.name().size() ||
-                    name_prefixes[center][center_match] > aln.name()[center_match]) {
+                if (center_match == name.size() ||
+                    name_prefixes[center][center_match] > name[center_match]) {
                     // The match, if it exists, must be before us
                     right_bound = center;
                     right_match = center_match;
@@ -1292,14 +1364,19 @@ bool ReadFilter<Read>::sample_read(const Read& read) const {
     // It is paired if fragment_next or fragment_prev point to something.
     bool is_paired = get_is_paired(read);
     
+    return sample_name(read.name(), is_paired);
+}
+
+template<typename Read>
+bool ReadFilter<Read>::sample_name(const string& name, bool is_paired) const {
     // Compute the QNAME that samtools would use
     string qname;
     if (is_paired) {
         // Strip pair end identifiers like _1 or /2 that vg uses at the end of the name.
-        qname = regex_replace(read.name(), regex("[/_][12]$"), "");
+        qname = regex_replace(name, regex("[/_][12]$"), "");
     } else {
         // Any _1 in the name is part of the actual read name.
-        qname = read.name();
+        qname = name;
     }
     
     // Now treat it as samtools would.
@@ -0,0 +1,77 @@
+#include "slow_read_capture.hpp"
+
+#include <cmath>
+
+#include "annotation.hpp"
+
+/**
+ * \file slow_read_capture.cpp: implementation of the SlowReadCapture class
+ */
+
+namespace vg {
+
+using namespace std;
+
+SlowReadCapture::SlowReadCapture(const string& filename, size_t thread_count, const Watchdog::duration& threshold, const string& command,
+                                 const string& options) :
+    emitter(vg::io::get_non_hts_alignment_emitter(filename, "GAM", map<string, int64_t>(), thread_count)),
+    threshold(threshold),
+    command(command),
+    options(options),
+    captured(0) {
+    
+    // Nothing to do
+}
+
+bool SlowReadCapture::is_slow(const Watchdog::duration& elapsed) const {
+    return elapsed >= threshold;
+}
+
+void SlowReadCapture::capture(const Alignment& read, const Watchdog::duration& elapsed) {
+    Alignment saved = read;
+    annotate(saved, elapsed);
+    emitter->emit_single(std::move(saved));
+    captured++;
+}
+
+void SlowReadCapture::capture_pair(const Alignment& read1, const Alignment& read2, const Watchdog::duration& elapsed,
+                                   double fragment_mean, double fragment_stdev) {
+    Alignment saved1 = read1;
+    Alignment saved2 = read2;
+    for (Alignment* saved : {&saved1, &saved2}) {
+        annotate(*saved, elapsed);
+        if (isfinite(fragment_mean) && isfinite(fragment_stdev)) {
+            set_annotation(*saved, "slow_read_fragment_mean", fragment_mean);
+            set_annotation(*saved, "slow_read_fragment_stdev", fragment_stdev);
+        }
+    }
+    emitter->emit_pair(std::move(saved1), std::move(saved2));
+    captured++;
+}
+
+size_t SlowReadCapture::capture_count() const {
+    return captured;
+}
+
+string SlowReadCapture::command_line(int argc, char** argv) {
+    string joined;
+    for (int i = 0; i < argc; i++) {
+        if (i != 0) {
+            joined.push_back(' ');
+        }
+        joined += argv[i];
+    }
+    return joined;
+}
+
+void SlowReadCapture::annotate(Alignment& read, const Watchdog::duration& elapsed) const {
+    // Take off anything the mapper may already have put on the read.
+    read.clear_path();
+    read.clear_score();
+    read.clear_mapping_quality();
+    set_annotation(read, "slow_read_seconds", chrono::duration_cast<chrono::duration<double>>(elapsed).count());
+    set_annotation(read, "slow_read_command", command);
+    set_annotation(read, "slow_read_options", options);
+}
+
+}
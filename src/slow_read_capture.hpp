@@ -0,0 +1,94 @@
+#ifndef VG_SLOW_READ_CAPTURE_HPP_INCLUDED
+#define VG_SLOW_READ_CAPTURE_HPP_INCLUDED
+
+/**
+ * \file slow_read_capture.hpp
+ * Defines a side channel for saving reads that were slow to process, so they
+ * can be replayed later.
+ */
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <vg/vg.pb.h>
+#include <vg/io/alignment_emitter.hpp>
+
+#include "watchdog.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Saves reads that a Watchdog saw checked in for longer than a threshold to a
+ * GAM side file, along with how long they took and the command that was being
+ * run, so that a corpus of difficult reads can be built up and replayed with
+ * vg benchmark.
+ *
+ * Reads are annotated with "slow_read_seconds", "slow_read_command", and
+ * "slow_read_options", which holds the mapping parameters in a form that can
+ * be parsed again to replay the reads with the same configuration.
+ * Paired reads are written as interleaved pairs, and also carry
+ * "slow_read_fragment_mean" and "slow_read_fragment_stdev" if a fragment
+ * length distribution was known.
+ *
+ * Safe to use from multiple threads.
+ */
+class SlowReadCapture {
+public:
+    
+    /**
+     * Make a capture writing to the given GAM file (or "-" for standard
+     * output), for use by up to the given number of threads, capturing reads
+     * that take at least the given threshold. The command is saved with each
+     * read to document how it was run, and the options are saved with each
+     * read so that it can be mapped again the same way.
+     */
+    SlowReadCapture(const string& filename, size_t thread_count, const Watchdog::duration& threshold, const string& command,
+                    const string& options);
+    
+    /**
+     * Return true if a read that took the given time should be captured.
+     */
+    bool is_slow(const Watchdog::duration& elapsed) const;
+    
+    /**
+     * Save the given read, which took the given time.
+     */
+    void capture(const Alignment& read, const Watchdog::duration& elapsed);
+    
+    /**
+     * Save the given read pair, which took the given time. Fragment length
+     * distribution parameters are saved if finite.
+     */
+    void capture_pair(const Alignment& read1, const Alignment& read2, const Watchdog::duration& elapsed,
+                      double fragment_mean = numeric_limits<double>::quiet_NaN(),
+                      double fragment_stdev = numeric_limits<double>::quiet_NaN());
+    
+    /**
+     * Get the number of reads or pairs captured so far.
+     */
+    size_t capture_count() const;
+    
+    /**
+     * Join the given command line arguments into a single string.
+     */
+    static string command_line(int argc, char** argv);
+    
+protected:
+    
+    /// Add the annotations common to all captured reads
+    void annotate(Alignment& read, const Watchdog::duration& elapsed) const;
+    
+    unique_ptr<vg::io::AlignmentEmitter> emitter;
+    Watchdog::duration threshold;
+    string command;
+    string options;
+    atomic<size_t> captured;
+};
+
+}
+
+#endif
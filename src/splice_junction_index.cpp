@@ -0,0 +1,264 @@
+/// \file splice_junction_index.cpp
+///
+/// Construction, serialization, and queries for the splice junction index
+///
+
+#include "splice_junction_index.hpp"
+#include "utility.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace vg {
+
+using namespace std;
+
+const uint64_t SpliceJunctionIndex::file_magic = 0x534a554e43494458ull; // "SJUNCIDX"
+const uint64_t SpliceJunctionIndex::file_version = 1;
+
+SpliceJunctionIndex::SpliceJunctionIndex(const PathHandleGraph& graph,
+                                         const vector<vector<handle_t>>& transcripts,
+                                         const unordered_set<string>& transcript_path_names,
+                                         int64_t max_intron_length) {
+
+    // transcripts take their own junctions, so only the other paths can show us the introns
+    unordered_set<path_handle_t> transcript_paths;
+    for (const auto& path_name : transcript_path_names) {
+        if (graph.has_path(path_name)) {
+            transcript_paths.insert(graph.get_path_handle(path_name));
+        }
+    }
+
+    // collect the distinct adjacencies along the transcripts, identifying each
+    // with the strand that has the smaller left side
+    vector<pair<handle_t, handle_t>> adjacencies;
+    for (const auto& transcript : transcripts) {
+        for (size_t i = 1; i < transcript.size(); ++i) {
+            handle_t left = transcript[i - 1];
+            handle_t right = transcript[i];
+            handle_t flipped_left = graph.flip(right);
+            handle_t flipped_right = graph.flip(left);
+            if (make_pair(graph.get_id(flipped_left), graph.get_is_reverse(flipped_left)) <
+                make_pair(graph.get_id(left), graph.get_is_reverse(left))) {
+                left = flipped_left;
+                right = flipped_right;
+            }
+            adjacencies.emplace_back(left, right);
+        }
+    }
+    auto adjacency_key = [&](const pair<handle_t, handle_t>& adj) {
+        return make_tuple(graph.get_id(adj.first), graph.get_is_reverse(adj.first),
+                          graph.get_id(adj.second), graph.get_is_reverse(adj.second));
+    };
+    sort(adjacencies.begin(), adjacencies.end(), [&](const pair<handle_t, handle_t>& a,
+                                                     const pair<handle_t, handle_t>& b) {
+        return adjacency_key(a) < adjacency_key(b);
+    });
+    adjacencies.resize(unique(adjacencies.begin(), adjacencies.end()) - adjacencies.begin());
+
+    for (const auto& adjacency : adjacencies) {
+        handle_t left = adjacency.first;
+        handle_t right = adjacency.second;
+
+        // look for the intron along each reference path that visits the upstream exon
+        bool is_junction = false;
+        int64_t intron_length = 0;
+        string intron_start, intron_end;
+        graph.for_each_step_on_handle(left, [&](const step_handle_t& step) {
+            if (transcript_paths.count(graph.get_path_handle_of_step(step))) {
+                return true;
+            }
+            bool forward = graph.get_handle_of_step(step) == left;
+            step_handle_t here = step;
+            int64_t length = 0;
+            string start_bases, end_bases;
+            while (forward ? graph.has_next_step(here) : graph.has_previous_step(here)) {
+                here = forward ? graph.get_next_step(here) : graph.get_previous_step(here);
+                handle_t handle = graph.get_handle_of_step(here);
+                if (!forward) {
+                    handle = graph.flip(handle);
+                }
+                if (handle == right) {
+                    // if this path takes the edge directly, it doesn't show us an intron, but
+                    // another path might
+                    if (length >= 2) {
+                        is_junction = true;
+                        intron_length = length;
+                        intron_start = start_bases;
+                        intron_end = end_bases;
+                        return false;
+                    }
+                    break;
+                }
+                string seq = graph.get_sequence(handle);
+                length += seq.size();
+                if (length > max_intron_length) {
+                    break;
+                }
+                if (start_bases.size() < 2) {
+                    start_bases += seq.substr(0, 2 - start_bases.size());
+                }
+                end_bases += seq;
+                if (end_bases.size() > 2) {
+                    end_bases = end_bases.substr(end_bases.size() - 2, 2);
+                }
+            }
+            return true;
+        });
+
+        if (!is_junction) {
+            continue;
+        }
+
+        // index the junction on both strands
+        by_left.emplace_back();
+        auto& junction = by_left.back();
+        junction.left_id = graph.get_id(left);
+        junction.left_is_reverse = graph.get_is_reverse(left);
+        junction.right_id = graph.get_id(right);
+        junction.right_is_reverse = graph.get_is_reverse(right);
+        junction.intron_length = intron_length;
+        copy(intron_start.begin(), intron_start.end(), junction.motif);
+        copy(intron_end.begin(), intron_end.end(), junction.motif + 2);
+
+        by_left.emplace_back();
+        auto& rev_junction = by_left.back();
+        rev_junction.left_id = graph.get_id(right);
+        rev_junction.left_is_reverse = !graph.get_is_reverse(right);
+        rev_junction.right_id = graph.get_id(left);
+        rev_junction.right_is_reverse = !graph.get_is_reverse(left);
+        rev_junction.intron_length = intron_length;
+        string rev_start = reverse_complement(intron_end);
+        string rev_end = reverse_complement(intron_start);
+        copy(rev_start.begin(), rev_start.end(), rev_junction.motif);
+        copy(rev_end.begin(), rev_end.end(), rev_junction.motif + 2);
+    }
+
+    finish();
+}
+
+void SpliceJunctionIndex::finish() {
+
+    sort(by_left.begin(), by_left.end(), [](const junction_t& a, const junction_t& b) {
+        return (make_tuple(a.left_id, a.left_is_reverse, a.intron_length, a.right_id, a.right_is_reverse) <
+                make_tuple(b.left_id, b.left_is_reverse, b.intron_length, b.right_id, b.right_is_reverse));
+    });
+    // a junction between the two strands of a node is its own reverse complement
+    by_left.resize(unique(by_left.begin(), by_left.end(), [](const junction_t& a, const junction_t& b) {
+        return (a.left_id == b.left_id && a.left_is_reverse == b.left_is_reverse &&
+                a.right_id == b.right_id && a.right_is_reverse == b.right_is_reverse);
+    }) - by_left.begin());
+
+    by_right = by_left;
+    sort(by_right.begin(), by_right.end(), [](const junction_t& a, const junction_t& b) {
+        return (make_tuple(a.right_id, a.right_is_reverse, a.intron_length, a.left_id, a.left_is_reverse) <
+                make_tuple(b.right_id, b.right_is_reverse, b.intron_length, b.left_id, b.left_is_reverse));
+    });
+}
+
+size_t SpliceJunctionIndex::size() const {
+    return by_left.size();
+}
+
+bool SpliceJunctionIndex::empty() const {
+    return by_left.empty();
+}
+
+pair<const SpliceJunctionIndex::junction_t*,
+     const SpliceJunctionIndex::junction_t*> SpliceJunctionIndex::junctions_from(nid_t node_id,
+                                                                                 bool is_reverse) const {
+    auto bounds = equal_range(by_left.begin(), by_left.end(), make_pair(node_id, is_reverse),
+                              [](const junction_t& a, const pair<nid_t, bool>& b) {
+        return make_pair(a.left_id, a.left_is_reverse) < b;
+    }, [](const pair<nid_t, bool>& a, const junction_t& b) {
+        return a < make_pair(b.left_id, b.left_is_reverse);
+    });
+    return make_pair(by_left.data() + (bounds.first - by_left.begin()),
+                     by_left.data() + (bounds.second - by_left.begin()));
+}
+
+pair<const SpliceJunctionIndex::junction_t*,
+     const SpliceJunctionIndex::junction_t*> SpliceJunctionIndex::junctions_to(nid_t node_id,
+                                                                               bool is_reverse) const {
+    auto bounds = equal_range(by_right.begin(), by_right.end(), make_pair(node_id, is_reverse),
+                              [](const junction_t& a, const pair<nid_t, bool>& b) {
+        return make_pair(a.right_id, a.right_is_reverse) < b;
+    }, [](const pair<nid_t, bool>& a, const junction_t& b) {
+        return a < make_pair(b.right_id, b.right_is_reverse);
+    });
+    return make_pair(by_right.data() + (bounds.first - by_right.begin()),
+                     by_right.data() + (bounds.second - by_right.begin()));
+}
+
+int64_t SpliceJunctionIndex::intron_length(nid_t left_id, bool left_is_reverse,
+                                           nid_t right_id, bool right_is_reverse) const {
+    auto junctions = junctions_from(left_id, left_is_reverse);
+    for (auto it = junctions.first; it != junctions.second; ++it) {
+        if (it->right_id == right_id && it->right_is_reverse == right_is_reverse) {
+            return it->intron_length;
+        }
+    }
+    return -1;
+}
+
+void SpliceJunctionIndex::serialize(ostream& out) const {
+    // header is magic, version, number of junctions
+    uint64_t header[3] = {file_magic, file_version, (uint64_t) by_left.size()};
+    out.write((const char*) header, sizeof(header));
+    for (const auto& junction : by_left) {
+        int64_t fields[3] = {junction.left_id, junction.right_id, junction.intron_length};
+        char flags = (junction.left_is_reverse ? 1 : 0) | (junction.right_is_reverse ? 2 : 0);
+        out.write((const char*) fields, sizeof(fields));
+        out.write(&flags, 1);
+        out.write(junction.motif, 4);
+    }
+    if (!out) {
+        throw runtime_error("error:[SpliceJunctionIndex] could not write splice junction index");
+    }
+}
+
+void SpliceJunctionIndex::deserialize(istream& in) {
+    uint64_t header[3];
+    in.read((char*) header, sizeof(header));
+    if (!in || header[0] != file_magic) {
+        throw runtime_error("error:[SpliceJunctionIndex] input is not a splice junction index");
+    }
+    if (header[1] != file_version) {
+        throw runtime_error("error:[SpliceJunctionIndex] splice junction index has unsupported version "
+                            + to_string(header[1]));
+    }
+    // don't trust the count to allocate for a corrupt file, so check it against
+    // the rest of the stream if we can, and otherwise grow as the records come in
+    const size_t record_size = 3 * sizeof(int64_t) + 1 + 4;
+    by_left.clear();
+    streampos start = in.tellg();
+    if (start != streampos(-1)) {
+        in.seekg(0, ios::end);
+        streampos end = in.tellg();
+        in.seekg(start);
+        if (header[2] > (end - start) / record_size) {
+            throw runtime_error("error:[SpliceJunctionIndex] splice junction index is truncated");
+        }
+        by_left.reserve(header[2]);
+    }
+    for (size_t i = 0; i < header[2] && in; ++i) {
+        int64_t fields[3];
+        char flags;
+        by_left.emplace_back();
+        auto& junction = by_left.back();
+        in.read((char*) fields, sizeof(fields));
+        in.read(&flags, 1);
+        in.read(junction.motif, 4);
+        junction.left_id = fields[0];
+        junction.right_id = fields[1];
+        junction.intron_length = fields[2];
+        junction.left_is_reverse = flags & 1;
+        junction.right_is_reverse = flags & 2;
+    }
+    if (!in) {
+        throw runtime_error("error:[SpliceJunctionIndex] splice junction index is truncated");
+    }
+    finish();
+}
+
+}
@@ -0,0 +1,115 @@
+/// \file splice_junction_index.hpp
+///
+/// An index of annotated splice junctions in a spliced pangenome graph
+///
+
+#ifndef splice_junction_index_hpp
+#define splice_junction_index_hpp
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <utility>
+#include <unordered_set>
+
+#include "handle.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/*
+ * The splice junctions that are traversed by a set of transcripts, e.g. the ones
+ * added to a graph by vg rna. Junctions fall on node boundaries, so each one is
+ * identified by the oriented node where the upstream exon ends and the oriented
+ * node where the downstream exon begins. Every junction is indexed in both strands
+ * of the graph, and the partners of each site are sorted by intron length.
+ */
+class SpliceJunctionIndex {
+public:
+
+    struct junction_t {
+        // the oriented node whose end is the end of the upstream exon
+        nid_t left_id;
+        bool left_is_reverse;
+        // the oriented node whose start is the start of the downstream exon
+        nid_t right_id;
+        bool right_is_reverse;
+        // length of the intron along the reference
+        int64_t intron_length;
+        // the first two and last two bases of the intron in this orientation
+        char motif[4];
+
+        /// The dinucleotide at the start of the intron
+        inline string left_motif() const;
+        /// The dinucleotide at the end of the intron
+        inline string right_motif() const;
+    };
+
+    SpliceJunctionIndex() = default;
+
+    /// Index the junctions along the given transcript traversals. The intron of a
+    /// junction is located by walking embedded reference paths in the graph from the
+    /// end of the upstream exon, and junctions whose intron cannot be found within the
+    /// maximum length on any of them are not indexed. Embedded paths with the given
+    /// names are transcripts rather than reference, and are not walked.
+    SpliceJunctionIndex(const PathHandleGraph& graph, const vector<vector<handle_t>>& transcripts,
+                        const unordered_set<string>& transcript_path_names = unordered_set<string>(),
+                        int64_t max_intron_length = 1000000);
+
+    ~SpliceJunctionIndex() = default;
+
+    /// The number of indexed junctions, counting the two strands of a junction separately
+    size_t size() const;
+
+    /// Returns true if there are no junctions
+    bool empty() const;
+
+    /// The junctions whose upstream exon ends at the end of this oriented node, in
+    /// order of increasing intron length
+    pair<const junction_t*, const junction_t*> junctions_from(nid_t node_id, bool is_reverse) const;
+
+    /// The junctions whose downstream exon starts at the start of this oriented node,
+    /// in order of increasing intron length
+    pair<const junction_t*, const junction_t*> junctions_to(nid_t node_id, bool is_reverse) const;
+
+    /// Returns the intron length of the junction between the end of one oriented node
+    /// and the start of another, or -1 if it is not an indexed junction
+    int64_t intron_length(nid_t left_id, bool left_is_reverse,
+                          nid_t right_id, bool right_is_reverse) const;
+
+    /// Write the index to a stream
+    void serialize(ostream& out) const;
+
+    /// Load the index from a stream, replacing the current contents
+    void deserialize(istream& in);
+
+private:
+
+    /// Sort the junctions into the two lookup orders
+    void finish();
+
+    static const uint64_t file_magic;
+    static const uint64_t file_version;
+
+    // both orientations of every junction, sorted by upstream node and intron length
+    vector<junction_t> by_left;
+    // both orientations of every junction, sorted by downstream node and intron length
+    vector<junction_t> by_right;
+};
+
+/*
+ * Implementations of inline methods
+ */
+
+inline string SpliceJunctionIndex::junction_t::left_motif() const {
+    return string(motif, motif + 2);
+}
+
+inline string SpliceJunctionIndex::junction_t::right_motif() const {
+    return string(motif + 2, motif + 4);
+}
+
+}
+
+#endif /* splice_junction_index_hpp */
@@ -227,7 +227,8 @@ void SpliceStats::init(const vector<tuple<string, string, double>>& motifs,
 SpliceRegion::SpliceRegion(const pos_t& seed_pos, bool search_left, int64_t search_dist,
                            const HandleGraph& graph,
                            const DinucleotideMachine& dinuc_machine,
-                           const SpliceStats& splice_stats)
+                           const SpliceStats& splice_stats,
+                           const SpliceJunctionIndex* junction_index)
     : subgraph(graph, seed_pos, search_left, search_dist + 2, 5, search_dist * search_dist), motif_matches(splice_stats.motif_size())
 {
     
@@ -257,8 +258,71 @@ SpliceRegion::SpliceRegion(const pos_t& seed_pos, bool search_left, int64_t sear
         cerr << "extract " << graph.get_id(subgraph.get_underlying_handle(handle)) << " " << graph.get_is_reverse(subgraph.get_underlying_handle(handle)) << " at distance " << subgraph.min_distance_from_start(handle) << endl;
 #endif
     }
+    
+    // how many of the matches to each motif came from annotated junctions
+    vector<size_t> num_annotated(splice_stats.motif_size(), 0);
+    
+    if (junction_index && !junction_index->empty()) {
+        // annotated junctions are at node boundaries, so we can find them without the DP
+        for (size_t i = 0; i < dinuc_states.size(); ++i) {
+            handle_t here = dinuc_states[i].first;
+            handle_t underlying = subgraph.get_underlying_handle(here);
+            auto junctions = search_left ? junction_index->junctions_to(graph.get_id(underlying),
+                                                                        graph.get_is_reverse(underlying))
+                                         : junction_index->junctions_from(graph.get_id(underlying),
+                                                                          graph.get_is_reverse(underlying));
+            if (junctions.first == junctions.second) {
+                continue;
+            }
+            size_t node_len = subgraph.get_length(here);
+            int64_t trav_dist = subgraph.min_distance_from_start(here) + node_len;
+            if (trav_dist > search_dist - 2) {
+                continue;
+            }
+            size_t site_offset = search_left ? 0 : node_len;
+            for (auto it = junctions.first; it != junctions.second; ++it) {
+                string left_motif = it->left_motif();
+                string right_motif = it->right_motif();
+                reverse(right_motif.begin(), right_motif.end());
+                for (size_t j = 0; j < splice_stats.motif_size(); ++j) {
+                    if (splice_stats.oriented_motif(j, false) == left_motif &&
+                        splice_stats.oriented_motif(j, true) == right_motif &&
+                        (motif_matches[j].empty() || get<0>(motif_matches[j].back()) != here)) {
+#ifdef debug_splice_region
+                        cerr << "record annotated match to motif " << j << " at node " << graph.get_id(underlying) << ", offset " << site_offset << ", dist " << trav_dist << endl;
+#endif
+                        motif_matches[j].emplace_back(here, site_offset, trav_dist);
+                        annotated = true;
+                    }
+                }
+            }
+        }
+        for (size_t j = 0; j < splice_stats.motif_size(); ++j) {
+            num_annotated[j] = motif_matches[j].size();
+        }
+    }
+    
     int64_t incr = search_left ? -1 : 1;
     
+    // annotated sites lie at the boundary where they leave a node, which the motif search sees as the
+    // boundary where it enters the next node, so we check for them there so as not to record them twice
+    auto is_annotated_site = [&](size_t i, handle_t handle, size_t site_offset) {
+        size_t boundary_offset = search_left ? subgraph.get_length(handle) : 0;
+        if (site_offset != boundary_offset) {
+            return false;
+        }
+        for (size_t k = 0; k < num_annotated[i]; ++k) {
+            bool adjacent = false;
+            subgraph.follow_edges(get<0>(motif_matches[i][k]), search_left, [&](const handle_t& next) {
+                adjacent = adjacent || next == handle;
+            });
+            if (adjacent) {
+                return true;
+            }
+        }
+        return false;
+    };
+    
     // check if we match any motifs at this location and if so remember it
     auto record_motif_matches = [&](handle_t handle, int64_t j,
                                     const vector<uint32_t>& states) {
@@ -290,7 +354,7 @@ SpliceRegion::SpliceRegion(const pos_t& seed_pos, bool search_left, int64_t sear
                         }
                     });
                 }
-                else {
+                else if (!is_annotated_site(i, handle, j - 2 * incr + !search_left)) {
                     int64_t trav_dist = subgraph.min_distance_from_start(handle);
                     if (search_left) {
                         trav_dist += states.size() - j - 2;
@@ -372,6 +436,10 @@ const vector<tuple<handle_t, size_t, int64_t>>& SpliceRegion::candidate_splice_s
     return motif_matches[motif_num];
 }
 
+bool SpliceRegion::is_annotated() const {
+    return annotated;
+}
+
 JoinedSpliceGraph::JoinedSpliceGraph(const HandleGraph& parent_graph,
                                      const IncrementalSubgraph& left_subgraph,
                                      handle_t left_splice_node, size_t left_splice_offset,
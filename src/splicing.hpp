@@ -12,6 +12,7 @@
 #include "aligner.hpp"
 #include "multipath_alignment.hpp"
 #include "statistics.hpp"
+#include "splice_junction_index.hpp"
 
 namespace vg {
 
@@ -92,7 +93,9 @@ private:
 
 /*
  * Object that identifies possible splice sites in a small region of
- * the graph and answers queries about them.
+ * the graph and answers queries about them. If given an index of annotated
+ * splice junctions, the sites are taken from the index, and the region also
+ * searches for splice motifs at the positions that are not annotated.
  */
 class SpliceRegion {
 public:
@@ -100,7 +103,8 @@ public:
     SpliceRegion(const pos_t& seed_pos, bool search_left, int64_t search_dist,
                  const HandleGraph& graph,
                  const DinucleotideMachine& dinuc_machine,
-                 const SpliceStats& splice_stats);
+                 const SpliceStats& splice_stats,
+                 const SpliceJunctionIndex* junction_index = nullptr);
     SpliceRegion() = default;
     ~SpliceRegion() = default;
     
@@ -115,6 +119,10 @@ public:
     // the position that extraction began from
     const pair<handle_t, size_t>& get_seed_pos() const;
     
+    // true if any of the candidate sites came from annotated junctions rather
+    // than a motif search. annotated sites come before the others.
+    bool is_annotated() const;
+    
 private:
 
     IncrementalSubgraph subgraph;
@@ -123,6 +131,8 @@ private:
         
     vector<vector<tuple<handle_t, size_t, int64_t>>> motif_matches;
     
+    bool annotated = false;
+    
 };
 
 /*
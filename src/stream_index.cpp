@@ -1,10 +1,18 @@
 #include "stream_index.hpp"
 
 #include <iostream>
+#include <fstream>
 #include <queue>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/coded_stream.h>
 
 namespace vg {
 
@@ -141,6 +149,10 @@ auto operator<<(ostream& out, const BitString& bs) -> ostream& {
 
 const string StreamIndexBase::MAGIC_BYTES = "GAI!";
 
+StreamIndexBase::~StreamIndexBase() {
+    release_flat();
+}
+
 auto StreamIndexBase::bin_to_prefix(bin_t bin) -> BitString {
 
 #ifdef debug
@@ -214,9 +226,82 @@ auto StreamIndexBase::id_to_prefix(id_t id) -> BitString {
 }
 
 auto StreamIndexBase::used_bins_of_range(id_t min_id, id_t max_id, const function<bool(bin_t)>& iteratee) const -> bool {
+    if (flat) {
+        return for_each_flat_bin(min_id, max_id, [&](const flat_bin_t& bin) {
+            return iteratee(bin.bin);
+        });
+    }
     // The iteratee types are the same so we can just pass that along.
     return bins_by_id_prefix.traverse_in_order(id_to_prefix(min_id), id_to_prefix(max_id), iteratee);
 }
+
+auto StreamIndexBase::for_each_flat_bin(id_t min_id, id_t max_id, const function<bool(const flat_bin_t&)>& iteratee) const -> bool {
+    // Each level of the bin tree is a contiguous, increasing block of bin
+    // numbers, so the bins at a level that the range touches are a
+    // contiguous block of the sorted bins. The root is level 0 and the most
+    // specific bins are level 63.
+    auto bin_less = [](const flat_bin_t& a, bin_t b) {
+        return a.bin < b;
+    };
+    for (size_t level = 0; level < numeric_limits<bin_t>::digits; level++) {
+        // Bins at this level are numbered from an all-1s offset, by ID prefix.
+        bin_t offset = ((bin_t)1 << level) - 1;
+        bin_t low = offset;
+        bin_t high = offset;
+        if (level != 0) {
+            size_t shift = numeric_limits<bin_t>::digits - level;
+            low += (bin_t)min_id >> shift;
+            high += (bin_t)max_id >> shift;
+        }
+        
+        for (auto it = lower_bound(flat_bins, flat_bins + flat_bin_count, low, bin_less);
+             it != flat_bins + flat_bin_count && it->bin <= high; ++it) {
+            if (!iteratee(*it)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+auto StreamIndexBase::for_each_used_bin(id_t min_id, id_t max_id,
+    const function<void(const run_t*, const run_t*)>& iteratee) const -> void {
+    
+    if (flat) {
+        for_each_flat_bin(min_id, max_id, [&](const flat_bin_t& bin) {
+            iteratee(flat_runs + bin.first_run, flat_runs + bin.first_run + bin.run_count);
+            return true;
+        });
+    } else {
+        used_bins_of_range(min_id, max_id, [&](bin_t bin_number) -> bool {
+            // All bins we get should be nonempty
+            auto found = bin_to_ranges.find(bin_number);
+            assert(found != bin_to_ranges.end());
+            iteratee(found->second.data(), found->second.data() + found->second.size());
+            return true;
+        });
+    }
+}
+
+auto StreamIndexBase::first_window_start(window_t min_window, window_t max_window, int64_t& start) const -> bool {
+    if (flat) {
+        auto found = lower_bound(flat_windows, flat_windows + flat_window_count, min_window,
+                                 [](const flat_window_t& a, window_t b) {
+            return a.window < b;
+        });
+        if (found != flat_windows + flat_window_count && found->window <= max_window) {
+            start = found->start;
+            return true;
+        }
+    } else {
+        auto found = window_to_start.lower_bound(min_window);
+        if (found != window_to_start.end() && found->first <= max_window) {
+            start = found->second;
+            return true;
+        }
+    }
+    return false;
+}
     
 auto StreamIndexBase::common_bin(id_t a, id_t b) -> bin_t {
     // Convert to unsigned numbers
@@ -243,6 +328,11 @@ auto StreamIndexBase::window_of_id(id_t id) -> window_t  {
 
 auto StreamIndexBase::add_group(id_t min_id, id_t max_id, int64_t virtual_start, int64_t virtual_past_end) -> void {
     
+    if (flat) {
+        // We need to be able to add to the tables.
+        unflatten();
+    }
+    
     if (min_id < last_group_min_id) {
         // Someone is trying to index an unsorted GAM.
         // This is probably user error, so complain appropriately:
@@ -331,15 +421,7 @@ auto StreamIndexBase::find(id_t min_node, id_t max_node, const function<bool(int
     // Find the minimum virtual offset we need to consider
     int64_t min_vo = 0;
     // It will be for the first occupied window at or after the min window but not greater than the max window.
-    auto found = window_to_start.lower_bound(min_window);
-    if (found != window_to_start.end() && found->first <= max_window) {
-        // Some groups overlapped this window, and they started here.
-        min_vo = found->second;
-        
-#ifdef debug
-        cerr << "First occupied window is " << found->first << " at offset " << min_vo << endl;
-#endif
-    } else {
+    if (!first_window_start(min_window, max_window, min_vo)) {
         // No groups overlapped any window within the range, so don't iterate anything.
         
 #ifdef debug
@@ -349,26 +431,26 @@ auto StreamIndexBase::find(id_t min_node, id_t max_node, const function<bool(int
         return;
     }
     
-    // This will hold bins that actually have vectors in the index, as
-    // iterators to them in the index.
-    vector<decltype(bin_to_ranges)::const_iterator> used_bins;
+#ifdef debug
+    cerr << "First occupied window starts at offset " << min_vo << endl;
+#endif
+    
+    // This will hold the runs of the bins that actually have runs in the
+    // index, as start and end pointers.
+    vector<pair<const run_t*, const run_t*>> used_bins;
     
     // Loop over the bins we have to deal with
-    used_bins_of_range(min_node, max_node, [&](bin_t bin_number) -> bool {
-        // All bins we get should be nonempty
-        auto found = bin_to_ranges.find(bin_number);
-        assert(found != bin_to_ranges.end());
-        used_bins.push_back(found);
-        // TODO: Is there a way we can just process all the bins one at a time,
-        // instead of merging across them?
-        return true;
+    // TODO: Is there a way we can just process all the bins one at a time,
+    // instead of merging across them?
+    for_each_used_bin(min_node, max_node, [&](const run_t* begin, const run_t* end) {
+        used_bins.emplace_back(begin, end);
     });
     
     // Define a cursor type within a bin.
-    // A cursor has an iterator to a pair of start and past-end VOs that occur in a bin.
+    // A cursor has a pointer to a pair of start and past-end VOs that occur in a bin.
     // But we also need to be able to look at the cursor and know if it is done
     // So we also keep the index in used_bins that it belongs to
-    using bin_cursor_t = pair<vector<pair<int64_t, int64_t>>::const_iterator, size_t>;
+    using bin_cursor_t = pair<const run_t*, size_t>;
     
     // As we iterate we will be interested in the smallest cursor (i.e. the cursor to the earliest-starting run not already iterated.)
     // Define a way to get that
@@ -384,21 +466,17 @@ auto StreamIndexBase::find(id_t min_node, id_t max_node, const function<bool(int
     // TODO: Could we do one cursor per specificity level instead? That would be faster.
     for (size_t i = 0; i < used_bins.size(); i++) {
         // Look at the start of the bin
-        bin_cursor_t cursor = make_pair(used_bins[i]->second.begin(), i);
+        bin_cursor_t cursor = make_pair(used_bins[i].first, i);
         
-        while(cursor.first != used_bins[cursor.second]->second.end() && cursor.first->second < min_vo) {
+        while(cursor.first != used_bins[cursor.second].second && cursor.first->second < min_vo) {
             // Skip any runs that end before the window VO
             cursor.first++;
         }
         
-        if (cursor.first != used_bins[cursor.second]->second.end()) {
+        if (cursor.first != used_bins[cursor.second].second) {
             // If there are still runs in the bin, use them.
             cursor_queue.push(cursor);
         }
-        
-#ifdef debug
-        cerr << "Bin " << used_bins[i]->first << " overlaps the query and has runs after the window min VO" << endl;
-#endif
     }
     
     bool keep_going = true;
@@ -436,7 +514,7 @@ auto StreamIndexBase::find(id_t min_node, id_t max_node, const function<bool(int
         
         // Advance what was the top iterator
         top.first++;
-        if (top.first != used_bins[top.second]->second.end()) {
+        if (top.first != used_bins[top.second].second) {
             // We haven't yet hit the end of this bin, so the cursor is eligible to be used again
             cursor_queue.push(top);
         } else {
@@ -451,6 +529,17 @@ auto StreamIndexBase::scan_backward(const function<bool(int64_t, int64_t)> scan_
     // Remember the previous range's start VO, to be the next range's past-end VO.
     int64_t prev_vo = numeric_limits<int64_t>::max();
     
+    if (flat) {
+        for (size_t i = flat_window_count; i > 0; i--) {
+            // Go over the flat windows in reverse order the same way.
+            if (!scan_callback(flat_windows[i - 1].start, prev_vo)) {
+                return;
+            }
+            prev_vo = flat_windows[i - 1].start;
+        }
+        return;
+    }
+    
     for(auto rit = window_to_start.rbegin(); rit != window_to_start.rend(); ++rit) {
         
         // Go over the window offsets we have stored in reverse order.
@@ -466,6 +555,74 @@ auto StreamIndexBase::scan_backward(const function<bool(int64_t, int64_t)> scan_
     }
 }
 
+auto StreamIndexBase::find_batch_intervals(const vector<vector<pair<id_t, id_t>>>& queries) const -> vector<batch_interval_t> {
+    // Get all the runs that any range wants
+    vector<batch_interval_t> intervals;
+    for (auto& query : queries) {
+        for (auto& range : query) {
+            find(range.first, range.second, [&](int64_t start_vo, int64_t past_end_vo) -> bool {
+                intervals.push_back({start_vo, past_end_vo, range.second});
+                return true;
+            });
+        }
+    }
+    
+    sort(intervals.begin(), intervals.end(), [](const batch_interval_t& a, const batch_interval_t& b) {
+        return a.start < b.start;
+    });
+    
+    // Merge the ones that overlap. Abutting intervals stay separate, so that
+    // each keeps its own max ID.
+    vector<batch_interval_t> merged;
+    for (auto& interval : intervals) {
+        if (!merged.empty() && interval.start < merged.back().past_end) {
+            merged.back().past_end = max(merged.back().past_end, interval.past_end);
+            merged.back().max_id = max(merged.back().max_id, interval.max_id);
+        } else {
+            merged.push_back(interval);
+        }
+    }
+    
+#ifdef debug
+    cerr << "Batch of " << queries.size() << " queries needs " << merged.size() << " intervals" << endl;
+#endif
+    
+    return merged;
+}
+
+StreamIndexBase::BatchRangeLookup::BatchRangeLookup(const vector<vector<pair<id_t, id_t>>>& queries) {
+    for (size_t i = 0; i < queries.size(); i++) {
+        for (auto& range : queries[i]) {
+            ranges.emplace_back(range.first, range.second, i);
+        }
+    }
+    sort(ranges.begin(), ranges.end());
+    
+    max_end.reserve(ranges.size());
+    for (auto& range : ranges) {
+        max_end.push_back(max_end.empty() ? get<1>(range) : max(max_end.back(), get<1>(range)));
+    }
+}
+
+auto StreamIndexBase::BatchRangeLookup::queries_of(id_t id, vector<size_t>& found) const -> void {
+    found.clear();
+    
+    // Find the ranges that start at or before the ID
+    size_t starting_before = upper_bound(ranges.begin(), ranges.end(), id, [](id_t a, const tuple<id_t, id_t, size_t>& b) {
+        return a < get<0>(b);
+    }) - ranges.begin();
+    
+    // And walk back through them until none of the rest can reach the ID
+    for (size_t i = starting_before; i > 0 && max_end[i - 1] >= id; i--) {
+        if (get<1>(ranges[i - 1]) >= id) {
+            found.push_back(get<2>(ranges[i - 1]));
+        }
+    }
+    
+    sort(found.begin(), found.end());
+    found.erase(unique(found.begin(), found.end()), found.end());
+}
+
 /// Return true if the given ID is in any of the sorted, coalesced, inclusive ranges in the vector, and false otherwise.
 /// TODO: Is repeated binary search on the ranges going to be better than an unordered_set of all the individual IDs?
 auto StreamIndexBase::is_in_range(const vector<pair<id_t, id_t>>& ranges, id_t id) -> bool {
@@ -501,70 +658,211 @@ auto StreamIndexBase::is_in_range(const vector<pair<id_t, id_t>>& ranges, id_t i
 }
 
 auto StreamIndexBase::save(ostream& to) const -> void {
-    // We aren't going to save as Protobuf messages; we're going to save as a bunch of varints.
-    
     // Format is
-    // Magic bytes
-    // Index version (varint32)
-    // Bin count (varint64)
-    // For each bin:
-    // Bin number (varint64)
-    // Run count (varint64)
-    // For each run:
-    // Start (varint64)
-    // Past-end (varint64)
-    // And then window count (varint64)
-    // And for each window:
-    // Window number (varint64)
-    // Window start (varint64)
+    // Magic bytes (4 bytes)
+    // Index version (uint32)
+    // Bin count, run count, and window count (uint64 each)
+    // For each bin, in bin number order:
+    // Bin number, index of its first run, and run count (uint64 each)
+    // For each run, grouped by bin and in order within each bin:
+    // Start and past-end (int64 each)
+    // For each window, in window number order:
+    // Window number (uint64) and window start (int64)
+    
+    // Nothing is compressed, all the integers are in native byte order, and
+    // all the tables are 8-byte aligned, so the file can be memory-mapped and
+    // searched in place.
+    
+    const flat_bin_t* bins = flat_bins;
+    const run_t* runs = flat_runs;
+    const flat_window_t* windows = flat_windows;
+    flat_header_t header;
+    std::copy(MAGIC_BYTES.begin(), MAGIC_BYTES.end(), header.magic);
+    header.version = OUTPUT_VERSION;
+    header.bin_count = flat_bin_count;
+    header.run_count = flat_run_count;
+    header.window_count = flat_window_count;
+    
+    // If we aren't flat already, we lay out the maps here.
+    vector<flat_bin_t> bin_table;
+    vector<run_t> run_table;
+    vector<flat_window_t> window_table;
+    if (!flat) {
+        for (auto& kv : bin_to_ranges) {
+            bin_table.push_back({kv.first, 0, kv.second.size()});
+        }
+        sort(bin_table.begin(), bin_table.end(), [](const flat_bin_t& a, const flat_bin_t& b) {
+            return a.bin < b.bin;
+        });
+        for (auto& bin : bin_table) {
+            auto& bin_runs = bin_to_ranges.at(bin.bin);
+            bin.first_run = run_table.size();
+            run_table.insert(run_table.end(), bin_runs.begin(), bin_runs.end());
+        }
+        for (auto& kv : window_to_start) {
+            window_table.push_back({kv.first, kv.second});
+        }
+        
+        bins = bin_table.data();
+        runs = run_table.data();
+        windows = window_table.data();
+        header.bin_count = bin_table.size();
+        header.run_count = run_table.size();
+        header.window_count = window_table.size();
+    }
     
-    // All the integers are Protobuf variable-length values.
-    // The result is gzip-compressed.
+    to.write((const char*) &header, sizeof(header));
+    to.write((const char*) bins, header.bin_count * sizeof(flat_bin_t));
+    to.write((const char*) runs, header.run_count * sizeof(run_t));
+    to.write((const char*) windows, header.window_count * sizeof(flat_window_t));
+}
+
+auto StreamIndexBase::load(const string& filename) -> void {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("GAMIndex::load could not open index file " + filename);
+    }
     
-    ::google::protobuf::io::OstreamOutputStream raw_out(&to);
-    ::google::protobuf::io::GzipOutputStream gzip_out(&raw_out);
-    ::google::protobuf::io::CodedOutputStream coded_out(&gzip_out);
+    // See if the file is in the flat format
+    char magic[4];
+    struct stat file_stat;
+    if (pread(fd, magic, sizeof(magic), 0) != sizeof(magic) ||
+        !std::equal(MAGIC_BYTES.begin(), MAGIC_BYTES.end(), magic) ||
+        fstat(fd, &file_stat) != 0) {
+        // It must be an older, compressed index, which we have to read in.
+        close(fd);
+        ifstream from(filename);
+        if (!from) {
+            throw std::runtime_error("GAMIndex::load could not open index file " + filename);
+        }
+        load(from);
+        return;
+    }
     
-    // Save the magic bytes
-    coded_out.WriteRaw((void*)MAGIC_BYTES.c_str(), MAGIC_BYTES.size());
+    // Otherwise we can map it and use it where it is
+    void* mapped = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("GAMIndex::load could not map index file " + filename);
+    }
     
-    // Save the version
-    coded_out.WriteVarint32(OUTPUT_VERSION);
+    release_flat();
+    bin_to_ranges.clear();
+    bins_by_id_prefix = BitStringTree<bin_t>();
+    window_to_start.clear();
     
-    // Save the bin count
-    coded_out.WriteVarint64(bin_to_ranges.size());
-    for (auto& kv : bin_to_ranges) {
-        // For each bin, save the number
-        coded_out.WriteVarint64(kv.first);
-        // And the number of runs
-        coded_out.WriteVarint64(kv.second.size());
-        
-        for (auto& run : kv.second) {
-            // For each run, write the VO range
-            coded_out.WriteVarint64(run.first);
-            coded_out.WriteVarint64(run.second);
-        }
+    mapping = mapped;
+    mapping_size = file_stat.st_size;
+    use_flat((const char*) mapping, mapping_size);
+}
+
+auto StreamIndexBase::use_flat(const char* data, size_t size) -> void {
+    static_assert(sizeof(flat_header_t) == 32 && sizeof(flat_bin_t) == 24 &&
+                  sizeof(run_t) == 16 && sizeof(flat_window_t) == 16,
+                  "flat index tables must be packed");
+    
+    // Define an error handling function
+    auto handle = [](bool ok) {
+        if (!ok) throw std::runtime_error("GAMIndex::load detected corrupt index file");
+    };
+    
+    flat_header_t header;
+    handle(size >= sizeof(header));
+    memcpy(&header, data, sizeof(header));
+    handle(std::equal(MAGIC_BYTES.begin(), MAGIC_BYTES.end(), header.magic));
+    if (header.version > MAX_INPUT_VERSION) {
+        throw std::runtime_error("GAMIndex::load can understand only up to index version " + to_string(MAX_INPUT_VERSION) +
+            " and file is version " + to_string(header.version));
     }
     
-    // Save the window count
-    coded_out.WriteVarint64(window_to_start.size());
-    for (auto& kv : window_to_start) {
-        // Save each window's number and start
-        coded_out.WriteVarint64(kv.first);
-        coded_out.WriteVarint64(kv.second);
+    // Make sure all the tables are there without overflowing
+    size_t body_size = size - sizeof(header);
+    handle(header.bin_count <= body_size / sizeof(flat_bin_t));
+    body_size -= header.bin_count * sizeof(flat_bin_t);
+    handle(header.run_count <= body_size / sizeof(run_t));
+    body_size -= header.run_count * sizeof(run_t);
+    handle(header.window_count == body_size / sizeof(flat_window_t) && body_size % sizeof(flat_window_t) == 0);
+    
+    flat_bins = (const flat_bin_t*) (data + sizeof(header));
+    flat_bin_count = header.bin_count;
+    flat_runs = (const run_t*) (flat_bins + flat_bin_count);
+    flat_run_count = header.run_count;
+    flat_windows = (const flat_window_t*) (flat_runs + flat_run_count);
+    flat_window_count = header.window_count;
+    
+    for (size_t i = 0; i < flat_bin_count; i++) {
+        // Every bin's runs need to be in the run table
+        handle(flat_bins[i].first_run <= flat_run_count &&
+               flat_bins[i].run_count <= flat_run_count - flat_bins[i].first_run);
     }
     
+    flat = true;
 }
 
-auto StreamIndexBase::load(istream& from) -> void {
+auto StreamIndexBase::release_flat() -> void {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+    flat_buffer.clear();
+    flat_buffer.shrink_to_fit();
+    
+    flat = false;
+    flat_bins = nullptr;
+    flat_bin_count = 0;
+    flat_runs = nullptr;
+    flat_run_count = 0;
+    flat_windows = nullptr;
+    flat_window_count = 0;
+}
 
-    ::google::protobuf::io::IstreamInputStream raw_in(&from);
-    ::google::protobuf::io::GzipInputStream gzip_in(&raw_in);
+auto StreamIndexBase::unflatten() -> void {
+    for (size_t i = 0; i < flat_bin_count; i++) {
+        auto& bin = flat_bins[i];
+        bin_to_ranges[bin.bin].assign(flat_runs + bin.first_run, flat_runs + bin.first_run + bin.run_count);
+        bins_by_id_prefix.insert(bin_to_prefix(bin.bin), bin.bin);
+    }
+    for (size_t i = 0; i < flat_window_count; i++) {
+        window_to_start[flat_windows[i].window] = flat_windows[i].start;
+    }
     
+    release_flat();
+}
+
+auto StreamIndexBase::load(istream& from) -> void {
 
+    release_flat();
     bin_to_ranges.clear();
+    bins_by_id_prefix = BitStringTree<bin_t>();
     window_to_start.clear();
     
+    if (from.peek() == MAGIC_BYTES.front()) {
+        // This is a flat index, which has its magic bytes out in the open
+        // instead of in a gzip stream. Read the whole thing and use it as is.
+        flat_buffer.assign(istreambuf_iterator<char>(from), istreambuf_iterator<char>());
+        use_flat(flat_buffer.data(), flat_buffer.size());
+        return;
+    }
+    
+    // Otherwise it is an older index, which is gzip-compressed and has
+    // Magic bytes (if version 1 or later)
+    // Index version (varint32) (if version 1 or later)
+    // Bin count (varint64)
+    // For each bin:
+    // Bin number (varint64)
+    // Run count (varint64)
+    // For each run:
+    // Start (varint64)
+    // Past-end (varint64)
+    // And then window count (varint64)
+    // And for each window:
+    // Window number (varint64)
+    // Window start (varint64)
+
+    ::google::protobuf::io::IstreamInputStream raw_in(&from);
+    ::google::protobuf::io::GzipInputStream gzip_in(&raw_in);
+    
     // Define an error handling function
     auto handle = [](bool ok) {
         if (!ok) throw std::runtime_error("GAMIndex::load detected corrupt index file");
@@ -9,12 +9,16 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <iterator>
 #include <unordered_map>
 #include <type_traits>
+#include <tuple>
 
 #include "types.hpp"
 #include <vg/vg.pb.h>
 #include <vg/io/protobuf_iterator.hpp>
+#include <vg/io/protobuf_emitter.hpp>
 #include "scanner.hpp"
 
 namespace vg {
@@ -28,6 +32,17 @@ using namespace std;
 // To make that work we in turn need a bit string type that is easily
 // convertible to/from 64-bit numbers.
 
+/**
+ * The types used to read and write a sorted, indexable file of the given
+ * message type. By default these are VPKG-format Protobuf streams; message
+ * types stored some other way can specialize this.
+ */
+template<typename Message>
+struct StreamFormat {
+    using cursor_t = vg::io::ProtobufIterator<Message>;
+    using emitter_t = vg::io::ProtobufEmitter<Message>;
+};
+
 /**
  * Represents a string of up to 64 bits.
  */
@@ -204,6 +219,7 @@ protected:
 class StreamIndexBase {
 public:
     StreamIndexBase() = default;
+    ~StreamIndexBase();
     
     // Bins are identified of unsigned integers of the same width as node IDs.
     using bin_t = make_unsigned<id_t>::type;
@@ -216,15 +232,22 @@ public:
     /// Index file format doesn't care what type of message is being indexed.
     void load(istream& from);
     
+    /// Load an index from the file with the given name. Current-version
+    /// index files are memory-mapped and queried in place instead of being
+    /// read into memory.
+    void load(const string& filename);
+    
     /// Save an index to a file.
     void save(ostream& to) const;
     
     // Like the XG we support versioning.
     
     /// What's the maximum index version number we can read with this code?
-    const static uint32_t MAX_INPUT_VERSION = 1;
+    const static uint32_t MAX_INPUT_VERSION = 2;
     /// What's the version we serialize?
-    const static uint32_t OUTPUT_VERSION = 1;
+    /// Versions 0 and 1 are gzipped varints. Version 2 is a flat, sorted,
+    /// uncompressed layout that can be memory-mapped.
+    const static uint32_t OUTPUT_VERSION = 2;
     /// What magic value do we embed in the compressed index data?
     /// TODO: Make this depend on type of message being indexed so we can't mix up index files.
     const static string MAGIC_BYTES;
@@ -305,8 +328,9 @@ public:
     static window_t window_of_id(id_t id);
     
     /// Iterate over the *populated* bins in the index, in in-order bin tree
-    /// traversal order, that any of the node IDs in the given inclusive range
-    /// occur in. Returns false if asked to stop.
+    /// traversal order (or level by level, for an index loaded from a
+    /// current-version file), that any of the node IDs in the given inclusive
+    /// range occur in. Returns false if asked to stop.
     bool used_bins_of_range(id_t min_id, id_t max_id, const function<bool(bin_t)>& iteratee) const;
     
     
@@ -314,6 +338,111 @@ protected:
     // How many bits of a node ID do we truncate to get its linear index window?
     const static size_t WINDOW_SHIFT = 8;
     
+    /// A run is a start and past-end virtual offset.
+    using run_t = pair<int64_t, int64_t>;
+    
+    /// Call the iteratee with the runs, in order, of each populated bin that
+    /// any of the node IDs in the given inclusive range occur in. Bins are not
+    /// visited in any particular order.
+    void for_each_used_bin(id_t min_id, id_t max_id, const function<void(const run_t*, const run_t*)>& iteratee) const;
+    
+    /// Find the start virtual offset of the first occupied window at or after
+    /// the given min window and not after the given max window. Returns false
+    /// if there is no such window.
+    bool first_window_start(window_t min_window, window_t max_window, int64_t& start) const;
+    
+    /// A virtual offset interval to scan for a batch query, along with the
+    /// largest node ID that any query range wanting the interval cares about.
+    struct batch_interval_t {
+        int64_t start;
+        int64_t past_end;
+        id_t max_id;
+    };
+    
+    /// Get the sorted, non-overlapping virtual offset intervals to scan to
+    /// answer all the given queries, each of which is a collection of sorted,
+    /// coalesced, inclusive node ID ranges. Intervals that overlap are merged,
+    /// keeping the larger max ID.
+    vector<batch_interval_t> find_batch_intervals(const vector<vector<pair<id_t, id_t>>>& queries) const;
+    
+    /**
+     * Finds which of a batch of queries have a range containing a node ID.
+     */
+    class BatchRangeLookup {
+    public:
+        /// Set up to look up IDs in the given queries, each of which is a
+        /// collection of inclusive node ID ranges.
+        BatchRangeLookup(const vector<vector<pair<id_t, id_t>>>& queries);
+        
+        /// Fill in the numbers of the queries with a range containing the
+        /// given ID, sorted and deduplicated.
+        void queries_of(id_t id, vector<size_t>& found) const;
+        
+    private:
+        /// All the ranges, with the queries they belong to, sorted by start.
+        vector<tuple<id_t, id_t, size_t>> ranges;
+        /// The greatest range end at or before each position in ranges.
+        vector<id_t> max_end;
+    };
+    
+    // When we are loaded from a current-version file, we query the flat
+    // tables from the file instead of the maps below. The tables are either
+    // memory-mapped or copied into flat_buffer.
+    
+    /// A populated bin in the flat layout, with where its runs are.
+    struct flat_bin_t {
+        bin_t bin;
+        uint64_t first_run;
+        uint64_t run_count;
+    };
+    
+    /// A linear index window in the flat layout.
+    struct flat_window_t {
+        window_t window;
+        int64_t start;
+    };
+    
+    /// The header at the start of a flat index file.
+    struct flat_header_t {
+        char magic[4];
+        uint32_t version;
+        uint64_t bin_count;
+        uint64_t run_count;
+        uint64_t window_count;
+    };
+    
+    /// Are we querying the flat tables?
+    bool flat = false;
+    /// Populated bins in bin number order.
+    const flat_bin_t* flat_bins = nullptr;
+    size_t flat_bin_count = 0;
+    /// Runs of all the bins, grouped by bin.
+    const run_t* flat_runs = nullptr;
+    size_t flat_run_count = 0;
+    /// Occupied windows in window order.
+    const flat_window_t* flat_windows = nullptr;
+    size_t flat_window_count = 0;
+    /// The memory-mapped index file, if any.
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    /// The index data, if read from a stream instead of mapped.
+    vector<char> flat_buffer;
+    
+    /// Point the flat tables into the given flat index file data, checking
+    /// that it is all there.
+    void use_flat(const char* data, size_t size);
+    
+    /// Call the iteratee with each populated bin in the flat tables that any of
+    /// the node IDs in the given inclusive range occur in, level by level.
+    /// Returns false if asked to stop.
+    bool for_each_flat_bin(id_t min_id, id_t max_id, const function<bool(const flat_bin_t&)>& iteratee) const;
+    
+    /// Drop the flat tables and unmap any mapped file.
+    void release_flat();
+    
+    /// Copy the flat tables into the maps, so we can add to them.
+    void unflatten();
+    
     /// Maps from bin number to all the ranges of virtual offsets, in order, for runs that land in the given bin.
     /// A run lands in a bin if that bin is the most specific bin that includes both its lowest and highest nodes it uses.
     unordered_map<bin_t, vector<pair<int64_t, int64_t>>> bin_to_ranges;
@@ -359,7 +488,7 @@ public:
     StreamIndex() = default;
     
     // Methods that actually go get messages for you are going to need a cursor on an open, seekable data file.
-    using cursor_t = vg::io::ProtobufIterator<Message>;
+    using cursor_t = typename StreamFormat<Message>::cursor_t;
     
     ///////////////////
     // Top-level message-based interface
@@ -378,6 +507,15 @@ public:
     void find(cursor_t& cursor, const vector<pair<id_t, id_t>>& ranges, const function<void(const Message&)> handle_result,
         bool only_fully_contained = false) const;
     
+    /// Answer a batch of queries, each a collection of sorted, coalesced
+    /// inclusive node ID ranges, in one pass through the file. Calls the given
+    /// callback with the number of each query that a message matches and the
+    /// message. Each group of the file is read at most once, and messages come
+    /// out in file order. If only_fully_contained is set, a message matches a
+    /// query only if *all* its nodes are in the query's ranges.
+    void find_batch(cursor_t& cursor, const vector<vector<pair<id_t, id_t>>>& queries,
+        const function<void(size_t, const Message&)>& handle_result, bool only_fully_contained = false) const;
+    
     /// Given a cursor at the beginning of a sorted, readable file, index the file.
     void index(cursor_t& cursor);
     
@@ -870,6 +1008,101 @@ auto StreamIndex<Message>::find(cursor_t& cursor, const vector<pair<id_t, id_t>>
     }
 }
 
+template<typename Message>
+auto StreamIndex<Message>::find_batch(cursor_t& cursor, const vector<vector<pair<id_t, id_t>>>& queries,
+    const function<void(size_t, const Message&)>& handle_result, bool only_fully_contained) const -> void {
+    
+    // We need seek support
+    assert(cursor.tell_group() != -1);
+    
+    // Get all the places to look, in file order, with overlaps merged so we
+    // never read a group twice.
+    vector<batch_interval_t> intervals = find_batch_intervals(queries);
+    
+    // And be able to tell which queries want each node ID
+    BatchRangeLookup lookup(queries);
+    
+    // Groups come in order of min ID, so once we see a group with a min ID,
+    // no later group can touch anything below it.
+    id_t floor_id = numeric_limits<id_t>::min();
+    
+    // Reuse these for each message
+    vector<id_t> message_ids;
+    vector<size_t> matched;
+    vector<size_t> id_queries;
+    vector<size_t> scratch;
+    
+    for (auto& interval : intervals) {
+        if (interval.max_id < floor_id) {
+            // Nobody wanting this interval can have anything left in the file.
+            continue;
+        }
+        
+#ifdef debug
+        cerr << "Scan VOs " << interval.start << "-" << interval.past_end << " for IDs up to " << interval.max_id << endl;
+#endif
+        
+        cursor.seek_group(interval.start);
+        
+        int64_t group_vo = cursor.tell_group();
+        id_t group_min_id = numeric_limits<id_t>::max();
+        while (cursor.has_current() && cursor.tell_group() < interval.past_end) {
+            if (cursor.tell_group() != group_vo) {
+                // We finished the previous group.
+                group_vo = cursor.tell_group();
+                if (group_min_id != numeric_limits<id_t>::max()) {
+                    floor_id = max(floor_id, group_min_id);
+                    if (group_min_id > interval.max_id) {
+                        // Everything from here on is too high for this interval.
+                        break;
+                    }
+                }
+                group_min_id = numeric_limits<id_t>::max();
+            }
+            
+            const auto& message = *cursor;
+            
+            // Get the IDs once, and work out which queries they belong to.
+            message_ids.clear();
+            for_each_id(message, [&](const id_t& found) {
+                message_ids.push_back(found);
+                return true;
+            });
+            sort(message_ids.begin(), message_ids.end());
+            message_ids.erase(unique(message_ids.begin(), message_ids.end()), message_ids.end());
+            
+            matched.clear();
+            for (size_t i = 0; i < message_ids.size(); i++) {
+                group_min_id = min(group_min_id, message_ids[i]);
+                lookup.queries_of(message_ids[i], id_queries);
+                
+                scratch.clear();
+                if (only_fully_contained && i > 0) {
+                    // Keep the queries that have all the IDs so far.
+                    set_intersection(matched.begin(), matched.end(), id_queries.begin(), id_queries.end(),
+                                     back_inserter(scratch));
+                } else {
+                    // Keep the queries that have any of the IDs so far.
+                    set_union(matched.begin(), matched.end(), id_queries.begin(), id_queries.end(),
+                              back_inserter(scratch));
+                }
+                swap(matched, scratch);
+            }
+            
+            for (auto& query : matched) {
+                handle_result(query, message);
+            }
+            
+            cursor.advance();
+        }
+        
+        if (group_min_id != numeric_limits<id_t>::max()) {
+            // Also learn from the last group we read.
+            floor_id = max(floor_id, group_min_id);
+        }
+    }
+}
+
 template<typename Message>
 auto StreamIndex<Message>::index(cursor_t& cursor) -> void {
     // Keep track of what group we are in 
@@ -8,7 +8,9 @@
 #include "types.hpp"
 #include "progressive.hpp"
 #include "stream_index.hpp"
+#include "gaf_stream.hpp"
 #include "utility.hpp"
+#include "zstdutil.hpp"
 #include "vg/io/json2pb.h"
 #include <string>
 #include <queue>
@@ -20,10 +22,20 @@
 #include <vector>
 #include <unordered_map>
 #include <tuple>
+#include <deque>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include <sys/time.h>
 #include <sys/resource.h>
 
+#include <omp.h>
+#include "ips4o.hpp"
+
 /**
  * \file stream_sorter.hpp
  * VPKG-format file sorting tools.
@@ -39,7 +51,8 @@ namespace vg {
  * important.
  */
 
-/// Provides the ability to sort a stream of Protobuf Messages, either "dumbly"
+/// Provides the ability to sort a stream of Protobuf Messages (or other
+/// records with a StreamFormat, like GAF lines), either "dumbly"
 /// (in memory), or streaming into temporary files. For Alignments, paired
 /// Alignments are not necessarily going to end up next to each other, so if
 /// sorting by position make sure to set the position cross-references first if
@@ -72,6 +85,17 @@ public:
 
     /// Sort a vector of messages, in place.
     void sort(vector<Message>& msgs) const;
+    
+    /// Set the maximum number of serialized bytes of messages that each
+    /// thread loads into memory for one temp file chunk, during the streaming
+    /// sort. Each thread fills its next chunk while its last one is still
+    /// being written, so it can hold about twice this much at its peak.
+    void set_max_buf_size(size_t bytes);
+    
+    /// Set the maximum number of temp files to merge at once, during the
+    /// streaming sort. Must be at least 2. Can't be raised above the limit
+    /// computed from the open file limit.
+    void set_max_fan_in(size_t fan_in);
 
     /// Return true if out of Messages a and b, a must come before b, and false otherwise.
     bool less_than(const Message& a, const Message& b) const;
@@ -89,25 +113,90 @@ public:
     bool less_than(const Position& a, const Position& b) const;
     
   private:
+    
+    /// A fixed-width key for sorting a message, with the fields of its
+    /// minimum Position in sort order and its original index to break ties.
+    struct sort_key_t {
+        int64_t node_id;
+        bool is_reverse;
+        int64_t offset;
+        size_t index;
+        
+        inline bool operator<(const sort_key_t& other) const {
+            return std::tie(node_id, is_reverse, offset, index) <
+                std::tie(other.node_id, other.is_reverse, other.offset, other.index);
+        }
+    };
+    
     /// What's the maximum size of messages in serialized, uncompressed bytes to
     /// load into memory for a single temp file chunk, during the streaming
-    /// sort?
+    /// sort? Each thread has up to two chunks in memory: one being written
+    /// out in the background and one being filled.
     /// For reference, a whole-genome GAM file is about 500 GB of uncompressed data
     size_t max_buf_size = (512 * 1024 * 1024);
     /// What's the max fan-in when combining temp files, during the streaming sort?
     /// This will be computed based on the max file descriptor limit from the OS.
     size_t max_fan_in;
     
-    using cursor_t = vg::io::ProtobufIterator<Message>;
-    using emitter_t = vg::io::ProtobufEmitter<Message>;
+    /// How many bytes of serialized messages go into each independently
+    /// compressed block of a temp file? Each temp file being merged keeps
+    /// about two blocks' worth of messages in memory.
+    size_t temp_block_size = 128 * 1024;
+    /// What zstd level should temp file blocks be compressed at? Temp files
+    /// are read back only once per merge pass, so favor speed over size.
+    int temp_compression_level = 1;
+    
+    using cursor_t = typename StreamFormat<Message>::cursor_t;
+    using emitter_t = typename StreamFormat<Message>::emitter_t;
+    
+    /// The decoded contents of one block of a temp file, with the sort key of
+    /// each message, and scratch space for reading the block.
+    struct temp_block_t {
+        vector<Message> messages;
+        vector<sort_key_t> keys;
+        string compressed;
+        string serialized;
+    };
     
-    /// Open all the given input files, keeping the streams and cursors in the given lists.
-    /// We use lists because none of these should be allowed to move after creation.
-    void open_all(const vector<string>& filenames, list<ifstream>& streams, list<cursor_t>& cursors);
+    /// Writes messages to a temp file as a series of zstd-compressed blocks,
+    /// each prefixed with its compressed size and message count, so that the
+    /// file can be decoded a block at a time.
+    class TempFileWriter {
+    public:
+        TempFileWriter(const string& filename, size_t block_size, int compression_level);
+        
+        /// Add a message to the file.
+        void write(const Message& msg);
+        
+        /// Write out any partial block and close the file.
+        void close();
+        
+    private:
+        /// Compress and write the current block, if it has anything in it.
+        void flush_block();
+        
+        ofstream out;
+        size_t block_size;
+        int compression_level;
+        string block;
+        string compressed;
+        uint64_t block_messages = 0;
+    };
+    
+    /// Write a sorted run of messages to a new temp file, freeing each message
+    /// as it is written.
+    void write_temp_file(const string& filename, vector<Message>& msgs) const;
+    
+    /// Decode the next block of a temp file into the given block, computing
+    /// the sort key of each message. Leaves the block empty at end of file.
+    void read_temp_block(istream& in, temp_block_t& block) const;
     
-    /// Merge all the messages from the given list of cursors into the given emitter.
-    /// The total expected number of messages can be passed for progress bar purposes.
-    void streaming_merge(list<cursor_t>& cursors, emitter_t& emitter, size_t expected_messages = 0);
+    /// Merge all the messages from the given sorted temp files, passing them to
+    /// the given function in order. Blocks are decoded ahead of the merge on
+    /// worker threads, so the calling thread only maintains the heap. The total
+    /// expected number of messages can be passed for progress bar purposes.
+    void streaming_merge(const vector<string>& temp_files, const function<void(Message&&)>& emit,
+                         size_t expected_messages = 0);
     
     /// Merge all the given temp input files into one or more temp output
     /// files, opening no more than max_fan_in input files at a time. The input
@@ -119,6 +208,7 @@ public:
 };
 
 using GAMSorter = StreamSorter<Alignment>;
+using GAFSorter = StreamSorter<GAFRecord>;
 
 //////////////
 // Template Implementations
@@ -171,20 +261,58 @@ StreamSorter<Message>::StreamSorter(bool show_progress) {
     }
 }
 
+template<typename Message>
+void StreamSorter<Message>::set_max_buf_size(size_t bytes) {
+    max_buf_size = bytes;
+}
+
+template<typename Message>
+void StreamSorter<Message>::set_max_fan_in(size_t fan_in) {
+    if (fan_in < 2) {
+        throw runtime_error("error:[vg::StreamSorter] cannot merge fewer than 2 temp files at a time");
+    }
+    max_fan_in = min(fan_in, max_fan_in);
+}
+
 template<typename Message>
 void StreamSorter<Message>::sort(vector<Message>& msgs) const {
-    std::sort(msgs.begin(), msgs.end(), [&](const Message& a, const Message& b) {
-        return this->less_than(a, b);
-    });
+    // Scan each message for its min position only once, instead of on every
+    // comparison.
+    vector<sort_key_t> keys(msgs.size());
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < msgs.size(); i++) {
+        Position min_pos = get_min_position(msgs[i]);
+        keys[i].node_id = min_pos.node_id();
+        keys[i].is_reverse = min_pos.is_reverse();
+        keys[i].offset = min_pos.offset();
+        keys[i].index = i;
+    }
+    
+    // Sort just the keys. The index tiebreak makes this a stable sort.
+    if (omp_in_parallel()) {
+        // We are already one of several threads sorting chunks.
+        ips4o::sort(keys.begin(), keys.end());
+    } else {
+        ips4o::parallel::sort(keys.begin(), keys.end());
+    }
+    
+    // Then move each message into its place once.
+    vector<Message> sorted;
+    sorted.reserve(msgs.size());
+    for (auto& key : keys) {
+        sorted.emplace_back(std::move(msgs[key.index]));
+    }
+    msgs = std::move(sorted);
 }
 
 template<typename Message>
 void StreamSorter<Message>::easy_sort(istream& stream_in, ostream& stream_out, StreamIndex<Message>* index_to) {
     std::vector<Message> sort_buffer;
 
-    vg::io::for_each<Message>(stream_in, [&](Message &msg) {
-        sort_buffer.push_back(msg);
-    });
+    cursor_t input_cursor(stream_in);
+    while (input_cursor.has_current()) {
+        sort_buffer.emplace_back(std::move(input_cursor.take()));
+    }
 
     this->sort(sort_buffer);
     
@@ -193,7 +321,7 @@ void StreamSorter<Message>::easy_sort(istream& stream_in, ostream& stream_out, S
     
     {
         // Make an output emitter
-        vg::io::ProtobufEmitter<Message> emitter(stream_out);
+        emitter_t emitter(stream_out);
         
         if (index_to != nullptr) {
             emitter.on_message([&](const Message& m) {
@@ -259,6 +387,10 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
     
     #pragma omp parallel shared(stream_in, input_cursor, outstanding_temp_files, messages_per_file, total_messages_read)
     {
+        // Each thread compresses and writes out its last sorted chunk in the
+        // background while it reads and sorts the next one, so it holds up to
+        // two chunks at once.
+        std::thread writer;
     
         while(true) {
     
@@ -287,23 +419,30 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
             // Do a sort of the data we grabbed
             this->sort(thread_buffer);
             
-            // Save it to a temp file.
+            // Save it to a temp file, once the previous chunk is out of the way.
             string temp_name = temp_file::create();
-            ofstream temp_stream(temp_name);
-            // OK to save as one massive group here.
-            // TODO: This write could also be in a thread.
-            vg::io::write_buffered(temp_stream, thread_buffer, 0);
+            size_t message_count = thread_buffer.size();
+            if (writer.joinable()) {
+                writer.join();
+            }
+            writer = std::thread([this, temp_name, sorted = std::move(thread_buffer)]() mutable {
+                write_temp_file(temp_name, sorted);
+            });
             
             #pragma omp critical (outstanding_temp_files)
             {
                 // Remember the temp file name
                 outstanding_temp_files.push_back(temp_name);
                 // Remember the messages in the file, for progress purposes
-                messages_per_file[temp_name] = thread_buffer.size();
+                messages_per_file[temp_name] = message_count;
                 // Remember how many messages we found in the total
-                total_messages_read += thread_buffer.size();
+                total_messages_read += message_count;
             }
         }
+        
+        if (writer.joinable()) {
+            writer.join();
+        }
     }
     
     // Now we know the reader thmessages have taken care of the input, and all the data is in temp files.
@@ -317,11 +456,6 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
     
     // Now we can merge (and maybe index) the final layer of the tree.
     
-    // Open up cursors into all the files.
-    list<ifstream> temp_ifstreams;
-    list<cursor_t> temp_cursors;
-    open_all(outstanding_temp_files, temp_ifstreams, temp_cursors);
-    
     // Maintain our own group buffer at a higher scope than the emitter.
     vector<Message> group_buffer;
     {
@@ -342,14 +476,14 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
             });
         }
     
-        // Merge the cursors into the emitter
-        streaming_merge(temp_cursors, emitter, total_messages_read);
+        // Merge the temp files into the emitter
+        streaming_merge(outstanding_temp_files, [&](Message&& msg) {
+            emitter.write(std::move(msg));
+        }, total_messages_read);
         
     }
     
     // Clean up
-    temp_cursors.clear();
-    temp_ifstreams.clear();
     for (auto& filename : outstanding_temp_files) {
         temp_file::remove(filename);
     }
@@ -357,67 +491,233 @@ void StreamSorter<Message>::stream_sort(istream& stream_in, ostream& stream_out,
 }
 
 template<typename Message>
-void StreamSorter<Message>::open_all(const vector<string>& filenames, list<ifstream>& streams, list<cursor_t>& cursors) {
-    // The open files need to live in a collection; the cursors don't own them.
-    // They also can't be allowed to move since we reference them.
-    // The cursors also need to live in a collection, because we don't want to be
-    // moving/copying them and their internal buffers and streams.
-    // And they can't move after creation either.
+StreamSorter<Message>::TempFileWriter::TempFileWriter(const string& filename, size_t block_size, int compression_level) :
+    out(filename, ios::binary), block_size(block_size), compression_level(compression_level) {
+    
+    if (!out) {
+        cerr << "error:[vg::StreamSorter]: Could not open temp file " << filename << " for writing" << endl;
+        exit(1);
+    }
+    block.reserve(block_size);
+}
+
+template<typename Message>
+void StreamSorter<Message>::TempFileWriter::write(const Message& msg) {
+    // Frame each message with its size within the block
+    uint32_t length = msg.ByteSize();
+    block.append((const char*) &length, sizeof(length));
+    msg.AppendToString(&block);
+    block_messages++;
+    
+    if (block.size() >= block_size) {
+        flush_block();
+    }
+}
+
+template<typename Message>
+void StreamSorter<Message>::TempFileWriter::flush_block() {
+    if (block_messages == 0) {
+        return;
+    }
     
-    // So everything lives in caller-passed lists.
+    if (zstdutil::CompressString(block, compressed, compression_level) != 0) {
+        cerr << "error:[vg::StreamSorter]: Could not compress temp file block" << endl;
+        exit(1);
+    }
+    
+    uint64_t header[2] = {(uint64_t) compressed.size(), block_messages};
+    out.write((const char*) header, sizeof(header));
+    out.write(compressed.data(), compressed.size());
     
-    for (auto& filename : filenames) {
-        // Open each file
-        streams.emplace_back();
-        streams.back().open(filename);
-        // Make a cursor for it
-        cursors.emplace_back(streams.back());
+    block.clear();
+    block_messages = 0;
+}
+
+template<typename Message>
+void StreamSorter<Message>::TempFileWriter::close() {
+    flush_block();
+    out.close();
+    if (!out) {
+        cerr << "error:[vg::StreamSorter]: Could not write temp file" << endl;
+        exit(1);
     }
+}
 
+template<typename Message>
+void StreamSorter<Message>::write_temp_file(const string& filename, vector<Message>& msgs) const {
+    TempFileWriter writer(filename, temp_block_size, temp_compression_level);
+    for (auto& msg : msgs) {
+        writer.write(msg);
+        // Give back the memory as we go, since the next chunk is being read in.
+        msg = Message();
+    }
+    writer.close();
 }
 
 template<typename Message>
-void StreamSorter<Message>::streaming_merge(list<cursor_t>& cursors, emitter_t& emitter, size_t expected_messages) {
+void StreamSorter<Message>::read_temp_block(istream& in, temp_block_t& block) const {
+    uint64_t header[2];
+    in.read((char*) header, sizeof(header));
+    if (in.gcount() == 0 && in.eof()) {
+        // We ran out of blocks
+        block.messages.clear();
+        block.keys.clear();
+        return;
+    }
+    
+    block.compressed.resize(in ? header[0] : 0);
+    in.read(&block.compressed[0], block.compressed.size());
+    if (!in || zstdutil::DecompressString(block.compressed, block.serialized) != 0) {
+        cerr << "error:[vg::StreamSorter]: Temp file block is truncated or corrupt" << endl;
+        exit(1);
+    }
+    
+    // Reuse the messages already in the block, to save on allocations
+    block.messages.resize(header[1]);
+    block.keys.resize(header[1]);
+    size_t cursor = 0;
+    for (size_t i = 0; i < block.messages.size(); i++) {
+        uint32_t length = 0;
+        if (cursor + sizeof(length) <= block.serialized.size()) {
+            memcpy(&length, block.serialized.data() + cursor, sizeof(length));
+            cursor += sizeof(length);
+        }
+        if (cursor + length > block.serialized.size() ||
+            !block.messages[i].ParseFromArray(block.serialized.data() + cursor, length)) {
+            cerr << "error:[vg::StreamSorter]: Could not parse message in temp file block" << endl;
+            exit(1);
+        }
+        cursor += length;
+        
+        Position min_pos = get_min_position(block.messages[i]);
+        block.keys[i].node_id = min_pos.node_id();
+        block.keys[i].is_reverse = min_pos.is_reverse();
+        block.keys[i].offset = min_pos.offset();
+        block.keys[i].index = 0;
+    }
+}
+
+template<typename Message>
+void StreamSorter<Message>::streaming_merge(const vector<string>& temp_files, const function<void(Message&&)>& emit,
+                                            size_t expected_messages) {
 
-    create_progress("merge " + to_string(cursors.size()) + " files", expected_messages == 0 ? 1 : expected_messages);
+    create_progress("merge " + to_string(temp_files.size()) + " files", expected_messages == 0 ? 1 : expected_messages);
     // Count the messages we actually see
     size_t observed_messages = 0;
-
-    // Put all the files in a priority queue based on which has a message that comes first.
-    // We work with pointers to cursors because we don't want to be copying the actual cursors around the heap.
-    // We also *reverse* the order, because priority queues put the "greatest" element first
-    auto cursor_order = [&](cursor_t*& a, cursor_t*& b) {
-        if (b->has_current()) {
-            if(!a->has_current()) {
-                // Cursors that aren't empty come first
-                return true;
-            }
-            return less_than(*(*b), *(*a));
+    
+    // Each file has a current block that the merge is consuming, and a next
+    // block that a decoder thread fills in while that happens.
+    struct run_t {
+        ifstream in;
+        temp_block_t current;
+        size_t next = 0;
+        temp_block_t prefetched;
+        bool ready = false;
+    };
+    vector<unique_ptr<run_t>> runs;
+    for (auto& filename : temp_files) {
+        runs.emplace_back(new run_t());
+        runs.back()->in.open(filename, ios::binary);
+        if (!runs.back()->in) {
+            cerr << "error:[vg::StreamSorter]: Could not open temp file " << filename << endl;
+            exit(1);
         }
-        return false;
+    }
+    
+    // Runs that need their next block decoded, and the state that goes with them
+    mutex decode_mutex;
+    condition_variable decode_wanted;
+    condition_variable decode_done;
+    deque<size_t> decode_queue;
+    bool merge_finished = false;
+    
+    // Ask for the next block of a run to be decoded
+    auto request_block = [&](size_t i) {
+        lock_guard<mutex> lock(decode_mutex);
+        runs[i]->ready = false;
+        decode_queue.push_back(i);
+        decode_wanted.notify_one();
     };
-    priority_queue<cursor_t*, vector<cursor_t*>, decltype(cursor_order)> cursor_queue(cursor_order);
-
-    for (auto& cursor : cursors) {
-        // Put the cursor pointers in the queue
-        cursor_queue.push(&cursor);
+    
+    // Wait for a run's next block and start consuming it. Returns false if the
+    // run is out of messages.
+    auto advance_block = [&](size_t i) {
+        run_t& run = *runs[i];
+        {
+            unique_lock<mutex> lock(decode_mutex);
+            decode_done.wait(lock, [&]() { return run.ready; });
+        }
+        swap(run.current, run.prefetched);
+        run.next = 0;
+        if (run.current.messages.empty()) {
+            return false;
+        }
+        request_block(i);
+        return true;
+    };
+    
+    // The calling thread does the merging, so use the other threads to decode.
+    size_t decoder_count = max<size_t>(1, min<size_t>(get_thread_count() - 1, runs.size()));
+    vector<std::thread> decoders;
+    for (size_t t = 0; t < decoder_count; t++) {
+        decoders.emplace_back([&]() {
+            unique_lock<mutex> lock(decode_mutex);
+            while (true) {
+                decode_wanted.wait(lock, [&]() { return merge_finished || !decode_queue.empty(); });
+                if (decode_queue.empty()) {
+                    break;
+                }
+                size_t i = decode_queue.front();
+                decode_queue.pop_front();
+                
+                lock.unlock();
+                read_temp_block(runs[i]->in, runs[i]->prefetched);
+                lock.lock();
+                
+                runs[i]->ready = true;
+                decode_done.notify_one();
+            }
+        });
     }
     
-    while(!cursor_queue.empty() && cursor_queue.top()->has_current()) {
+    // Put all the runs in a priority queue based on the cached key of their
+    // next message, using the run number to break ties. We *reverse* the
+    // order, because priority queues put the "greatest" element first.
+    auto key_order = [](const sort_key_t& a, const sort_key_t& b) {
+        return b < a;
+    };
+    priority_queue<sort_key_t, vector<sort_key_t>, decltype(key_order)> run_queue(key_order);
+    auto queue_run = [&](size_t i) {
+        sort_key_t key = runs[i]->current.keys[runs[i]->next];
+        key.index = i;
+        run_queue.push(key);
+    };
+    
+    for (size_t i = 0; i < runs.size(); i++) {
+        request_block(i);
+    }
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (advance_block(i)) {
+            queue_run(i);
+        }
+    }
+    
+    while (!run_queue.empty()) {
         // Until we have run out of data in all the temp files
         
-        // Pop off the winning cursor
-        cursor_t* winner = cursor_queue.top();
-        cursor_queue.pop();
+        // Pop off the winning run
+        size_t winner = run_queue.top().index;
+        run_queue.pop();
+        run_t& run = *runs[winner];
         
         // Grab and emit its message, and advance it
-        emitter.write(std::move(winner->take()));
+        emit(std::move(run.current.messages[run.next]));
+        run.next++;
         
         // Put it back in the heap if it is not depleted
-        if (winner->has_current()) {
-            cursor_queue.push(winner);
+        if (run.next < run.current.messages.size() || advance_block(winner)) {
+            queue_run(winner);
         }
-        // TODO: Maybe keep it off the heap for the next loop somehow if it still wins
         
         observed_messages++;
         if (expected_messages != 0) {
@@ -425,6 +725,15 @@ void StreamSorter<Message>::streaming_merge(list<cursor_t>& cursors, emitter_t&
         }
     }
     
+    {
+        lock_guard<mutex> lock(decode_mutex);
+        merge_finished = true;
+        decode_wanted.notify_all();
+    }
+    for (auto& decoder : decoders) {
+        decoder.join();
+    }
+    
     // We finished the files, so say we're done.
     // TODO: Should we warn/fail if we expected the wrong number of messages?
     update_progress(expected_messages == 0 ? 1 : expected_messages);
@@ -442,38 +751,30 @@ vector<string> StreamSorter<Message>::streaming_merge(const vector<string>& temp
     for (size_t start_file = 0; start_file < temp_files_in.size(); start_file += max_fan_in) {
         // For each range of sufficiently few files, starting at start_file and running for file_count
         size_t file_count = min(max_fan_in, temp_files_in.size() - start_file);
-    
-        // Open up cursors into all the files.
-        list<ifstream> temp_ifstreams;
-        list<cursor_t> temp_cursors;
-        open_all(vector<string>(&temp_files_out[start_file], &temp_files_out[start_file + file_count]), temp_ifstreams, temp_cursors);
+        vector<string> to_merge(temp_files_in.begin() + start_file, temp_files_in.begin() + start_file + file_count);
         
         // Work out how many messages to expect
         size_t expected_messages = 0;
         if (messages_per_file != nullptr) {
-            for (size_t i = start_file; i < start_file + file_count; i++) {
-                expected_messages += messages_per_file->at(temp_files_in.at(i));
+            for (auto& filename : to_merge) {
+                expected_messages += messages_per_file->at(filename);
             }
         }
         
         // Open an output file
         string out_file_name = temp_file::create();
-        ofstream out_stream(out_file_name);
         temp_files_out.push_back(out_file_name);
+        TempFileWriter writer(out_file_name, temp_block_size, temp_compression_level);
         
-        // Make an output emitter
-        emitter_t emitter(out_stream);
-        
-        // Merge the cursors into the emitter
-        streaming_merge(temp_cursors, emitter, expected_messages);
-        
-        // The output file will be flushed and finished automatically when the emitter goes away.
+        // Merge the input files into it
+        streaming_merge(to_merge, [&](Message&& msg) {
+            writer.write(msg);
+        }, expected_messages);
+        writer.close();
         
         // Clean up the input files we used
-        temp_cursors.clear();
-        temp_ifstreams.clear();
-        for (size_t i = start_file; i < file_count; i++) {
-            temp_file::remove(temp_files_in.at(i));
+        for (auto& filename : to_merge) {
+            temp_file::remove(filename);
         }
         
         if (messages_per_file != nullptr) {
@@ -1,6 +1,7 @@
 /** \file benchmark_main.cpp
  *
- * Defines the "vg benchmark" subcommand, which runs and reports on microbenchmarks.
+ * Defines the "vg benchmark" subcommand, which runs and reports on microbenchmarks,
+ * or replays captured slow reads against Giraffe.
  */
 
 #include <omp.h>
@@ -14,8 +15,18 @@
 #include "../benchmark.hpp"
 #include "../version.hpp"
 
+#include "giraffe_options.hpp"
+
 #include "../gbwt_extender.hpp"
 #include "../gbwt_helper.hpp"
+#include "../minimizer_mapper.hpp"
+#include "../annotation.hpp"
+#include "../funnel.hpp"
+
+#include <vg/io/vpkg.hpp>
+#include <vg/io/stream.hpp>
+#include <gbwtgraph/gbz.h>
+#include <gbwtgraph/minimizer.h>
 
 
 
@@ -26,13 +37,158 @@ using namespace vg::subcommand;
 void help_benchmark(char** argv) {
     cerr << "usage: " << argv[0] << " benchmark [options] >report.tsv" << endl
          << "options:" << endl
-         << "    -p, --progress         show progress" << endl;
+         << "    -p, --progress         show progress" << endl
+         << "replay options:" << endl
+         << "    -G, --replay FILE      instead of microbenchmarks, map the reads in FILE (from vg giraffe --capture-slow)" << endl
+         << "                           with the options they were captured with, and report per-read and per-stage timings" << endl
+         << "    -Z, --gbz-name FILE    map to this GBZ graph" << endl
+         << "    -m, --minimizer-name FILE  use this minimizer index" << endl
+         << "    -d, --dist-name FILE   use this distance index" << endl
+         << "    -i, --interleaved      reads are interleaved pairs" << endl;
+}
+
+/// Map each read or pair in the given GAM with Giraffe's mapper on one thread,
+/// configured with the options each read was captured with. Writes a TSV line
+/// per read or pair to standard output and a per-stage summary to standard
+/// error.
+static void replay_reads(const string& replay_filename, const string& gbz_filename,
+                         const string& minimizer_filename, const string& distance_filename,
+                         bool interleaved, bool show_progress) {
+    
+    if (show_progress) {
+        cerr << "Loading indexes" << endl;
+    }
+    auto gbz = vg::io::VPKG::load_one<gbwtgraph::GBZ>(gbz_filename);
+    auto minimizer_index = vg::io::VPKG::load_one<gbwtgraph::DefaultMinimizerIndex>(minimizer_filename);
+    auto distance_index = vg::io::VPKG::load_one<SnarlDistanceIndex>(distance_filename);
+    distance_index->preload(true);
+    
+    // Count stages as we go
+    FunnelStageCounter stage_counter(1);
+    MinimizerMapper minimizer_mapper(gbz->graph, *minimizer_index, &*distance_index);
+    minimizer_mapper.stage_counter = &stage_counter;
+    
+    // Get the total time in each stage so far, so we can difference them to
+    // get the time each read spent in each stage.
+    auto stage_seconds = [&]() {
+        vector<pair<string, double>> totals;
+        stage_counter.for_each_stage([&](const string& stage, const FunnelStageCounter::StageTotals& stage_totals) {
+            totals.emplace_back(stage, stage_totals.seconds);
+        });
+        return totals;
+    };
+    
+    // Put the timings for one read in a line
+    auto report = [&](const string& name, double captured_seconds, double seconds, int64_t score,
+                      const vector<pair<string, double>>& before) {
+        cout << name << "\t" << captured_seconds << "\t" << seconds << "\t" << score;
+        auto after = stage_seconds();
+        for (size_t i = 0; i < after.size(); i++) {
+            // Stages keep their order, and new ones only go on the end
+            double spent = after[i].second - (i < before.size() ? before[i].second : 0.0);
+            if (spent > 0) {
+                cout << "\t" << after[i].first << "=" << spent;
+            }
+        }
+        cout << endl;
+    };
+    
+    cout << "#name\tcaptured_seconds\treplay_seconds\treplay_score\tstage_seconds" << endl;
+    
+    bool reported_command = false;
+    auto report_command = [&](const Alignment& aln) {
+        if (!reported_command && has_annotation(aln, "slow_read_command")) {
+            cout << "# captured from: " << get_annotation<string>(aln, "slow_read_command") << endl;
+            reported_command = true;
+        }
+    };
+    // Set the mapper up the way Giraffe was when the read was captured. The
+    // options are the same for a whole capture, so we only redo this when
+    // they change.
+    string applied_options;
+    bool have_applied_options = false;
+    auto configure = [&](const Alignment& aln) {
+        if (!has_annotation(aln, "slow_read_options")) {
+            cerr << "error:[vg benchmark] Read " << aln.name() << " was captured without its mapping options" << endl;
+            exit(1);
+        }
+        string options = get_annotation<string>(aln, "slow_read_options");
+        if (!have_applied_options || options != applied_options) {
+            apply_giraffe_mapping_options(options, minimizer_mapper, show_progress);
+            applied_options = std::move(options);
+            have_applied_options = true;
+        }
+    };
+    auto captured_seconds = [&](const Alignment& aln) {
+        return has_annotation(aln, "slow_read_seconds") ? get_annotation<double>(aln, "slow_read_seconds") : 0.0;
+    };
+    
+    // Holds the first read of a pair until we see the second
+    Alignment pending;
+    bool have_pending = false;
+    
+    get_input_file(replay_filename, [&](istream& in) {
+        vg::io::for_each<Alignment>(in, [&](Alignment& aln) {
+            report_command(aln);
+            if (!interleaved) {
+                configure(aln);
+                double captured = captured_seconds(aln);
+                auto before = stage_seconds();
+                auto start = chrono::steady_clock::now();
+                vector<Alignment> mapped = minimizer_mapper.map(aln);
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                report(aln.name(), captured, elapsed.count(), mapped.empty() ? 0 : mapped.front().score(), before);
+            } else if (!have_pending) {
+                pending = std::move(aln);
+                have_pending = true;
+            } else {
+                have_pending = false;
+                configure(pending);
+                if (!minimizer_mapper.fragment_distr_is_finalized()) {
+                    // Use the fragment length distribution that was in use when the pair was captured.
+                    if (!has_annotation(pending, "slow_read_fragment_mean") || !has_annotation(pending, "slow_read_fragment_stdev")) {
+                        cerr << "error:[vg benchmark] Pair " << pending.name() << ", " << aln.name()
+                             << " was captured without a fragment length distribution" << endl;
+                        exit(1);
+                    }
+                    minimizer_mapper.force_fragment_length_distr(get_annotation<double>(pending, "slow_read_fragment_mean"),
+                                                                 get_annotation<double>(pending, "slow_read_fragment_stdev"));
+                }
+                double captured = captured_seconds(pending);
+                string name = pending.name() + "," + aln.name();
+                auto before = stage_seconds();
+                auto start = chrono::steady_clock::now();
+                auto mapped = minimizer_mapper.map_paired(pending, aln);
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                int64_t score = 0;
+                if (!mapped.first.empty() && !mapped.second.empty()) {
+                    score = mapped.first.front().score() + mapped.second.front().score();
+                }
+                report(name, captured, elapsed.count(), score, before);
+            }
+        });
+    });
+    
+    if (have_pending) {
+        cerr << "error:[vg benchmark] Interleaved replay file " << replay_filename << " has an unpaired read at the end" << endl;
+        exit(1);
+    }
+    
+    cerr << "Replayed " << stage_counter.input_count() << " reads; stage totals:" << endl;
+    stage_counter.write_table(cerr);
 }
 
 int main_benchmark(int argc, char** argv) {
 
     bool show_progress = false;
     
+    // Should we replay captured reads instead?
+    string replay_filename;
+    string gbz_filename;
+    string minimizer_filename;
+    string distance_filename;
+    bool interleaved = false;
+    
     // Which experiments should we run?
     bool sort_and_order_experiment = false;
     bool get_sequence_experiment = true;
@@ -43,12 +199,17 @@ int main_benchmark(int argc, char** argv) {
         static struct option long_options[] =
             {
                 {"progress",  no_argument, 0, 'p'},
+                {"replay", required_argument, 0, 'G'},
+                {"gbz-name", required_argument, 0, 'Z'},
+                {"minimizer-name", required_argument, 0, 'm'},
+                {"dist-name", required_argument, 0, 'd'},
+                {"interleaved", no_argument, 0, 'i'},
                 {"help", no_argument, 0, 'h'},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "ph?",
+        c = getopt_long (argc, argv, "pG:Z:m:d:ih?",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -62,6 +223,26 @@ int main_benchmark(int argc, char** argv) {
             show_progress = true;
             break;
             
+        case 'G':
+            replay_filename = optarg;
+            break;
+            
+        case 'Z':
+            gbz_filename = optarg;
+            break;
+            
+        case 'm':
+            minimizer_filename = optarg;
+            break;
+            
+        case 'd':
+            distance_filename = optarg;
+            break;
+            
+        case 'i':
+            interleaved = true;
+            break;
+            
         case 'h':
         case '?':
             /* getopt_long already printed an error message. */
@@ -84,6 +265,15 @@ int main_benchmark(int argc, char** argv) {
     // Do all benchmarking on one thread
     omp_set_num_threads(1);
     
+    if (!replay_filename.empty()) {
+        if (gbz_filename.empty() || minimizer_filename.empty() || distance_filename.empty()) {
+            cerr << "error:[vg benchmark] Replaying reads requires a GBZ (-Z), minimizer index (-m), and distance index (-d)" << endl;
+            exit(1);
+        }
+        replay_reads(replay_filename, gbz_filename, minimizer_filename, distance_filename, interleaved, show_progress);
+        return 0;
+    }
+    
     // Turn on nested parallelism, so we can parallelize over VCFs and over alignment bands
     omp_set_nested(1);
     
@@ -19,6 +19,7 @@
 #include "../utility.hpp"
 #include "../chunker.hpp"
 #include "../stream_index.hpp"
+#include "../gaf_stream.hpp"
 #include "../region.hpp"
 #include "../haplotype_extracter.hpp"
 #include "../algorithms/sorted_id_ranges.hpp"
@@ -34,6 +35,15 @@ static string chunk_name(const string& out_chunk_prefix, int i, const Region& re
 static int split_gam(istream& gam_stream, size_t chunk_size, const string& out_prefix,
                      size_t gam_buffer_size = 100);
 static void check_read(const Alignment& aln, const HandleGraph* graph);
+static void check_read(const GAFRecord& record, const HandleGraph* graph);
+
+/// Send the reads in a sorted, indexed GAM or GAF file to the files of all the
+/// chunks with node ID ranges they touch, in one pass through the file.
+template<typename Message>
+static void route_reads(const StreamIndex<Message>& index, const string& filename,
+                        const vector<vector<pair<vg::id_t, vg::id_t>>>& chunk_ranges,
+                        const vector<string>& chunk_filenames, bool fully_contained,
+                        size_t threads, const HandleGraph* graph);
                      
 
 void help_chunk(char** argv) {
@@ -48,7 +58,7 @@ void help_chunk(char** argv) {
          << "options:" << endl
          << "    -x, --xg-name FILE       use this graph or xg index to chunk subgraphs" << endl
          << "    -G, --gbwt-name FILE     use this GBWT haplotype index for haplotype extraction (for -T)" << endl
-         << "    -a, --gam-name FILE      chunk this gam file instead of the graph (multiple allowed)" << endl
+         << "    -a, --gam-name FILE      chunk this gam file (or sorted, indexed .gaf.gz file) instead of the graph (multiple allowed)" << endl
          << "    -g, --gam-and-graph      when used in combination with -a, both gam and graph will be chunked" << endl 
          << "path chunking:" << endl
          << "    -p, --path TARGET        write the chunk in the specified (0-based inclusive, multiple allowed)\n"
@@ -301,6 +311,12 @@ int main_chunk(int argc, char** argv) {
         cerr << "error:[vg chunk] gam file must be specified with -a when using -f or -m" << endl;
         return 1;
     }
+    for (auto& gam_file : gam_files) {
+        if (is_gaf_file_name(gam_file) && (gam_split_size != 0 || components)) {
+            cerr << "error:[vg chunk] GAF file " << gam_file << " can only be chunked by region with its index" << endl;
+            return 1;
+        }
+    }
     if (components == true && context_steps >= 0) {
         cerr << "error:[vg chunk] context cannot be specified (-c) when splitting into components (-C)" << endl;
         return 1;
@@ -407,14 +423,22 @@ int main_chunk(int argc, char** argv) {
 
     
     // We need an index on the GAM to chunk it (if we're not doing components)
+    // GAF files get a GAF index instead, leaving a null GAM index in their slot.
     vector<unique_ptr<GAMIndex>> gam_indexes;
+    vector<unique_ptr<GAFIndex>> gaf_indexes;
     if (chunk_gam && !components) {
         for (auto gam_file : gam_files) {
             try {
-                get_input_file(gam_file + ".gai", [&](istream& index_stream) {
-                        gam_indexes.push_back(unique_ptr<GAMIndex>(new GAMIndex()));
-                        gam_indexes.back()->load(index_stream);
-                    });
+                // Current indexes get memory-mapped.
+                gam_indexes.emplace_back();
+                gaf_indexes.emplace_back();
+                if (is_gaf_file_name(gam_file)) {
+                    gaf_indexes.back() = unique_ptr<GAFIndex>(new GAFIndex());
+                    gaf_indexes.back()->load(gam_file + ".gai");
+                } else {
+                    gam_indexes.back() = unique_ptr<GAMIndex>(new GAMIndex());
+                    gam_indexes.back()->load(gam_file + ".gai");
+                }
             } catch (...) {
                 cerr << "error:[vg chunk] unable to load GAM index file: " << gam_file << ".gai" << endl
                      << "                 note: a GAM index is required when *not* chunking by components with -C or -M" << endl;
@@ -640,33 +664,12 @@ int main_chunk(int argc, char** argv) {
         chunker.graph = graph;
     }
     
-    // When chunking GAMs, every thread gets its own cursor to seek into the input GAM.
-    // Todo: when operating on multiple gams, we make |threads| X |gams| cursors, even though
-    // we only ever use |threads| threads.
-    vector<list<ifstream>> gam_streams_vec(gam_files.size());
-    vector<vector<GAMIndex::cursor_t>> cursors_vec(gam_files.size());
-    
-    if (chunk_gam) {
-        for (size_t gam_i = 0; gam_i < gam_streams_vec.size(); ++gam_i) {
-            auto& gam_file = gam_files[gam_i];
-            auto& gam_streams = gam_streams_vec[gam_i];
-            auto& cursors = cursors_vec[gam_i];
-            cursors.reserve(threads);
-            for (size_t i = 0; i < threads; i++) {
-                // Open a stream for every thread
-                gam_streams.emplace_back(gam_file);
-                if (!gam_streams.back()) {
-                    cerr << "error[vg chunk]: unable to open GAM file " << gam_file << endl;
-                    return 1;
-                }
-                // And wrap it in a cursor
-                cursors.emplace_back(gam_streams.back());
-            }
-        }
-    }
+    // When chunking with the index, we remember the node ID ranges of each
+    // region, and route all the reads to them afterward in one pass.
+    vector<vector<pair<vg::id_t, vg::id_t>>> region_id_ranges(chunk_gam && !components ? num_regions : 0);
 
     // extract chunks in parallel
-#pragma omp parallel for
+#pragma omp parallel for schedule(dynamic, 1)
     for (int i = 0; i < num_regions; ++i) {
         int tid = omp_get_thread_num();
         Region& region = regions[i];
@@ -779,36 +782,13 @@ int main_chunk(int argc, char** argv) {
         if (chunk_gam) {
             if (!components) {
                 // old way: use the gam index
-                for (size_t gi = 0; gi < gam_indexes.size(); ++gi) {
-                    auto& gam_index = gam_indexes[gi];
-                    assert(gam_index.get() != nullptr);
-                    GAMIndex::cursor_t& cursor = cursors_vec[gi][tid];
-            
-                    string gam_name = chunk_name(out_chunk_prefix, i, output_regions[i], ".gam", gi, components);
-                    ofstream out_gam_file(gam_name);
-                    if (!out_gam_file) {
-                        cerr << "error[vg chunk]: can't open output gam file " << gam_name << endl;
-                        exit(1);
-                    }
-            
-                    // Work out the ID ranges to look up
-                    vector<pair<vg::id_t, vg::id_t>> region_id_ranges;
-                    if (subgraph) {
-                        // Use the regions from the graph
-                        region_id_ranges = vg::algorithms::sorted_id_ranges(subgraph.get());
-                    } else {
-                        // Use the region we were asked for
-                        region_id_ranges = {{region.start, region.end}};
-                    }
-                    
-                    auto emit = vg::io::emit_to<Alignment>(out_gam_file);
-                    
-                    auto handle_read = [&](const Alignment& aln) {
-                        check_read(aln, graph);
-                        emit(aln);
-                    };
-                    
-                    gam_index->find(cursor, region_id_ranges, handle_read, fully_contained);
+                // Work out the ID ranges to look up
+                if (subgraph) {
+                    // Use the regions from the graph
+                    region_id_ranges[i] = vg::algorithms::sorted_id_ranges(subgraph.get());
+                } else {
+                    // Use the region we were asked for
+                    region_id_ranges[i] = {{region.start, region.end}};
                 }
             } else {
 #pragma omp critical (node_to_component)
@@ -838,17 +818,38 @@ int main_chunk(int argc, char** argv) {
         }
     }
         
+    if (chunk_gam && !components) {
+        // Make one pass through each input, sending each read to all the
+        // chunks it belongs in.
+        for (size_t gi = 0; gi < gam_indexes.size(); ++gi) {
+            vector<string> chunk_filenames;
+            for (int i = 0; i < num_regions; ++i) {
+                chunk_filenames.push_back(chunk_name(out_chunk_prefix, i, output_regions[i],
+                                                     gaf_indexes[gi].get() != nullptr ? ".gaf" : ".gam", gi, components));
+            }
+            if (gaf_indexes[gi].get() != nullptr) {
+                route_reads(*gaf_indexes[gi], gam_files[gi], region_id_ranges, chunk_filenames,
+                            fully_contained, threads, graph);
+            } else {
+                route_reads(*gam_indexes[gi], gam_files[gi], region_id_ranges, chunk_filenames,
+                            fully_contained, threads, graph);
+            }
+        }
+    }
+        
     // write a bed file if asked giving a more explicit linking of chunks to files
     if (!out_bed_file.empty()) {
         ofstream obed(out_bed_file);
         if (!obed) {
             cerr << "error[vg chunk]: can't open output bed file: " << out_bed_file << endl;
         }
+        // The first alignment file's chunks are the ones we list
+        string gam_ext = (!gaf_indexes.empty() && gaf_indexes.front().get() != nullptr) ? ".gaf" : ".gam";
         for (int i = 0; i < num_regions; ++i) {
             const Region& oregion = output_regions[i];
             string seq = id_range ? "ids" : oregion.seq;
             obed << seq << "\t" << oregion.start << "\t" << (oregion.end + 1)
-                 << "\t" << chunk_name(out_chunk_prefix, i, oregion, chunk_gam ? ".gam" : output_ext, 0, components);
+                 << "\t" << chunk_name(out_chunk_prefix, i, oregion, chunk_gam ? gam_ext : output_ext, 0, components);
             if (trace) {
                 obed << "\t" << chunk_name(out_chunk_prefix, i, oregion, ".annotate.txt", 0, components);
             }
@@ -1116,3 +1117,42 @@ static void check_read(const Alignment& aln, const HandleGraph* graph) {
     }
 }
 
+static void check_read(const GAFRecord& record, const HandleGraph* graph) {
+    if (!graph) {
+        return;
+    }
+    // Make sure the nodes it visits are all in the graph.
+    record.for_each_step([&](nid_t node_id, bool is_reverse, size_t offset) {
+        if (!graph->has_node(node_id)) {
+            #pragma omp critical (cerr)
+            {
+                std::cerr << "error:[vg chunk] Alignment " << record.name() << " visits node " << node_id << " which is not in this graph" << std::endl;
+                std::cerr << "Make sure that you are using the same graph that the reads were mapped to!" << std::endl;
+            }
+            exit(1);
+        }
+        return true;
+    });
+}
+
+template<typename Message>
+static void route_reads(const StreamIndex<Message>& index, const string& filename,
+                        const vector<vector<pair<vg::id_t, vg::id_t>>>& chunk_ranges,
+                        const vector<string>& chunk_filenames, bool fully_contained,
+                        size_t threads, const HandleGraph* graph) {
+    ifstream in(filename);
+    if (!in) {
+        cerr << "error[vg chunk]: unable to open GAM file " << filename << endl;
+        exit(1);
+    }
+    typename StreamIndex<Message>::cursor_t cursor(in);
+    
+    // The index reads each group once, and the router writes the chunks in
+    // the background.
+    ChunkReadRouter<Message> router(chunk_filenames, threads);
+    index.find_batch(cursor, chunk_ranges, [&](size_t chunk, const Message& read) {
+        check_read(read, graph);
+        router.route(chunk, read);
+    }, fully_contained);
+    router.finish();
+}
@@ -5,6 +5,7 @@
 #include "../algorithms/gfa_to_handle.hpp"
 #include "../algorithms/find_gbwtgraph.hpp"
 #include "../io/save_handle_graph.hpp"
+#include "../io/arena_for_each.hpp"
 #include "../gfa.hpp"
 #include "../gbwt_helper.hpp"
 #include "../gbwtgraph_helper.hpp"
@@ -249,16 +250,25 @@ int main_convert(int argc, char** argv) {
         string input_graph_filename = get_input_file_name(optind, argc, argv);
         input_graph = vg::io::VPKG::load_one<HandleGraph>(input_graph_filename);
 
-        unique_ptr<AlignmentEmitter> emitter = get_non_hts_alignment_emitter("-", (input == input_gam) ? "GAF" : "GAM", {}, get_thread_count(),
-                                                                             input_graph.get());
-        std::function<void(Alignment&)> lambda = [&] (Alignment& aln) {
-            emitter->emit_singles({aln});
-        };                
         if (input == input_gam) {
+            // Convert batches of reads to GAF text in parallel, and write
+            // them out whole and in order.
+            std::function<void(Alignment&, string&)> format = [&] (Alignment& aln, string& out) {
+                // GAF records only know how to write themselves to a stream
+                ostringstream line;
+                line << vg::io::alignment_to_gaf(*input_graph, aln);
+                out += line.str();
+                out += "\n";
+            };
             get_input_file(input_aln, [&](istream& in) {
-                    vg::io::for_each_parallel(in, lambda);
+                    vg::io::format_parallel_ordered(in, cout, format);
             });
         } else {
+            unique_ptr<AlignmentEmitter> emitter = get_non_hts_alignment_emitter("-", "GAM", {}, get_thread_count(),
+                                                                                 input_graph.get());
+            std::function<void(Alignment&)> lambda = [&] (Alignment& aln) {
+                emitter->emit_single(std::move(aln));
+            };
             gaf_unpaired_for_each_parallel(*input_graph, input_aln, lambda);
         }
         return 0;
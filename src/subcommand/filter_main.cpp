@@ -29,6 +29,7 @@ void help_filter(char** argv) {
          << endl
          << "options:" << endl
          << "    -M, --input-mp-alns        input is multipath alignments (GAMP) rather than GAM" << endl
+         << "    -G, --gaf-input            input is GAF rather than GAM (implied by a .gaf file name)" << endl
          << "    -n, --name-prefix NAME     keep only reads with this prefix in their names [default='']" << endl
          << "    -N, --name-prefixes FILE   keep reads with names with one of many prefixes, one per nonempty line" << endl
          << "    -a, --subsequence NAME     keep reads that contain this subsequence" << endl
@@ -68,6 +69,7 @@ int main_filter(int argc, char** argv) {
     }
     
     bool input_gam = true;
+    bool input_gaf = false;
     vector<string> name_prefixes;
     vector<regex> excluded_refpos_contigs;
     unordered_set<string> excluded_features;
@@ -115,6 +117,7 @@ int main_filter(int argc, char** argv) {
         static struct option long_options[] =
             {
                 {"input-mp-alns", no_argument, 0, 'M'},
+                {"gaf-input", no_argument, 0, 'G'},
                 {"name-prefix", required_argument, 0, 'n'},
                 {"name-prefixes", required_argument, 0, 'N'},
                 {"subsequence", required_argument, 0, 'a'},
@@ -147,7 +150,7 @@ int main_filter(int argc, char** argv) {
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "Mn:N:a:A:pPX:F:s:r:Od:e:fauo:m:Sx:vVq:E:D:C:d:iIb:Ut:",
+        c = getopt_long (argc, argv, "MGn:N:a:A:pPX:F:s:r:Od:e:fauo:m:Sx:vVq:E:D:C:d:iIb:Ut:",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -159,6 +162,9 @@ int main_filter(int argc, char** argv) {
         case 'M':
             input_gam = false;
             break;
+        case 'G':
+            input_gaf = true;
+            break;
         case 'n':
             name_prefixes.push_back(optarg);
             break;
@@ -331,6 +337,14 @@ int main_filter(int argc, char** argv) {
         help_filter(argv);
         return 1;
     }
+    
+    if (is_gaf_file_name(argv[optind])) {
+        input_gaf = true;
+    }
+    if (input_gaf && !input_gam) {
+        cerr << "error[vg filter]: GAF input cannot be multipath alignments" << endl;
+        return 1;
+    }
 
     // What should our return code be?
     int error_code = 0;
@@ -413,7 +427,13 @@ int main_filter(int argc, char** argv) {
         // Open up the alignment stream
         
         // Read in the alignments and filter them.
-        if (input_gam) {
+        if (input_gaf) {
+            // Filter the GAF lines without making Alignments
+            ReadFilter<Alignment> filter;
+            set_params(filter);
+            error_code = filter.filter_gaf(&in);
+        }
+        else if (input_gam) {
             ReadFilter<Alignment> filter;
             set_params(filter);
             error_code = filter.filter(&in);
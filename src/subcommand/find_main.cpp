@@ -9,6 +9,7 @@
 #include <gcsa/support.h>
 #include "../region.hpp"
 #include "../stream_index.hpp"
+#include "../gaf_stream.hpp"
 #include "../algorithms/subgraph.hpp"
 #include "../algorithms/sorted_id_ranges.hpp"
 #include "../algorithms/approx_path_distance.hpp"
@@ -51,7 +52,7 @@ void help_find(char** argv) {
          << "    -K, --subgraph-k K     instead of graphs, write kmers from the subgraphs" << endl
          << "    -H, --gbwt FILE        when enumerating kmers from subgraphs, determine their frequencies in this GBWT haplotype index" << endl
          << "alignments:" << endl
-         << "    -l, --sorted-gam FILE  use this sorted, indexed GAM file" << endl
+         << "    -l, --sorted-gam FILE  use this sorted, indexed GAM (or .gaf/.gaf.gz GAF) file" << endl
          << "    -o, --alns-on N:M      write alignments which align to any of the nodes between N and M (inclusive)" << endl
          << "    -A, --to-graph VG      get alignments to the provided subgraph" << endl
          << "sequences:" << endl
@@ -419,15 +420,41 @@ int main_find(int argc, char** argv) {
     }
     
     unique_ptr<GAMIndex> gam_index;
-    unique_ptr<vg::io::ProtobufIterator<Alignment>> gam_cursor;
+    unique_ptr<GAFIndex> gaf_index;
     if (!sorted_gam_name.empty()) {
-        // Load the GAM index
-        gam_index = unique_ptr<GAMIndex>(new GAMIndex());
-        get_input_file(sorted_gam_name + ".gai", [&](istream& in) {
-            // We get it form the appropriate .gai, which must exist
-            gam_index->load(in); 
-        });
+        // We get the index from the appropriate .gai, which must exist.
+        // Current indexes get memory-mapped.
+        string index_name = sorted_gam_name + ".gai";
+        try {
+            if (is_gaf_file_name(sorted_gam_name)) {
+                gaf_index = unique_ptr<GAFIndex>(new GAFIndex());
+                gaf_index->load(index_name);
+            } else {
+                gam_index = unique_ptr<GAMIndex>(new GAMIndex());
+                gam_index->load(index_name);
+            }
+        } catch (const exception& e) {
+            cerr << "error:[vg find] unable to load GAM index file " << index_name << ": " << e.what() << endl;
+            return 1;
+        }
     }
+    
+    // Dump the alignments in the sorted file that touch the given ID ranges to cout
+    auto find_alignments = [&](const vector<pair<vg::id_t, vg::id_t>>& ranges) {
+        get_input_file(sorted_gam_name, [&](istream& in) {
+            if (gaf_index.get() != nullptr) {
+                // Make a cursor for input and write out the GAF lines we find
+                GAFCursor cursor(in);
+                gaf_index->find(cursor, ranges, [&](const GAFRecord& record) {
+                    cout << record.line() << "\n";
+                });
+            } else {
+                // Make a cursor for input and write out GAM
+                vg::io::ProtobufIterator<Alignment> cursor(in);
+                gam_index->find(cursor, ranges, vg::io::emit_to<Alignment>(cout));
+            }
+        });
+    };
 
     if (!aln_on_id_range.empty()) {
         // Parse the range
@@ -439,18 +466,9 @@ int main_find(int argc, char** argv) {
             convert(parts.front(), start_id);
             convert(parts.back(), end_id);
         }
-        if (gam_index.get() != nullptr) {
+        if (!sorted_gam_name.empty()) {
             // Find in sorted GAM
-            
-            get_input_file(sorted_gam_name, [&](istream& in) {
-                // Make a cursor for input
-                // TODO: Refactor so we can put everything with the GAM index inside one get_input_file call to deduplicate code
-                vg::io::ProtobufIterator<Alignment> cursor(in);
-                
-                // Find the alignments and dump them to cout
-                gam_index->find(cursor, start_id, end_id, vg::io::emit_to<Alignment>(cout));
-            });
-            
+            find_alignments({{start_id, end_id}});
         } else {
             cerr << "error [vg find]: Cannot find alignments on range without a sorted GAM" << endl;
             exit(1);
@@ -462,7 +480,7 @@ int main_find(int argc, char** argv) {
         
         // Load up the graph
         auto graph = vg::io::VPKG::load_one<PathHandleGraph>(to_graph_file);
-        if (gam_index.get() != nullptr) {
+        if (!sorted_gam_name.empty()) {
             // Find in sorted GAM
             
             // Get the ID ranges from the graph
@@ -470,15 +488,7 @@ int main_find(int argc, char** argv) {
             // Throw out the graph
             graph.reset();
             
-            get_input_file(sorted_gam_name, [&](istream& in) {
-                // Make a cursor for input
-                // TODO: Refactor so we can put everything with the GAM index inside one get_input_file call to deduplicate code
-                vg::io::ProtobufIterator<Alignment> cursor(in);
-            
-                // Find the alignments and send them to cout
-                gam_index->find(cursor, ranges, vg::io::emit_to<Alignment>(cout)); 
-            });
-            
+            find_alignments(ranges);
         } else {
             cerr << "error [vg find]: Cannot find alignments on graph without a sorted GAM" << endl;
             exit(1);
@@ -14,6 +14,7 @@
 #include "../annotation.hpp"
 #include "../snarl_distance_index.hpp"
 #include "../vg.hpp"
+#include "../io/arena_for_each.hpp"
 #include <vg/io/stream.hpp>
 #include <vg/io/vpkg.hpp>
 
@@ -214,9 +215,9 @@ int main_gamcompare(int argc, char** argv) {
             exit(1);
         }
         if (distance_name.empty()) {
-            vg::io::for_each_parallel(std::cin, record_path_positions);
+            vg::io::for_each_parallel_arena(std::cin, record_path_positions);
         } else {
-            vg::io::for_each_parallel(std::cin, record_graph_positions);
+            vg::io::for_each_parallel_arena(std::cin, record_graph_positions);
         }
     } else {
         // Read truth from this file, if it looks good.
@@ -226,9 +227,9 @@ int main_gamcompare(int argc, char** argv) {
             exit(1);
         }
         if (distance_name.empty()) {
-            vg::io::for_each_parallel(truth_file_in, record_path_positions);
+            vg::io::for_each_parallel_arena(truth_file_in, record_path_positions);
         } else {
-            vg::io::for_each_parallel(truth_file_in, record_graph_positions);
+            vg::io::for_each_parallel_arena(truth_file_in, record_graph_positions);
         }
     }
     if (score_alignment && range == -1) {
@@ -391,14 +392,14 @@ int main_gamcompare(int argc, char** argv) {
             cerr << "error[vg gamcompare]: Unable to read standard input when looking for reads under test" << endl;
             exit(1);
         }
-        vg::io::for_each_parallel(std::cin, annotate_test);
+        vg::io::for_each_parallel_arena(std::cin, annotate_test);
     } else {
         ifstream test_file_in(test_file_name);
         if (!test_file_in) {
             cerr << "error[vg gamcompare]: Unable to read " << test_file_name << " when looking for reads under test" << endl;
             exit(1);
         }
-        vg::io::for_each_parallel(test_file_in, annotate_test);
+        vg::io::for_each_parallel_arena(test_file_in, annotate_test);
     }
 
     if (output_tsv) {
@@ -1,6 +1,7 @@
 #include "../stream_sorter.hpp"
 #include <vg/io/stream.hpp>
 #include "../stream_index.hpp"
+#include "../gaf_stream.hpp"
 #include <getopt.h>
 #include "subcommand.hpp"
 
@@ -13,19 +14,50 @@ using namespace vg;
 using namespace vg::subcommand;
 void help_gamsort(char **argv)
 {
-    cerr << "gamsort: sort a GAM file, or index a sorted GAM file" << endl
+    cerr << "gamsort: sort a GAM or GAF file, or index a sorted GAM or GAF file" << endl
          << "Usage: " << argv[1] << " [Options] gamfile" << endl
          << "Options:" << endl
          << "  -i / --index FILE       produce an index of the sorted GAM file" << endl
+         << "  -G / --gaf-input        input is GAF (plain or compressed), output is BGZF-compressed GAF" << endl
          << "  -d / --dumb-sort        use naive sorting algorithm (no tmp files, faster for small GAMs)" << endl
          << "  -p / --progress         Show progress." << endl
          << "  -t / --threads          Use the specified number of threads." << endl
          << endl;
 }
 
+/// Sort the messages of the given type from the input to standard output,
+/// optionally indexing them into the given file.
+template<typename Message>
+static void sort_and_index(istream& in, const string& index_filename, bool easy_sort, bool show_progress) {
+
+    StreamSorter<Message> sorter(show_progress);
+
+    unique_ptr<StreamIndex<Message>> index;
+    
+    if (!index_filename.empty()) {
+        // Make an index
+        index = unique_ptr<StreamIndex<Message>>(new StreamIndex<Message>());
+    }
+    
+    if (easy_sort) {
+        // Sort in a single pass in memory
+        sorter.easy_sort(in, cout, index.get());
+    } else {
+        // Sort using fan-in-limited temp file merging
+        sorter.stream_sort(in, cout, index.get());
+    }
+    
+    if (index.get() != nullptr) {
+        // Save the index
+        ofstream index_out(index_filename);
+        index->save(index_out);
+    }
+}
+
 int main_gamsort(int argc, char **argv)
 {
     string index_filename;
+    bool gaf_input = false;
     bool easy_sort = false;
     bool show_progress = false;
     // We limit the max threads, and only allow thread count to be lowered, to
@@ -40,13 +72,14 @@ int main_gamsort(int argc, char **argv)
         static struct option long_options[] =
             {
                 {"index", required_argument, 0, 'i'},
+                {"gaf-input", no_argument, 0, 'G'},
                 {"dumb-sort", no_argument, 0, 'd'},
                 {"rocks", required_argument, 0, 'r'},
                 {"progress", no_argument, 0, 'p'},
                 {"threads", required_argument, 0, 't'},
                 {0, 0, 0, 0}};
         int option_index = 0;
-        c = getopt_long(argc, argv, "i:dhpt:",
+        c = getopt_long(argc, argv, "i:Gdhpt:",
                         long_options, &option_index);
 
         // Detect the end of the options.
@@ -58,6 +91,9 @@ int main_gamsort(int argc, char **argv)
         case 'i':
             index_filename = optarg;
             break;
+        case 'G':
+            gaf_input = true;
+            break;
         case 'd':
             easy_sort = true;
             break;
@@ -84,33 +120,14 @@ int main_gamsort(int argc, char **argv)
     omp_set_num_threads(num_threads);
 
     get_input_file(optind, argc, argv, [&](istream& gam_in) {
-
-        GAMSorter gs(show_progress);
-
-        // Do a normal GAMSorter sort
-        unique_ptr<GAMIndex> index;
-        
-        if (!index_filename.empty()) {
-            // Make an index
-            index = unique_ptr<GAMIndex>(new GAMIndex());
-        }
-        
-        if (easy_sort) {
-            // Sort in a single pass in memory
-            gs.easy_sort(gam_in, cout, index.get());
+        if (gaf_input) {
+            sort_and_index<GAFRecord>(gam_in, index_filename, easy_sort, show_progress);
         } else {
-            // Sort using fan-in-limited temp file merging
-            gs.stream_sort(gam_in, cout, index.get());
-        }
-        
-        if (index.get() != nullptr) {
-            // Save the index
-            ofstream index_out(index_filename);
-            index->save(index_out);
+            sort_and_index<Alignment>(gam_in, index_filename, easy_sort, show_progress);
         }
     });
 
     return 0;
 }
 
-static Subcommand vg_gamsort("gamsort", "Sort a GAM file or index a sorted GAM file.", main_gamsort);
+static Subcommand vg_gamsort("gamsort", "Sort a GAM or GAF file or index a sorted GAM or GAF file.", main_gamsort);
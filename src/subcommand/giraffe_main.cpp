@@ -14,9 +14,17 @@
 #include <unordered_set>
 #include <chrono>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <algorithm>
 
 #include "subcommand.hpp"
 #include "options.hpp"
+#include "giraffe_options.hpp"
 
 #include "../snarl_seed_clusterer.hpp"
 #include "../mapper.hpp"
@@ -27,6 +35,7 @@
 #include "../minimizer_mapper.hpp"
 #include "../index_registry.hpp"
 #include "../watchdog.hpp"
+#include "../slow_read_capture.hpp"
 #include "../crash.hpp"
 #include <bdsg/overlays/overlay_helper.hpp>
 
@@ -255,6 +264,12 @@ static GroupedOptionGroup get_options() {
         MinimizerMapper::default_rescue_seed_limit,
         "attempt rescue with at most INT seeds"
     );
+    comp_opts.add_range(
+        "rescue-cache-size",
+        &MinimizerMapper::rescue_cache_size,
+        MinimizerMapper::default_rescue_cache_size,
+        "keep up to INT recent rescue subgraphs per thread for reuse"
+    );
     
     // Configure chaining
     auto& chaining_opts = parser.add_group<MinimizerMapper>("long-read/chaining parameters");
@@ -350,6 +365,92 @@ static GroupedOptionGroup get_options() {
     return parser;
 }
 
+// Map algorithm names to rescue algorithms
+static const std::map<std::string, MinimizerMapper::RescueAlgorithm> rescue_algorithms = {
+    { "none", MinimizerMapper::rescue_none },
+    { "dozeu", MinimizerMapper::rescue_dozeu },
+    { "gssw", MinimizerMapper::rescue_gssw },
+};
+static const std::map<MinimizerMapper::RescueAlgorithm, std::string> algorithm_names =  {
+    { MinimizerMapper::rescue_none, "none" },
+    { MinimizerMapper::rescue_dozeu, "dozeu" },
+    { MinimizerMapper::rescue_gssw, "gssw" },
+};
+
+namespace vg {
+namespace subcommand {
+
+std::string describe_giraffe_mapping_options(const GroupedOptionGroup& parser,
+                                             MinimizerMapper::RescueAlgorithm rescue_algorithm) {
+    std::stringstream s;
+    // Don't round off any floating point parameters
+    s << std::setprecision(std::numeric_limits<double>::max_digits10);
+    parser.print_options(s);
+    s << "--rescue-algorithm " << algorithm_names.at(rescue_algorithm) << endl;
+    return s.str();
+}
+
+void apply_giraffe_mapping_options(const std::string& description, MinimizerMapper& minimizer_mapper,
+                                   bool show_progress) {
+    
+    // Parse with a fresh parser, so everything not described keeps its default
+    GroupedOptionGroup parser = get_options();
+    std::vector<struct option> long_options;
+    parser.make_long_options(long_options);
+    
+    MinimizerMapper::RescueAlgorithm rescue_algorithm = MinimizerMapper::rescue_dozeu;
+    
+    std::stringstream lines(description);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        // Each line is "--option" for a flag or "--option value"
+        if (line.compare(0, 2, "--") != 0) {
+            cerr << "error:[vg giraffe] Could not parse mapping option: " << line << endl;
+            exit(1);
+        }
+        size_t space = line.find(' ');
+        std::string name = line.substr(2, space == std::string::npos ? std::string::npos : space - 2);
+        std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+        
+        if (name == "rescue-algorithm") {
+            auto found = rescue_algorithms.find(value);
+            if (found == rescue_algorithms.end()) {
+                cerr << "error:[vg giraffe] Invalid rescue algorithm: " << value << endl;
+                exit(1);
+            }
+            rescue_algorithm = found->second;
+            continue;
+        }
+        
+        auto found = std::find_if(long_options.begin(), long_options.end(), [&](const struct option& long_option) {
+            return name == long_option.name;
+        });
+        if (found == long_options.end()
+            || !parser.parse(found->val, found->has_arg == no_argument ? nullptr : value.c_str())) {
+            cerr << "error:[vg giraffe] Unknown mapping option: --" << name << endl;
+            exit(1);
+        }
+    }
+    
+    if (show_progress) {
+        parser.print_options(cerr);
+        cerr << "--rescue-algorithm " << algorithm_names.at(rescue_algorithm) << endl;
+    }
+    
+    // Configure the mapper the same way main_giraffe() does
+    parser.apply(minimizer_mapper);
+    ScoringOptions scoring_options;
+    parser.apply(scoring_options);
+    minimizer_mapper.rescue_algorithm = rescue_algorithm;
+    minimizer_mapper.set_alignment_scores(scoring_options.match, scoring_options.mismatch, scoring_options.gap_open, scoring_options.gap_extend, scoring_options.full_length_bonus);
+}
+
+}
+}
+
 // Try stripping all suffixes in the vector, one at a time, and return on failure.
 std::string strip_suffixes(std::string filename, const std::vector<std::string>& suffixes) {
     for (const std::string& suffix : suffixes) {
@@ -428,6 +529,11 @@ void help_giraffe(char** argv, const BaseOptionGroup& parser, bool full_help) {
         << "  --fragment-stdev FLOAT        force the fragment length distribution to have this standard deviation (requires --fragment-mean)" << endl
         << "  --track-provenance            track how internal intermediate alignment candidates were arrived at" << endl
         << "  --track-correctness           track if internal intermediate alignment candidates are correct (implies --track-provenance)" << endl
+        << "  --stage-counts                count items and time in each mapping stage, and report totals at the end" << endl
+        << "  --stage-stats FILE            write per-stage counts and latency percentiles to FILE as JSON at the end" << endl
+        << "  --stage-stats-interval INT    also write a line of stage stats JSON to the --stage-stats file every INT seconds" << endl
+        << "  --capture-slow FILE           save reads or pairs that take too long to map to FILE as GAM, for vg benchmark" << endl
+        << "  --capture-slow-seconds FLOAT  capture reads that take at least this long [watchdog timeout]" << endl
         << "  -B, --batch-size INT          number of reads or pairs per batch to distribute to threads [" << vg::io::DEFAULT_PARALLEL_BATCHSIZE << "]" << endl;
 
         auto helps = parser.get_help();
@@ -461,6 +567,11 @@ int main_giraffe(int argc, char** argv) {
     #define OPT_REF_PATHS 1010
     #define OPT_SHOW_WORK 1011
     #define OPT_NAMED_COORDINATES 1012
+    #define OPT_STAGE_COUNTS 1013
+    #define OPT_STAGE_STATS 1014
+    #define OPT_STAGE_STATS_INTERVAL 1015
+    #define OPT_CAPTURE_SLOW 1016
+    #define OPT_CAPTURE_SLOW_SECONDS 1017
     constexpr int OPT_HAPLOTYPE_NAME = 1100;
     constexpr int OPT_KFF_NAME = 1101;
     constexpr int OPT_INDEX_BASENAME = 1102;
@@ -520,6 +631,16 @@ int main_giraffe(int argc, char** argv) {
     bool track_correctness = MinimizerMapper::default_track_correctness;
     // Should we log our mapping decision making?
     bool show_work = MinimizerMapper::default_show_work;
+    // Should we count items and time in each mapping stage?
+    bool count_stages = false;
+    // Where should we write stage stats JSON, if anywhere?
+    string stage_stats_filename;
+    // How often in seconds should we write it while mapping, if at all?
+    size_t stage_stats_interval = 0;
+    // Where should we save slow reads, if anywhere?
+    string capture_slow_filename;
+    // How slow is slow? 0 means the watchdog timeout.
+    double capture_slow_seconds = 0;
     
     // Should we throw out our alignments instead of outputting them?
     bool discard_alignments = false;
@@ -542,18 +663,6 @@ int main_giraffe(int argc, char** argv) {
     // For GAM format, should we report in named-segment space instead of node ID space?
     bool named_coordinates = false;
 
-    // Map algorithm names to rescue algorithms
-    std::map<std::string, MinimizerMapper::RescueAlgorithm> rescue_algorithms = {
-        { "none", MinimizerMapper::rescue_none },
-        { "dozeu", MinimizerMapper::rescue_dozeu },
-        { "gssw", MinimizerMapper::rescue_gssw },
-    };
-    std::map<MinimizerMapper::RescueAlgorithm, std::string> algorithm_names =  {
-        { MinimizerMapper::rescue_none, "none" },
-        { MinimizerMapper::rescue_dozeu, "dozeu" },
-        { MinimizerMapper::rescue_gssw, "gssw" },
-    };
-    
     // Map preset names to presets
     std::map<std::string, Preset> presets;
     // We have a fast preset that sets a bunch of stuff
@@ -609,6 +718,11 @@ int main_giraffe(int argc, char** argv) {
         {"track-provenance", no_argument, 0, OPT_TRACK_PROVENANCE},
         {"track-correctness", no_argument, 0, OPT_TRACK_CORRECTNESS},
         {"show-work", no_argument, 0, OPT_SHOW_WORK},
+        {"stage-counts", no_argument, 0, OPT_STAGE_COUNTS},
+        {"stage-stats", required_argument, 0, OPT_STAGE_STATS},
+        {"stage-stats-interval", required_argument, 0, OPT_STAGE_STATS_INTERVAL},
+        {"capture-slow", required_argument, 0, OPT_CAPTURE_SLOW},
+        {"capture-slow-seconds", required_argument, 0, OPT_CAPTURE_SLOW_SECONDS},
         {"batch-size", required_argument, 0, 'B'},
         {"threads", required_argument, 0, 't'},
     };
@@ -874,6 +988,26 @@ int main_giraffe(int argc, char** argv) {
                 Explainer::save_explanations = true;
                 break;
                 
+            case OPT_STAGE_COUNTS:
+                count_stages = true;
+                break;
+                
+            case OPT_STAGE_STATS:
+                stage_stats_filename = optarg;
+                break;
+                
+            case OPT_STAGE_STATS_INTERVAL:
+                stage_stats_interval = parse<size_t>(optarg);
+                break;
+                
+            case OPT_CAPTURE_SLOW:
+                capture_slow_filename = optarg;
+                break;
+                
+            case OPT_CAPTURE_SLOW_SECONDS:
+                capture_slow_seconds = parse<double>(optarg);
+                break;
+                
             case 'B':
                 batch_size = parse<uint64_t>(optarg);
                 break;
@@ -963,6 +1097,11 @@ int main_giraffe(int argc, char** argv) {
         exit(1);
     }
     
+    if (stage_stats_interval != 0 && stage_stats_filename.empty()) {
+        cerr << "error:[vg giraffe] Writing stage stats periodically (--stage-stats-interval) requires a file to write them to (--stage-stats)" << endl;
+        exit(1);
+    }
+    
     if (interleaved && !fastq_filename_2.empty()) {
         cerr << "error:[vg giraffe] Cannot designate both interleaved paired ends (-i) and separate paired end file (-f)." << endl;
         exit(1);
@@ -1161,6 +1300,16 @@ int main_giraffe(int argc, char** argv) {
         // Add a header
         report << "#file\treads/second/thread" << endl;
     }
+    
+    // And to write stage stats JSON if requested.
+    ofstream stage_stats;
+    if (!stage_stats_filename.empty()) {
+        stage_stats.open(stage_stats_filename);
+        if (!stage_stats) {
+            cerr << "error:[vg giraffe] Could not open stage stats file " << stage_stats_filename << endl;
+            exit(1);
+        }
+    }
 
     // We need to loop over all the ranges...
     for_each_combo([&]() {
@@ -1227,7 +1376,7 @@ int main_giraffe(int argc, char** argv) {
                 cerr << "--fragment-mean " << fragment_mean << endl; 
                 cerr << "--fragment-stdev " << fragment_stdev << endl;
             }
-            cerr << "--rescue-algorithm " << algorithm_names[rescue_algorithm] << endl;
+            cerr << "--rescue-algorithm " << algorithm_names.at(rescue_algorithm) << endl;
         }
         minimizer_mapper.rescue_algorithm = rescue_algorithm;
 
@@ -1243,6 +1392,23 @@ int main_giraffe(int argc, char** argv) {
         // Set up counters per-thread for total reads mapped
         vector<size_t> reads_mapped_by_thread(thread_count, 0);
         
+        // And for items and time in each stage, if wanted
+        unique_ptr<FunnelStageCounter> stage_counter;
+        if (count_stages || stage_stats.is_open()) {
+            if (show_progress && count_stages) {
+                cerr << "--stage-counts " << endl;
+            }
+            stage_counter.reset(new FunnelStageCounter(thread_count));
+        }
+        
+        // If we are writing stage stats periodically, we do it from a
+        // background thread, which we can wake up to stop it.
+        std::thread stage_stats_thread;
+        std::mutex stage_stats_mutex;
+        std::condition_variable stage_stats_wakeup;
+        bool mapping_done = false;
+        minimizer_mapper.stage_counter = stage_counter.get();
+        
         // For timing, we may run one thread first and then switch to all threads. So track both start times.
         std::chrono::time_point<std::chrono::system_clock> first_thread_start;
         std::chrono::time_point<std::chrono::system_clock> all_threads_start;
@@ -1300,6 +1466,16 @@ int main_giraffe(int argc, char** argv) {
         // Establish a watchdog to find reads that take too long to map.
         // If we see any, we will issue a warning.
         unique_ptr<Watchdog> watchdog(new Watchdog(thread_count, chrono::seconds(main_options.watchdog_timeout)));
+        
+        // And save them for later if requested.
+        unique_ptr<SlowReadCapture> slow_capture;
+        if (!capture_slow_filename.empty()) {
+            chrono::duration<double> threshold(capture_slow_seconds != 0 ? capture_slow_seconds : main_options.watchdog_timeout);
+            slow_capture.reset(new SlowReadCapture(capture_slow_filename, thread_count,
+                                                   chrono::duration_cast<Watchdog::duration>(threshold),
+                                                   SlowReadCapture::command_line(argc, argv),
+                                                   describe_giraffe_mapping_options(parser, rescue_algorithm)));
+        }
 
         {
         
@@ -1347,6 +1523,17 @@ int main_giraffe(int argc, char** argv) {
             first_thread_start = std::chrono::system_clock::now();
             cpu_time_before = clock();
             
+            if (stage_counter && stage_stats_interval != 0) {
+                stage_stats_thread = std::thread([&]() {
+                    std::unique_lock<std::mutex> lock(stage_stats_mutex);
+                    while (!stage_stats_wakeup.wait_for(lock, chrono::seconds(stage_stats_interval), [&]() { return mapping_done; })) {
+                        // Write a snapshot of everything so far.
+                        std::chrono::duration<double> elapsed = std::chrono::system_clock::now() - first_thread_start;
+                        stage_counter->write_json(stage_stats, elapsed.count());
+                    }
+                });
+            }
+            
 #ifdef __linux__
             reset_perf_for_thread();
 #endif
@@ -1396,6 +1583,17 @@ int main_giraffe(int argc, char** argv) {
                     }
                 };
                 
+                // Define how to output a mapped read pair, counting the time
+                // it takes if we are counting stages.
+                auto emit_pair = [&](pair<vector<Alignment>, vector<Alignment>>& mapped_pairs, int64_t tlen_limit) {
+                    auto emit_start = std::chrono::steady_clock::now();
+                    alignment_emitter->emit_mapped_pair(std::move(mapped_pairs.first), std::move(mapped_pairs.second), tlen_limit);
+                    if (stage_counter) {
+                        std::chrono::duration<double> emit_time = std::chrono::steady_clock::now() - emit_start;
+                        stage_counter->record_time("emit", emit_time.count(), omp_get_thread_num());
+                    }
+                };
+                
                 // Define how to align and output a read pair, in a thread.
                 auto map_read_pair = [&](Alignment& aln1, Alignment& aln2) {
                     try {
@@ -1410,6 +1608,13 @@ int main_giraffe(int argc, char** argv) {
                             watchdog->check_in(thread_num, aln1.name() + ", " + aln2.name());
                         }
                         
+                        // Keep the reads as they came in, in case we need to capture them.
+                        Alignment original1, original2;
+                        if (slow_capture) {
+                            original1 = aln1;
+                            original2 = aln2;
+                        }
+                        
                         toUppercaseInPlace(*aln1.mutable_sequence());
                         toUppercaseInPlace(*aln2.mutable_sequence());
 
@@ -1430,7 +1635,7 @@ int main_giraffe(int argc, char** argv) {
                                  tlen_limit = minimizer_mapper.get_fragment_length_mean() + 6 * minimizer_mapper.get_fragment_length_stdev();
                             }
                             // Emit it
-                            alignment_emitter->emit_mapped_pair(std::move(mapped_pairs.first), std::move(mapped_pairs.second), tlen_limit);
+                            emit_pair(mapped_pairs, tlen_limit);
                             // Record that we mapped a read.
                             reads_mapped_by_thread.at(thread_num) += 2;
                         }
@@ -1444,7 +1649,16 @@ int main_giraffe(int argc, char** argv) {
                         }
                         
                         if (watchdog) {
-                            watchdog->check_out(thread_num);
+                            auto elapsed = watchdog->check_out(thread_num);
+                            if (slow_capture && slow_capture->is_slow(elapsed)) {
+                                if (minimizer_mapper.fragment_distr_is_finalized()) {
+                                    slow_capture->capture_pair(original1, original2, elapsed,
+                                                               minimizer_mapper.get_fragment_length_mean(),
+                                                               minimizer_mapper.get_fragment_length_stdev());
+                                } else {
+                                    slow_capture->capture_pair(original1, original2, elapsed);
+                                }
+                            }
                         }
                         
                         clear_crash_context();
@@ -1483,7 +1697,7 @@ int main_giraffe(int argc, char** argv) {
                              tlen_limit = minimizer_mapper.get_fragment_length_mean() + 6 * minimizer_mapper.get_fragment_length_stdev();
                         }
                         // Emit the read
-                        alignment_emitter->emit_mapped_pair(std::move(mapped_pairs.first), std::move(mapped_pairs.second), tlen_limit);
+                        emit_pair(mapped_pairs, tlen_limit);
                         // Record that we mapped a read.
                         reads_mapped_by_thread.at(omp_get_thread_num()) += 2;
                         clear_crash_context();
@@ -1509,6 +1723,12 @@ int main_giraffe(int argc, char** argv) {
                             watchdog->check_in(thread_num, aln.name());
                         }
                         
+                        // Keep the read as it came in, in case we need to capture it.
+                        Alignment original;
+                        if (slow_capture) {
+                            original = aln;
+                        }
+                        
                         toUppercaseInPlace(*aln.mutable_sequence());
                     
                         // Map the read with the MinimizerMapper.
@@ -1517,7 +1737,10 @@ int main_giraffe(int argc, char** argv) {
                         reads_mapped_by_thread.at(thread_num)++;
                         
                         if (watchdog) {
-                            watchdog->check_out(thread_num);
+                            auto elapsed = watchdog->check_out(thread_num);
+                            if (slow_capture && slow_capture->is_slow(elapsed)) {
+                                slow_capture->capture(original, elapsed);
+                            }
                         }
                         clear_crash_context();
                     } catch (const std::exception& ex) {
@@ -1538,6 +1761,16 @@ int main_giraffe(int argc, char** argv) {
                     fastq_unpaired_for_each_parallel(fastq_filename_1, map_read, batch_size);
                 }
             }
+            
+            if (stage_stats_thread.joinable()) {
+                // Stop writing stage stats periodically
+                {
+                    std::lock_guard<std::mutex> lock(stage_stats_mutex);
+                    mapping_done = true;
+                }
+                stage_stats_wakeup.notify_all();
+                stage_stats_thread.join();
+            }
         
         } // Make sure alignment emitter is destroyed and all alignments are on disk.
         
@@ -1609,6 +1842,22 @@ int main_giraffe(int argc, char** argv) {
             cerr << "Memory footprint: " << gbwt::inGigabytes(gbwt::memoryUsage()) << " GB" << endl;
         }
         
+        if (slow_capture && show_progress) {
+            cerr << "Captured " << slow_capture->capture_count() << " slow reads or pairs to " << capture_slow_filename << endl;
+        }
+        
+        if (stage_counter && count_stages) {
+            // Report where the time went
+            cerr << "Mapping stage totals:" << endl;
+            stage_counter->write_table(cerr);
+        }
+        if (stage_counter && stage_stats.is_open()) {
+            // Write the final stats
+            std::chrono::duration<double> elapsed = end - first_thread_start;
+            stage_counter->write_json(stage_stats, elapsed.count());
+        }
+        minimizer_mapper.stage_counter = nullptr;
+        
         
         if (report) {
             // Log output filename and mapping speed in reads/second/thread to report TSV
@@ -0,0 +1,39 @@
+#ifndef VG_SUBCOMMAND_GIRAFFE_OPTIONS_HPP_INCLUDED
+#define VG_SUBCOMMAND_GIRAFFE_OPTIONS_HPP_INCLUDED
+
+/** \file
+ * giraffe_options.hpp: lets other subcommands save and restore the mapping
+ * parameters that "vg giraffe" configures its MinimizerMapper with, so that
+ * reads can be remapped the way Giraffe mapped them.
+ */
+
+#include <string>
+
+#include "options.hpp"
+#include "../minimizer_mapper.hpp"
+
+namespace vg {
+namespace subcommand {
+
+/**
+ * Describe the mapping parameters set in the given Giraffe option parser,
+ * along with the rescue algorithm, which Giraffe handles outside the parser.
+ * The description has one "--option value" line per option, including
+ * defaults and presets.
+ */
+std::string describe_giraffe_mapping_options(const GroupedOptionGroup& parser,
+                                             MinimizerMapper::RescueAlgorithm rescue_algorithm);
+
+/**
+ * Parse a description made by describe_giraffe_mapping_options() with
+ * Giraffe's option parser, and configure the given mapper the way Giraffe
+ * would. If show_progress is set, log the options. Exits with an error if the
+ * description can't be parsed.
+ */
+void apply_giraffe_mapping_options(const std::string& description, MinimizerMapper& minimizer_mapper,
+                                   bool show_progress = false);
+
+}
+}
+
+#endif
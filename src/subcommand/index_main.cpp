@@ -26,6 +26,7 @@
 #include "../gbwt_helper.hpp"
 #include "../gbwtgraph_helper.hpp"
 #include "../gcsa_helper.hpp"
+#include "../mem_accelerator.hpp"
 
 #include <gcsa/algorithms.h>
 #include <gbwt/variants.h>
@@ -73,6 +74,7 @@ void help_index(char** argv) {
          << "    -X, --doubling-steps N use this number of doubling steps for GCSA2 construction (default " << gcsa::ConstructionParameters::DOUBLING_STEPS << ")" << endl
          << "    -Z, --size-limit N     limit temporary disk space usage to N gigabytes (default " << gcsa::ConstructionParameters::SIZE_LIMIT << ")" << endl
          << "    -V, --verify-index     validate the GCSA2 index using the input kmers (important for testing)" << endl
+         << "    --mem-accel N          also save a table of GCSA2 ranges for all N-mers to FILE.mema for vg mpmap" << endl
          << "gam indexing options:" << endl
          << "    -l, --index-sorted-gam input is sorted .gam format alignments, store a GAI index of the sorted GAM in INPUT.gam.gai" << endl
          << "vg in-place indexing options:" << endl
@@ -98,6 +100,7 @@ int main_index(int argc, char** argv) {
     #define OPT_BUILD_VGI_INDEX  1000
     #define OPT_RENAME_VARIANTS  1001
     #define OPT_DISTANCE_SNARL_LIMIT 1002
+    #define OPT_MEM_ACCEL_LENGTH 1003
 
     // Which indexes to build.
     bool build_xg = false, build_gbwt = false, build_gcsa = false, build_dist = false;
@@ -123,6 +126,7 @@ int main_index(int argc, char** argv) {
     gcsa::size_type kmer_size = gcsa::Key::MAX_LENGTH;
     gcsa::ConstructionParameters params;
     bool verify_gcsa = false;
+    size_t mem_accel_length = 0;
     
     // Gam index (GAI)
     bool build_gai_index = false;
@@ -178,6 +182,7 @@ int main_index(int argc, char** argv) {
             {"doubling-steps", required_argument, 0, 'X'},
             {"size-limit", required_argument, 0, 'Z'},
             {"verify-index", no_argument, 0, 'V'},
+            {"mem-accel", required_argument, 0, OPT_MEM_ACCEL_LENGTH},
             
             // GAM index (GAI)
             {"index-sorted-gam", no_argument, 0, 'l'},
@@ -353,6 +358,13 @@ int main_index(int argc, char** argv) {
         case 'V':
             verify_gcsa = true;
             break;
+        case OPT_MEM_ACCEL_LENGTH:
+            mem_accel_length = parse<size_t>(optarg);
+            if (mem_accel_length == 0 || mem_accel_length > 16) {
+                cerr << "error: [vg index] MEM accelerator length must be between 1 and 16" << endl;
+                exit(1);
+            }
+            break;
             
         // Gam index (GAI)
         case 'l':
@@ -447,6 +459,11 @@ int main_index(int argc, char** argv) {
         return 1;
     }
     
+    if (mem_accel_length != 0 && !build_gcsa) {
+        cerr << "error: [vg index] a MEM accelerator table (--mem-accel) can only be built along with a GCSA2 index (-g)" << endl;
+        return 1;
+    }
+    
     if (build_xg && build_gcsa && file_names.empty()) {
         // Really we want to build a GCSA by *reading* and XG
         build_xg = false;
@@ -613,6 +630,15 @@ int main_index(int argc, char** argv) {
         // Save the indexes
         save_gcsa(gcsa_index, gcsa_name, show_progress);
         save_lcp(lcp_array, gcsa_name + ".lcp", show_progress);
+        
+        // Memoize the initial steps of MEM queries for vg mpmap
+        if (mem_accel_length != 0) {
+            if (show_progress) {
+                cerr << "Memoizing GCSA2 queries of length " << mem_accel_length << "..." << endl;
+            }
+            MEMAccelerator accelerator(gcsa_index, mem_accel_length, omp_get_max_threads());
+            accelerator.save(gcsa_name + ".mema");
+        }
 
         // Verify the index
         if (verify_gcsa) {
@@ -94,6 +94,7 @@ void help_mpmap(char** argv) {
     << "graph/index:" << endl
     << "  -x, --graph-name FILE     graph (required; XG format recommended but other formats are valid, see `vg convert`) " << endl
     << "  -g, --gcsa-name FILE      use this GCSA2/LCP index pair for MEMs (required; both FILE and FILE.lcp, see `vg index`)" << endl
+    << "                            (a MEM accelerator table in FILE.mema will also be used if present)" << endl
     //<< "  -H, --gbwt-name FILE         use this GBWT haplotype index for population-based MAPQs" << endl
     << "  -d, --dist-name FILE      use this snarl distance index for clustering (recommended, see `vg index`)" << endl
     //<< "      --linear-index FILE      use this sublinear Li and Stephens index file for population-based MAPQs" << endl
@@ -131,6 +132,7 @@ void help_mpmap(char** argv) {
     << "  -M, --max-multimaps INT   report (up to) this many mappings per read [10 rna / 1 dna]" << endl
     << "  -a, --agglomerate-alns    combine separate multipath alignments into one (possibly disconnected) alignment" << endl
     << "  -r, --intron-distr FILE   intron length distribution (from scripts/intron_length_distribution.py)" << endl
+    << "      --splice-index FILE   annotated splice junctions (from vg rna --write-splice-index)" << endl
     << "  -Q, --mq-max INT          cap mapping quality estimates at this much [60]" << endl
     << "  -b, --frag-sample INT     look for this many unambiguous mappings to estimate the fragment length distribution [1000]" << endl
     << "  -I, --frag-mean FLOAT     mean for a pre-determined fragment length distribution (also requires -D)" << endl
@@ -148,6 +150,8 @@ void help_mpmap(char** argv) {
     //<< "  -K, --clust-length INT       minimum MEM length used in clustering [automatic]" << endl
     //<< "  -F, --stripped-match         use stripped match algorithm instead of MEMs" << endl
     << "  -c, --hit-max INT         use at most this many hits for any match seeds (0 for no limit) [1024 DNA / 100 RNA]" << endl
+    << "      --windowed-cluster    cluster seeds by their coordinates on embedded paths, within a window (ignored with -d)" << endl
+    << "      --cluster-edges INT   connect each seed hit to at most this many others with --windowed-cluster (0 for no limit) [64]" << endl
     //<< "  --approx-exp FLOAT           let the approximate likelihood miscalculate likelihood ratios by this power [10.0 DNA / 5.0 RNA]" << endl
     //<< "  --recombination-penalty FLOAT use this log recombination penalty for GBWT haplotype scoring [20.7]" << endl
     //<< "  --always-check-population    always try to population-score reads, even if there is only a single mapping" << endl
@@ -215,6 +219,9 @@ int main_mpmap(int argc, char** argv) {
     #define OPT_RESEED_LENGTH 1035
     #define OPT_MAX_MOTIF_PAIRS 1036
     #define OPT_SUPPRESS_MISMAPPING_DETECTION 1037
+    #define OPT_SPLICE_INDEX 1038
+    #define OPT_WINDOWED_CLUSTER 1039
+    #define OPT_CLUSTER_EDGES 1040
     string matrix_file_name;
     string graph_name;
     string gcsa_name;
@@ -228,6 +235,7 @@ int main_mpmap(int argc, char** argv) {
     string gam_file_name;
     string ref_paths_name;
     string intron_distr_name;
+    string splice_index_name;
     int match_score = default_match;
     int mismatch_score = default_mismatch;
     int gap_open_score = default_gap_open;
@@ -289,6 +297,8 @@ int main_mpmap(int argc, char** argv) {
     bool use_min_dist_clusterer = false;
     bool greedy_min_dist = false;
     bool component_min_dist = true;
+    bool use_windowed_clusterer = false;
+    size_t max_cluster_edges_per_hit = 64;
     bool no_clustering = false;
     bool qual_adjusted = true;
     bool strip_full_length_bonus = false;
@@ -344,6 +354,7 @@ int main_mpmap(int argc, char** argv) {
     bool use_pessimistic_tail_alignment = false;
     double pessimistic_gap_multiplier = 3.0;
     bool restrained_graph_extraction = false;
+    size_t min_nodes_for_parallel_alignment = 0;
     bool do_spliced_alignment = false;
     int max_softclip_overlap = 8;
     int max_splice_overhang = 2 * max_softclip_overlap;
@@ -443,6 +454,8 @@ int main_mpmap(int argc, char** argv) {
             {"min-dist-cluster", no_argument, 0, OPT_MIN_DIST_CLUSTER},
             {"greedy-min-dist", no_argument, 0, OPT_GREEDY_MIN_DIST},
             {"component-min-dist", no_argument, 0, OPT_COMPONENT_MIN_DIST},
+            {"windowed-cluster", no_argument, 0, OPT_WINDOWED_CLUSTER},
+            {"cluster-edges", required_argument, 0, OPT_CLUSTER_EDGES},
             {"no-cluster", no_argument, 0, OPT_NO_CLUSTER},
             {"drop-subgraph", required_argument, 0, 'C'},
             {"prune-exp", required_argument, 0, OPT_PRUNE_EXP},
@@ -451,6 +464,7 @@ int main_mpmap(int argc, char** argv) {
             {"splice-odds", required_argument, 0, OPT_SPLICE_ODDS},
             {"intron-distr", required_argument, 0, 'r'},
             {"max-motif-pairs", required_argument, 0, OPT_MAX_MOTIF_PAIRS},
+            {"splice-index", required_argument, 0, OPT_SPLICE_INDEX},
             {"read-length", required_argument, 0, 'l'},
             {"nt-type", required_argument, 0, 'n'},
             {"error-rate", required_argument, 0, 'e'},
@@ -787,6 +801,14 @@ int main_mpmap(int argc, char** argv) {
                 component_min_dist = true;
                 break;
                 
+            case OPT_WINDOWED_CLUSTER:
+                use_windowed_clusterer = true;
+                break;
+                
+            case OPT_CLUSTER_EDGES:
+                max_cluster_edges_per_hit = parse<size_t>(optarg);
+                break;
+                
             case OPT_NO_CLUSTER:
                 no_clustering = true;
                 break;
@@ -820,6 +842,10 @@ int main_mpmap(int argc, char** argv) {
                 intron_distr_name = optarg;
                 break;
                 
+            case OPT_SPLICE_INDEX:
+                splice_index_name = optarg;
+                break;
+                
             case 'l':
                 read_length = optarg;
                 break;
@@ -970,6 +996,8 @@ int main_mpmap(int argc, char** argv) {
         full_length_bonus = 0;
         // we don't want to extract huge graphs every time there's an error in the read
         restrained_graph_extraction = true;
+        // a single long read can make a graph large enough that it's worth sharing with idle threads
+        min_nodes_for_parallel_alignment = 1000;
     }
     else if (read_length == "very-short") {
         // clustering is unlikely to improve accuracy in very short data
@@ -1484,6 +1512,10 @@ int main_mpmap(int argc, char** argv) {
         cerr << "error:[vg mpmap] Cannot open LCP file " << lcp_name << endl;
         exit(1);
     }
+    
+    // a prebuilt MEM accelerator is optional
+    string mem_accelerator_name = gcsa_name + ".mema";
+    bool have_mem_accelerator_file = ifstream(mem_accelerator_name).good();
 
     ifstream matrix_stream;
     if (!matrix_file_name.empty()) {
@@ -1503,6 +1535,15 @@ int main_mpmap(int argc, char** argv) {
         }
     }
     
+    ifstream splice_index_stream;
+    if (!splice_index_name.empty()) {
+        splice_index_stream.open(splice_index_name);
+        if (!splice_index_stream) {
+            cerr << "error:[vg mpmap] Cannot open splice junction index file " << splice_index_name << endl;
+            exit(1);
+        }
+    }
+    
     ifstream distance_index_stream;
     if (!distance_index_name.empty() && !(no_clustering && !snarls_name.empty())) {
         distance_index_stream.open(distance_index_name);
@@ -1618,6 +1659,19 @@ int main_mpmap(int argc, char** argv) {
         tie(intron_mixture_weights, intron_component_params) = parse_intron_distr_file(intron_distr_stream);
     }
     
+    unique_ptr<SpliceJunctionIndex> splice_junction_index;
+    if (!splice_index_name.empty()) {
+        log_progress("Loading splice junction index from " + splice_index_name);
+        splice_junction_index = unique_ptr<SpliceJunctionIndex>(new SpliceJunctionIndex());
+        try {
+            splice_junction_index->deserialize(splice_index_stream);
+        }
+        catch (const exception& ex) {
+            cerr << ex.what() << endl;
+            exit(1);
+        }
+    }
+    
     // Configure GCSA2 verbosity so it doesn't spit out loads of extra info
     gcsa::Verbosity::set(gcsa::Verbosity::SILENT);
     
@@ -1779,25 +1833,43 @@ int main_mpmap(int argc, char** argv) {
     unique_ptr<MEMAccelerator> mem_accelerator;
     unique_ptr<gcsa::LCPArray> lcp_array;
     if (!use_stripped_match_alg) {
-        // don't make a huge table for a small graph
-        mem_accelerator_length = min<int>(mem_accelerator_length, round(log(total_seq_length) / log(4.0)));
-        // try to add an active thread
-        int curr_thread_active = threads_active++;
-        if (curr_thread_active >= thread_count) {
-            // take back the increment and don't let it go multithreaded
-            --threads_active;
-            log_progress("Memoizing GCSA2 queries");
-            mem_accelerator = unique_ptr<MEMAccelerator>(new MEMAccelerator(*gcsa_index, mem_accelerator_length));
-            log_progress("Completed memoizing GCSA2 queries");
+        if (have_mem_accelerator_file) {
+            // mapping the prebuilt table in is cheap, so there's no need for a thread
+            log_progress("Loading MEM accelerator from " + mem_accelerator_name);
+            try {
+                mem_accelerator = unique_ptr<MEMAccelerator>(new MEMAccelerator(mem_accelerator_name, *gcsa_index));
+            }
+            catch (const exception& ex) {
+                cerr << ex.what() << endl;
+                exit(1);
+            }
+            log_progress("Completed loading MEM accelerator");
         }
         else {
-            // do the process in a background thread
-            background_processes.emplace_back([&]() {
-                log_progress("Memoizing GCSA2 queries (in background)");
-                mem_accelerator = unique_ptr<MEMAccelerator>(new MEMAccelerator(*gcsa_index, mem_accelerator_length));
+            // don't make a huge table for a small graph
+            mem_accelerator_length = min<int>(mem_accelerator_length, round(log(total_seq_length) / log(4.0)));
+            // try to add an active thread
+            int curr_thread_active = threads_active++;
+            if (curr_thread_active >= thread_count) {
+                // take back the increment and don't let it go multithreaded
                 --threads_active;
+                log_progress("Memoizing GCSA2 queries");
+                mem_accelerator = unique_ptr<MEMAccelerator>(new MEMAccelerator(*gcsa_index, mem_accelerator_length));
                 log_progress("Completed memoizing GCSA2 queries");
-            });
+            }
+            else {
+                // the table build can also have any threads that no other loader has taken
+                int build_threads = 1 + max(thread_count - threads_active.load(), 0);
+                threads_active += build_threads - 1;
+                // do the process in a background thread
+                background_processes.emplace_back([&, build_threads]() {
+                    log_progress("Memoizing GCSA2 queries (in background)");
+                    mem_accelerator = unique_ptr<MEMAccelerator>(new MEMAccelerator(*gcsa_index, mem_accelerator_length,
+                                                                                    build_threads));
+                    threads_active -= build_threads;
+                    log_progress("Completed memoizing GCSA2 queries");
+                });
+            }
         }
         
         // The stripped algorithm doesn't use the LCP, but we aren't doing it
@@ -1966,6 +2038,8 @@ int main_mpmap(int argc, char** argv) {
     multipath_mapper.use_min_dist_clusterer = use_min_dist_clusterer;
     multipath_mapper.greedy_min_dist = greedy_min_dist;
     multipath_mapper.component_min_dist = component_min_dist;
+    multipath_mapper.use_windowed_clusterer = use_windowed_clusterer;
+    multipath_mapper.max_cluster_edges_per_hit = max_cluster_edges_per_hit;
     multipath_mapper.max_expected_dist_approx_error = max_dist_error;
     multipath_mapper.mem_coverage_min_ratio = cluster_ratio;
     multipath_mapper.log_likelihood_approx_factor = likelihood_approx_exp;
@@ -1977,6 +2051,7 @@ int main_mpmap(int argc, char** argv) {
     multipath_mapper.reversing_walk_length = reversing_walk_length;
     multipath_mapper.max_alt_mappings = max_num_mappings;
     multipath_mapper.max_alignment_gap = max_alignment_gap;
+    multipath_mapper.min_nodes_for_parallel_alignment = min_nodes_for_parallel_alignment;
     multipath_mapper.use_pessimistic_tail_alignment = use_pessimistic_tail_alignment;
     multipath_mapper.pessimistic_gap_multiplier = pessimistic_gap_multiplier;
     multipath_mapper.restrained_graph_extraction = restrained_graph_extraction;
@@ -2012,6 +2087,7 @@ int main_mpmap(int argc, char** argv) {
     multipath_mapper.splice_rescue_graph_std_devs = splice_rescue_graph_std_devs;
     multipath_mapper.ref_path_handles = move(ref_path_handles);
     multipath_mapper.max_motif_pairs = max_motif_pairs;
+    multipath_mapper.splice_junction_index = splice_junction_index.get();
     if (!intron_distr_name.empty()) {
         multipath_mapper.set_intron_length_distribution(intron_mixture_weights, intron_component_params);
     }
@@ -3,6 +3,8 @@
 #include "../xg.hpp"
 #include "../utility.hpp"
 #include "../packer.hpp"
+#include "../alignment_field_scanner.hpp"
+#include "../io/arena_for_each.hpp"
 #include <vg/io/stream.hpp>
 #include <vg/io/vpkg.hpp>
 #include <handlegraph/handle_graph.hpp>
@@ -230,8 +232,19 @@ int main_pack(int argc, char** argv) {
     };
 
     if (!gam_in.empty()) {
+        // Packer only looks at the path and the mapping quality, and at the
+        // base qualities when filtering on them. It can work out the read
+        // length from the path, so we don't decode anything else.
+        vector<string> fields {"path", "mapping_quality"};
+        if (min_baseq > 0) {
+            fields.push_back("quality");
+        }
+        AlignmentFieldScanner scanner(fields);
+        function<bool(const string&, string&)> preparse = [&scanner](const string& serialized, string& output) {
+            return scanner.extract(serialized, output);
+        };
         get_input_file(gam_in, [&](istream& in) {
-                vg::io::for_each_parallel(in, lambda, batch_size);
+                vg::io::for_each_parallel_arena(in, lambda, batch_size, preparse);
             });
     } else if (!gaf_in.empty()) {
         // we use this interface so we can ignore sequence, which takes a lot of time to parse
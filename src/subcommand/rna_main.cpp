@@ -10,6 +10,7 @@
 #include "subcommand.hpp"
 
 #include "../transcriptome.hpp"
+#include "../splice_junction_index.hpp"
 #include <vg/io/vpkg.hpp>
 #include <vg/io/stream.hpp>
 #include "../gbwt_helper.hpp"
@@ -56,6 +57,7 @@ void help_rna(char** argv) {
          << "    -b, --write-gbwt FILE      write pantranscriptome transcript paths as GBWT index file" << endl
          << "    -f, --write-fasta FILE     write pantranscriptome transcript sequences as fasta file" << endl
          << "    -i, --write-info FILE      write pantranscriptome transcript info table as tsv file" << endl
+         << "    -x, --write-splice-index FILE  write index of transcript splice-junctions for vg mpmap" << endl
          << "    -q, --out-exclude-ref      exclude reference transcripts from pantranscriptome output" << endl
          << "    -g, --gbwt-bidirectional   use bidirectional paths in GBWT index construction" << endl
 
@@ -88,6 +90,7 @@ int32_t main_rna(int32_t argc, char** argv) {
     bool gbwt_add_bidirectional = false;
     string fasta_out_filename = "";
     string info_out_filename = "";
+    string splice_index_out_filename = "";
     int32_t num_threads = 1;
     bool show_progress = false;
 
@@ -114,6 +117,7 @@ int32_t main_rna(int32_t argc, char** argv) {
                 {"write-gbwt",  required_argument, 0, 'b'},
                 {"write-fasta",  required_argument, 0, 'f'},
                 {"write-info",  required_argument, 0, 'i'},
+                {"write-splice-index",  required_argument, 0, 'x'},
                 {"out-ref-paths",  no_argument, 0, 'u'},
                 {"out-exclude-ref",  no_argument, 0, 'q'},
                 {"gbwt-bidirectional",  no_argument, 0, 'g'},   
@@ -124,7 +128,7 @@ int32_t main_rna(int32_t argc, char** argv) {
             };
 
         int32_t option_index = 0;
-        c = getopt_long(argc, argv, "n:m:y:s:l:zjec:k:dorab:f:i:uqgt:ph?", long_options, &option_index);
+        c = getopt_long(argc, argv, "n:m:y:s:l:zjec:k:dorab:f:i:x:uqgt:ph?", long_options, &option_index);
 
         /* Detect the end of the options. */
         if (c == -1)
@@ -201,6 +205,10 @@ int32_t main_rna(int32_t argc, char** argv) {
             info_out_filename = optarg;
             break;
 
+        case 'x':
+            splice_index_out_filename = optarg;
+            break;
+
         case 'u':
             exclude_reference_transcripts = false;
             break;
@@ -509,6 +517,31 @@ int32_t main_rna(int32_t argc, char** argv) {
         info_ostream.close();
     }    
 
+    // Write splice-junctions along transcript paths as index file.
+    if (!splice_index_out_filename.empty()) {
+
+        vector<vector<handle_t> > transcript_traversals;
+        transcript_traversals.reserve(transcriptome.transcript_paths().size());
+
+        // Transcripts may be embedded in the graph, but only the reference paths show the introns.
+        unordered_set<string> transcript_path_names;
+
+        for (auto & transcript_path: transcriptome.transcript_paths()) {
+
+            transcript_traversals.emplace_back(transcript_path.path);
+            transcript_path_names.insert(transcript_path.get_name());
+        }
+
+        SpliceJunctionIndex splice_junction_index(transcriptome.graph(), transcript_traversals, transcript_path_names);
+
+        ofstream splice_index_ostream;
+        splice_index_ostream.open(splice_index_out_filename);
+
+        splice_junction_index.serialize(splice_index_ostream);
+
+        splice_index_ostream.close();
+    }
+
     if (show_progress) { cerr << "[vg rna] Writing splicing graph to stdout ..." << endl; }
 
     // Write splicing graph to stdout 
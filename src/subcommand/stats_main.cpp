@@ -32,6 +32,7 @@
 #include <bdsg/overlays/overlay_helper.hpp>
 #include "../io/converted_hash_graph.hpp"
 #include "../io/save_handle_graph.hpp"
+#include "../io/arena_for_each.hpp"
 #include "../gbzgraph.hpp"
 
 using namespace std;
@@ -910,7 +911,7 @@ int main_stats(int argc, char** argv) {
         };
 
         // Actually go through all the reads and count stuff up.
-        vg::io::for_each_parallel(alignment_stream, lambda);
+        vg::io::for_each_parallel_arena(alignment_stream, lambda);
         
         // Now combine into a single ReadStats object (for which we pre-populated reads_on_allele with 0s).
         for (auto& per_thread : read_stats) {
@@ -7,6 +7,11 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <iterator>
 
 #include "subcommand.hpp"
 
@@ -19,12 +24,15 @@
 #include <vg/io/stream.hpp>
 #include <vg/io/vpkg.hpp>
 #include "../utility.hpp"
+#include "../io/arena_for_each.hpp"
 #include "../surjector.hpp"
 #include "../hts_alignment_emitter.hpp"
 #include "../multipath_alignment_emitter.hpp"
 #include "../crash.hpp"
 #include "../watchdog.hpp"
 
+#include <atomic_queue.h>
+
 
 using namespace std;
 using namespace vg;
@@ -57,7 +65,11 @@ void help_surject(char** argv) {
          << "  -L, --list-all-paths     annotate SAM records with a list of all attempted re-alignments to paths in SS tag" << endl
          << "  -C, --compression N      level for compression [0-9]" << endl
          << "  -V, --no-validate        skip checking whether alignments plausibly are against the provided graph" << endl
-         << "  -w, --watchdog-timeout N warn when reads take more than the given number of seconds to surject" << endl;
+         << "  -w, --watchdog-timeout N warn when reads take more than the given number of seconds to surject" << endl
+         << "pipeline options (GAM and GAF input only):" << endl
+         << "  --pipeline               read, surject, and compress output in separate stages with their own threads" << endl
+         << "  --write-threads N        use N of the threads to convert and compress output (default: 1/4 of -t)" << endl
+         << "  --report-queues          periodically report how full the queues between the stages are" << endl;
 }
 
 /// If the given alignment doesn't make sense against the given graph (i.e.
@@ -75,6 +87,216 @@ static void ensure_alignment_is_for_graph(const Alignment& aln, const HandleGrap
     }
 }
 
+/// Surjected reads waiting to be emitted, either unpaired or in pairs.
+struct SurjectedBatch {
+    vector<Alignment> singles;
+    vector<Alignment> firsts;
+    vector<Alignment> seconds;
+    vector<int64_t> tlen_limits;
+    /// Runs of consecutive pairs (true) or singles (false) and their
+    /// lengths, in the order they were added, so they can be emitted in that
+    /// order
+    vector<pair<bool, size_t>> runs;
+    
+    void add_pair(Alignment&& first, Alignment&& second, int64_t tlen_limit) {
+        firsts.emplace_back(std::move(first));
+        seconds.emplace_back(std::move(second));
+        tlen_limits.push_back(tlen_limit);
+        add_to_run(true);
+    }
+    
+    void add_single(Alignment&& single) {
+        singles.emplace_back(std::move(single));
+        add_to_run(false);
+    }
+    
+    void clear() {
+        singles.clear();
+        firsts.clear();
+        seconds.clear();
+        tlen_limits.clear();
+        runs.clear();
+    }
+    
+private:
+    
+    void add_to_run(bool is_pair) {
+        if (!runs.empty() && runs.back().first == is_pair) {
+            ++runs.back().second;
+        } else {
+            runs.emplace_back(is_pair, 1);
+        }
+    }
+};
+
+/// A bounded lock-free queue of batches between two stages of the surject
+/// pipeline. It keeps track of how full it is and how often each side had to
+/// wait, so we can tell which stage is the bottleneck.
+template<typename Batch>
+class StageQueue {
+public:
+    
+    StageQueue(size_t capacity, size_t num_producers) : queue(capacity), producers(num_producers) {}
+    
+    ~StageQueue() {
+        Batch* batch;
+        while (queue.try_pop(batch)) {
+            delete batch;
+        }
+    }
+    
+    /// Add a batch, waiting if the queue is full. Takes ownership.
+    void push(Batch* batch) {
+        occupancy_sum += queue.was_size();
+        ++pushes;
+        if (!queue.try_push(batch)) {
+            ++full_waits;
+            while (!queue.try_push(batch)) {
+                this_thread::sleep_for(chrono::microseconds(100));
+            }
+        }
+    }
+    
+    /// Take a batch, waiting if the queue is empty. Returns nullptr once the
+    /// queue is empty and all the producers are done. Caller takes ownership.
+    Batch* pop() {
+        Batch* batch;
+        bool waited = false;
+        while (true) {
+            // Check for the producers finishing before we look in the queue,
+            // so we can't miss a last batch.
+            bool finished = producers.load() == 0;
+            if (queue.try_pop(batch)) {
+                return batch;
+            }
+            if (finished) {
+                return nullptr;
+            }
+            if (!waited) {
+                ++empty_waits;
+                waited = true;
+            }
+            this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+    
+    /// Note that one of the producers will not push any more batches.
+    void producer_done() {
+        --producers;
+    }
+    
+    /// Describe how the queue has been used
+    string report(const string& name) const {
+        stringstream strm;
+        size_t num_pushes = pushes.load();
+        strm << name << " queue: " << num_pushes << " batches, mean occupancy "
+             << (num_pushes == 0 ? 0.0 : double(occupancy_sum.load()) / num_pushes) << " / " << queue.capacity()
+             << ", producers waited " << full_waits.load() << " times, consumers waited "
+             << empty_waits.load() << " times";
+        return strm.str();
+    }
+    
+private:
+    atomic_queue::AtomicQueueB<Batch*> queue;
+    atomic<size_t> producers;
+    atomic<size_t> pushes{0};
+    atomic<size_t> occupancy_sum{0};
+    atomic<size_t> full_waits{0};
+    atomic<size_t> empty_waits{0};
+};
+
+/// Run surjection as three stages connected by bounded queues: one thread
+/// reads and parses the input into batches, surject_threads threads surject
+/// them, and write_threads threads convert and compress the results. All the
+/// stages run as OpenMP threads, so the emitter's per-thread state works.
+/// If interleaved is set, the batches always hold whole pairs.
+static void run_surject_pipeline(const function<void(const function<void(Alignment&)>&)>& for_each_input,
+                                 const function<void(vector<Alignment>&, SurjectedBatch&)>& surject_batch,
+                                 const function<void(SurjectedBatch&)>& emit_batch,
+                                 bool interleaved, size_t surject_threads, size_t write_threads,
+                                 bool report_queues) {
+    
+    // Batch size is even, so pairs stay together
+    const size_t batch_size = 256;
+    const chrono::seconds report_interval(10);
+    
+    StageQueue<vector<Alignment>> input_queue(4 * surject_threads, 1);
+    StageQueue<SurjectedBatch> output_queue(4 * write_threads, surject_threads);
+    
+    auto report = [&]() {
+        #pragma omp critical (cerr)
+        {
+            cerr << "[vg surject] " << input_queue.report("input") << endl;
+            cerr << "[vg surject] " << output_queue.report("output") << endl;
+        }
+    };
+    
+    #pragma omp parallel num_threads(1 + surject_threads + write_threads)
+    {
+        size_t thread_num = omp_get_thread_num();
+        if (omp_get_num_threads() != 1 + surject_threads + write_threads) {
+            #pragma omp single
+            {
+                cerr << "error:[vg surject] could not start " << (1 + surject_threads + write_threads)
+                     << " threads for the surjection pipeline" << endl;
+                exit(1);
+            }
+        }
+        
+        if (thread_num == 0) {
+            // Read stage
+            auto last_report = chrono::steady_clock::now();
+            vector<Alignment>* batch = new vector<Alignment>();
+            batch->reserve(batch_size);
+            for_each_input([&](Alignment& aln) {
+                batch->emplace_back(std::move(aln));
+                if (batch->size() == batch_size) {
+                    input_queue.push(batch);
+                    batch = new vector<Alignment>();
+                    batch->reserve(batch_size);
+                    if (report_queues && chrono::steady_clock::now() - last_report > report_interval) {
+                        report();
+                        last_report = chrono::steady_clock::now();
+                    }
+                }
+            });
+            if (interleaved && batch->size() % 2 != 0) {
+                #pragma omp critical (cerr)
+                cerr << "[vg surject] error: interleaved input has an odd number of alignments" << endl;
+                exit(1);
+            }
+            if (!batch->empty()) {
+                input_queue.push(batch);
+            }
+            else {
+                delete batch;
+            }
+            input_queue.producer_done();
+        }
+        else if (thread_num <= surject_threads) {
+            // Surject stage
+            while (vector<Alignment>* batch = input_queue.pop()) {
+                SurjectedBatch* out = new SurjectedBatch();
+                surject_batch(*batch, *out);
+                delete batch;
+                output_queue.push(out);
+            }
+            output_queue.producer_done();
+        }
+        else {
+            // Write stage
+            while (SurjectedBatch* out = output_queue.pop()) {
+                emit_batch(*out);
+                delete out;
+            }
+        }
+    }
+    
+    if (report_queues) {
+        report();
+    }
+}
+
 int main_surject(int argc, char** argv) {
     
     if (argc == 2) {
@@ -102,6 +324,13 @@ int main_surject(int argc, char** argv) {
     bool annotate_with_all_path_scores = false;
     bool multimap = false;
     bool validate = true;
+    bool pipeline = false;
+    size_t pipeline_write_threads = 0;
+    bool report_queues = false;
+
+    #define OPT_PIPELINE 1000
+    #define OPT_WRITE_THREADS 1001
+    #define OPT_REPORT_QUEUES 1002
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -133,6 +362,9 @@ int main_surject(int argc, char** argv) {
             {"compress", required_argument, 0, 'C'},
             {"no-validate", required_argument, 0, 'V'},
             {"watchdog-timeout", required_argument, 0, 'w'},
+            {"pipeline", no_argument, 0, OPT_PIPELINE},
+            {"write-threads", required_argument, 0, OPT_WRITE_THREADS},
+            {"report-queues", no_argument, 0, OPT_REPORT_QUEUES},
             {0, 0, 0, 0}
         };
 
@@ -239,6 +471,22 @@ int main_surject(int argc, char** argv) {
         case 'L':
             annotate_with_all_path_scores = true;
             break;
+            
+        case OPT_PIPELINE:
+            pipeline = true;
+            break;
+            
+        case OPT_WRITE_THREADS:
+            pipeline_write_threads = parse<size_t>(optarg);
+            if (pipeline_write_threads == 0) {
+                cerr << "error:[vg surject] --write-threads must be at least 1" << endl;
+                exit(1);
+            }
+            break;
+            
+        case OPT_REPORT_QUEUES:
+            report_queues = true;
+            break;
 
         case 'h':
         case '?':
@@ -290,8 +538,13 @@ int main_surject(int argc, char** argv) {
         paths.insert(get<0>(entry));
     }
     
+    // Index the steps on just the paths we surject onto, so we don't have to
+    // look through every other path on each node
+    SurjectionPathIndex path_index(xgidx, paths);
+    
     // Make a single thread-safe Surjector.
     Surjector surjector(xgidx);
+    surjector.path_index = &path_index;
     surjector.adjust_alignments_for_base_quality = qual_adj;
     surjector.prune_suspicious_anchors = prune_anchors;
     surjector.max_anchors = max_anchors;
@@ -308,6 +561,31 @@ int main_surject(int argc, char** argv) {
     // Count our threads
     int thread_count = vg::get_thread_count();
     
+    // Divide them among the pipeline stages, if we're using it
+    size_t pipeline_surject_threads = 0;
+    if (pipeline) {
+        if (input_format != "GAM" && input_format != "GAF") {
+            cerr << "error:[vg surject] --pipeline is only available for GAM and GAF input" << endl;
+            exit(1);
+        }
+        if (thread_count < 3) {
+            // Each stage needs its own thread
+            cerr << "warning:[vg surject] --pipeline needs at least 3 threads; surjecting without it" << endl;
+            pipeline = false;
+        } else {
+            if (pipeline_write_threads == 0) {
+                pipeline_write_threads = max(thread_count / 4, 1);
+            }
+            if (pipeline_write_threads > (size_t) thread_count - 2) {
+                cerr << "error:[vg surject] --write-threads must leave a thread for reading and one for surjecting out of "
+                     << thread_count << " threads" << endl;
+                exit(1);
+            }
+            // one thread always reads the input, and the rest surject
+            pipeline_surject_threads = thread_count - 1 - pipeline_write_threads;
+        }
+    }
+    
     // Prepare the watchdog
     unique_ptr<Watchdog> watchdog(new Watchdog(thread_count, chrono::seconds(watchdog_timeout)));
     
@@ -330,108 +608,224 @@ int main_surject(int argc, char** argv) {
         unique_ptr<AlignmentEmitter> alignment_emitter = get_alignment_emitter("-", 
             output_format, sequence_dictionary, thread_count, xgidx,
             ALIGNMENT_EMITTER_FLAG_HTS_RAW | (spliced * ALIGNMENT_EMITTER_FLAG_HTS_SPLICED));
-
-        if (interleaved) {
-            // GAM input is paired, and for HTS output reads need to know their pair partners' mapping locations.
-            // TODO: We don't preserve order relationships (like primary/secondary) beyond the interleaving.
-            function<void(Alignment&, Alignment&)> lambda = [&](Alignment& src1, Alignment& src2) {
-                try {
-                    set_crash_context(src1.name() + ", " + src2.name());
-                    size_t thread_num = omp_get_thread_num();
-                    if (watchdog) {
-                        watchdog->check_in(thread_num, src1.name() + ", " + src2.name());
-                    }
-                    // Make sure that the alignments are actually paired with each other
-                    // (proper fragment_prev/fragment_next). We want to catch people giving us
-                    // un-interleaved GAMs as interleaved.
-                    // TODO: Integrate into for_each_interleaved_pair_parallel when running on Alignments.
-                    if (src1.has_fragment_next()) {
-                        // Alignment 1 comes first in fragment
-                        if (src1.fragment_next().name() != src2.name() ||
-                            !src2.has_fragment_prev() ||
-                            src2.fragment_prev().name() != src1.name()) {
-                            
+        
+        // Surject a pair of reads and collect the results to emit.
+        // TODO: We don't preserve order relationships (like primary/secondary) beyond the interleaving.
+        auto surject_pair = [&](Alignment& src1, Alignment& src2, SurjectedBatch& out) {
+            // Make sure that the alignments are actually paired with each other
+            // (proper fragment_prev/fragment_next). We want to catch people giving us
+            // un-interleaved GAMs as interleaved.
+            // TODO: Integrate into for_each_interleaved_pair_parallel when running on Alignments.
+            if (src1.has_fragment_next()) {
+                // Alignment 1 comes first in fragment
+                if (src1.fragment_next().name() != src2.name() ||
+                    !src2.has_fragment_prev() ||
+                    src2.fragment_prev().name() != src1.name()) {
+                    
 #pragma omp critical (cerr)
-                            cerr << "[vg surject] error: alignments " << src1.name()
-                            << " and " << src2.name() << " are adjacent but not paired" << endl;
-                            
-                            exit(1);
-                            
-                        }
-                    } else if (src2.has_fragment_next()) {
-                        // Alignment 2 comes first in fragment
-                        if (src2.fragment_next().name() != src1.name() ||
-                            !src1.has_fragment_prev() ||
-                            src1.fragment_prev().name() != src2.name()) {
-                            
+                    cerr << "[vg surject] error: alignments " << src1.name()
+                    << " and " << src2.name() << " are adjacent but not paired" << endl;
+                    
+                    exit(1);
+                    
+                }
+            } else if (src2.has_fragment_next()) {
+                // Alignment 2 comes first in fragment
+                if (src2.fragment_next().name() != src1.name() ||
+                    !src1.has_fragment_prev() ||
+                    src1.fragment_prev().name() != src2.name()) {
+                    
 #pragma omp critical (cerr)
-                            cerr << "[vg surject] error: alignments " << src1.name()
-                            << " and " << src2.name() << " are adjacent but not paired" << endl;
-                            
-                            exit(1);
-                            
-                        }
-                    } else {
-                        // Alignments aren't paired up at all
+                    cerr << "[vg surject] error: alignments " << src1.name()
+                    << " and " << src2.name() << " are adjacent but not paired" << endl;
+                    
+                    exit(1);
+                    
+                }
+            } else {
+                // Alignments aren't paired up at all
 #pragma omp critical (cerr)
-                        cerr << "[vg surject] error: alignments " << src1.name()
-                        << " and " << src2.name() << " are adjacent but not paired" << endl;
-                        
-                        exit(1);
+                cerr << "[vg surject] error: alignments " << src1.name()
+                << " and " << src2.name() << " are adjacent but not paired" << endl;
+                
+                exit(1);
+            }
+            
+            if (validate) {
+                ensure_alignment_is_for_graph(src1, *xgidx);
+                ensure_alignment_is_for_graph(src2, *xgidx);
+            }
+            
+            // Preprocess read to set metadata before surjection
+            set_metadata(src1);
+            set_metadata(src2);
+            
+            // Surject
+            if (multimap) {
+                
+                auto surjected1 = surjector.multi_surject(src1, paths, subpath_global, spliced);
+                auto surjected2 = surjector.multi_surject(src2, paths, subpath_global, spliced);
+                
+                // we have to pair these up manually
+                unordered_map<pair<string, bool>, size_t> strand_idx1, strand_idx2;
+                for (size_t i = 0; i < surjected1.size(); ++i) {
+                    const auto& pos = surjected1[i].refpos(0);
+                    strand_idx1[make_pair(pos.name(), pos.is_reverse())] = i;
+                }
+                for (size_t i = 0; i < surjected2.size(); ++i) {
+                    const auto& pos = surjected2[i].refpos(0);
+                    strand_idx2[make_pair(pos.name(), pos.is_reverse())] = i;
+                }
+                
+                for (size_t i = 0; i < surjected1.size(); ++i) {
+                    const auto& pos = surjected1[i].refpos(0);
+                    auto it = strand_idx2.find(make_pair(pos.name(), !pos.is_reverse()));
+                    if (it != strand_idx2.end()) {
+                        // the alignments are paired on this strand
+                        out.add_pair(move(surjected1[i]), move(surjected2[it->second]), max_frag_len);
                     }
-                    
-                    if (validate) {
-                        ensure_alignment_is_for_graph(src1, *xgidx);
-                        ensure_alignment_is_for_graph(src2, *xgidx);
+                    else {
+                        // this strand's surjection is unpaired
+                        out.add_single(move(surjected1[i]));
                     }
-                    
-                    // Preprocess read to set metadata before surjection
-                    set_metadata(src1);
-                    set_metadata(src2);
-                    
-                    // Surject and emit.
-                    if (multimap) {
-                        
-                        auto surjected1 = surjector.multi_surject(src1, paths, subpath_global, spliced);
-                        auto surjected2 = surjector.multi_surject(src2, paths, subpath_global, spliced);
-                        
-                        // we have to pair these up manually
-                        unordered_map<pair<string, bool>, size_t> strand_idx1, strand_idx2;
-                        for (size_t i = 0; i < surjected1.size(); ++i) {
-                            const auto& pos = surjected1[i].refpos(0);
-                            strand_idx1[make_pair(pos.name(), pos.is_reverse())] = i;
+                }
+                for (size_t i = 0; i < surjected2.size(); ++i) {
+                    const auto& pos = surjected2[i].refpos(0);
+                    if (!strand_idx1.count(make_pair(pos.name(), !pos.is_reverse()))) {
+                        // this strand's surjection is unpaired
+                        out.add_single(move(surjected2[i]));
+                    }
+                }
+            }
+            else {
+                // FIXME: these aren't forced to be on the same path, which could be fucky
+                out.add_pair(surjector.surject(src1, paths, subpath_global, spliced),
+                             surjector.surject(src2, paths, subpath_global, spliced),
+                             max_frag_len);
+            }
+        };
+        
+        // Surject a single read and collect the results to emit.
+        // TODO: We don't preserve order relationships (like primary/secondary).
+        auto surject_single = [&](Alignment& src, SurjectedBatch& out) {
+            if (validate) {
+                ensure_alignment_is_for_graph(src, *xgidx);
+            }
+            
+            // Preprocess read to set metadata before surjection
+            set_metadata(src);
+            
+            if (multimap) {
+                for (auto& surjected : surjector.multi_surject(src, paths, subpath_global, spliced)) {
+                    out.add_single(move(surjected));
+                }
+            }
+            else {
+                out.add_single(surjector.surject(src, paths, subpath_global, spliced));
+            }
+        };
+        
+        // Hand surjected reads to the emitter, which converts and compresses them,
+        // in the order they were surjected
+        auto emit_surjected = [&](SurjectedBatch& out) {
+            if (out.runs.size() == 1) {
+                // Everything is of one kind, so we can hand it all over at once
+                if (out.runs.front().first) {
+                    alignment_emitter->emit_pairs(move(out.firsts), move(out.seconds), move(out.tlen_limits));
+                } else {
+                    alignment_emitter->emit_singles(move(out.singles));
+                }
+            } else {
+                size_t next_pair = 0;
+                size_t next_single = 0;
+                for (auto& run : out.runs) {
+                    if (run.first) {
+                        vector<Alignment> firsts(make_move_iterator(out.firsts.begin() + next_pair),
+                                                 make_move_iterator(out.firsts.begin() + next_pair + run.second));
+                        vector<Alignment> seconds(make_move_iterator(out.seconds.begin() + next_pair),
+                                                  make_move_iterator(out.seconds.begin() + next_pair + run.second));
+                        vector<int64_t> tlen_limits(out.tlen_limits.begin() + next_pair,
+                                                    out.tlen_limits.begin() + next_pair + run.second);
+                        alignment_emitter->emit_pairs(move(firsts), move(seconds), move(tlen_limits));
+                        next_pair += run.second;
+                    } else {
+                        vector<Alignment> singles(make_move_iterator(out.singles.begin() + next_single),
+                                                  make_move_iterator(out.singles.begin() + next_single + run.second));
+                        alignment_emitter->emit_singles(move(singles));
+                        next_single += run.second;
+                    }
+                }
+            }
+            out.clear();
+        };
+
+        if (pipeline) {
+            // Read, surject, and emit in separate stages, so that slow input
+            // or expensive compression doesn't hold up the surjection threads
+            function<void(const function<void(Alignment&)>&)> for_each_input = [&](const function<void(Alignment&)>& iteratee) {
+                if (input_format == "GAM") {
+                    get_input_file(file_name, [&](istream& in) {
+                        vg::io::for_each<Alignment>(in, iteratee);
+                    });
+                } else if (interleaved) {
+                    // Read through the pairing annotations, so we keep the pairs together
+                    vg::io::gaf_paired_interleaved_for_each(*xgidx, file_name, [&](Alignment& src1, Alignment& src2) {
+                        check_gaf_aln(src1);
+                        check_gaf_aln(src2);
+                        iteratee(src1);
+                        iteratee(src2);
+                    });
+                } else {
+                    vg::io::gaf_unpaired_for_each(*xgidx, file_name, [&](Alignment& src) {
+                        check_gaf_aln(src);
+                        iteratee(src);
+                    });
+                }
+            };
+            
+            auto surject_batch = [&](vector<Alignment>& batch, SurjectedBatch& out) {
+                size_t thread_num = omp_get_thread_num();
+                size_t stride = interleaved ? 2 : 1;
+                for (size_t i = 0; i < batch.size(); i += stride) {
+                    try {
+                        string context = interleaved ? batch[i].name() + ", " + batch[i + 1].name() : batch[i].name();
+                        set_crash_context(context);
+                        if (watchdog) {
+                            watchdog->check_in(thread_num, context);
                         }
-                        for (size_t i = 0; i < surjected2.size(); ++i) {
-                            const auto& pos = surjected2[i].refpos(0);
-                            strand_idx2[make_pair(pos.name(), pos.is_reverse())] = i;
+                        if (interleaved) {
+                            surject_pair(batch[i], batch[i + 1], out);
                         }
-                        
-                        for (size_t i = 0; i < surjected1.size(); ++i) {
-                            const auto& pos = surjected1[i].refpos(0);
-                            auto it = strand_idx2.find(make_pair(pos.name(), !pos.is_reverse()));
-                            if (it != strand_idx2.end()) {
-                                // the alignments are paired on this strand
-                                alignment_emitter->emit_pair(move(surjected1[i]), move(surjected2[it->second]), max_frag_len);
-                            }
-                            else {
-                                // this strand's surjection is unpaired
-                                alignment_emitter->emit_single(move(surjected1[i]));
-                            }
+                        else {
+                            surject_single(batch[i], out);
                         }
-                        for (size_t i = 0; i < surjected2.size(); ++i) {
-                            const auto& pos = surjected2[i].refpos(0);
-                            if (!strand_idx1.count(make_pair(pos.name(), !pos.is_reverse()))) {
-                                // this strand's surjection is unpaired
-                                alignment_emitter->emit_single(move(surjected2[i]));
-                            }
+                        if (watchdog) {
+                            watchdog->check_out(thread_num);
                         }
+                        clear_crash_context();
+                    } catch (const std::exception& ex) {
+                        report_exception(ex);
                     }
-                    else {
-                        // FIXME: these aren't forced to be on the same path, which could be fucky
-                        alignment_emitter->emit_pair(surjector.surject(src1, paths, subpath_global, spliced),
-                                                     surjector.surject(src2, paths, subpath_global, spliced),
-                                                     max_frag_len);
+                }
+            };
+            
+            run_surject_pipeline(for_each_input, surject_batch, emit_surjected, interleaved,
+                                 pipeline_surject_threads, pipeline_write_threads, report_queues);
+        } else if (interleaved) {
+            // GAM input is paired, and for HTS output reads need to know their pair partners' mapping locations.
+            function<void(Alignment&, Alignment&)> lambda = [&](Alignment& src1, Alignment& src2) {
+                try {
+                    set_crash_context(src1.name() + ", " + src2.name());
+                    size_t thread_num = omp_get_thread_num();
+                    if (watchdog) {
+                        watchdog->check_in(thread_num, src1.name() + ", " + src2.name());
                     }
+                    
+                    // Surject and emit.
+                    SurjectedBatch out;
+                    surject_pair(src1, src2, out);
+                    emit_surjected(out);
+                    
                     if (watchdog) {
                         watchdog->check_out(thread_num);
                     }
@@ -454,7 +848,6 @@ int main_surject(int argc, char** argv) {
             }
         } else {
             // We can just surject each Alignment by itself.
-            // TODO: We don't preserve order relationships (like primary/secondary).
             function<void(Alignment&)> lambda = [&](Alignment& src) {
                 try {
                     set_crash_context(src.name());
@@ -462,20 +855,12 @@ int main_surject(int argc, char** argv) {
                     if (watchdog) {
                         watchdog->check_in(thread_num, src.name());
                     }
-                    if (validate) {
-                        ensure_alignment_is_for_graph(src, *xgidx);
-                    }
-                    
-                    // Preprocess read to set metadata before surjection
-                    set_metadata(src);
                     
                     // Surject and emit the single read.
-                    if (multimap) {
-                        alignment_emitter->emit_singles(surjector.multi_surject(src, paths, subpath_global, spliced));
-                    }
-                    else {
-                        alignment_emitter->emit_single(surjector.surject(src, paths, subpath_global, spliced));
-                    }
+                    SurjectedBatch out;
+                    surject_single(src, out);
+                    emit_surjected(out);
+                    
                     if (watchdog) {
                         watchdog->check_out(thread_num);
                     }
@@ -486,7 +871,7 @@ int main_surject(int argc, char** argv) {
             };
             if (input_format == "GAM") {
                 get_input_file(file_name, [&](istream& in) {
-                    vg::io::for_each_parallel<Alignment>(in,lambda);
+                    vg::io::for_each_parallel_arena<Alignment>(in, lambda);
                 });
             } else {
                 auto gaf_checking_lambda = [&](Alignment& src) {
@@ -18,6 +18,7 @@
 #include "../snarl_distance_index.hpp"
 #include "../gfa.hpp"
 #include "../io/json_stream_helper.hpp"
+#include "../io/arena_for_each.hpp"
 #include "../handle.hpp"
 #include "../algorithms/gfa_to_handle.hpp"
 
@@ -574,17 +575,19 @@ int main_view(int argc, char** argv) {
         if (!input_json) {
             if (output_type == "json") {
                 // convert values to printable ones
-                function<void(Alignment&)> lambda = [](Alignment& a) {
+                function<void(Alignment&, string&)> format = [](Alignment& a, string& out) {
                     if(std::isnan(a.identity())) {
                         // Fix up NAN identities that can't be serialized in
                         // JSON. We shouldn't generate these any more, and they
                         // are out of spec, but they can be in files.
                         a.set_identity(0);
                     }
-                    cout << pb2json(a) << "\n";
+                    out += pb2json(a);
+                    out += "\n";
                 };
                 get_input_file(file_name, [&](istream& in) {
-                    vg::io::for_each(in, lambda);
+                    // Convert batches in parallel, but keep them in order
+                    vg::io::format_parallel_ordered(in, cout, format);
                 });
             } else if (output_type == "fastq") {
                 function<void(Alignment&)> lambda = [](Alignment& a) {
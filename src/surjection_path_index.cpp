@@ -0,0 +1,107 @@
+#include "surjection_path_index.hpp"
+
+#include <algorithm>
+
+//#define debug_surjection_path_index
+
+namespace vg {
+
+    SurjectionPathIndex::SurjectionPathIndex(const PathPositionHandleGraph* graph,
+                                             const unordered_set<path_handle_t>& paths) {
+        
+        // give the paths a stable order so that the records are deterministic
+        path_handles.assign(paths.begin(), paths.end());
+        sort(path_handles.begin(), path_handles.end(), [&](const path_handle_t& a, const path_handle_t& b) {
+            return graph->get_path_name(a) < graph->get_path_name(b);
+        });
+        path_number.reserve(path_handles.size());
+        for (uint32_t i = 0; i < path_handles.size(); ++i) {
+            path_number[path_handles[i]] = i;
+        }
+        
+        // walk each path and record its steps with their offsets
+        path_steps.resize(path_handles.size());
+        vector<vector<step_record_t>> path_records(path_handles.size());
+#pragma omp parallel for schedule(dynamic, 1)
+        for (size_t i = 0; i < path_handles.size(); ++i) {
+            auto& steps = path_steps[i];
+            auto& recs = path_records[i];
+            steps.reserve(graph->get_step_count(path_handles[i]));
+            recs.reserve(steps.capacity());
+            size_t offset = 0;
+            graph->for_each_step_in_path(path_handles[i], [&](const step_handle_t& step) {
+                handle_t handle = graph->get_handle_of_step(step);
+                recs.push_back(step_record_t{graph->get_id(handle), offset, steps.size(), (uint32_t) i,
+                                             graph->get_is_reverse(handle)});
+                steps.push_back(step);
+                offset += graph->get_length(handle);
+            });
+        }
+        
+        size_t total = 0;
+        for (const auto& recs : path_records) {
+            total += recs.size();
+        }
+        records.reserve(total);
+        for (auto& recs : path_records) {
+            records.insert(records.end(), recs.begin(), recs.end());
+            vector<step_record_t>().swap(recs);
+        }
+        
+        // the records are already in path and offset order within each node,
+        // so a stable sort on the node ID is enough
+        stable_sort(records.begin(), records.end(), [](const step_record_t& a, const step_record_t& b) {
+            return a.node_id < b.node_id;
+        });
+        
+#ifdef debug_surjection_path_index
+        cerr << "indexed " << records.size() << " steps on " << path_handles.size() << " paths" << endl;
+#endif
+    }
+    
+    bool SurjectionPathIndex::covers(const unordered_set<path_handle_t>& paths) const {
+        if (paths.size() > path_handles.size()) {
+            return false;
+        }
+        for (const path_handle_t& path : paths) {
+            if (!path_number.count(path)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    pair<vector<SurjectionPathIndex::step_record_t>::const_iterator, vector<SurjectionPathIndex::step_record_t>::const_iterator>
+    SurjectionPathIndex::records_on_node(const nid_t& node_id) const {
+        auto begin = lower_bound(records.begin(), records.end(), node_id, [](const step_record_t& rec, const nid_t& id) {
+            return rec.node_id < id;
+        });
+        auto end = begin;
+        while (end != records.end() && end->node_id == node_id) {
+            ++end;
+        }
+        return make_pair(begin, end);
+    }
+    
+    void SurjectionPathIndex::for_each_step_on_node(const nid_t& node_id,
+                                                    const function<void(const step_handle_t&, const path_handle_t&, bool)>& iteratee) const {
+        auto range = records_on_node(node_id);
+        for (auto it = range.first; it != range.second; ++it) {
+            iteratee(path_steps[it->path_number][it->rank], path_handles[it->path_number], it->is_reverse);
+        }
+    }
+    
+    size_t SurjectionPathIndex::get_position_of_step(const nid_t& node_id, const step_handle_t& step) const {
+        auto range = records_on_node(node_id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (path_steps[it->path_number][it->rank] == step) {
+                return it->offset;
+            }
+        }
+        throw runtime_error("error:[SurjectionPathIndex] step is not on an indexed path on node " + to_string(node_id));
+    }
+    
+    size_t SurjectionPathIndex::size() const {
+        return records.size();
+    }
+}
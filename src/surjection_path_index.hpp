@@ -0,0 +1,84 @@
+#ifndef VG_SURJECTION_PATH_INDEX_HPP_INCLUDED
+#define VG_SURJECTION_PATH_INDEX_HPP_INCLUDED
+
+/** \file
+ *
+ * Contains an index of the steps that a chosen set of embedded paths take
+ * on each node, for use in surjection
+ */
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+
+#include "handle.hpp"
+
+namespace vg {
+    
+    using namespace std;
+    
+    /*
+     * A compact, sorted index from node IDs to the steps that a fixed set of
+     * paths take on them, along with the path offset of each step. Graphs can
+     * have many more paths over a node than the handful we are surjecting onto,
+     * so this lets the surjector skip the rest without enumerating them.
+     */
+    class SurjectionPathIndex {
+    public:
+        
+        /// Index the steps of the given paths
+        SurjectionPathIndex(const PathPositionHandleGraph* graph,
+                            const unordered_set<path_handle_t>& paths);
+        
+        /// Returns true if every one of these paths is indexed
+        bool covers(const unordered_set<path_handle_t>& paths) const;
+        
+        /// Execute an iteratee on each indexed step on a node, along with its
+        /// path and whether the path visits the node in reverse. Steps are
+        /// given in path and then offset order.
+        void for_each_step_on_node(const nid_t& node_id,
+                                   const function<void(const step_handle_t&, const path_handle_t&, bool)>& iteratee) const;
+        
+        /// Returns the offset of the beginning of a step on one of the indexed
+        /// paths, which must be on the given node.
+        size_t get_position_of_step(const nid_t& node_id, const step_handle_t& step) const;
+        
+        /// Returns the number of indexed steps
+        size_t size() const;
+        
+    private:
+        
+        /// A step on one of the indexed paths
+        struct step_record_t {
+            /// The node the step visits
+            nid_t node_id;
+            /// The offset of the step along its path
+            size_t offset;
+            /// The index of the step along its path
+            size_t rank;
+            /// The index of the path among the indexed paths
+            uint32_t path_number;
+            /// Does the path visit the node in reverse?
+            bool is_reverse;
+        };
+        
+        /// Get the range of records on a node
+        pair<vector<step_record_t>::const_iterator, vector<step_record_t>::const_iterator>
+        records_on_node(const nid_t& node_id) const;
+        
+        /// The step records, sorted by node ID, path number, and offset
+        vector<step_record_t> records;
+        
+        /// The indexed paths
+        vector<path_handle_t> path_handles;
+        
+        /// The steps of each indexed path, in order
+        vector<vector<step_handle_t>> path_steps;
+        
+        /// The index of each path among the indexed paths
+        unordered_map<path_handle_t, uint32_t> path_number;
+    };
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "sequence_complexity.hpp"
 #include "alignment.hpp"
 #include "utility.hpp"
+#include "wang_hash.hpp"
 #include "memoizing_graph.hpp"
 #include "multipath_alignment_graph.hpp"
 #include "reverse_graph.hpp"
@@ -36,6 +37,7 @@ using namespace std;
         if (!graph) {
             cerr << "error:[Surjector] Failed to provide an graph to the Surjector" << endl;
         }
+        path_graph_caches.resize(get_thread_count());
     }
     
     Alignment Surjector::surject(const Alignment& source, const unordered_set<path_handle_t>& paths,
@@ -2983,30 +2985,13 @@ using namespace std;
             // nonempty path interval that they cover.
             assert(ref_path_interval.first <= ref_path_interval.second);
             
-            // get the path graph corresponding to this interval
-            bdsg::HashGraph path_graph;
-            unordered_map<id_t, pair<id_t, bool>> node_trans = extract_linearized_path_graph(path_position_graph, &path_graph, path_handle,
-                                                                                             ref_path_interval.first, ref_path_interval.second);
-            
-            // choose an orientation for the path graph
-            ReverseGraph rev_comp_path_graph(&path_graph, true);
-            HandleGraph* aln_graph;
-            if (rev_strand) {
-                // we align to the reverse strand of the path graph, and the translation chages accordingly
-                aln_graph = &rev_comp_path_graph;
-                for (pair<const id_t, pair<id_t, bool>>& translation : node_trans) {
-                    translation.second.second = !translation.second.second;
-                }
-            }
-            else {
-                aln_graph = &path_graph;
-            }
-            
-#ifdef debug_anchored_surject
-            cerr << "made split, linearized path graph with " << aln_graph->get_node_count() << " nodes" << endl;
-#endif
-
-            size_t subgraph_bases = aln_graph->get_total_length();
+            // the path graph may be made for a wider window, so measure the nodes that
+            // this interval touches
+            step_handle_t first_step = path_position_graph->get_step_at_position(path_handle, ref_path_interval.first);
+            step_handle_t last_step = path_position_graph->get_step_at_position(path_handle, ref_path_interval.second);
+            size_t subgraph_bases = (path_position_graph->get_position_of_step(last_step)
+                                     + path_position_graph->get_length(path_position_graph->get_handle_of_step(last_step))
+                                     - path_position_graph->get_position_of_step(first_step));
             if (subgraph_bases > max_subgraph_bases) {
 #ifdef debug_always_warn_on_too_long
                 cerr << "gave up on too long read " + source.name() + "\n";
@@ -3019,6 +3004,19 @@ using namespace std;
                 return move(make_null_alignment(source)); 
             }
             
+            // get the path graph corresponding to this interval
+            shared_ptr<PathIntervalGraph> path_graph = get_path_interval_graph(path_position_graph, path_handle,
+                                                                               ref_path_interval.first,
+                                                                               ref_path_interval.second);
+            
+            // choose an orientation for the path graph, and the translation changes accordingly
+            const HandleGraph* aln_graph = rev_strand ? (const HandleGraph*) &path_graph->rev_comp_graph : &path_graph->graph;
+            const unordered_map<id_t, pair<id_t, bool>>& node_trans = rev_strand ? path_graph->rev_node_trans : path_graph->node_trans;
+            
+#ifdef debug_anchored_surject
+            cerr << "made split, linearized path graph with " << aln_graph->get_node_count() << " nodes" << endl;
+#endif
+            
             // compute the connectivity between the path chunks
             // TODO: i'm not sure if we actually need to preserve all indel anchors in either case, but i don't
             // want to change too much about the anchoring logic at once while i'm switching from blanket preservation
@@ -3265,6 +3263,15 @@ using namespace std;
         
         // map from (path, strand, subpath idx) to indexes among path chunks that have outgoing connections
         unordered_map<tuple<path_handle_t, bool, size_t>, vector<size_t>> connection_sources;
+        
+        // can we find the steps on the surjection paths without asking the graph?
+        bool use_index = path_index && path_index->covers(surjection_paths);
+        auto position_of_step = [&](const step_handle_t& step) {
+            if (use_index) {
+                return path_index->get_position_of_step(graph->get_id(graph->get_handle_of_step(step)), step);
+            }
+            return graph->get_position_of_step(step);
+        };
                 
         // the mappings (subpath, mapping, step) that have already been associated
         unordered_set<tuple<int64_t, int64_t, step_handle_t>> associated;
@@ -3275,13 +3282,11 @@ using namespace std;
                 const auto& mapping = path.mapping(j);
                 const auto& pos = mapping.position();
                 handle_t handle = graph->get_handle(pos.node_id(), pos.is_reverse());
-                graph->for_each_step_on_handle(handle, [&](const step_handle_t& step) {
-                    
-                    path_handle_t path_handle = graph->get_path_handle_of_step(step);
+                for_each_surjection_step(graph, handle, surjection_paths, use_index,
+                                         [&](const step_handle_t& step, const path_handle_t& path_handle, bool step_is_reverse) {
                     
-                    if (!surjection_paths.count(path_handle) || associated.count(make_tuple(i, j, step))) {
-                        // this is not on a path we're surjecting to, or we've already
-                        // done it
+                    if (associated.count(make_tuple(i, j, step))) {
+                        // we've already done it
                         return;
                     }
                     
@@ -3318,7 +3323,7 @@ using namespace std;
                             if (added_new_mappings) {
                                 
                                 // a DFS traveresal has gone as far as possible, output the stack as a path
-                                auto path_strand = make_pair(path_handle, handle != graph->get_handle_of_step(step));
+                                auto path_strand = make_pair(path_handle, graph->get_is_reverse(handle) != step_is_reverse);
                                 auto& section_record = to_return[path_strand];
                                 
                                 if (m_idx + 1 == path_here.mapping_size() && !subpath_here.connection().empty()) {
@@ -3390,17 +3395,17 @@ using namespace std;
                                             int64_t dist;
                                             if (path_strand.second) {
                                                 // reverse strand of path
-                                                dist = (graph->get_position_of_step(step1)
+                                                dist = (position_of_step(step1)
                                                         + graph->get_length(graph->get_handle_of_step(step1))
-                                                        - graph->get_position_of_step(step2)
+                                                        - position_of_step(step2)
                                                         - graph->get_length(graph->get_handle_of_step(step2))
                                                         + offset(pos2)
                                                         - offset(pos1));
                                             }
                                             else {
                                                 // forward strand of path
-                                                dist = (graph->get_position_of_step(step2)
-                                                        - graph->get_position_of_step(step1)
+                                                dist = (position_of_step(step2)
+                                                        - position_of_step(step1)
                                                         + offset(pos2)
                                                         - offset(pos1));
                                             }
@@ -3547,6 +3552,9 @@ using namespace std;
         
         const Path& path = source.path();
         
+        // can we find the steps on the surjection paths without asking the graph?
+        bool use_index = path_index && path_index->covers(surjection_paths);
+        
         // for each path that we're extending, the previous step and the strand we were at on it
         // mapped to the index of that path chunk in the path's vector
         unordered_map<pair<step_handle_t, bool>, size_t> extending_steps;
@@ -3566,28 +3574,20 @@ using namespace std;
             
             unordered_map<pair<step_handle_t, bool>, size_t> next_extending_steps;
             
-            for (const step_handle_t& step : graph->steps_of_handle(handle)) {
+            for_each_surjection_step(graph, handle, surjection_paths, use_index,
+                                     [&](const step_handle_t& step, const path_handle_t& path_handle, bool step_is_reverse) {
                 
 #ifdef debug_anchored_surject
-                cerr << "found a step on " << graph->get_path_name(graph->get_path_handle_of_step(step)) << endl;
+                cerr << "found a step on " << graph->get_path_name(path_handle) << endl;
 #endif
                 
-                path_handle_t path_handle = graph->get_path_handle_of_step(step);
-                if (!surjection_paths.count(path_handle)) {
-                    // we are not surjecting onto this path
-#ifdef debug_anchored_surject
-                    cerr << "not surjecting to this path, skipping" << endl;
-#endif
-                    continue;
-                }
-                
                 // We always see paths on the forward strand, so we need to
                 // work out if the read is running along the path in the path's
                 // forward (false) or reverse (true) direction.
                 //
                 // If the read visits the node in a different orientation than
                 // the path does, then the read runs along the path in reverse.
-                bool path_strand = graph->get_is_reverse(handle) != graph->get_is_reverse(graph->get_handle_of_step(step));
+                bool path_strand = graph->get_is_reverse(handle) != step_is_reverse;
                 
                 step_handle_t prev_step = path_strand ? graph->get_next_step(step) : graph->get_previous_step(step);
                 
@@ -3664,7 +3664,7 @@ using namespace std;
                     cerr << "no preceeding chunk so start new chunk " << path_chunks.first.size() - 1 << endl;
 #endif
                 }
-            }
+            });
             
             // we've finished extending the steps from the previous mapping, so we replace them
             // with the steps we found in this iteration that we want to extend on the next one
@@ -3674,6 +3674,30 @@ using namespace std;
         return to_return;
     }
 
+    void Surjector::for_each_surjection_step(const PathPositionHandleGraph* graph, const handle_t& handle,
+                                             const unordered_set<path_handle_t>& surjection_paths, bool use_index,
+                                             const function<void(const step_handle_t&, const path_handle_t&, bool)>& iteratee) const {
+        if (use_index) {
+            // only the surjection paths are in the index, so we don't need to
+            // look at any other steps
+            path_index->for_each_step_on_node(graph->get_id(handle), [&](const step_handle_t& step,
+                                                                         const path_handle_t& path_handle,
+                                                                         bool step_is_reverse) {
+                if (surjection_paths.count(path_handle)) {
+                    iteratee(step, path_handle, step_is_reverse);
+                }
+            });
+        }
+        else {
+            for (const step_handle_t& step : graph->steps_of_handle(handle)) {
+                path_handle_t path_handle = graph->get_path_handle_of_step(step);
+                if (surjection_paths.count(path_handle)) {
+                    iteratee(step, path_handle, graph->get_is_reverse(graph->get_handle_of_step(step)));
+                }
+            }
+        }
+    }
+
     void Surjector::filter_redundant_path_chunks(bool path_rev, vector<path_chunk_t>& path_chunks,
                                                  vector<pair<step_handle_t, step_handle_t>>& ref_chunks,
                                                  vector<tuple<size_t, size_t, int32_t>>& connections) const {
@@ -4121,6 +4145,57 @@ using namespace std;
         return interval;
     }
     
+    shared_ptr<Surjector::PathIntervalGraph>
+    Surjector::get_path_interval_graph(const PathPositionHandleGraph* graph, path_handle_t path_handle,
+                                       size_t first, size_t last) const {
+        
+        // find this thread's cache, if we are caching
+        LRUCache<size_t, shared_ptr<PathIntervalGraph>>* cache = nullptr;
+        size_t thread_num = omp_get_thread_num();
+        if (path_graph_cache_size != 0 && thread_num < path_graph_caches.size()) {
+            auto& thread_cache = path_graph_caches[thread_num];
+            if (!thread_cache) {
+                thread_cache.reset(new LRUCache<size_t, shared_ptr<PathIntervalGraph>>(path_graph_cache_size));
+            }
+            cache = thread_cache.get();
+            
+            if (path_graph_window != 0) {
+                // widen the interval out to whole windows, so that reads from nearby
+                // get the same graph. the interval already has room for the longest
+                // gaps the read's tails could align with, so the extra sequence
+                // shouldn't be reached
+                first -= first % path_graph_window;
+                last = min((last / path_graph_window + 1) * path_graph_window - 1,
+                           graph->get_path_length(path_handle) - 1);
+            }
+        }
+        
+        // entries are keyed on a hash of the interval, so we check for collisions
+        size_t key = wang_hash_64(wang_hash_64(wang_hash_64(as_integer(path_handle)) ^ first) ^ last);
+        if (cache) {
+            auto cached = cache->retrieve(key);
+            if (cached.second && cached.first->path_handle == path_handle
+                && cached.first->first == first && cached.first->last == last) {
+                return cached.first;
+            }
+        }
+        
+        shared_ptr<PathIntervalGraph> path_graph = make_shared<PathIntervalGraph>();
+        path_graph->path_handle = path_handle;
+        path_graph->first = first;
+        path_graph->last = last;
+        path_graph->node_trans = extract_linearized_path_graph(graph, &path_graph->graph, path_handle, first, last);
+        path_graph->rev_node_trans = path_graph->node_trans;
+        for (pair<const id_t, pair<id_t, bool>>& translation : path_graph->rev_node_trans) {
+            translation.second.second = !translation.second.second;
+        }
+        
+        if (cache) {
+            cache->put(key, path_graph);
+        }
+        return path_graph;
+    }
+    
     unordered_map<id_t, pair<id_t, bool>>
     Surjector::extract_linearized_path_graph(const PathPositionHandleGraph* graph, MutableHandleGraph* into,
                                              path_handle_t path_handle, size_t first, size_t last) const {
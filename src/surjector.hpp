@@ -11,11 +11,17 @@
 #include <sstream>
 #include <algorithm>
 #include <functional>
+#include <memory>
 
 #include "aligner.hpp"
 #include "handle.hpp"
 #include <vg/vg.pb.h>
 #include "multipath_alignment.hpp"
+#include "surjection_path_index.hpp"
+#include "reverse_graph.hpp"
+#include "lru_cache.h"
+
+#include "bdsg/hash_graph.hpp"
 
 
 namespace vg {
@@ -132,8 +138,53 @@ using namespace std;
         
         bool annotate_with_all_path_scores = false;
         
+        /// An optional index of the steps on the paths we surject onto, built
+        /// over the same graph. It is used in place of graph step queries
+        /// whenever it covers all of the paths being surjected onto.
+        const SurjectionPathIndex* path_index = nullptr;
+        
+        /// How many linearized path interval graphs should each thread keep
+        /// around for realignment? Reads from the same locus often realign
+        /// against the same interval. 0 disables the cache.
+        size_t path_graph_cache_size = 16;
+        
+        /// Cached path interval graphs cover the needed interval widened out
+        /// to multiples of this many bases, so that reads from the same locus
+        /// can share them. 0 caches only exact intervals.
+        size_t path_graph_window = 1024;
+        
     protected:
         
+        /**
+         * A linearized copy of a path interval, ready to align against on
+         * either strand, with translations back to the surjection graph.
+         */
+        struct PathIntervalGraph {
+            PathIntervalGraph() : rev_comp_graph(&graph, true) {}
+            PathIntervalGraph(const PathIntervalGraph& other) = delete;
+            PathIntervalGraph& operator=(const PathIntervalGraph& other) = delete;
+            
+            /// The path and offset interval this graph was made from, which
+            /// may be wider than the one that was asked for
+            path_handle_t path_handle;
+            size_t first;
+            size_t last;
+            /// The linearized path graph
+            bdsg::HashGraph graph;
+            /// Overlay of the reverse strand of the path graph
+            ReverseGraph rev_comp_graph;
+            /// Translations from the path graph and from its reverse strand
+            unordered_map<id_t, pair<id_t, bool>> node_trans;
+            unordered_map<id_t, pair<id_t, bool>> rev_node_trans;
+        };
+        
+        /// Get a linearized graph containing a path interval, from this
+        /// thread's cache if it has been made recently. When caching, the
+        /// graph covers the whole windows that the interval touches.
+        shared_ptr<PathIntervalGraph> get_path_interval_graph(const PathPositionHandleGraph* graph,
+                                                              path_handle_t path_handle,
+                                                              size_t first, size_t last) const;
+        
         void surject_internal(const Alignment* source_aln, const multipath_alignment_t* source_mp_aln,
                               vector<Alignment>* alns_out, vector<multipath_alignment_t>* mp_alns_out,
                               const unordered_set<path_handle_t>& paths,
@@ -179,6 +230,12 @@ using namespace std;
                                   const unordered_set<path_handle_t>& surjection_paths,
                                   unordered_map<pair<path_handle_t, bool>, vector<tuple<size_t, size_t, int32_t>>>& connections_out) const;
         
+        /// execute an iteratee on each step on a handle's node that is on one of the surjection
+        /// paths, along with its path and whether the path visits the node in reverse
+        void for_each_surjection_step(const PathPositionHandleGraph* graph, const handle_t& handle,
+                                      const unordered_set<path_handle_t>& surjection_paths, bool use_index,
+                                      const function<void(const step_handle_t&, const path_handle_t&, bool)>& iteratee) const;
+        
         /// remove any path chunks and corresponding ref chunks that are identical to a longer
         /// path chunk over the region where they overlap
         void filter_redundant_path_chunks(bool path_rev, vector<path_chunk_t>& path_chunks,
@@ -271,6 +328,10 @@ using namespace std;
         
         /// the graph we're surjecting onto
         const PathPositionHandleGraph* graph = nullptr;
+        
+        /// Per-thread LRU caches of path interval graphs, keyed by a hash of
+        /// the window. Each cache is created by its own thread on first use.
+        mutable vector<unique_ptr<LRUCache<size_t, shared_ptr<PathIntervalGraph>>>> path_graph_caches;
     };
 
 
@@ -0,0 +1,100 @@
+/// \file alignment_field_scanner.cpp
+///
+/// Unit tests for decoding parts of serialized Alignments
+///
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <vg/vg.pb.h>
+#include "../alignment_field_scanner.hpp"
+#include "catch.hpp"
+
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+/// Make a serialized three-node alignment with a substitution on each node
+static string make_serialized_alignment(Alignment& aln) {
+    aln.set_name("read1");
+    aln.set_sequence("GATTACAGATTAC");
+    aln.set_quality(string(13, 30));
+    aln.set_mapping_quality(37);
+    for (size_t i = 0; i < 3; i++) {
+        Mapping* mapping = aln.mutable_path()->add_mapping();
+        mapping->mutable_position()->set_node_id(10 + i);
+        mapping->mutable_position()->set_offset(i);
+        mapping->mutable_position()->set_is_reverse(i == 1);
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(3);
+        edit->set_to_length(3);
+        edit = mapping->add_edit();
+        edit->set_from_length(1);
+        edit->set_to_length(1);
+        edit->set_sequence("C");
+    }
+    string serialized;
+    aln.SerializeToString(&serialized);
+    return serialized;
+}
+
+TEST_CASE("AlignmentFieldScanner decodes only the fields it is asked for", "[alignment][gam]") {
+
+    Alignment original;
+    string serialized = make_serialized_alignment(original);
+    string scratch;
+    Alignment partial;
+
+    SECTION("Paths and scalars come through whole") {
+        AlignmentFieldScanner scanner({"path", "mapping_quality"});
+        REQUIRE(scanner.parse(serialized, partial, scratch));
+        REQUIRE(partial.name().empty());
+        REQUIRE(partial.sequence().empty());
+        REQUIRE(partial.quality().empty());
+        REQUIRE(partial.mapping_quality() == 37);
+        REQUIRE(partial.path().SerializeAsString() == original.path().SerializeAsString());
+    }
+
+    SECTION("Paths can be reduced to whether they are mapped") {
+        AlignmentFieldScanner scanner({"name"});
+        scanner.keep_only_path_presence();
+        REQUIRE(scanner.parse(serialized, partial, scratch));
+        REQUIRE(partial.name() == "read1");
+        REQUIRE(partial.path().mapping_size() == 1);
+        REQUIRE(partial.path().mapping(0).edit_size() == 0);
+
+        Alignment unmapped;
+        unmapped.set_name("read2");
+        REQUIRE(scanner.parse(unmapped.SerializeAsString(), partial, scratch));
+        REQUIRE(partial.path().mapping_size() == 0);
+    }
+
+    SECTION("Mappings can be walked without decoding anything") {
+        int32_t mapping_quality;
+        vector<tuple<id_t, bool, int64_t, int64_t, int64_t>> mappings;
+        REQUIRE(AlignmentFieldScanner::for_each_mapping(serialized, mapping_quality,
+            [&](id_t node_id, bool is_reverse, int64_t offset, int64_t from_length, int64_t to_length) {
+                mappings.emplace_back(node_id, is_reverse, offset, from_length, to_length);
+            }));
+        REQUIRE(mapping_quality == 37);
+        REQUIRE(mappings == vector<tuple<id_t, bool, int64_t, int64_t, int64_t>>{
+            {10, false, 0, 4, 4}, {11, true, 1, 4, 4}, {12, false, 2, 4, 4}});
+    }
+
+    SECTION("Truncated messages are rejected") {
+        string truncated = serialized.substr(0, serialized.size() - 3);
+        int32_t mapping_quality;
+        REQUIRE(!AlignmentFieldScanner::for_each_mapping(truncated, mapping_quality,
+            [&](id_t node_id, bool is_reverse, int64_t offset, int64_t from_length, int64_t to_length) {}));
+        AlignmentFieldScanner scanner({"path"});
+        REQUIRE(!scanner.extract(truncated, scratch));
+    }
+
+    SECTION("Unknown fields can't be asked for") {
+        REQUIRE_THROWS(AlignmentFieldScanner({"not_a_field"}));
+    }
+}
+
+}
+}
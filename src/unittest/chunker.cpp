@@ -230,6 +230,51 @@ TEST_CASE("basic graph chunking", "[chunk]") {
     }
 }
 
-
+TEST_CASE("ChunkReadRouter writes each chunk's reads in order", "[chunk]") {
+    
+    vector<string> filenames;
+    for (size_t i = 0; i < 5; i++) {
+        filenames.push_back(temp_file::create());
+    }
+    
+    {
+        // Use small buffers so reads get handed off many times
+        ChunkReadRouter<Alignment> router(filenames, 2, 3);
+        for (size_t i = 0; i < 100; i++) {
+            Alignment aln;
+            aln.set_name("read" + to_string(i));
+            // Chunk 4 gets nothing
+            router.route(i % 4, aln);
+            if (i % 10 == 0) {
+                // And chunk 0 gets some reads twice
+                router.route(0, aln);
+            }
+        }
+        router.finish();
+    }
+    
+    for (size_t chunk = 0; chunk < filenames.size(); chunk++) {
+        vector<string> names;
+        ifstream in(filenames[chunk]);
+        vg::io::for_each<Alignment>(in, [&](Alignment& aln) {
+            names.push_back(aln.name());
+        });
+        
+        vector<string> expected;
+        if (chunk != 4) {
+            for (size_t i = chunk; i < 100; i += 4) {
+                expected.push_back("read" + to_string(i));
+                if (chunk == 0 && i % 10 == 0) {
+                    expected.push_back("read" + to_string(i));
+                }
+            }
+        }
+        REQUIRE(names == expected);
+        
+        temp_file::remove(filenames[chunk]);
+    }
 }
+
+
 }
+}
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "../snarl_distance_index.hpp"
 #include "../genotypekit.hpp"
 #include "random_graph.hpp"
+#include "test_aligner.hpp"
 #include <fstream>
 #include <random>
 #include <time.h> 
@@ -392,6 +393,26 @@ namespace unittest {
             REQUIRE(dist == -7);
         }
         
+        SECTION("Path coordinates give the same distances as the distance approximation when positions are on path") {
+            
+            measurer.max_walk = 10;
+            vector<pair<pos_t, pos_t>> test_pairs{
+                make_pair(make_pos_t(n2->id(), false, 0), make_pos_t(n5->id(), false, 0)),
+                make_pair(make_pos_t(n5->id(), false, 0), make_pos_t(n2->id(), false, 0)),
+                make_pair(make_pos_t(n5->id(), true, n5->sequence().size()), make_pos_t(n2->id(), true, n2->sequence().size()))
+            };
+            
+            for (const auto& test_pair : test_pairs) {
+                auto coords_1 = measurer.path_coordinates(test_pair.first);
+                auto coords_2 = measurer.path_coordinates(test_pair.second);
+                REQUIRE(coords_1.size() == 1);
+                REQUIRE(coords_2.size() == 1);
+                REQUIRE(coords_1.front().first == coords_2.front().first);
+                REQUIRE(coords_2.front().second - coords_1.front().second == measurer.oriented_distance(test_pair.first,
+                                                                                                        test_pair.second));
+            }
+        }
+        
         SECTION("Distance approxmation produces expected distances when positions are not on path") {
             
             measurer.max_walk = 10;
@@ -430,6 +451,253 @@ namespace unittest {
             REQUIRE(dist == std::numeric_limits<int64_t>::max());
         }
     }
+    
+    class TestOrientedDistanceClusterer : public OrientedDistanceClusterer {
+    public:
+        using OrientedDistanceClusterer::OrientedDistanceClusterer;
+        using OrientedDistanceClusterer::make_hit_graph;
+    };
+    
+    class TestWindowedPathClusterer : public WindowedPathClusterer {
+    public:
+        using WindowedPathClusterer::WindowedPathClusterer;
+        using WindowedPathClusterer::make_hit_graph;
+    };
+    
+    /// Get the edges of a hit graph as (from, to, weight, distance)
+    template<typename HitGraph>
+    static set<tuple<size_t, size_t, int32_t, int64_t>> hit_graph_edges(const HitGraph& hit_graph) {
+        set<tuple<size_t, size_t, int32_t, int64_t>> edges;
+        for (size_t i = 0; i < hit_graph.nodes.size(); ++i) {
+            for (const auto& edge : hit_graph.nodes[i].edges_from) {
+                edges.emplace(i, edge.to_idx, edge.weight, edge.distance);
+            }
+        }
+        return edges;
+    }
+    
+    /// Make MEMs on a read from (read begin, read end, node, offset) records
+    static vector<MaximalExactMatch> make_path_mems(const Alignment& alignment,
+                                                    const vector<tuple<size_t, size_t, id_t, size_t>>& records) {
+        vector<MaximalExactMatch> mems;
+        for (const auto& record : records) {
+            mems.emplace_back();
+            MaximalExactMatch& mem = mems.back();
+            mem.begin = alignment.sequence().begin() + get<0>(record);
+            mem.end = alignment.sequence().begin() + get<1>(record);
+            mem.queried_count = 1;
+            mem.match_count = 1;
+            mem.nodes.push_back(gcsa::Node::encode(get<2>(record), get<3>(record), false));
+        }
+        return mems;
+    }
+    
+    /// Count the edges in a hit graph, including any duplicates
+    template<typename HitGraph>
+    static size_t hit_graph_edge_count(const HitGraph& hit_graph) {
+        size_t count = 0;
+        for (const auto& node : hit_graph.nodes) {
+            count += node.edges_from.size();
+        }
+        return count;
+    }
+    
+    TEST_CASE("WindowedPathClusterer finds the same edges as OrientedDistanceClusterer", "[cluster][mapping]") {
+        
+        VG vg;
+        string sequence;
+        vector<Node*> nodes;
+        for (const string& seq : {"GATTACA", "CTGAAGT", "TCCAGGA", "ACGTTGC", "GGCATAC", "TTAGCCA"}) {
+            nodes.push_back(vg.create_node(seq));
+            if (nodes.size() > 1) {
+                vg.create_edge(nodes[nodes.size() - 2], nodes.back());
+            }
+            sequence += seq;
+        }
+        Graph graph = vg.graph;
+        Path* path = graph.add_path();
+        path->set_name("path");
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Mapping* mapping = path->add_mapping();
+            mapping->mutable_position()->set_node_id(nodes[i]->id());
+            mapping->set_rank(i + 1);
+        }
+        
+        xg::XG xg_index;
+        xg_index.from_path_handle_graph(VG(graph));
+        PathOrientedDistanceMeasurer measurer(&xg_index);
+        
+        Alignment alignment;
+        alignment.set_sequence(sequence);
+        
+        // MEMs along the read where it matches the path, with one redundant sub-MEM
+        vector<pair<size_t, size_t>> intervals{{0, 9}, {11, 20}, {13, 18}, {22, 30}, {33, 42}};
+        vector<MaximalExactMatch> mems;
+        for (const auto& interval : intervals) {
+            mems.emplace_back();
+            MaximalExactMatch& mem = mems.back();
+            mem.begin = alignment.sequence().begin() + interval.first;
+            mem.end = alignment.sequence().begin() + interval.second;
+            mem.queried_count = 1;
+            mem.match_count = 1;
+            mem.nodes.push_back(gcsa::Node::encode(nodes[interval.first / 7]->id(), interval.first % 7, false));
+        }
+        
+        TestAligner test_aligner;
+        const GSSWAligner* aligner = test_aligner.get_regular_aligner();
+        
+        TestOrientedDistanceClusterer oriented_clusterer(measurer);
+        auto oriented_graph = oriented_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+        auto oriented_edges = hit_graph_edges(oriented_graph);
+        
+        SECTION("All of the edges fit in the window") {
+            TestWindowedPathClusterer windowed_clusterer(measurer);
+            auto windowed_graph = windowed_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+            
+            // every MEM can reach the ones after it, and the big MEM gets a dummy edge to its sub-MEM
+            REQUIRE(oriented_edges.size() == 4 + 3 + 2 + 1);
+            REQUIRE(hit_graph_edges(windowed_graph) == oriented_edges);
+        }
+        
+        SECTION("Dummy edges to sub-MEMs count against the maximum edges per hit") {
+            TestWindowedPathClusterer windowed_clusterer(measurer, 8, 1);
+            auto windowed_graph = windowed_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+            
+            // the MEM containing the sub-MEM has to choose between its dummy edge and its real edges
+            for (size_t i : {0, 1, 2, 3}) {
+                REQUIRE(windowed_graph.nodes[i].edges_from.size() == 1);
+            }
+            
+            // and whatever it keeps is one of the true edges
+            for (const auto& edge : hit_graph_edges(windowed_graph)) {
+                REQUIRE(oriented_edges.count(edge));
+            }
+        }
+    }
+    
+    TEST_CASE("WindowedPathClusterer finds each edge once when hits are on several path strands", "[cluster][mapping]") {
+        
+        VG vg;
+        string sequence;
+        vector<Node*> nodes;
+        for (const string& seq : {"GATTACA", "CTGAAGT", "TCCAGGA", "ACGTTGC", "GGCATAC", "TTAGCCA"}) {
+            nodes.push_back(vg.create_node(seq));
+            if (nodes.size() > 1) {
+                vg.create_edge(nodes[nodes.size() - 2], nodes.back());
+            }
+            sequence += seq;
+        }
+        Graph graph = vg.graph;
+        // one path along the forward strand of the nodes and one along their reverse strand, so every
+        // hit is on two path strands
+        Path* forward_path = graph.add_path();
+        forward_path->set_name("forward");
+        Path* reverse_path = graph.add_path();
+        reverse_path->set_name("reverse");
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Mapping* mapping = forward_path->add_mapping();
+            mapping->mutable_position()->set_node_id(nodes[i]->id());
+            mapping->set_rank(i + 1);
+            mapping = reverse_path->add_mapping();
+            mapping->mutable_position()->set_node_id(nodes[nodes.size() - i - 1]->id());
+            mapping->mutable_position()->set_is_reverse(true);
+            mapping->set_rank(i + 1);
+        }
+        
+        xg::XG xg_index;
+        xg_index.from_path_handle_graph(VG(graph));
+        PathOrientedDistanceMeasurer measurer(&xg_index);
+        
+        Alignment alignment;
+        alignment.set_sequence(sequence);
+        
+        vector<tuple<size_t, size_t, id_t, size_t>> records;
+        for (const auto& interval : vector<pair<size_t, size_t>>{{0, 9}, {11, 20}, {13, 18}, {22, 30}, {33, 42}}) {
+            records.emplace_back(interval.first, interval.second, nodes[interval.first / 7]->id(), interval.first % 7);
+        }
+        auto mems = make_path_mems(alignment, records);
+        
+        TestAligner test_aligner;
+        const GSSWAligner* aligner = test_aligner.get_regular_aligner();
+        
+        TestOrientedDistanceClusterer oriented_clusterer(measurer);
+        auto oriented_graph = oriented_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+        auto oriented_edges = hit_graph_edges(oriented_graph);
+        
+        SECTION("Edges found on both path strands are only added once") {
+            TestWindowedPathClusterer windowed_clusterer(measurer);
+            auto windowed_graph = windowed_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+            
+            REQUIRE(oriented_edges.size() == 4 + 3 + 2 + 1);
+            REQUIRE(hit_graph_edges(windowed_graph) == oriented_edges);
+            REQUIRE(hit_graph_edge_count(windowed_graph) == oriented_edges.size());
+        }
+        
+        SECTION("The maximum edges per hit applies across path strands") {
+            TestWindowedPathClusterer windowed_clusterer(measurer, 8, 2);
+            auto windowed_graph = windowed_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+            
+            for (const auto& node : windowed_graph.nodes) {
+                REQUIRE(node.edges_from.size() <= 2);
+            }
+            REQUIRE(windowed_graph.nodes[0].edges_from.size() == 2);
+            for (const auto& edge : hit_graph_edges(windowed_graph)) {
+                REQUIRE(oriented_edges.count(edge));
+            }
+        }
+    }
+    
+    TEST_CASE("WindowedPathClusterer drops edges beyond the gap window like OrientedDistanceClusterer", "[cluster][mapping]") {
+        
+        VG vg;
+        vector<Node*> nodes;
+        string filler;
+        for (size_t i = 0; i < 150; ++i) {
+            filler += "ACGT";
+        }
+        for (const string& seq : {string("GATTACA"), string("CTGAAGT"), string("TCCAGGA"), filler, string("GGCATACTTAGCCA")}) {
+            nodes.push_back(vg.create_node(seq));
+            if (nodes.size() > 1) {
+                vg.create_edge(nodes[nodes.size() - 2], nodes.back());
+            }
+        }
+        Graph graph = vg.graph;
+        Path* path = graph.add_path();
+        path->set_name("path");
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Mapping* mapping = path->add_mapping();
+            mapping->mutable_position()->set_node_id(nodes[i]->id());
+            mapping->set_rank(i + 1);
+        }
+        
+        xg::XG xg_index;
+        xg_index.from_path_handle_graph(VG(graph));
+        PathOrientedDistanceMeasurer measurer(&xg_index);
+        
+        // the read skips the filler node with a deletion far longer than the aligner could detect
+        Alignment alignment;
+        alignment.set_sequence("GATTACACTGAAGTTCCAGGAGGCATACTTAGCCA");
+        auto mems = make_path_mems(alignment, {make_tuple(0, 9, nodes[0]->id(), 0),
+                                               make_tuple(11, 20, nodes[1]->id(), 4),
+                                               make_tuple(21, 35, nodes[4]->id(), 0)});
+        
+        TestAligner test_aligner;
+        const GSSWAligner* aligner = test_aligner.get_regular_aligner();
+        
+        TestOrientedDistanceClusterer oriented_clusterer(measurer);
+        auto oriented_graph = oriented_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+        
+        TestWindowedPathClusterer windowed_clusterer(measurer);
+        auto windowed_graph = windowed_clusterer.make_hit_graph(alignment, mems, aligner, 1, nullptr);
+        
+        auto windowed_edges = hit_graph_edges(windowed_graph);
+        REQUIRE(windowed_edges == hit_graph_edges(oriented_graph));
+        
+        // the MEMs before the deletion are connected, but not to the one after it
+        REQUIRE(windowed_edges.size() == 1);
+        REQUIRE(get<0>(*windowed_edges.begin()) == 0);
+        REQUIRE(get<1>(*windowed_edges.begin()) == 1);
+    }
 }
 
 }
@@ -0,0 +1,124 @@
+/// \file funnel.cpp
+///
+/// Unit tests for the Funnel instrumentation at its different tracking levels
+///
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <vg/vg.pb.h>
+#include "../funnel.hpp"
+#include "../annotation.hpp"
+#include "catch.hpp"
+
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+/// Run a little two-stage pipeline through the given funnel
+static void run_funnel(Funnel& funnel) {
+    funnel.start("read");
+    funnel.stage("seed");
+    funnel.introduce(3);
+    funnel.stage("cluster");
+    vector<size_t> to_merge {0, 1};
+    funnel.merge_group(to_merge.begin(), to_merge.end());
+    funnel.score(funnel.latest(), 10);
+    funnel.fail("too-far", 2);
+    funnel.stop();
+}
+
+TEST_CASE("Funnels record stage counts at every level above none", "[funnel]") {
+
+    SECTION("Full tracking counts items and annotates filters") {
+        Funnel funnel(Funnel::Tracking::FULL);
+        run_funnel(funnel);
+
+        vector<pair<string, size_t>> counts;
+        funnel.for_each_stage_count([&](const string& stage, size_t count, double duration) {
+            counts.emplace_back(stage, count);
+        });
+        REQUIRE(counts == vector<pair<string, size_t>>{{"seed", 3}, {"cluster", 1}});
+
+        Alignment aln;
+        funnel.annotate_mapped_alignment(aln, false);
+        REQUIRE(get_annotation<double>(aln, "stage_seed_results") == 3);
+        REQUIRE(has_annotation(aln, "last_placed_stage"));
+    }
+
+    SECTION("Counts-only tracking counts items without keeping them") {
+        Funnel funnel(Funnel::Tracking::COUNTS);
+        run_funnel(funnel);
+
+        vector<pair<string, size_t>> counts;
+        funnel.for_each_stage_count([&](const string& stage, size_t count, double duration) {
+            counts.emplace_back(stage, count);
+        });
+        REQUIRE(counts == vector<pair<string, size_t>>{{"seed", 3}, {"cluster", 1}});
+
+        Alignment aln;
+        funnel.annotate_mapped_alignment(aln, false);
+        REQUIRE(get_annotation<double>(aln, "stage_cluster_results") == 1);
+        REQUIRE(!has_annotation(aln, "last_placed_stage"));
+    }
+
+    SECTION("No tracking records only the time used") {
+        Funnel funnel(Funnel::Tracking::NONE);
+        run_funnel(funnel);
+
+        size_t stage_count = 0;
+        funnel.for_each_stage_count([&](const string& stage, size_t count, double duration) {
+            stage_count++;
+        });
+        REQUIRE(stage_count == 0);
+
+        Alignment aln;
+        funnel.annotate_mapped_alignment(aln, false);
+        REQUIRE(aln.time_used() >= 0);
+        REQUIRE(!has_annotation(aln, "stage_seed_results"));
+    }
+}
+
+TEST_CASE("FunnelStageCounter sums stages over threads", "[funnel]") {
+
+    FunnelStageCounter counter(2);
+    for (size_t thread = 0; thread < 2; thread++) {
+        Funnel funnel(Funnel::Tracking::COUNTS);
+        run_funnel(funnel);
+        counter.record(funnel, thread);
+    }
+
+    REQUIRE(counter.input_count() == 2);
+
+    REQUIRE(counter.input_latency().count() == 2);
+    
+    counter.record_time("emit", 0.5, 1);
+
+    vector<string> names;
+    counter.for_each_stage([&](const string& stage, const FunnelStageCounter::StageTotals& totals) {
+        names.push_back(stage);
+        if (stage == "emit") {
+            REQUIRE(totals.inputs == 1);
+            REQUIRE(totals.latency.max() == 0.5);
+        } else {
+            REQUIRE(totals.inputs == 2);
+            REQUIRE(totals.items == (stage == "seed" ? 6 : 2));
+            REQUIRE(totals.latency.count() == 2);
+        }
+    });
+    REQUIRE(names == vector<string>{"seed", "cluster", "emit"});
+
+    stringstream table;
+    counter.write_table(table);
+    REQUIRE(table.str().substr(0, 5) == "stage");
+    
+    stringstream json;
+    counter.write_json(json, 1.0);
+    REQUIRE(json.str().substr(0, 12) == "{\"inputs\": 2");
+    REQUIRE(json.str().find("\"name\": \"emit\"") != string::npos);
+}
+
+}
+}
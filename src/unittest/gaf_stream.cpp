@@ -0,0 +1,164 @@
+///
+///  \file gaf_stream.cpp
+///
+///  Unit tests for sorting and indexing GAF files a line at a time
+///
+
+#include <iostream>
+#include <sstream>
+#include <set>
+#include "catch.hpp"
+#include "../gaf_stream.hpp"
+#include "../stream_sorter.hpp"
+#include "../utility.hpp"
+
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// Make a GAF line for a read aligned along the given path string
+static string make_gaf_line(const string& name, const string& path, size_t path_start = 0) {
+    stringstream line;
+    line << name << "\t100\t0\t100\t+\t" << path << "\t1000\t" << path_start << "\t" << (path_start + 100)
+         << "\t100\t100\t60\tcs:Z::100";
+    return line.str();
+}
+
+TEST_CASE("GAFRecords scan their paths without parsing the rest of the line", "[gaf][gamindex]") {
+
+    SECTION("A mapped record visits its nodes in path order") {
+        GAFRecord record(make_gaf_line("read1", ">12<7>30", 5));
+        REQUIRE(record.name() == "read1");
+
+        vector<tuple<id_t, bool, size_t>> steps;
+        record.for_each_step([&](id_t node_id, bool is_reverse, size_t offset) {
+            steps.emplace_back(node_id, is_reverse, offset);
+            return true;
+        });
+        REQUIRE(steps == vector<tuple<id_t, bool, size_t>>{{12, false, 5}, {7, true, 0}, {30, false, 0}});
+
+        // The sorter sees the lowest node
+        GAFSorter sorter;
+        Position min_pos = sorter.get_min_position(record);
+        REQUIRE(min_pos.node_id() == 7);
+        REQUIRE(min_pos.is_reverse());
+    }
+
+    SECTION("An unmapped record visits only the unplaced sentinel") {
+        GAFRecord record(make_gaf_line("read2", "*"));
+        vector<id_t> ids;
+        IDScanner<GAFRecord>::scan(record, [&](const id_t& id) {
+            ids.push_back(id);
+            return true;
+        });
+        REQUIRE(ids == vector<id_t>{0});
+    }
+
+    SECTION("A record with segment names can't be scanned") {
+        GAFRecord record(make_gaf_line("read3", ">s1>s2"));
+        REQUIRE_THROWS(record.for_each_step([&](id_t node_id, bool is_reverse, size_t offset) {
+            return true;
+        }));
+    }
+}
+
+TEST_CASE("GAF files can be sorted, indexed, and queried", "[gaf][gamindex]") {
+
+    // Make an unsorted GAF with a few thousand reads, enough for many groups
+    stringstream unsorted;
+    size_t read_count = 5000;
+    for (size_t i = 0; i < read_count; i++) {
+        id_t node_id = (i * 7919) % read_count + 1;
+        unsorted << make_gaf_line("read" + to_string(i), ">" + to_string(node_id) + ">" + to_string(node_id + 1)) << "\n";
+    }
+
+    stringstream sorted;
+    GAFIndex index;
+    {
+        GAFSorter sorter;
+        sorter.easy_sort(unsorted, sorted, &index);
+    }
+
+    // Everything should come back out in order
+    GAFIndex::cursor_t cursor(sorted);
+    REQUIRE(cursor.tell_group() != -1);
+    size_t seen = 0;
+    id_t last_min = 0;
+    while (cursor.has_current()) {
+        id_t min_id = numeric_limits<id_t>::max();
+        cursor->for_each_step([&](id_t node_id, bool is_reverse, size_t offset) {
+            min_id = min(min_id, node_id);
+            return true;
+        });
+        REQUIRE(min_id >= last_min);
+        last_min = min_id;
+        seen++;
+        cursor.advance();
+    }
+    REQUIRE(seen == read_count);
+
+    // And we should be able to find just the reads on a node range
+    vector<string> found;
+    index.find(cursor, 100, 109, [&](const GAFRecord& record) {
+        found.push_back(record.name());
+    });
+    // Nodes 100-109 are touched by the reads starting at 99 through 109
+    REQUIRE(found.size() == 11);
+
+    // Indexing the sorted file from scratch should give the same answer
+    GAFIndex reindexed;
+    cursor.seek_group(0);
+    reindexed.index(cursor);
+    vector<string> refound;
+    reindexed.find(cursor, 100, 109, [&](const GAFRecord& record) {
+        refound.push_back(record.name());
+    });
+    REQUIRE(refound == found);
+}
+
+TEST_CASE("GAF files can be stream sorted through several merge passes", "[gaf][gamindex]") {
+
+    // Make an unsorted GAF with a few thousand reads
+    stringstream unsorted;
+    size_t read_count = 5000;
+    multiset<string> names_in;
+    for (size_t i = 0; i < read_count; i++) {
+        id_t node_id = (i * 7919) % read_count + 1;
+        string name = "read" + to_string(i);
+        unsorted << make_gaf_line(name, ">" + to_string(node_id) + ">" + to_string(node_id + 1)) << "\n";
+        names_in.insert(name);
+    }
+
+    stringstream sorted;
+    {
+        GAFSorter sorter;
+        // Make chunks of a few dozen reads, so we get over a hundred temp
+        // files, and merge them 3 at a time, so it takes several passes to
+        // get down to one.
+        sorter.set_max_buf_size(4 * 1024);
+        sorter.set_max_fan_in(3);
+        sorter.stream_sort(unsorted, sorted);
+    }
+
+    // Everything should come back out exactly once, in order
+    GAFIndex::cursor_t cursor(sorted);
+    multiset<string> names_out;
+    id_t last_min = 0;
+    while (cursor.has_current()) {
+        id_t min_id = numeric_limits<id_t>::max();
+        cursor->for_each_step([&](id_t node_id, bool is_reverse, size_t offset) {
+            min_id = min(min_id, node_id);
+            return true;
+        });
+        REQUIRE(min_id >= last_min);
+        last_min = min_id;
+        names_out.insert(cursor->name());
+        cursor.advance();
+    }
+    REQUIRE(names_out == names_in);
+}
+
+}
+}
@@ -0,0 +1,68 @@
+/// \file latency_histogram.cpp
+///
+/// Unit tests for the LatencyHistogram
+///
+
+#include <iostream>
+#include <sstream>
+#include "../latency_histogram.hpp"
+#include "catch.hpp"
+
+
+namespace vg {
+namespace unittest {
+using namespace std;
+
+TEST_CASE("LatencyHistogram reports quantiles to within its resolution", "[latency_histogram]") {
+
+    LatencyHistogram histogram;
+    
+    SECTION("An empty histogram reports zeros") {
+        REQUIRE(histogram.count() == 0);
+        REQUIRE(histogram.mean() == 0);
+        REQUIRE(histogram.quantile(0.5) == 0);
+    }
+    
+    SECTION("Quantiles are within an eighth of the true values") {
+        for (size_t i = 1; i <= 10000; i++) {
+            // Record 1 us through 10 ms
+            histogram.record(i * 1E-6);
+        }
+        REQUIRE(histogram.count() == 10000);
+        REQUIRE(histogram.max() == Approx(0.01));
+        REQUIRE(histogram.mean() == Approx(0.0050005));
+        
+        for (double fraction : {0.1, 0.5, 0.9, 0.99}) {
+            double truth = fraction * 0.01;
+            double reported = histogram.quantile(fraction);
+            REQUIRE(reported >= truth * 0.875);
+            REQUIRE(reported <= truth * 1.125);
+        }
+        REQUIRE(histogram.quantile(1.0) == Approx(0.01));
+    }
+    
+    SECTION("Small latencies are exact") {
+        histogram.record(3E-6);
+        histogram.record(5E-6);
+        REQUIRE(histogram.quantile(0.5) == Approx(3E-6));
+        REQUIRE(histogram.quantile(1.0) == Approx(5E-6));
+    }
+    
+    SECTION("Merged histograms count everything") {
+        LatencyHistogram other;
+        histogram.record(1);
+        other.record(2);
+        other.record(3);
+        histogram.merge(other);
+        REQUIRE(histogram.count() == 3);
+        REQUIRE(histogram.max() == 3);
+        REQUIRE(histogram.mean() == Approx(2));
+        
+        stringstream json;
+        histogram.write_json(json);
+        REQUIRE(json.str().substr(0, 11) == "{\"count\": 3");
+    }
+}
+
+}
+}
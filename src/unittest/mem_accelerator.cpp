@@ -92,6 +92,63 @@ TEST_CASE("MEMAccelerator returns same ranges as direct LF queries",
         delete lcpidx;
     }
 }
+
+TEST_CASE("MEMAccelerator gives the same ranges after saving and memory-mapping",
+          "[mem][mapping][memaccelerator]" ) {
+    
+    int seq_size = 100;
+    int var_count = 4;
+    int var_length = 3;
+    int memo_length = 5;
+    
+    bdsg::HashGraph graph;
+    random_graph(seq_size, var_length, var_count, &graph);
+    
+    // Make GCSA quiet
+    gcsa::Verbosity::set(gcsa::Verbosity::SILENT);
+    
+    gcsa::GCSA* gcsaidx = nullptr;
+    gcsa::LCPArray* lcpidx = nullptr;
+    build_gcsa_lcp(graph, gcsaidx, lcpidx, 8, 2);
+    
+    MEMAccelerator accelerator(*gcsaidx, memo_length);
+    
+    string filename = temp_file::create();
+    accelerator.save(filename);
+    
+    SECTION("A table loaded for the same index matches the one that was saved") {
+        MEMAccelerator loaded(filename, *gcsaidx);
+        
+        REQUIRE(loaded.length() == accelerator.length());
+        
+        // iterate over all k-mers
+        for (int k = 0; k < (1 << (2 * memo_length)); ++k) {
+            string seq(memo_length, 'N');
+            for (int i = 0; i < memo_length; ++i) {
+                seq[i] = "ACGT"[(k >> i) & 3];
+            }
+            REQUIRE(loaded.memoized_LF(seq.end() - 1) == accelerator.memoized_LF(seq.end() - 1));
+        }
+    }
+    
+    SECTION("A table is not loaded for a different index") {
+        bdsg::HashGraph other_graph;
+        random_graph(2 * seq_size, var_length, var_count, &other_graph);
+        
+        gcsa::GCSA* other_gcsaidx = nullptr;
+        gcsa::LCPArray* other_lcpidx = nullptr;
+        build_gcsa_lcp(other_graph, other_gcsaidx, other_lcpidx, 8, 2);
+        
+        REQUIRE_THROWS(MEMAccelerator(filename, *other_gcsaidx));
+        
+        delete other_gcsaidx;
+        delete other_lcpidx;
+    }
+    
+    temp_file::remove(filename);
+    delete gcsaidx;
+    delete lcpidx;
+}
    
 }
 }
@@ -28,6 +28,10 @@ public:
     using MinimizerMapper::Minimizer;
     using MinimizerMapper::fragment_length_distr;
     using MinimizerMapper::faster_cap;
+    using MinimizerMapper::DisruptionInfo;
+    using MinimizerMapper::get_log10_prob_of_disruption_in_interval;
+    using MinimizerMapper::for_each_agglomeration_interval;
+    using MinimizerMapper::get_prob_of_disruption_in_column;
     using MinimizerMapper::with_dagified_local_graph;
     using MinimizerMapper::align_sequence_between;
     using MinimizerMapper::fix_dozeu_end_deletions;
@@ -244,6 +248,57 @@ TEST_CASE("Mapping quality cap cannot be confused by fuzzing with high base qual
     }
 }
 
+TEST_CASE("Interval disruption probabilities match the column-at-a-time computation", "[giraffe][mapping]") {
+    string sequence;
+    string quality;
+    for (size_t i = 0; i < 150; i++) {
+        sequence.push_back("ACGT"[i % 4]);
+        quality.push_back((char)(10 + (i * 7) % 31));
+    }
+    
+    for (int flank_width : {0, 5, 10}) {
+        vector<TestMinimizerMapper::Minimizer> minimizers;
+        vector<size_t> minimizers_explored;
+        cover_in_minimizers(sequence, 25, flank_width, 3, minimizers, minimizers_explored);
+        
+        // Get into agglomeration order, the same way faster_cap does.
+        std::sort(minimizers_explored.begin(), minimizers_explored.end(), [&](size_t a, size_t b) {
+            size_t a_end = minimizers[a].agglomeration_start + minimizers[a].agglomeration_length;
+            size_t b_end = minimizers[b].agglomeration_start + minimizers[b].agglomeration_length;
+            return a_end < b_end || (a_end == b_end && minimizers[a].agglomeration_start < minimizers[b].agglomeration_start);
+        });
+        
+        vector<TestMinimizerMapper::DisruptionInfo> disruption;
+        for (size_t i : minimizers_explored) {
+            disruption.emplace_back(minimizers[i]);
+        }
+        vector<double> scratch;
+        
+        size_t intervals = 0;
+        TestMinimizerMapper::for_each_agglomeration_interval(minimizers, sequence, quality, minimizers_explored,
+                                                             [&](size_t left, size_t right, size_t bottom, size_t top) {
+            // Compute the interval probability the old way, one column at a time.
+            double expected = 0;
+            if (left != right) {
+                double p = 0;
+                for (size_t i = left; i < right; i++) {
+                    double col_p = TestMinimizerMapper::get_prob_of_disruption_in_column(minimizers, sequence, quality,
+                                                                                         minimizers_explored.begin() + bottom,
+                                                                                         minimizers_explored.begin() + top, i);
+                    p = (i == left) ? col_p : (p + col_p - (p * col_p));
+                }
+                expected = log10(p);
+            }
+            
+            double observed = TestMinimizerMapper::get_log10_prob_of_disruption_in_interval(disruption, quality, bottom, top,
+                                                                                            left, right, scratch);
+            REQUIRE(observed == expected);
+            intervals++;
+        });
+        REQUIRE(intervals > 0);
+    }
+}
+
 TEST_CASE("MinimizerMapper can map against subgraphs between points", "[giraffe][mapping]") {
 
         Aligner aligner;
@@ -8,6 +8,7 @@
 #include "../cactus_snarl_finder.hpp"
 #include "../integrated_snarl_finder.hpp"
 #include "../multipath_alignment_graph.hpp"
+#include "bdsg/hash_graph.hpp"
 #include "../snarl_distance_index.hpp"
 #include "catch.hpp"
 #include "test_aligner.hpp"
@@ -19,7 +20,10 @@ namespace unittest {
 
 class TestMultipathAlignmentGraph : public MultipathAlignmentGraph {
 public:
+    using MultipathAlignmentGraph::MultipathAlignmentGraph;
     using MultipathAlignmentGraph::decompose_alignments;
+    using MultipathAlignmentGraph::path_nodes;
+    using MultipathAlignmentGraph::max_transitive_closure_words;
 };
 
 TEST_CASE( "MultipathAlignmentGraph::align handles tails correctly", "[multipath][mapping][multipathalignmentgraph]" ) {
@@ -422,6 +426,243 @@ TEST_CASE("Corresponding path lengths can be computed", "[multipathalignmentgrap
     
 }
 
+TEST_CASE("Parallel passes over a MultipathAlignmentGraph give the same results", "[multipathalignmentgraph]") {
+    
+    bdsg::HashGraph graph;
+    vector<handle_t> handles;
+    for (const string& seq : {"AAAA", "CCCC", "GGGG", "TTTT", "ACGT"}) {
+        handles.push_back(graph.create_handle(seq));
+        if (handles.size() > 1) {
+            graph.create_edge(handles[handles.size() - 2], handles.back());
+        }
+    }
+    
+    Alignment alignment;
+    alignment.set_sequence("AAAACCCCGGTGTTTTACGT");
+    
+    // make anchors on the middle of each node, so that the read has to be realigned in between them
+    vector<pair<pair<string::const_iterator, string::const_iterator>, Path>> path_chunks;
+    for (size_t i = 0; i < handles.size(); ++i) {
+        path_chunks.emplace_back();
+        auto& chunk = path_chunks.back();
+        chunk.first.first = alignment.sequence().begin() + 4 * i + 1;
+        chunk.first.second = alignment.sequence().begin() + 4 * i + 3;
+        Mapping* mapping = chunk.second.add_mapping();
+        mapping->mutable_position()->set_node_id(graph.get_id(handles[i]));
+        mapping->mutable_position()->set_offset(1);
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(2);
+        edit->set_to_length(2);
+    }
+    
+    TestAligner test_aligner;
+    auto aligner = test_aligner.get_regular_aligner();
+    auto identity = MultipathAlignmentGraph::create_identity_projection_trans(graph);
+    
+    // run all the passes, either serially or letting other threads steal work
+    auto run_passes = [&](size_t min_nodes_for_parallel_passes, size_t& edges_out, multipath_alignment_t& mp_aln_out) {
+        #pragma omp parallel num_threads(2)
+        #pragma omp single
+        {
+            MultipathAlignmentGraph mpg(graph, path_chunks, alignment, identity);
+            mpg.min_nodes_for_parallel_passes = min_nodes_for_parallel_passes;
+            
+            vector<size_t> topological_order;
+            mpg.topological_sort(topological_order);
+            mpg.remove_transitive_edges(topological_order);
+            
+            vector<size_t> provenance(mpg.size());
+            mpg.prune_to_high_scoring_paths(alignment, aligner, 2.0, topological_order, provenance);
+            edges_out = mpg.count_reachability_edges();
+            
+            mpg.align(alignment, graph, aligner, true, 2, false, 100, 0.0, true, 0, 1, mp_aln_out);
+        }
+    };
+    
+    size_t serial_edges, parallel_edges;
+    multipath_alignment_t serial_mp_aln, parallel_mp_aln;
+    run_passes(0, serial_edges, serial_mp_aln);
+    run_passes(1, parallel_edges, parallel_mp_aln);
+    
+    REQUIRE(serial_edges == parallel_edges);
+    REQUIRE(serial_mp_aln.subpath_size() > 0);
+    REQUIRE(debug_string(serial_mp_aln) == debug_string(parallel_mp_aln));
+}
+
+TEST_CASE("Transitive edge removal with the closure matches the search", "[multipathalignmentgraph]") {
+    
+    // Two bubbles in a row, so that anchors can branch and rejoin
+    bdsg::HashGraph graph;
+    handle_t h0 = graph.create_handle("AAAA");
+    handle_t h1a = graph.create_handle("CCAC");
+    handle_t h1b = graph.create_handle("GCAG");
+    handle_t h2 = graph.create_handle("TTTT");
+    handle_t h3a = graph.create_handle("ACGA");
+    handle_t h3b = graph.create_handle("TCGT");
+    handle_t h4 = graph.create_handle("GGGG");
+    graph.create_edge(h0, h1a);
+    graph.create_edge(h0, h1b);
+    graph.create_edge(h1a, h2);
+    graph.create_edge(h1b, h2);
+    graph.create_edge(h2, h3a);
+    graph.create_edge(h2, h3b);
+    graph.create_edge(h3a, h4);
+    graph.create_edge(h3b, h4);
+    
+    Alignment alignment;
+    alignment.set_sequence("AAAACCACTTTTACGAGGGG");
+    
+    // anchor the middle of every node, so both sides of each bubble get an anchor on the same part of the read
+    vector<pair<pair<string::const_iterator, string::const_iterator>, Path>> path_chunks;
+    vector<pair<handle_t, size_t>> anchored{{h0, 0}, {h1a, 1}, {h1b, 1}, {h2, 2}, {h3a, 3}, {h3b, 3}, {h4, 4}};
+    for (auto& node_and_level : anchored) {
+        path_chunks.emplace_back();
+        auto& chunk = path_chunks.back();
+        chunk.first.first = alignment.sequence().begin() + 4 * node_and_level.second + 1;
+        chunk.first.second = alignment.sequence().begin() + 4 * node_and_level.second + 3;
+        Mapping* mapping = chunk.second.add_mapping();
+        mapping->mutable_position()->set_node_id(graph.get_id(node_and_level.first));
+        mapping->mutable_position()->set_offset(1);
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(2);
+        edit->set_to_length(2);
+    }
+    
+    auto identity = MultipathAlignmentGraph::create_identity_projection_trans(graph);
+    
+    // connect every anchor to every anchor at a later level, which makes most of the edges transitive
+    auto make_graph = [&]() {
+        unique_ptr<TestMultipathAlignmentGraph> mpg(new TestMultipathAlignmentGraph(graph, path_chunks, alignment, identity));
+        REQUIRE(mpg->path_nodes.size() == anchored.size());
+        for (auto& from : mpg->path_nodes) {
+            from.edges.clear();
+            size_t from_level = (from.begin - alignment.sequence().begin()) / 4;
+            for (size_t j = 0; j < mpg->path_nodes.size(); ++j) {
+                size_t to_level = (mpg->path_nodes[j].begin - alignment.sequence().begin()) / 4;
+                if (to_level > from_level) {
+                    from.edges.emplace_back(j, 4 * (to_level - from_level) - 2);
+                }
+            }
+        }
+        return mpg;
+    };
+    
+    // get the edges as a sorted list of (from, to) pairs
+    auto get_edges = [](const TestMultipathAlignmentGraph& mpg) {
+        vector<pair<size_t, size_t>> edges;
+        for (size_t i = 0; i < mpg.path_nodes.size(); ++i) {
+            for (auto& edge : mpg.path_nodes[i].edges) {
+                edges.emplace_back(i, edge.first);
+            }
+        }
+        sort(edges.begin(), edges.end());
+        return edges;
+    };
+    
+    auto closure_mpg = make_graph();
+    auto search_mpg = make_graph();
+    size_t edges_before = closure_mpg->count_reachability_edges();
+    
+    vector<size_t> topological_order;
+    closure_mpg->topological_sort(topological_order);
+    closure_mpg->remove_transitive_edges(topological_order);
+    
+    // force the DFS from every edge
+    search_mpg->max_transitive_closure_words = 0;
+    search_mpg->topological_sort(topological_order);
+    search_mpg->remove_transitive_edges(topological_order);
+    
+    REQUIRE(get_edges(*closure_mpg) == get_edges(*search_mpg));
+    
+    // only the 8 edges between adjacent levels should be left
+    REQUIRE(closure_mpg->count_reachability_edges() < edges_before);
+    REQUIRE(closure_mpg->count_reachability_edges() == 8);
+    
+    SECTION("Building the closure in parallel tasks gives the same edges") {
+        auto parallel_mpg = make_graph();
+        parallel_mpg->min_nodes_for_parallel_passes = 1;
+        #pragma omp parallel num_threads(2)
+        #pragma omp single
+        {
+            parallel_mpg->topological_sort(topological_order);
+            parallel_mpg->remove_transitive_edges(topological_order);
+        }
+        REQUIRE(get_edges(*parallel_mpg) == get_edges(*closure_mpg));
+    }
+}
+
+TEST_CASE("Parallel passes split wide levels of a MultipathAlignmentGraph into blocks", "[multipathalignmentgraph]") {
+    
+    // A bubble with more alleles than fit in one parallel block, all of which match the read in
+    // the middle, so every allele gets an anchor at the same height
+    bdsg::HashGraph graph;
+    handle_t source = graph.create_handle("AAAA");
+    handle_t sink = graph.create_handle("TTTT");
+    vector<handle_t> alleles;
+    const string bases = "ACGT";
+    for (size_t i = 0; i < 100; ++i) {
+        string seq = string(1, bases[i % 4]) + "CC" + bases[(i / 4) % 4] + bases[(i / 16) % 4] + bases[(i / 64) % 4];
+        alleles.push_back(graph.create_handle(seq));
+        graph.create_edge(source, alleles.back());
+        graph.create_edge(alleles.back(), sink);
+    }
+    
+    Alignment alignment;
+    alignment.set_sequence("AAAA" + graph.get_sequence(alleles.front()) + "TTTT");
+    
+    vector<pair<pair<string::const_iterator, string::const_iterator>, Path>> path_chunks;
+    auto add_anchor = [&](const handle_t& handle, size_t read_offset) {
+        path_chunks.emplace_back();
+        auto& chunk = path_chunks.back();
+        chunk.first.first = alignment.sequence().begin() + read_offset + 1;
+        chunk.first.second = alignment.sequence().begin() + read_offset + 3;
+        Mapping* mapping = chunk.second.add_mapping();
+        mapping->mutable_position()->set_node_id(graph.get_id(handle));
+        mapping->mutable_position()->set_offset(1);
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(2);
+        edit->set_to_length(2);
+    };
+    add_anchor(source, 0);
+    for (const handle_t& allele : alleles) {
+        add_anchor(allele, 4);
+    }
+    add_anchor(sink, 10);
+    
+    TestAligner test_aligner;
+    auto aligner = test_aligner.get_regular_aligner();
+    auto identity = MultipathAlignmentGraph::create_identity_projection_trans(graph);
+    
+    // run the passes, either serially or splitting them into tasks
+    auto run_passes = [&](size_t min_nodes_for_parallel_passes, size_t& edges_out, multipath_alignment_t& mp_aln_out) {
+        #pragma omp parallel num_threads(2)
+        #pragma omp single
+        {
+            TestMultipathAlignmentGraph mpg(graph, path_chunks, alignment, identity);
+            REQUIRE(mpg.path_nodes.size() == alleles.size() + 2);
+            mpg.min_nodes_for_parallel_passes = min_nodes_for_parallel_passes;
+            
+            vector<size_t> topological_order;
+            mpg.topological_sort(topological_order);
+            mpg.remove_transitive_edges(topological_order);
+            edges_out = mpg.count_reachability_edges();
+            
+            mpg.align(alignment, graph, aligner, true, 2, false, 100, 0.0, true, 0, 1, mp_aln_out);
+        }
+    };
+    
+    size_t serial_edges, parallel_edges;
+    multipath_alignment_t serial_mp_aln, parallel_mp_aln;
+    run_passes(0, serial_edges, serial_mp_aln);
+    run_passes(4, parallel_edges, parallel_mp_aln);
+    
+    // only the edges into and out of the alleles are left
+    REQUIRE(serial_edges == 2 * alleles.size());
+    REQUIRE(parallel_edges == serial_edges);
+    REQUIRE(serial_mp_aln.subpath_size() > 0);
+    REQUIRE(debug_string(serial_mp_aln) == debug_string(parallel_mp_aln));
+}
+
 TEST_CASE("Tail alignments can be decomposed", "[multipathalignmentgraph]") {
     
     TestAligner test_aligner;
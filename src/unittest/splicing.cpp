@@ -5,6 +5,7 @@
 
 #include <iostream>
 #include <random>
+#include <sstream>
 
 #include "../splicing.hpp"
 #include "../multipath_mapper.hpp"
@@ -242,6 +243,164 @@ TEST_CASE("SpliceRegion can detect a splice sites across node boundaries going l
 
 }
 
+TEST_CASE("SpliceRegion takes splice sites from an annotated junction index",
+          "[splice]") {
+
+    HashGraph graph;
+
+    handle_t h0 = graph.create_handle("ACGTA");
+    handle_t h1 = graph.create_handle("GTCCCAG");
+    handle_t h2 = graph.create_handle("TTGCA");
+
+    graph.create_edge(h0, h1);
+    graph.create_edge(h1, h2);
+    graph.create_edge(h0, h2);
+
+    path_handle_t ref = graph.create_path_handle("ref");
+    graph.append_step(ref, h0);
+    graph.append_step(ref, h1);
+    graph.append_step(ref, h2);
+
+    vector<vector<handle_t>> transcripts{{h0, h2}, {h0, h1, h2}};
+    SpliceJunctionIndex junction_index(graph, transcripts);
+
+    vector<double> weights{1.0};
+    vector<pair<double, double>> params{{5.0, 2.0}};
+    TestAligner test_aligner;
+    vector<tuple<string, string, double>> table{make_tuple("GT", "AG", 1.0)};
+    SpliceStats splice_stats(table, weights, params, *test_aligner.get_regular_aligner());
+    DinucleotideMachine machine;
+
+    SECTION("The index contains both strands of the spliced junction") {
+
+        REQUIRE(junction_index.size() == 2);
+        REQUIRE(junction_index.intron_length(graph.get_id(h0), false, graph.get_id(h2), false) == 7);
+        REQUIRE(junction_index.intron_length(graph.get_id(h2), true, graph.get_id(h0), true) == 7);
+        REQUIRE(junction_index.intron_length(graph.get_id(h0), false, graph.get_id(h1), false) == -1);
+
+        auto junctions = junction_index.junctions_from(graph.get_id(h0), false);
+        REQUIRE(junctions.second - junctions.first == 1);
+        REQUIRE(junctions.first->left_motif() == "GT");
+        REQUIRE(junctions.first->right_motif() == "AG");
+
+        junctions = junction_index.junctions_to(graph.get_id(h0), true);
+        REQUIRE(junctions.second - junctions.first == 1);
+        REQUIRE(junctions.first->left_motif() == "CT");
+        REQUIRE(junctions.first->right_motif() == "AC");
+    }
+
+    SECTION("The index survives serialization") {
+
+        stringstream strm;
+        junction_index.serialize(strm);
+        SpliceJunctionIndex loaded;
+        loaded.deserialize(strm);
+
+        REQUIRE(loaded.size() == junction_index.size());
+        REQUIRE(loaded.intron_length(graph.get_id(h0), false, graph.get_id(h2), false) == 7);
+        REQUIRE(loaded.intron_length(graph.get_id(h2), true, graph.get_id(h0), true) == 7);
+    }
+
+    SECTION("A junction count larger than the file is reported as truncated") {
+
+        stringstream strm;
+        junction_index.serialize(strm);
+        string data = strm.str();
+        // claim far more junctions than the file holds
+        uint64_t count = numeric_limits<uint64_t>::max() / 2;
+        data.replace(2 * sizeof(uint64_t), sizeof(count), (const char*) &count, sizeof(count));
+        stringstream corrupt(data);
+        SpliceJunctionIndex loaded;
+        REQUIRE_THROWS_AS(loaded.deserialize(corrupt), runtime_error);
+    }
+
+    SECTION("SpliceRegion finds the annotated donor") {
+
+        pos_t pos(graph.get_id(h0), false, 2);
+        SpliceRegion splice_region(pos, false, 4, graph, machine, splice_stats, &junction_index);
+
+        REQUIRE(splice_region.is_annotated());
+        auto m0 = splice_region.candidate_splice_sites(0);
+        // the annotated site, and then the unannotated motif inside the upstream node, but
+        // not the motif at the annotated site again
+        REQUIRE(m0.size() == 2);
+        REQUIRE(splice_region.get_subgraph().get_underlying_handle(get<0>(m0.front())) == h0);
+        REQUIRE(get<1>(m0.front()) == 5);
+        REQUIRE(get<2>(m0.front()) == 3);
+        REQUIRE(splice_region.get_subgraph().get_underlying_handle(get<0>(m0.back())) == h0);
+        REQUIRE(get<1>(m0.back()) == 2);
+        REQUIRE(get<2>(m0.back()) == 0);
+        REQUIRE(splice_region.candidate_splice_sites(1).empty());
+    }
+
+    SECTION("SpliceRegion finds the annotated acceptor") {
+
+        pos_t pos(graph.get_id(h2), false, 2);
+        SpliceRegion splice_region(pos, true, 4, graph, machine, splice_stats, &junction_index);
+
+        REQUIRE(splice_region.is_annotated());
+        auto m0 = splice_region.candidate_splice_sites(0);
+        REQUIRE(m0.size() == 1);
+        // the motif at the end of the intron is the annotated site, so it isn't found again
+        REQUIRE(splice_region.get_subgraph().get_underlying_handle(get<0>(m0.front())) == h2);
+        REQUIRE(get<1>(m0.front()) == 0);
+        REQUIRE(get<2>(m0.front()) == 2);
+    }
+
+    SECTION("SpliceRegion falls back to motif search away from annotated junctions") {
+
+        pos_t pos(graph.get_id(h1), false, 0);
+        SpliceRegion splice_region(pos, false, 4, graph, machine, splice_stats, &junction_index);
+
+        REQUIRE(!splice_region.is_annotated());
+        auto m0 = splice_region.candidate_splice_sites(0);
+        REQUIRE(m0.size() == 1);
+        REQUIRE(get<1>(m0.front()) == 0);
+    }
+}
+
+TEST_CASE("Splice junction index ignores embedded transcript paths", "[splice]") {
+
+    HashGraph graph;
+
+    handle_t h0 = graph.create_handle("ACGTA");
+    handle_t h1 = graph.create_handle("GTCCCAG");
+    handle_t h2 = graph.create_handle("TTGCA");
+
+    graph.create_edge(h0, h1);
+    graph.create_edge(h1, h2);
+    graph.create_edge(h0, h2);
+
+    // embed the transcripts first, the way vg rna does, so that their steps are seen first
+    vector<vector<handle_t>> transcripts{{h0, h2}, {h0, h1, h2}};
+    unordered_set<string> transcript_names;
+    for (size_t i = 0; i < transcripts.size(); ++i) {
+        string name = "transcript" + to_string(i);
+        path_handle_t path = graph.create_path_handle(name);
+        for (handle_t handle : transcripts[i]) {
+            graph.append_step(path, handle);
+        }
+        transcript_names.insert(name);
+    }
+
+    // another reference path that takes the spliced edge directly
+    path_handle_t alt = graph.create_path_handle("alt");
+    graph.append_step(alt, h0);
+    graph.append_step(alt, h2);
+
+    path_handle_t ref = graph.create_path_handle("ref");
+    graph.append_step(ref, h0);
+    graph.append_step(ref, h1);
+    graph.append_step(ref, h2);
+
+    SpliceJunctionIndex junction_index(graph, transcripts, transcript_names);
+
+    REQUIRE(junction_index.size() == 2);
+    REQUIRE(junction_index.intron_length(graph.get_id(h0), false, graph.get_id(h2), false) == 7);
+    REQUIRE(junction_index.intron_length(graph.get_id(h2), true, graph.get_id(h0), true) == 7);
+    REQUIRE(junction_index.intron_length(graph.get_id(h0), false, graph.get_id(h1), false) == -1);
+}
+
 TEST_CASE("Softclip trimming works on a simple example",
           "[splice]") {
     
@@ -5,6 +5,8 @@
 ///
 
 #include <iostream>
+#include <fstream>
+#include <numeric>
 #include "catch.hpp"
 #include "../stream_index.hpp"
 #include <vg/io/stream.hpp>
@@ -247,6 +249,46 @@ TEST_CASE("StreamIndexBase can look up inserted ranges", "[gam][gamindex]") {
     
 }
 
+TEST_CASE("GAMIndex can be memory-mapped from a file and still work", "[gam][gamindex]") {
+    GAMIndex build_index;
+    build_index.add_group(1, 5, 0, 100);
+    build_index.add_group(3, 7, 100, 200);
+    build_index.add_group(6, 9, 200, 300);
+    build_index.add_group(7, 8, 300, 400);
+    build_index.add_group(100, 110, 400, 500);
+    build_index.add_group(1000, 1005, 500, 600);
+    
+    string filename = temp_file::create();
+    {
+        ofstream out(filename);
+        build_index.save(out);
+    }
+    
+    GAMIndex index;
+    index.load(filename);
+    
+    // The mapped index should answer the same as the one we built
+    for (id_t node_id : {1, 7, 9, 105, 500, 1000}) {
+        REQUIRE(index.find(node_id) == build_index.find(node_id));
+    }
+    
+    // And it should save back out the same
+    stringstream built_data;
+    build_index.save(built_data);
+    stringstream mapped_data;
+    index.save(mapped_data);
+    REQUIRE(mapped_data.str() == built_data.str());
+    
+    // We should still be able to add groups after the existing ones
+    index.add_group(2000, 2001, 600, 700);
+    auto found = index.find(2000);
+    REQUIRE(found.size() == 1);
+    REQUIRE(found.front() == make_pair<int64_t, int64_t>(600, 700));
+    REQUIRE(index.find(7) == build_index.find(7));
+    
+    temp_file::remove(filename);
+}
+
 TEST_CASE("GAMindex can be serialized and deserialized and still work", "[gam][gamindex]") {
     // Make an empty index
     GAMIndex build_index;
@@ -408,6 +450,25 @@ TEST_CASE("GAMIndex can work with ProtobufIterator cursors", "[gam][gamindex]")
     
     REQUIRE(recovered == total_found);
     
+    // And when querying them as a batch, each alignment should come back for its range.
+    vector<vector<pair<id_t, id_t>>> queries;
+    for (auto& range : ranges) {
+        queries.push_back({range});
+    }
+    // Also ask for everything at once, which overlaps all the other queries
+    queries.push_back(ranges);
+    vector<size_t> batch_found(queries.size(), 0);
+    index.find_batch(cursor, queries, [&](size_t query, const Alignment& found) {
+        id_t node_id = found.path().mapping(0).position().node_id();
+        REQUIRE(node_id >= queries[query].front().first);
+        REQUIRE(node_id <= queries[query].back().second);
+        batch_found[query]++;
+    });
+    
+    REQUIRE(batch_found.back() == total_found);
+    batch_found.pop_back();
+    REQUIRE(std::accumulate(batch_found.begin(), batch_found.end(), (size_t) 0) == total_found);
+    
 }
 
 
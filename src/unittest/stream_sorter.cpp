@@ -0,0 +1,71 @@
+///
+///  \file stream_sorter.cpp
+///
+///  Unit tests for the StreamSorter which sorts GAM files by node ID
+///
+
+#include <iostream>
+#include <sstream>
+#include <set>
+#include "catch.hpp"
+#include "../stream_sorter.hpp"
+#include <vg/io/stream.hpp>
+#include "../utility.hpp"
+
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("GAM files can be stream sorted through several merge passes", "[gam][gamindex]") {
+
+    // Make an unsorted GAM with a few thousand reads
+    stringstream unsorted;
+    size_t read_count = 5000;
+    multiset<string> names_in;
+    {
+        vector<Alignment> alns;
+        for (size_t i = 0; i < read_count; i++) {
+            alns.emplace_back();
+            Alignment& aln = alns.back();
+            aln.set_name("read" + to_string(i));
+            aln.set_sequence(random_sequence(20));
+            id_t node_id = (i * 7919) % read_count + 1;
+            for (id_t offset : {0, 1}) {
+                auto* mapping = aln.mutable_path()->add_mapping();
+                mapping->mutable_position()->set_node_id(node_id + offset);
+            }
+            names_in.insert(aln.name());
+        }
+        vg::io::write_buffered(unsorted, alns, 0);
+    }
+
+    stringstream sorted;
+    {
+        GAMSorter sorter;
+        // Make chunks of a few dozen reads, so we get over a hundred temp
+        // files, and merge them 3 at a time, so it takes several passes to
+        // get down to one.
+        sorter.set_max_buf_size(2 * 1024);
+        sorter.set_max_fan_in(3);
+        sorter.stream_sort(unsorted, sorted);
+    }
+
+    // Everything should come back out exactly once, in order
+    multiset<string> names_out;
+    id_t last_min = 0;
+    vg::io::for_each<Alignment>(sorted, [&](Alignment& aln) {
+        id_t min_id = numeric_limits<id_t>::max();
+        for (auto& mapping : aln.path().mapping()) {
+            min_id = min(min_id, mapping.position().node_id());
+        }
+        REQUIRE(min_id >= last_min);
+        last_min = min_id;
+        names_out.insert(aln.name());
+    });
+    REQUIRE(names_out == names_in);
+}
+
+}
+}
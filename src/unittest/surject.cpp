@@ -22,6 +22,8 @@ public:
     
     using Surjector::extract_overlapping_paths;
     using Surjector::filter_redundant_path_chunks;
+    using Surjector::get_path_interval_graph;
+    using Surjector::PathIntervalGraph;
     
 };
 
@@ -125,6 +127,111 @@ TEST_CASE( "Spliced surject algorithm preserves deletions against the path", "[s
     REQUIRE(rev_surjected.refpos(0).name() == graph.get_path_name(p));
     REQUIRE(rev_surjected.refpos(0).offset() == 0);
     
+    // surjecting again uses the cached path graphs and should not change anything
+    REQUIRE(surjector.surject(read, paths, true, true).SerializeAsString() == surjected.SerializeAsString());
+    REQUIRE(surjector.surject(rev_read, paths, true, true).SerializeAsString() == rev_surjected.SerializeAsString());
+    
+    Surjector uncached_surjector(&pos_graph);
+    uncached_surjector.path_graph_cache_size = 0;
+    REQUIRE(uncached_surjector.surject(read, paths, true, true).SerializeAsString() == surjected.SerializeAsString());
+    REQUIRE(uncached_surjector.surject(rev_read, paths, true, true).SerializeAsString() == rev_surjected.SerializeAsString());
+}
+
+TEST_CASE( "Surjector shares path graphs between reads in the same window", "[surject]" ) {
+    
+    // a 300 bp path of 10 bp nodes, with SNPs off the path on two of them
+    bdsg::HashGraph graph;
+    path_handle_t p = graph.create_path_handle("p");
+    vector<handle_t> path_nodes;
+    uint64_t state = 12345;
+    for (size_t i = 0; i < 30; ++i) {
+        string seq;
+        for (size_t j = 0; j < 10; ++j) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            seq.push_back("ACGT"[state >> 62]);
+        }
+        path_nodes.push_back(graph.create_handle(seq));
+        if (i != 0) {
+            graph.create_edge(path_nodes[i - 1], path_nodes[i]);
+        }
+        graph.append_step(p, path_nodes[i]);
+    }
+    unordered_map<size_t, handle_t> snp_nodes;
+    for (size_t i : {5, 15}) {
+        string seq = graph.get_sequence(path_nodes[i]);
+        seq[4] = (seq[4] == 'A' ? 'C' : 'A');
+        snp_nodes[i] = graph.create_handle(seq);
+        graph.create_edge(path_nodes[i - 1], snp_nodes[i]);
+        graph.create_edge(snp_nodes[i], path_nodes[i + 1]);
+    }
+    
+    bdsg::PositionOverlay pos_graph(&graph);
+    
+    SECTION("Intervals in the same window get the same graph") {
+        TestSurjector surjector(&pos_graph);
+        surjector.path_graph_window = 100;
+        
+        auto first_graph = surjector.get_path_interval_graph(&pos_graph, p, 12, 40);
+        REQUIRE(first_graph->first == 0);
+        REQUIRE(first_graph->last == 99);
+        REQUIRE(first_graph->graph.get_total_length() == 100);
+        
+        REQUIRE(surjector.get_path_interval_graph(&pos_graph, p, 55, 90) == first_graph);
+        
+        // crossing into the next window gets both windows
+        auto straddling_graph = surjector.get_path_interval_graph(&pos_graph, p, 95, 120);
+        REQUIRE(straddling_graph != first_graph);
+        REQUIRE(straddling_graph->first == 0);
+        REQUIRE(straddling_graph->last == 199);
+        
+        // the last window stops at the end of the path
+        auto last_graph = surjector.get_path_interval_graph(&pos_graph, p, 250, 260);
+        REQUIRE(last_graph->first == 200);
+        REQUIRE(last_graph->last == 299);
+        REQUIRE(last_graph->graph.get_total_length() == 100);
+    }
+    
+    SECTION("Intervals are exact without the cache") {
+        TestSurjector surjector(&pos_graph);
+        surjector.path_graph_cache_size = 0;
+        
+        auto path_graph = surjector.get_path_interval_graph(&pos_graph, p, 12, 40);
+        REQUIRE(path_graph->first == 12);
+        REQUIRE(path_graph->last == 40);
+        REQUIRE(path_graph->graph.get_total_length() == 40);
+    }
+    
+    SECTION("Realigning against a shared window gives the same surjections") {
+        Surjector surjector(&pos_graph);
+        Surjector uncached_surjector(&pos_graph);
+        uncached_surjector.path_graph_cache_size = 0;
+        
+        unordered_set<path_handle_t> paths{p};
+        for (size_t snp : {5, 15}) {
+            // a read across the SNP, which has to be realigned onto the path
+            Alignment read;
+            string seq;
+            Path* rpath = read.mutable_path();
+            for (size_t i = snp - 2; i <= snp + 2; ++i) {
+                handle_t h = (i == snp ? snp_nodes[snp] : path_nodes[i]);
+                Mapping* m = rpath->add_mapping();
+                m->set_rank(rpath->mapping_size());
+                m->mutable_position()->set_node_id(graph.get_id(h));
+                Edit* e = m->add_edit();
+                e->set_from_length(graph.get_length(h));
+                e->set_to_length(graph.get_length(h));
+                seq += graph.get_sequence(h);
+            }
+            read.set_sequence(seq);
+            read.set_score(Aligner().score_contiguous_alignment(read));
+            
+            Alignment surjected = surjector.surject(read, paths);
+            REQUIRE(surjected.path().mapping_size() == 5);
+            REQUIRE(surjected.path().mapping(2).position().node_id() == graph.get_id(path_nodes[snp]));
+            REQUIRE(surjected.score() == read.score() - Aligner().mismatch - Aligner().match);
+            REQUIRE(surjected.SerializeAsString() == uncached_surjector.surject(read, paths).SerializeAsString());
+        }
+    }
 }
 
 TEST_CASE( "Spliced surject algorithm works when a read touches the same path in both orientations", "[surject]" ) {
@@ -458,6 +565,43 @@ TEST_CASE("Path overlapping segments can be identified from multipath alignment"
             }
         }
     }
+    
+    SECTION("The surjection path index finds the same segments and connections") {
+        
+        SurjectionPathIndex path_index(&pos_graph, surjection_paths);
+        
+        REQUIRE(path_index.covers(surjection_paths));
+        REQUIRE(path_index.size() == 5);
+        REQUIRE(path_index.get_position_of_step(graph.get_id(h1), st0) == 0);
+        REQUIRE(path_index.get_position_of_step(graph.get_id(h4), st2) == 6);
+        REQUIRE(path_index.get_position_of_step(graph.get_id(h6), st4) == 15);
+        
+        TestSurjector indexed_surjector(&pos_graph);
+        indexed_surjector.path_index = &path_index;
+        
+        unordered_map<pair<path_handle_t, bool>, vector<tuple<size_t, size_t, int32_t>>> connections;
+        unordered_map<pair<path_handle_t, bool>, vector<tuple<size_t, size_t, int32_t>>> indexed_connections;
+        
+        auto overlaps = surjector.extract_overlapping_paths(&pos_graph, mp_aln,
+                                                            surjection_paths,
+                                                            connections);
+        auto indexed_overlaps = indexed_surjector.extract_overlapping_paths(&pos_graph, mp_aln,
+                                                                            surjection_paths,
+                                                                            indexed_connections);
+        
+        REQUIRE(indexed_overlaps.size() == overlaps.size());
+        for (auto& record : overlaps) {
+            REQUIRE(indexed_overlaps.count(record.first));
+            auto& indexed_record = indexed_overlaps[record.first];
+            REQUIRE(indexed_record.first.size() == record.second.first.size());
+            for (size_t i = 0; i < record.second.first.size(); ++i) {
+                REQUIRE(indexed_record.first[i].first == record.second.first[i].first);
+                REQUIRE(indexed_record.first[i].second.SerializeAsString() == record.second.first[i].second.SerializeAsString());
+            }
+            REQUIRE(indexed_record.second == record.second.second);
+        }
+        REQUIRE(indexed_connections == connections);
+    }
 }
 
 TEST_CASE("Multipath alignments can be surjected", "[surject][multipath]") {
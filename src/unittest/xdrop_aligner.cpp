@@ -140,6 +140,50 @@ TEST_CASE("XdropAligner can compute an alignment with a MEM in the middle", "[xd
     REQUIRE(aln.path().mapping(2).position().node_id() == n3->id());
 }
 
+TEST_CASE("XdropAligner can reuse a packed graph across alignments", "[xdrop][alignment][mapping]") {
+    
+    VG graph;
+    
+    TestAligner aligner_source;
+    aligner_source.set_alignment_scores(1, 4, 6, 1, 0);
+    const Aligner& aligner = *aligner_source.get_regular_aligner();
+    
+    Node* n0 = graph.create_node("AGTG");
+    Node* n1 = graph.create_node("C");
+    Node* n2 = graph.create_node("A");
+    Node* n3 = graph.create_node("TGAAGT");
+    
+    graph.create_edge(n0, n1);
+    graph.create_edge(n0, n2);
+    graph.create_edge(n1, n3);
+    graph.create_edge(n2, n3);
+    
+    vector<handle_t> order = handlealgs::lazier_topological_order(&graph);
+    DozeuInterface::OrderedGraph packed(graph, order);
+    
+    REQUIRE(packed.size() == 4);
+    REQUIRE(packed.total_length() == 12);
+    
+    vector<MaximalExactMatch> no_mems;
+    
+    for (string read : {string("AGTGCTGAAGT"), string("AGTGATGAAGT"), string("AGTGCTGAAGT")}) {
+        Alignment direct;
+        direct.set_sequence(read);
+        aligner.align_xdrop(direct, graph, order, no_mems, false);
+        
+        Alignment reused;
+        reused.set_sequence(read);
+        aligner.align_xdrop(reused, packed, no_mems, false);
+        
+        REQUIRE(reused.score() == read.size());
+        REQUIRE(reused.score() == direct.score());
+        REQUIRE(reused.path().mapping_size() == 3);
+        for (size_t i = 0; i < reused.path().mapping_size(); i++) {
+            REQUIRE(reused.path().mapping(i).position().node_id() == direct.path().mapping(i).position().node_id());
+        }
+    }
+}
+
 TEST_CASE("XdropAligner still incorrectly applies the full length bonus at only one end with a MEM", "[xdrop][alignment][mapping]") {
     
     VG graph;
@@ -47,7 +47,7 @@ void Watchdog::check_in(size_t thread, const string& task) {
     t.checkin_high_water_kb = memory_high_water_kb;
 }
 
-void Watchdog::check_out(size_t thread) {
+Watchdog::duration Watchdog::check_out(size_t thread) {
     // Find the state for the thread we are talking about
     auto& t = state.at(thread); 
 
@@ -61,11 +61,12 @@ void Watchdog::check_out(size_t thread) {
             " but is trying to check out again!");
     }
     
+    // How long was the thread checked in?
+    auto checked_in_duration = clock::now() - t.last_checkin;
+    
     if (t.timed_out) {
         // The thread already hit the timeout and we reported a warning. We should follow up.
         
-        // How long was the thread checked in?
-        auto checked_in_duration = clock::now() - t.last_checkin;
         auto checked_in_seconds = chrono::duration_cast<chrono::seconds>(checked_in_duration);
         
         // While it was checked in, how much did the high water memory usage mark rise
@@ -79,6 +80,8 @@ void Watchdog::check_out(size_t thread) {
     
     // Record the checkout
     t.is_checked_in = false;
+    
+    return checked_in_duration;
 }
 
 void Watchdog::watcher_loop() {
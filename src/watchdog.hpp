@@ -54,9 +54,10 @@ public:
     void check_in(size_t thread, const string& task);
     
     /**
-     * Check the given thread out of the task it is checked in for.
+     * Check the given thread out of the task it is checked in for. Returns
+     * how long the thread was checked in, so callers can act on slow tasks.
      */
-    void check_out(size_t thread);
+    duration check_out(size_t thread);
     
 private:
     // Since we are accessed by the watcher thread, we can't be copied or moved
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 29
+plan tests 31
 
 vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz >x.vg
 is $? 0 "construction"
@@ -66,7 +66,12 @@ vg gamsort -i x.sorted.gam.gai x.gam > x.sorted.gam
 is $(vg find -o 127 --sorted-gam x.sorted.gam | vg view -a - | wc -l) 6 "the GAM index can return the set of alignments mapping to a node"
 is $(vg find -A <(vg find -N <(seq 37 52 ) -x x.xg ) --sorted-gam x.sorted.gam | vg view -a - | wc -l) 15 "a subgraph query may be used to obtain a particular subset of alignments from a sorted GAM"
 
-rm -rf x.gam x.sorted.gam x.sorted.gam.gai
+vg convert x.xg -G x.gam > x.gaf
+vg gamsort -G -i x.sorted.gaf.gz.gai x.gaf > x.sorted.gaf.gz
+is "$(vg find -o 127 --sorted-gam x.sorted.gaf.gz | cut -f1 | sort | md5sum)" "$(vg find -o 127 --sorted-gam x.sorted.gam | vg view -aj - | jq -r '.name' | sort | md5sum)" "the GAF index returns the same alignments mapping to a node as the GAM index"
+is "$(vg find -A <(vg find -N <(seq 37 52 ) -x x.xg ) --sorted-gam x.sorted.gaf.gz | cut -f1 | sort | md5sum)" "$(vg find -A <(vg find -N <(seq 37 52 ) -x x.xg ) --sorted-gam x.sorted.gam | vg view -aj - | jq -r '.name' | sort | md5sum)" "a subgraph query returns the same alignments from a sorted GAF as from a sorted GAM"
+
+rm -rf x.gam x.sorted.gam x.sorted.gam.gai x.gaf x.sorted.gaf.gz x.sorted.gaf.gz.gai
 
 is $(vg find -G small/x-s1337-n1.gam -x x.xg | vg view - | grep ATTAGCCATGTGACTTTGAACAAGTTAGTTAATCTCTCTGAACTTCAGTT | wc -l) 1 "the index can be queried using GAM alignments"
 
@@ -7,7 +7,7 @@ PATH=../bin:$PATH # for vg
 
 export LC_ALL="en_US.utf8" # force ekg's favorite sort order
 
-plan tests 54
+plan tests 59
 
 # Single graph without haplotypes
 vg construct -r small/x.fa -v small/x.vcf.gz > x.vg
@@ -174,6 +174,9 @@ vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg x.vg bogus123.vg 2>/dev/null
 is $? 1 "fail with nonexistent file"
 
+vg index -x x.xg --mem-accel 4 x.vg 2>/dev/null
+is $? 1 "a MEM accelerator table can't be built without a GCSA2 index"
+
 vg kmers -k 16 -gB x.vg >x.graph
 vg index -i x.graph -g x.gcsa
 is $? 0 "a prebuilt deBruijn graph in GCSA2 format may be used"
@@ -190,6 +193,24 @@ is "$(md5sum <x1337.sorted.gam.gai)" "$(md5sum <x1337.sorted.gam.gai2)" "vg inde
 
 rm -rf x1337.gam x1337.sorted.gam.gai2 x1337.sorted.gam.gai x1337.sorted.gam
 
+# A saved MEM accelerator table is used by mpmap and doesn't change its results
+vg sim -x x.xg -n 20 -l 50 -e 0.01 -s 1 -a > sim.gam
+vg mpmap -x x.xg -g x.gcsa -G sim.gam -F GAM -t 1 2> /dev/null | vg view -aj - > memoized.json
+vg index -g x.gcsa -k 11 --mem-accel 6 x.vg
+is $? 0 "a MEM accelerator table can be saved with the GCSA2 index"
+vg mpmap -x x.xg -g x.gcsa -G sim.gam -F GAM -t 1 2> mema.log | vg view -aj - > mema.json
+is "$(grep -c "Loading MEM accelerator" mema.log)" "1" "mpmap loads a saved MEM accelerator table"
+is "$(md5sum < mema.json)" "$(md5sum < memoized.json)" "mpmap gives the same alignments with a saved MEM accelerator table"
+
+# A table left over from another GCSA2 index is rejected
+vg construct -r small/x.fa > x_ref.vg
+vg index -g x_ref.gcsa -k 11 --mem-accel 6 x_ref.vg
+mv x_ref.gcsa.mema x.gcsa.mema
+vg mpmap -x x.xg -g x.gcsa -G sim.gam -F GAM -t 1 > /dev/null 2> mema.log
+is $? 1 "mpmap rejects a MEM accelerator table built from another GCSA2 index"
+
+rm -f sim.gam memoized.json mema.json mema.log x.gcsa.mema x_ref.vg x_ref.gcsa x_ref.gcsa.lcp
+
 
 vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
 vg construct -r small/x.fa -v small/x.vcf.gz >y.vg
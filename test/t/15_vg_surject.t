@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 47
+plan tests 48
 
 vg construct -r small/x.fa >j.vg
 vg index -x j.xg j.vg
@@ -106,7 +106,10 @@ vg surject -p x -x x.xg -i read.gam -s > read.gam.surject.sam
 vg convert x.xg -G read.gam -t 1 | vg surject -p x -x x.xg -i -G - -s > read.gaf.surject.sam
 diff read.gam.surject.sam read.gaf.surject.sam
 is $? 0 "interleaved surjection produces same SAM when using GAF and GAM inputs"
-rm -f read.gam.surject.sam read.gaf.surject.sam
+vg convert x.xg -G read.gam -t 1 | vg surject -p x -x x.xg -i -G --pipeline -t 3 - -s > read.gaf.pipeline.sam
+diff read.gam.surject.sam read.gaf.pipeline.sam
+is $? 0 "pipelined interleaved surjection keeps GAF pairs together"
+rm -f read.gam.surject.sam read.gaf.surject.sam read.gaf.pipeline.sam
 
 vg map -d x -iG <(vg view -a small/x-s13241-n1-p500-v300.gam | sed 's%_1%/1%' | sed 's%_2%/2%' | vg view -JaG - ) | vg surject -x x.xg -p x -s -i -N Sample1 -R RG1 - >surjected.sam
 is "$(cat surjected.sam | grep -v '^@' | sort | cut -f 4)" "$(printf '321\n762')" "surjection of paired reads to SAM yields correct positions"
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 13
+plan tests 17
 
 vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg  x.vg
@@ -28,6 +28,25 @@ fi
 is "${OUT_OF_RANGE}" "0" "vg filter downsamples correctly"
 
 
+# Filters that only need some fields of each read shouldn't change the answer
+vg filter -r 90 -P -d 0.5 x.gam | vg view -aj - | jq -rc '.name' | sort > partial.txt
+vg filter -r 90 -P -d 0.5 -o 1000 x.gam | vg view -aj - | jq -rc '.name' | sort > full.txt
+is "$(md5sum < partial.txt)" "$(md5sum < full.txt)" "filtering on decoded fields agrees with filtering whole reads"
+
+vg convert x.xg -G x.gam > x.gaf
+vg filter -r 90 -P -d 0.5 x.gaf | cut -f1 | sort > gaf.txt
+is "$(md5sum < gaf.txt)" "$(md5sum < full.txt)" "GAF input can be filtered without converting it"
+
+# MAPQ filters agree between GAM and GAF, and GAF's missing MAPQ of 255 counts as 0 like an unset GAM MAPQ
+(vg view -aj x.gam | head -n 100 | jq -c '.mapping_quality = 30'; vg view -aj x.gam | tail -n +101) | vg view -JaG - > mapq.gam
+vg convert x.xg -G mapq.gam > mapq.gaf
+vg filter -q 10 mapq.gam | vg view -aj - | jq -rc '.name' | sort > mapq_gam.txt
+vg filter -q 10 mapq.gaf | cut -f1 | sort > mapq_gaf.txt
+is "$(md5sum < mapq_gaf.txt)" "$(md5sum < mapq_gam.txt)" "GAF and GAM input agree on MAPQ filtering"
+is "$(awk 'BEGIN {FS = OFS = "\t"} {$12 = 255; print}' mapq.gaf | vg filter -G -q 1 - | wc -l)" "0" "a missing GAF MAPQ doesn't pass a MAPQ filter"
+
+rm -f partial.txt full.txt gaf.txt x.gaf mapq.gam mapq.gaf mapq_gam.txt mapq_gaf.txt
+
 cp small/x-s1-l100-n100-p50.gam paired.gam
 cp small/x-s1-l100-n100.gam single.gam
 
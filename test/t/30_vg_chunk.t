@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 32
+plan tests 34
 
 # Construct a graph with alt paths so we can make a GBWT and a GBZ
 vg construct -m 1000 -r small/x.fa -v small/x.vcf.gz -a >x.vg
@@ -51,6 +51,15 @@ is "$(vg view -aj _chunk_test_0_x_0_199.gam | wc -l)" "$(vg view -aj _chunk_test
 is "$(vg view -aj _chunk_test_1_x_500_627.gam | wc -l)" "225" "chunk contains the expected number of alignments"
 rm -f _chunk_test*
 
+#check that a sorted, indexed GAF is chunked into the same reads as the GAM
+vg convert x.xg -G x.sorted.gam > x.gaf
+vg gamsort -G -i x.sorted.gaf.gz.gai x.gaf > x.sorted.gaf.gz
+vg chunk -x x.xg -a x.sorted.gam -b _chunk_test_gam -e _chunk_test_bed.bed -c 0
+vg chunk -x x.xg -a x.sorted.gaf.gz -b _chunk_test_gaf -e _chunk_test_bed.bed -c 0
+is $(ls -l _chunk_test_gaf*.gaf | wc -l) 2 "GAF chunker produces correct number of GAFs"
+is "$(cut -f1 _chunk_test_gaf_1_x_500_627.gaf | sort | md5sum)" "$(vg view -aj _chunk_test_gam_1_x_500_627.gam | jq -r '.name' | sort | md5sum)" "GAF chunk contains the same alignments as the GAM chunk"
+rm -f _chunk_test* x.gaf x.sorted.gaf.gz x.sorted.gaf.gz.gai
+
 #check that we can chunk by read count
 vg chunk -a small/x-l100-n1000-s10-e0.01-i0.01.gam -m 100 -b _chunk_test
 is $(ls -l _chunk_test*.gam | wc -l) 10 "simple gam chunker produces correct number of gams"
@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 2
+plan tests 4
 
 vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg  x.vg
@@ -22,5 +22,13 @@ is "$(md5sum <min_ids.gamsorted.txt)" "$(md5sum <min_ids.sorted.txt)" "Sorting a
 vg gamsort x.gam -i x.sorted.gam.gai >x.sorted.gam
 is "$?" "0" "sorted GAMs can be indexed during the sort"
 
+vg convert x.xg -G x.gam >x.gaf
+vg gamsort -G x.gaf -i x.sorted.gaf.gz.gai >x.sorted.gaf.gz
+is "$?" "0" "GAF files can be sorted and indexed"
+
+zcat <x.sorted.gaf.gz | cut -f6 | tr '<>' '  ' | awk '{min = $1; for (i = 2; i <= NF; i++) if ($i + 0 < min + 0) min = $i; print min}' >min_ids.gafsorted.txt
+is "$(md5sum <min_ids.gafsorted.txt)" "$(md5sum <min_ids.sorted.txt)" "Sorting a GAF orders the alignments by min node ID"
+
 
 rm -f x.vg x.xg x.gam x.sorted.gam x.sorted.2.gam min_ids.gamsorted.txt min_ids.sorted.txt x.sorted.gam.gai x.sorted.2.gam.gai
+rm -f x.gaf x.sorted.gaf.gz x.sorted.gaf.gz.gai min_ids.gafsorted.txt
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 50
+plan tests 52
 
 vg construct -a -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg x.vg
@@ -49,6 +49,11 @@ vg giraffe -Z x.giraffe.gbz -f reads/small.middle.ref.fq --full-l-bonus 0 > mapp
 is "$(vg view -aj  mapped-nobonus.gam | jq '.score')" "63" "Mapping without a full length bonus produces the correct score"
 rm -f mapped-nobonus.gam
 
+vg giraffe -Z x.giraffe.gbz -f reads/small.middle.ref.fq --full-l-bonus 0 --capture-slow slow.gam --capture-slow-seconds 0.000000001 >/dev/null
+is "$(vg view -aj slow.gam | wc -l)" "1" "a slow read can be captured"
+is "$(vg benchmark -G slow.gam -Z x.giraffe.gbz -m x.min -d x.dist | grep -v '^#' | cut -f4)" "63" "a captured read is replayed with the options it was captured with"
+rm -f slow.gam
+
 vg minimizer -k 29 -b -s 18 -d x.dist -g x.gbwt -o x.sync x.xg
 
 vg giraffe -x x.xg -H x.gbwt -m x.sync -d x.dist -f reads/small.middle.ref.fq > mapped.sync.gam